@@ -0,0 +1,133 @@
+#include "bit_parallel_ed.h"
+
+#include <immintrin.h>
+
+/// peq[c][w] has bit i set iff pattern[64 * w + i] == c. Bits at and above m
+/// are never read back: additions and shifts only carry towards higher bits.
+static void
+build_peq(const u8* pattern, const int m, u64 peq[4][BPED_MAX_WORDS])
+{
+    memset(peq, 0, sizeof(u64) * 4 * BPED_MAX_WORDS);
+    for (int i = 0; i < m; ++i) peq[pattern[i] & 3][i >> 6] |= U64_ONE << (i & 63);
+}
+
+int
+semi_global_edit_distance_scalar(const u8* pattern, const int m, const u8* text, const int n)
+{
+    hbn_assert(m > 0 && m <= BPED_MAX_PATTERN, "m = %d", m);
+    u64 peq[4][BPED_MAX_WORDS];
+    build_peq(pattern, m, peq);
+    const int nw = (m + 63) >> 6;
+    const int hw = (m - 1) >> 6;
+    const int hb = (m - 1) & 63;
+    u64 Pv[BPED_MAX_WORDS], Mv[BPED_MAX_WORDS], Ph[BPED_MAX_WORDS], Mh[BPED_MAX_WORDS];
+    for (int w = 0; w < nw; ++w) { Pv[w] = ~(u64)0; Mv[w] = 0; }
+    int score = m, min_score = m;
+
+    for (int j = 0; j < n; ++j) {
+        const u64* Eq = peq[text[j] & 3];
+        u64 carry = 0;
+        for (int w = 0; w < nw; ++w) {
+            /// Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq over the whole vector
+            const u64 x = Eq[w] & Pv[w];
+            const u64 s = x + Pv[w];
+            const u64 t = s + carry;
+            carry = (s < x) | (t < s);
+            const u64 Xh = (t ^ Pv[w]) | Eq[w];
+            Ph[w] = Mv[w] | ~(Xh | Pv[w]);
+            Mh[w] = Pv[w] & Xh;
+        }
+        score += (Ph[hw] >> hb) & 1;
+        score -= (Mh[hw] >> hb) & 1;
+        min_score = hbn_min(min_score, score);
+        /// the top row of the matrix is 0 (free start in the text),
+        /// so nothing is shifted into bit 0
+        u64 ph_in = 0, mh_in = 0;
+        for (int w = 0; w < nw; ++w) {
+            const u64 ph = Ph[w], mh = Mh[w];
+            const u64 Xv = Eq[w] | Mv[w];
+            Ph[w] = (ph << 1) | ph_in;
+            Mh[w] = (mh << 1) | mh_in;
+            ph_in = ph >> 63;
+            mh_in = mh >> 63;
+            Pv[w] = Mh[w] | ~(Xv | Ph[w]);
+            Mv[w] = Ph[w] & Xv;
+        }
+    }
+    return min_score;
+}
+
+/// a + b as one 256-bit integer. Lane i overflows (g) or is all ones and
+/// passes a carry on (p); the carries into the lanes are then the carry
+/// bits of the 4-bit addition (g | p) + g.
+__attribute__((target("avx2")))
+static inline __m256i
+add_u256(__m256i a, __m256i b)
+{
+    const __m256i sign = _mm256_set1_epi64x((long long)(U64_ONE << 63));
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    __m256i s = _mm256_add_epi64(a, b);
+    __m256i ovf = _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(s, sign));
+    __m256i all1 = _mm256_cmpeq_epi64(s, ones);
+    const int g = _mm256_movemask_pd(_mm256_castsi256_pd(ovf));
+    const int p = _mm256_movemask_pd(_mm256_castsi256_pd(all1));
+    const int c = (((g | p) + g) ^ p) & 0xf;
+    if (!c) return s;
+    __m256i cv = _mm256_and_si256(_mm256_set1_epi64x(c), lane_bits);
+    cv = _mm256_srli_epi64(_mm256_cmpeq_epi64(cv, lane_bits), 63);
+    return _mm256_add_epi64(s, cv);
+}
+
+/// x << 1 as one 256-bit integer
+__attribute__((target("avx2")))
+static inline __m256i
+shl1_u256(__m256i x)
+{
+    __m256i t = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0));
+    t = _mm256_blend_epi32(t, _mm256_setzero_si256(), 0x03);
+    return _mm256_or_si256(_mm256_slli_epi64(x, 1), _mm256_srli_epi64(t, 63));
+}
+
+__attribute__((target("avx2")))
+int
+semi_global_edit_distance_avx2(const u8* pattern, const int m, const u8* text, const int n)
+{
+    hbn_assert(m > 0 && m <= BPED_MAX_PATTERN, "m = %d", m);
+    u64 peq[4][BPED_MAX_WORDS];
+    build_peq(pattern, m, peq);
+    __m256i Peq[4];
+    for (int c = 0; c < 4; ++c) Peq[c] = _mm256_loadu_si256((const __m256i*)peq[c]);
+    u64 hbm[BPED_MAX_WORDS] = { 0 };
+    hbm[(m - 1) >> 6] = U64_ONE << ((m - 1) & 63);
+    const __m256i hbmask = _mm256_loadu_si256((const __m256i*)hbm);
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    __m256i Pv = ones;
+    __m256i Mv = _mm256_setzero_si256();
+    int score = m, min_score = m;
+
+    for (int j = 0; j < n; ++j) {
+        const __m256i Eq = Peq[text[j] & 3];
+        const __m256i Xv = _mm256_or_si256(Eq, Mv);
+        __m256i Xh = add_u256(_mm256_and_si256(Eq, Pv), Pv);
+        Xh = _mm256_or_si256(_mm256_xor_si256(Xh, Pv), Eq);
+        __m256i Ph = _mm256_or_si256(Mv, _mm256_xor_si256(_mm256_or_si256(Xh, Pv), ones));
+        __m256i Mh = _mm256_and_si256(Pv, Xh);
+        score += !_mm256_testz_si256(Ph, hbmask);
+        score -= !_mm256_testz_si256(Mh, hbmask);
+        min_score = hbn_min(min_score, score);
+        Ph = shl1_u256(Ph);
+        Mh = shl1_u256(Mh);
+        Pv = _mm256_or_si256(Mh, _mm256_xor_si256(_mm256_or_si256(Xv, Ph), ones));
+        Mv = _mm256_and_si256(Ph, Xv);
+    }
+    return min_score;
+}
+
+int
+semi_global_edit_distance(const u8* pattern, const int m, const u8* text, const int n)
+{
+    /// one word does not need the carries between lanes
+    if (m > 64 && hbn_get_simd_level() >= eSimdAvx2) return semi_global_edit_distance_avx2(pattern, m, text, n);
+    return semi_global_edit_distance_scalar(pattern, m, text, n);
+}
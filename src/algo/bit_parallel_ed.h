@@ -0,0 +1,39 @@
+#ifndef __BIT_PARALLEL_ED_H
+#define __BIT_PARALLEL_ED_H
+
+#include "../corelib/hbn_aux.h"
+#include "../corelib/hbn_simd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Myers' bit-vector edit distance (Myers 1999, Hyyro 2003).
+///
+/// The pattern is held as one (64 * BPED_MAX_WORDS)-bit vector, so every
+/// text base costs one wide addition, one wide shift and a few boolean ops
+/// regardless of the edit distance. The scalar kernel carries the addition
+/// and the shift through BPED_MAX_WORDS u64 words, the avx2 kernel keeps
+/// all the words in one register and resolves the carries between lanes
+/// with a 4-bit carry-lookahead. It is used at simd level eSimdAvx2.
+
+#define BPED_MAX_WORDS      4
+#define BPED_MAX_PATTERN    (64 * BPED_MAX_WORDS)
+
+/// smallest edit distance between pattern[0, m) and any substring of
+/// text[0, n), i.e. the pattern is aligned end to end and both ends of the
+/// text are free. Bases are unpacked (0, 1, 2, 3), 0 < m <= BPED_MAX_PATTERN.
+int
+semi_global_edit_distance(const u8* pattern, const int m, const u8* text, const int n);
+
+int
+semi_global_edit_distance_scalar(const u8* pattern, const int m, const u8* text, const int n);
+
+int
+semi_global_edit_distance_avx2(const u8* pattern, const int m, const u8* text, const int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BIT_PARALLEL_ED_H
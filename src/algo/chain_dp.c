@@ -2,6 +2,8 @@
 
 #include "../corelib/ksort.h"
 
+#include <immintrin.h>
+
 #define chain_seed_soff_lt(a, b) ( \
     ((a).soff < (b).soff) \
     || \
@@ -21,6 +23,9 @@ ChainWorkDataNew(int min_seed_cnt, int min_can_score)
     kv_init(data->seeds);
     kv_init(data->fwd_seeds);
     kv_init(data->rev_seeds);
+    kv_init(data->seed_qoff);
+    kv_init(data->seed_soff);
+    kv_init(data->seed_len);
 #if 0
     data->max_dist_qry = 3000;
     data->max_dist_ref = 3000;
@@ -47,6 +52,9 @@ ChainWorkDataFree(ChainWorkData* data)
     kv_destroy(data->seeds);
     kv_destroy(data->fwd_seeds);
     kv_destroy(data->rev_seeds);
+    kv_destroy(data->seed_qoff);
+    kv_destroy(data->seed_soff);
+    kv_destroy(data->seed_len);
     free(data); 
     return NULL;   
 }
@@ -78,8 +86,70 @@ static inline int ilog2_32(uint32_t v)
 	return (t = v>>8) ? 8 + LogTable256[t] : LogTable256[v];
 }
 
+/// score of chaining seed j in front of seed i (qi, ri, cov). Returns FALSE
+/// if j can not precede i.
+static inline BOOL
+chain_pair_score(const idx qi,
+    const idx ri,
+    const int cov,
+    const idx qj,
+    const idx rj,
+    const int lj,
+    const int fj,
+    const int max_dist_qry,
+    const int max_dist_ref,
+    const int band_width,
+    const int avg_cov,
+    const BOOL is_maximal_exact_match,
+    int* score)
+{
+    if (is_maximal_exact_match) {
+        if (qj + lj >= qi || rj + lj >= ri) return FALSE;
+    } else {
+        if (qj >= qi || rj >= ri) return FALSE;
+    }
+    idx dr = ri - rj;
+    idx dq = qi - qj;
+    int dd, sc, log_dd, min_d;
+    if (dr == 0 || dq <= 0) return FALSE;
+    if (dq > max_dist_qry || dr > max_dist_ref) return FALSE;
+    dd = (dr > dq) ? (dr - dq) : (dq - dr);
+    if (dd > band_width) return FALSE;
+    min_d = hbn_min(dq, dr);
+    sc = (min_d > cov) ? cov : hbn_min(dq, dr);
+    log_dd = dd ? ilog2_32(dd) : 0;
+    sc -= (int)(dd * .01 * avg_cov) + (log_dd>>1);
+    *score = sc + fj;
+    return TRUE;
+}
+
+/// keeps the best predecessor of seed i. Returns TRUE once more than
+/// max_skip predecessors that were already the best predecessor choice of
+/// a seed chained to i fail to improve the score.
+static inline BOOL
+update_chain_score(const int i,
+    const int j,
+    const int sc,
+    const int max_skip,
+    const int* p,
+    int* t,
+    int* max_f,
+    int* max_j,
+    int* n_skip)
+{
+    if (sc > *max_f) {
+        *max_f = sc;
+        *max_j = j;
+        if (*n_skip) --(*n_skip);
+    } else if (t[j] == i) {
+        if (++(*n_skip) > max_skip) return TRUE;
+    }
+    if (p[j] >= 0) t[p[j]] = i;
+    return FALSE;
+}
+
 static void
-scoring_chain_seeds(ChainWorkData* data, 
+scoring_chain_seeds_scalar(ChainWorkData* data, 
     const ChainSeed* seeds,
     const int n,
     const BOOL is_maximal_exact_match)
@@ -104,46 +174,169 @@ scoring_chain_seeds(ChainWorkData* data,
         idx qi = seeds[i].qoff;
         int max_j = -1;
         int cov = seeds[i].length;
-        int max_f = cov, n_skip = 0, min_d;
+        int max_f = cov, n_skip = 0, sc;
         while (st < i && ri > seeds[st].soff + max_dist_ref) ++st;
         for (int j = i - 1; j >= st; --j) {
-            //HBN_LOG("comparing");
-            //fprintf(stderr, "[%d, %d, %d] v.s. [%d, %d, %d]\n",
-            //    i, seeds[i].qoff, seeds[i].soff, j, seeds[j].qoff, seeds[j].sdir);
+            if (!chain_pair_score(qi, ri, cov, seeds[j].qoff, seeds[j].soff, seeds[j].length, f[j],
+                    max_dist_qry, max_dist_ref, band_width, avg_cov, is_maximal_exact_match, &sc)) continue;
+            if (update_chain_score(i, j, sc, max_skip, p, t, &max_f, &max_j, &n_skip)) break;
+        }
+        f[i] = max_f;
+        p[i] = max_j;
+        // v[i] keeps the peak score up to i;
+        // f[i] is the score ending at i, not always the peak score
+        v[i] = (max_j >= 0 && v[max_j] > max_f) ? v[max_j] : max_f;
+    }
+}
+
+/// Same results as scoring_chain_seeds_scalar(). The pair scores of eight
+/// predecessors are computed at once, windows of eight predecessors none of
+/// which can precede seed i are skipped, and the order dependent max_skip
+/// heuristic runs on the surviving predecessors from the highest index down.
+/// Offsets are rebased to int, the caller checks that they fit.
+__attribute__((target("avx2")))
+static void
+scoring_chain_seeds_avx2(ChainWorkData* data,
+    const ChainSeed* seeds,
+    const int n,
+    const BOOL is_maximal_exact_match,
+    const idx qoff_base,
+    const idx soff_base)
+{
+    const int max_dist_ref = data->max_dist_ref;
+    const int max_dist_qry = data->max_dist_qry;
+    const int band_width = data->max_band_width;
+    const int max_skip = data->max_skip;
+    int sum_cov = 0;
+    for (int i = 0; i < n; ++i) sum_cov += seeds[i].length;
+    const int avg_cov = sum_cov / n;
+    int st = 0;
+    ChainWorkDataSetup(data, n);
+    int* f = kv_data(data->f);
+    int* p = kv_data(data->p);
+    int* t = kv_data(data->t);
+    int* v = kv_data(data->v);
+    kv_resize(int, data->seed_qoff, n);
+    kv_resize(int, data->seed_soff, n);
+    kv_resize(int, data->seed_len, n);
+    int* qa = kv_data(data->seed_qoff);
+    int* ra = kv_data(data->seed_soff);
+    int* la = kv_data(data->seed_len);
+    for (int i = 0; i < n; ++i) {
+        qa[i] = seeds[i].qoff - qoff_base;
+        ra[i] = seeds[i].soff - soff_base;
+        la[i] = seeds[i].length;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max_dq_v = _mm256_set1_epi32(max_dist_qry);
+    const __m256i max_dr_v = _mm256_set1_epi32(max_dist_ref);
+    const __m256i band_v = _mm256_set1_epi32(band_width);
+    const __m256d pct_v = _mm256_set1_pd(.01);
+    const __m256d avg_cov_v = _mm256_set1_pd(avg_cov);
+    const __m256i float_bias = _mm256_set1_epi32(127);
+    int sc_array[8] __attribute__((aligned(32)));
+
+    for (int i = 0; i < n; ++i) {
+        const int ri = ra[i];
+        const int qi = qa[i];
+        int max_j = -1;
+        int cov = la[i];
+        int max_f = cov, n_skip = 0, sc;
+        while (st < i && ri > ra[st] + max_dist_ref) ++st;
+        const __m256i qi_v = _mm256_set1_epi32(qi);
+        const __m256i ri_v = _mm256_set1_epi32(ri);
+        const __m256i cov_v = _mm256_set1_epi32(cov);
+        BOOL stop = FALSE;
+        int j = i - 1;
+        for (; j - 7 >= st && !stop; j -= 8) {
+            const int j0 = j - 7;
+            const __m256i qj = _mm256_loadu_si256((const __m256i*)(qa + j0));
+            const __m256i rj = _mm256_loadu_si256((const __m256i*)(ra + j0));
+            __m256i qe = qj, re = rj;
             if (is_maximal_exact_match) {
-                if (seeds[j].qoff + seeds[j].length >= qi || seeds[j].soff + seeds[j].length >= ri) continue;
-            } else {
-                if (seeds[j].qoff >= qi || seeds[j].soff >= ri) continue;
+                const __m256i lj = _mm256_loadu_si256((const __m256i*)(la + j0));
+                qe = _mm256_add_epi32(qj, lj);
+                re = _mm256_add_epi32(rj, lj);
             }
-            idx dr = ri - seeds[j].soff;
-            idx dq = qi - seeds[j].qoff;
-            int dd, sc, log_dd;
-            if (dr == 0 || dq <= 0) continue;
-            if (dq > max_dist_qry || dr > max_dist_ref) continue;
-            dd = (dr > dq) ? (dr - dq) : (dq - dr);
-            if (dd > band_width) continue;
-            min_d = hbn_min(dq, dr);
-            sc = (min_d > cov) ? cov : hbn_min(dq, dr);
-            log_dd = dd ? ilog2_32(dd) : 0;
-            sc -= (int)(dd * .01 * avg_cov) + (log_dd>>1);
-            sc += f[j];
-            if (sc > max_f) {
-                max_f = sc;
-                max_j = j;
-                if (n_skip) --n_skip;
-            } else if (t[j] == i) {
-                if (++n_skip > max_skip) { break; }
+            const __m256i dq = _mm256_sub_epi32(qi_v, qj);
+            const __m256i dr = _mm256_sub_epi32(ri_v, rj);
+            const __m256i dd = _mm256_abs_epi32(_mm256_sub_epi32(dr, dq));
+            /// qe >= qi || re >= ri || dr == 0 || dq <= 0 || dq > max || dr > max || dd > band
+            __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(qe, _mm256_sub_epi32(qi_v, _mm256_set1_epi32(1))),
+                                          _mm256_cmpgt_epi32(re, _mm256_sub_epi32(ri_v, _mm256_set1_epi32(1))));
+            bad = _mm256_or_si256(bad, _mm256_cmpeq_epi32(dr, zero));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(_mm256_set1_epi32(1), dq));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(dq, max_dq_v));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(dr, max_dr_v));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(dd, band_v));
+            const int valid = ~_mm256_movemask_ps(_mm256_castsi256_ps(bad)) & 0xff;
+            if (!valid) continue;
+
+            __m256i sc_v = _mm256_min_epi32(_mm256_min_epi32(dq, dr), cov_v);
+            /// (int)(dd * .01 * avg_cov) in double precision as in the scalar code
+            __m256d lo = _mm256_mul_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(dd)), pct_v), avg_cov_v);
+            __m256d hi = _mm256_mul_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(dd, 1)), pct_v), avg_cov_v);
+            __m256i gap = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(lo)), _mm256_cvttpd_epi32(hi), 1);
+            /// ilog2(dd) is the float exponent of dd (exact as dd <= band_width), 0 for dd = 0
+            __m256i log_dd = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(dd)), 23);
+            log_dd = _mm256_max_epi32(_mm256_sub_epi32(log_dd, float_bias), zero);
+            gap = _mm256_add_epi32(gap, _mm256_srai_epi32(log_dd, 1));
+            sc_v = _mm256_sub_epi32(sc_v, gap);
+            sc_v = _mm256_add_epi32(sc_v, _mm256_loadu_si256((const __m256i*)(f + j0)));
+            _mm256_store_si256((__m256i*)sc_array, sc_v);
+
+            for (int k = 7; k >= 0; --k) {
+                if (!((valid >> k) & 1)) continue;
+                if (update_chain_score(i, j0 + k, sc_array[k], max_skip, p, t, &max_f, &max_j, &n_skip)) {
+                    stop = TRUE;
+                    break;
+                }
             }
-            if (p[j] >= 0) t[p[j]] = i;
+        }
+        for (; j >= st && !stop; --j) {
+            if (!chain_pair_score(qi, ri, cov, qa[j], ra[j], la[j], f[j],
+                    max_dist_qry, max_dist_ref, band_width, avg_cov, is_maximal_exact_match, &sc)) continue;
+            if (update_chain_score(i, j, sc, max_skip, p, t, &max_f, &max_j, &n_skip)) break;
         }
         f[i] = max_f;
         p[i] = max_j;
-        // v[i] keeps the peak score up to i;
-        // f[i] is the score ending at i, not always the peak score
         v[i] = (max_j >= 0 && v[max_j] > max_f) ? v[max_j] : max_f;
     }
 }
 
+/// the avx2 kernel computes on int offsets
+#define CHAIN_DP_MAX_INT_SPAN   (1 << 29)
+
+void
+scoring_chain_seeds(ChainWorkData* data,
+    const ChainSeed* seeds,
+    const int n,
+    const BOOL is_maximal_exact_match)
+{
+    if (n > 8 && hbn_get_simd_level() >= eSimdAvx2) {
+        idx min_q = seeds[0].qoff, max_q = seeds[0].qoff;
+        idx min_r = seeds[0].soff, max_r = seeds[0].soff;
+        int max_len = seeds[0].length;
+        for (int i = 1; i < n; ++i) {
+            min_q = hbn_min(min_q, seeds[i].qoff);
+            max_q = hbn_max(max_q, seeds[i].qoff);
+            min_r = hbn_min(min_r, seeds[i].soff);
+            max_r = hbn_max(max_r, seeds[i].soff);
+            max_len = hbn_max(max_len, seeds[i].length);
+        }
+        if (max_q - min_q < CHAIN_DP_MAX_INT_SPAN
+            &&
+            max_r - min_r < CHAIN_DP_MAX_INT_SPAN
+            &&
+            max_len < CHAIN_DP_MAX_INT_SPAN) {
+            scoring_chain_seeds_avx2(data, seeds, n, is_maximal_exact_match, min_q, min_r);
+            return;
+        }
+    }
+    scoring_chain_seeds_scalar(data, seeds, n, is_maximal_exact_match);
+}
+
 int
 find_best_kmer_match(ChainWorkData* data,
     int* best_kmer_match_index,
@@ -153,6 +346,10 @@ find_best_kmer_match(ChainWorkData* data,
     if (n == 0) return 0;
     const int min_cnt = data->min_cnt;
     const int min_score = data->min_score;
+    if (data->dump_seeds) {
+        kv_push_v(ChainSeed, *data->dump_seeds, kv_data(data->seeds), n);
+        kv_push(int, *data->dump_seed_counts, n);
+    }
     scoring_chain_seeds(data, kv_data(data->seeds), kv_size(data->seeds), FALSE);
     int* f = kv_data(data->f);
     int* p = kv_data(data->p);
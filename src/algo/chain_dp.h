@@ -2,6 +2,7 @@
 #define __CHAIN_DP_H
 
 #include "../corelib/hbn_aux.h"
+#include "../corelib/hbn_simd.h"
 #include "../corelib/gapped_candidate.h"
 
 #ifdef __cplusplus
@@ -37,6 +38,14 @@ typedef struct {
     vec_chain_seed seeds;
     vec_chain_seed fwd_seeds;
     vec_chain_seed rev_seeds;
+    /// seed offsets and lengths as int arrays for the avx2 kernel
+    vec_int     seed_qoff;
+    vec_int     seed_soff;
+    vec_int     seed_len;
+    /// if set, find_best_kmer_match() appends every seed set it scores
+    /// to dump_seeds and its size to dump_seed_counts
+    vec_chain_seed* dump_seeds;
+    vec_int*    dump_seed_counts;
 } ChainWorkData;
 
 ChainWorkData*
@@ -45,6 +54,15 @@ ChainWorkDataNew(int min_seed_cnt, int min_can_score);
 ChainWorkData*
 ChainWorkDataFree(ChainWorkData* data);
 
+/// fills data->f (best chain score ending at each seed), data->p (its
+/// predecessor or -1) and data->v (peak score of the chain up to each seed),
+/// with the avx2 predecessor scan at simd level eSimdAvx2
+void
+scoring_chain_seeds(ChainWorkData* data,
+    const ChainSeed* seeds,
+    const int n,
+    const BOOL is_maximal_exact_match);
+
 int
 find_best_kmer_match(ChainWorkData* data,
     int* best_kmer_match_index,
@@ -11,8 +11,6 @@ using namespace std;
 #define DIFF_ROW_SIZE           4096
 #define DIFF_COLUMN_SIZE        4096
 #define SEGMENT_ALIGN_SIZE      4096
-#define DIFF_D_PATH_SIZE        5000000
-#define DIFF_ALN_PATH_SIZE      5000000
 
 static const int kMatLen = 8;
 static const int kMaxOverHang = 1000;
@@ -24,8 +22,6 @@ DiffAlignParamsInit(DiffAlignParams* params)
     params->row_size = DIFF_ROW_SIZE;
     params->column_size = DIFF_COLUMN_SIZE;
     params->segment_align_size = SEGMENT_ALIGN_SIZE;
-    params->d_path_size = DIFF_D_PATH_SIZE;
-    params->aln_path_size = DIFF_ALN_PATH_SIZE;
 }
 
 void
@@ -87,8 +83,8 @@ DiffGapAlignDataNew()
     data->dynq = (int*)malloc(sizeof(int) * data->params.row_size);
     data->dynt = (int*)malloc(sizeof(int) * data->params.column_size);
     data->align = DiffAlignmentNew(&data->params);
-    data->d_path = (DPathData2*)malloc(sizeof(DPathData2) * data->params.d_path_size);
-    data->aln_path = (PathPoint*)malloc(sizeof(PathPoint) * data->params.aln_path_size);
+    kv_init(data->d_path);
+    kv_init(data->aln_path);
     data->ksw = Ksw2DataNew();
     ksw2_set_params(data->ksw, MATCH_REWARD, MISMATCH_PENALTY,
         AMB_PENALTY, GAP_OPEN, GAP_EXTEND, KSW_ZDROP, KSW_BAND_WIDTH);
@@ -103,13 +99,33 @@ DiffGapAlignDataFree(DiffGapAlignData* data)
     free(data->dynq);
     free(data->dynt);
     DiffAlignmentFree(data->align);
-    free(data->d_path);
-    free(data->aln_path);
+    kv_destroy(data->d_path);
+    kv_destroy(data->aln_path);
     Ksw2DataFree(data->ksw);
     free(data);
     return NULL;
 }
 
+size_t
+DiffGapAlignDataMemSize(const DiffGapAlignData* data)
+{
+    size_t n = sizeof(DiffGapAlignData);
+    n += data->qabuf.m + data->sabuf.m;
+    n += sizeof(int) * (data->params.row_size + data->params.column_size);
+    n += sizeof(DiffAlignment) + 2 * data->params.segment_align_size;
+    n += sizeof(DPathData2) * data->d_path.m;
+    n += sizeof(PathPoint) * data->aln_path.m;
+    n += sizeof(Ksw2Data) + data->ksw->qfrag.m + data->ksw->tfrag.m;
+    return n;
+}
+
+/// grow geometrically so that a band that widens one diagonal at a time
+/// does not reallocate on every edit distance
+#define diff_reserve(type, v, n) \
+    do { \
+        if ((v).m < (size_t)(n)) kv_reserve(type, v, hbn_max((size_t)(n), (v).m * 2)); \
+    } while (0)
+
 //////////////
 
 struct SCompareDPathData2
@@ -215,7 +231,7 @@ diff_align_get_align_string(const u8* query, const int q_len,
 static int
 diff_align(const u8* query, const int q_len, const u8* target, const int t_len,
 	const int band_tolerance, const int get_aln_str, DiffAlignment* align,
-	int* V, int* U, DPathData2* d_path, PathPoint* aln_path, const int right_extend)
+	int* V, int* U, vec_dpath* d_path_list, vec_path_point* aln_path_list, const int right_extend)
 {
 	int k_offset;
 	int  d;
@@ -241,6 +257,8 @@ diff_align(const u8* query, const int q_len, const u8* target, const int t_len,
 	for (d = 0; d < max_d; ++d)
 	{
 		if (max_k - min_k > band_size) break;
+		diff_reserve(DPathData2, *d_path_list, d_path_idx + (max_k - min_k) / 2 + 1);
+		DPathData2* d_path = kv_data(*d_path_list);
 		
 		for (k = min_k; k <= max_k; k += 2)
 		{
@@ -297,9 +315,10 @@ diff_align(const u8* query, const int q_len, const u8* target, const int t_len,
 			align->aln_t_s = 0;
 
 			if (get_aln_str) {
+				diff_reserve(PathPoint, *aln_path_list, q_len + t_len + 2);
 				diff_align_get_align_string(query, q_len, 
                     target, t_len, 
-                    d_path, max_idx, aln_path, align, x, y, d, k, right_extend);
+                    d_path, max_idx, kv_data(*aln_path_list), align, x, y, d, k, right_extend);
 			}
             //HBN_LOG("aligned, right_extend = %d", right_extend);
 			break;
@@ -316,9 +335,10 @@ diff_align(const u8* query, const int q_len, const u8* target, const int t_len,
 			align->aln_q_s = 0;
 			align->aln_t_s = 0;
 			if (get_aln_str) {
+				diff_reserve(PathPoint, *aln_path_list, q_len + t_len + 2);
 				diff_align_get_align_string(query, q_len, 
                     target, t_len, 
-                    d_path, best_d_path_idx, aln_path, align, best_x, best_y, best_d, best_k, right_extend);
+                    kv_data(*d_path_list), best_d_path_idx, kv_data(*aln_path_list), align, best_x, best_y, best_d, best_k, right_extend);
 			}
 		} else {
 			align->aln_q_e = 0;
@@ -386,8 +406,8 @@ dw_extend(const u8* query, const int query_size,
     const u8* target, const int target_size,
     int* U, int* V,
     DiffAlignment* align,
-    DPathData2* d_path,
-    PathPoint* aln_path,
+    vec_dpath* d_path,
+    vec_path_point* aln_path,
     DiffAlignParams* params,
     const int right_extend,
     int* qend,
@@ -630,7 +650,7 @@ left_extend(Ksw2Data* ksw,
     for (ls = sls; ls; --ls) kv_push(u8, *ssbuf, subject[ls-1]);
     ksw_extz_t ez; memset(&ez, 0, sizeof(ksw_extz_t));
     int flag = KSW_EZ_RIGHT | KSW_EZ_EXTZ_ONLY;
-    ksw_extz2_sse(ksw->km, qls, kv_data(*qsbuf), sls, kv_data(*ssbuf), 5, ksw->mat,
+    ksw2_extz2(ksw->km, qls, kv_data(*qsbuf), sls, kv_data(*ssbuf), 5, ksw->mat,
         ksw->go, ksw->ge, ksw->band_width, ksw->zdrop, ksw->end_bonus, flag, &ez);
     if (ez.n_cigar == 0) return 0;
 
@@ -707,7 +727,7 @@ right_extend(Ksw2Data* ksw,
     const u8* s = subject + subject_length - srs;
     ksw_extz_t ez; memset(&ez, 0, sizeof(ksw_extz_t));
     int flag = KSW_EZ_RIGHT | KSW_EZ_EXTZ_ONLY;
-    ksw_extz2_sse(ksw->km, qrs, q, srs, s, 5, ksw->mat,
+    ksw2_extz2(ksw->km, qrs, q, srs, s, 5, ksw->mat,
         ksw->go, ksw->ge, ksw->band_width, ksw->zdrop, ksw->end_bonus, flag, &ez);
     if (ez.n_cigar == 0) return 0;    
 
@@ -788,8 +808,8 @@ diff_align(DiffGapAlignData* data,
         data->dynq,
         data->dynt,
         data->align,
-        data->d_path,
-        data->aln_path,
+        &data->d_path,
+        &data->aln_path,
         &data->params,
         FALSE,
         &qend,
@@ -827,8 +847,8 @@ diff_align(DiffGapAlignData* data,
         data->dynq,
         data->dynt,
         data->align,
-        data->d_path,
-        data->aln_path,
+        &data->d_path,
+        &data->aln_path,
         &data->params,
         TRUE,
         &qend,
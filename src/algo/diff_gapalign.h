@@ -13,8 +13,6 @@ typedef struct {
     int row_size;
     int column_size;
     int segment_align_size;
-    int d_path_size;
-    int aln_path_size;
 } DiffAlignParams;
 
 void
@@ -52,6 +50,9 @@ typedef struct {
     int x, y;
 } PathPoint;
 
+typedef kvec_t(DPathData2) vec_dpath;
+typedef kvec_t(PathPoint) vec_path_point;
+
 typedef struct {
     int qid, qoff, qend, qsize;
     int sid, soff, send, ssize;
@@ -68,8 +69,10 @@ typedef struct {
     int* dynq;
     int* dynt;
     DiffAlignment* align;
-    DPathData2* d_path;
-    PathPoint*  aln_path;
+    /// traceback of diff_align(); grows with the widest band and the
+    /// longest segment aligned so far and is never shrunk
+    vec_dpath d_path;
+    vec_path_point aln_path;
     Ksw2Data* ksw;
 } DiffGapAlignData;
 
@@ -85,6 +88,10 @@ DiffGapAlignDataNew();
 DiffGapAlignData*
 DiffGapAlignDataFree(DiffGapAlignData* data);
 
+/// bytes held by data; as no buffer is ever shrunk this is also the peak
+size_t
+DiffGapAlignDataMemSize(const DiffGapAlignData* data);
+
 void
 DiffGapAlignDataInit(DiffGapAlignData* data,
     int qoff,
@@ -4,6 +4,14 @@
 #include "../corelib/ksort.h"
 #include "../corelib/khash.h"
 #include "hash_list_bucket_sort.h"
+#include "kmer_hash.h"
+#include "kmer_mphf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 KHASH_MAP_INIT_INT64(KmerHashToOffsetMap, u64);
 
@@ -28,68 +36,106 @@ calc_num_kmers(const text_t* db,
     return num_kmers;
 }
 
+typedef kvec_t(KmerHashAndOffset) vec_khao;
+
+typedef struct {
+    ESeedMode seed_mode;
+    int kmer_size;
+    int window_size;
+    vec_u64 words;
+    vec_u64 kmer_list;
+    vec_u64 hash_list;
+    vec_u64 pos_list;
+    vec_khao khao_list;
+} KmerSampler;
+
+static void
+kmer_sampler_init(KmerSampler* sampler, ESeedMode seed_mode, const int kmer_size, const int window_size, const u64 num_kmers)
+{
+    sampler->seed_mode = seed_mode;
+    sampler->kmer_size = kmer_size;
+    sampler->window_size = window_size;
+    kv_init(sampler->words);
+    kv_init(sampler->kmer_list);
+    kv_init(sampler->hash_list);
+    kv_init(sampler->pos_list);
+    kv_init(sampler->khao_list);
+    /// exact for fixed sampling, minimizers grow the list (their density is about 2 / (w + 1))
+    if (num_kmers) kv_reserve(KmerHashAndOffset, sampler->khao_list, num_kmers);
+}
+
+/// returns the sampled kmers, the caller takes over the array
+static KmerHashAndOffset*
+kmer_sampler_destroy(KmerSampler* sampler, u64* khao_count)
+{
+    kv_destroy(sampler->words);
+    kv_destroy(sampler->kmer_list);
+    kv_destroy(sampler->hash_list);
+    kv_destroy(sampler->pos_list);
+    *khao_count = kv_size(sampler->khao_list);
+    return kv_data(sampler->khao_list);
+}
+
+/// seq is an unpacked sequence if pac is NULL
+static void
+kmer_sampler_add_one_seq(KmerSampler* sampler,
+    const u8* seq,
+    const u8* pac,
+    const u64 start,
+    const u64 seq_size)
+{
+    if (pac) {
+        kmer_words_from_packed(pac, start, seq_size, &sampler->words);
+    } else {
+        kmer_words_from_unpacked(seq + start, seq_size, &sampler->words);
+    }
+    const u64* words = kv_data(sampler->words);
+    KmerHashAndOffset khao;
+    if (sampler->seed_mode == eSeedMinimizer) {
+        u64 n = kmer_minimizer_extract(words, 0, seq_size, sampler->kmer_size, sampler->window_size,
+                    &sampler->kmer_list, &sampler->hash_list, &sampler->pos_list);
+        for (u64 i = 0; i < n; ++i) {
+            khao.hash = kv_A(sampler->hash_list, i);
+            khao.offset = start + kv_A(sampler->pos_list, i);
+            kv_push(KmerHashAndOffset, sampler->khao_list, khao);
+        }
+        return;
+    }
+
+    u64 n = kmer_hash_count(seq_size, sampler->kmer_size, sampler->window_size);
+    if (kv_max(sampler->hash_list) < n) kv_reserve(u64, sampler->hash_list, n);
+    kmer_hash_extract(words, 0, seq_size, sampler->kmer_size, sampler->window_size, kv_data(sampler->hash_list));
+    for (u64 i = 0; i < n; ++i) {
+        khao.hash = kv_A(sampler->hash_list, i);
+        khao.offset = start + i * sampler->window_size;
+        kv_push(KmerHashAndOffset, sampler->khao_list, khao);
+    }
+}
+
 static KmerHashAndOffset*
 get_khao_array(const text_t* db,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
     u64* khao_count)
 {
     hbn_timing_begin(__FUNCTION__);
 
-    hbn_assert(db->unpacked_seq != NULL);
-    u64 num_kmers = calc_num_kmers(db, kmer_size, window_size);
-    KmerHashAndOffset* khao_array = (KmerHashAndOffset*)calloc(num_kmers, sizeof(KmerHashAndOffset));
-    const int kIntersect = kmer_size > window_size;
-    const int kStride = kmer_size - window_size;
-    const u64 kIntersectMask = kIntersect ? ((U64_ONE << (kStride<<1)) - 1) : 0;
-    const u64 kMaxHashValue = U64_ONE << (kmer_size << 1);
+    hbn_assert(db->unpacked_seq != NULL || db->packed_seq != NULL);
+    KmerSampler sampler;
+    kmer_sampler_init(&sampler, seed_mode, kmer_size, window_size, calc_num_kmers(db, kmer_size, window_size));
     const int num_subjects = seqdb_num_seqs(db);
-    size_t cnt = 0;
+    const u8* pac = db->unpacked_seq ? NULL : db->packed_seq;
 
-    HBN_LOG("kmer size = %d, window_size = %d", kmer_size, window_size);
+    HBN_LOG("kmer size = %d, window_size = %d, seed mode = %s", kmer_size, window_size, seed_mode_names[seed_mode]);
 
     for (int i = 0; i < num_subjects; ++i) {
         const u64 subject_size = seqdb_seq_size(db, i);
         if (subject_size < kmer_size) continue;
         const u64 start = seqdb_seq_offset(db, i);
-
-        if (!kIntersect) {
-            for (u64 j = 0; j <= subject_size - kmer_size; j += window_size) {
-                u64 hash = 0;
-                for (int k = 0; k < kmer_size; ++k) {
-                    const u64 pos = start + j + k;
-                    const u8 c = db->unpacked_seq[pos];
-                    hash = (hash << 2) | c;
-                }
-                hbn_assert(hash < kMaxHashValue);
-                KmerHashAndOffset khao = { hash, start + j };
-                khao_array[cnt++] = khao;
-            }
-        } else {
-            u64 hash = 0;
-            for (int j = 0; j < kmer_size; ++j) {
-                const u64 pos = start + j;
-                const u8 c = db->unpacked_seq[pos];
-                hash = (hash << 2) | c;
-            }
-            hbn_assert(hash < kMaxHashValue);
-            KmerHashAndOffset khao = { hash, start };
-            khao_array[cnt++] = khao;
-            for (u64 j = window_size; j <= subject_size - kmer_size; j += window_size) {
-                hash &= kIntersectMask;
-                for (int k = kStride; k < kmer_size; ++k) {
-                    const u64 pos = start + j + k;
-                    const u8 c = db->unpacked_seq[pos];
-                    hash = (hash << 2) | c;
-                }
-                hbn_assert(hash < kMaxHashValue);
-                KmerHashAndOffset khao = { hash, start + j };
-                khao_array[cnt++] = khao;
-            }
-        }
+        kmer_sampler_add_one_seq(&sampler, db->unpacked_seq, pac, start, subject_size);
     }
-    hbn_assert(cnt == num_kmers);
-    *khao_count = num_kmers;
+    KmerHashAndOffset* khao_array = kmer_sampler_destroy(&sampler, khao_count);
     hbn_timing_end(__FUNCTION__);
     return khao_array;
 }
@@ -115,61 +161,21 @@ get_khao_array_from_seq_chunk(BLAST_SequenceBlk* seq_blk,
     BlastQueryInfo* seq_info,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
     u64* khao_count)
 {
-    HBN_LOG("kmer_size = %d, window_size = %d", kmer_size, window_size);
-    u64 num_kmers = calc_num_kmers_from_seq_chunk(seq_blk, seq_info, kmer_size, window_size);
-    KmerHashAndOffset* khao_array = (KmerHashAndOffset*)calloc(num_kmers, sizeof(KmerHashAndOffset));
-    const int kIntersect = kmer_size > window_size;
-    const int kStride = kmer_size - window_size;
-    const u64 kIntersectMask = kIntersect ? ((U64_ONE << (kStride<<1)) - 1) : 0;
-    const u64 kMaxHashValue = U64_ONE << (kmer_size << 1);
-    size_t cnt = 0;
+    HBN_LOG("kmer_size = %d, window_size = %d, seed mode = %s", kmer_size, window_size, seed_mode_names[seed_mode]);
+    KmerSampler sampler;
+    kmer_sampler_init(&sampler, seed_mode, kmer_size, window_size, 
+        calc_num_kmers_from_seq_chunk(seq_blk, seq_info, kmer_size, window_size));
 
     for (int i = seq_info->first_context; i <= seq_info->last_context; ++i) {
         const u64 subject_size = seq_info->contexts[i].query_length;
         if (subject_size < kmer_size) continue;
         const u64 start = seq_info->contexts[i].query_offset;
-        const u8* seq = seq_blk->sequence;
-
-        if (!kIntersect) {
-            for (u64 j = 0; j <= subject_size - kmer_size; j += window_size) {
-                u64 hash = 0;
-                for (int k = 0; k < kmer_size; ++k) {
-                    const u64 pos = start + j + k;
-                    const u8 c = seq[pos];
-                    hash = (hash << 2) | c;
-                }
-                hbn_assert(hash < kMaxHashValue);
-                KmerHashAndOffset khao = { hash, start + j };
-                khao_array[cnt++] = khao;
-            }
-        } else {
-            u64 hash = 0;
-            for (int j = 0; j < kmer_size; ++j) {
-                const u64 pos = start + j;
-                const u8 c = seq[pos];
-                hash = (hash << 2) | c;
-            }
-            hbn_assert(hash < kMaxHashValue);
-            KmerHashAndOffset khao = { hash, start };
-            khao_array[cnt++] = khao;
-            for (u64 j = window_size; j <= subject_size - kmer_size; j += window_size) {
-                hash &= kIntersectMask;
-                for (int k = kStride; k < kmer_size; ++k) {
-                    const u64 pos = start + j + k;
-                    const u8 c = seq[pos];
-                    hash = (hash << 2) | c;
-                }
-                hbn_assert(hash < kMaxHashValue);
-                KmerHashAndOffset khao = { hash, start + j };
-                khao_array[cnt++] = khao;
-            }
-        }
+        kmer_sampler_add_one_seq(&sampler, seq_blk->sequence, NULL, start, subject_size);
     }
-    hbn_assert(cnt == num_kmers);
-    *khao_count = num_kmers;
-    return khao_array;
+    return kmer_sampler_destroy(&sampler, khao_count);
 }
 
 static u64
@@ -217,14 +223,40 @@ remove_repetitive_kmers(KmerHashAndOffset* khao_array,
     return i;
 }
 
-static void
-build_lktbl_from_khao_array(KmerHashAndOffset* khao_array,
-    u64 khao_count,
-    const int max_kmer_occ,
-    khash_t(KmerHashToOffsetMap)** hash_2_offset_map_pp,
-    u64** offset_array_pp)
+const char* lktbl_backend_names[eLktblInvalid] = {
+    "khash",
+    "dense",
+    "mphf"
+};
+
+ELookupTableBackend
+string_to_lktbl_backend(const char* str)
+{
+    for (int i = 0; i < eLktblInvalid; ++i) {
+        if (strcmp(lktbl_backend_names[i], str) == 0) return i;
+    }
+    return eLktblInvalid;
+}
+
+static ELookupTableBackend
+resolve_lktbl_backend(ELookupTableBackend backend, const int kmer_size, const u64 khao_count)
+{
+    if (backend == eLktblDense && (kmer_size > LKTBL_DENSE_MAX_KMER_SIZE || khao_count >= U32_MAX)) {
+        HBN_WARN("dense lookup table supports kmer size <= %d and less than %u kmers (kmer size = %d, kmers = %zu), use khash instead",
+            LKTBL_DENSE_MAX_KMER_SIZE, U32_MAX, kmer_size, (size_t)khao_count);
+        backend = eLktblKhash;
+    }
+    if (backend == eLktblMphf && khao_count >= U32_MAX) {
+        HBN_WARN("mphf lookup table supports less than %u kmers (kmers = %zu), use khash instead",
+            U32_MAX, (size_t)khao_count);
+        backend = eLktblKhash;
+    }
+    return backend;
+}
+
+static void*
+build_khash_kmer_stats(KmerHashAndOffset* khao_array, u64 khao_count, const int max_kmer_occ)
 {
-    khao_count = remove_repetitive_kmers(khao_array, khao_count, max_kmer_occ);
     khash_t(KmerHashToOffsetMap)* hash_2_offset_map = kh_init(KmerHashToOffsetMap);
     u64 i = 0;
     while (i < khao_count) {
@@ -242,12 +274,92 @@ build_lktbl_from_khao_array(KmerHashAndOffset* khao_array,
         kh_value(hash_2_offset_map, iter) = u;
         i = j;
     }
+    return hash_2_offset_map;
+}
+
+static void*
+build_dense_kmer_stats(KmerHashAndOffset* khao_array, u64 khao_count, const int kmer_size)
+{
+    /// kmer_starts[h] is the index of the first offset of kmer h in offset_list,
+    /// the offsets of h are [kmer_starts[h], kmer_starts[h+1])
+    const u64 num_kmers = U64_ONE << (kmer_size << 1);
+    u32* kmer_starts = (u32*)malloc(sizeof(u32) * (num_kmers + 1));
+    u64 i = 0;
+    for (u64 h = 0; h < num_kmers; ++h) {
+        kmer_starts[h] = i;
+        while (i < khao_count && khao_array[i].hash == h) ++i;
+    }
+    hbn_assert(i == khao_count);
+    kmer_starts[num_kmers] = khao_count;
+    return kmer_starts;
+}
+
+/// the offsets are put into offset_array in the slot order of the kmers
+static void*
+build_mphf_kmer_stats(KmerHashAndOffset* khao_array, u64 khao_count, u64* offset_array)
+{
+    u64 distinct_kmers = 0;
+    for (u64 i = 0; i < khao_count; ++i) {
+        if (i == 0 || khao_array[i].hash != khao_array[i-1].hash) ++distinct_kmers;
+    }
+    u64* keys = (u64*)malloc(sizeof(u64) * (distinct_kmers + 1));
+    u64* cnts = (u64*)malloc(sizeof(u64) * (distinct_kmers + 1));
+    u64 i = 0, k = 0;
+    while (i < khao_count) {
+        u64 j = i + 1;
+        while (j < khao_count && khao_array[i].hash == khao_array[j].hash) ++j;
+        keys[k] = khao_array[i].hash;
+        cnts[k] = j - i;
+        ++k;
+        i = j;
+    }
+    hbn_assert(k == distinct_kmers);
+    KmerMphf* mphf = KmerMphfBuild(keys, cnts, distinct_kmers);
+    free(keys);
+    free(cnts);
+
+    i = 0;
+    while (i < khao_count) {
+        u64 slot = kmer_mphf_slot(mphf, khao_array[i].hash);
+        u64 start = mphf->starts[slot];
+        u64 j = i;
+        for (; j < khao_count && khao_array[j].hash == khao_array[i].hash; ++j) {
+            offset_array[start + j - i] = khao_array[j].offset;
+        }
+        hbn_assert(start + j - i == mphf->starts[slot + 1]);
+        i = j;
+    }
+    return mphf;
+}
+
+static LookupTable*
+build_lktbl_from_khao_array(KmerHashAndOffset* khao_array,
+    u64 khao_count,
+    const int kmer_size,
+    const int max_kmer_occ,
+    ELookupTableBackend backend)
+{
+    khao_count = remove_repetitive_kmers(khao_array, khao_count, max_kmer_occ);
+    backend = resolve_lktbl_backend(backend, kmer_size, khao_count);
 
+    LookupTable* lktbl = (LookupTable*)calloc(1, sizeof(LookupTable));
+    lktbl->backend = backend;
+    lktbl->kmer_size = kmer_size;
+    lktbl->offset_count = khao_count;
     u64* offset_array = (u64*)calloc(khao_count, sizeof(u64));
-    for (i = 0; i < khao_count; ++i) offset_array[i] = khao_array[i].offset;
-    
-    *hash_2_offset_map_pp = hash_2_offset_map;
-    *offset_array_pp = offset_array;
+    if (backend == eLktblDense) {
+        lktbl->kmer_stats = build_dense_kmer_stats(khao_array, khao_count, kmer_size);
+    } else if (backend == eLktblMphf) {
+        lktbl->kmer_stats = build_mphf_kmer_stats(khao_array, khao_count, offset_array);
+    } else {
+        lktbl->kmer_stats = build_khash_kmer_stats(khao_array, khao_count, max_kmer_occ);
+    }
+
+    if (backend != eLktblMphf) {
+        for (u64 i = 0; i < khao_count; ++i) offset_array[i] = khao_array[i].offset;
+    }
+    lktbl->offset_list = offset_array;
+    return lktbl;
 }
 
 static u64 
@@ -276,11 +388,13 @@ LookupTable*
 build_lookup_table(const text_t* db,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
     const int max_kmer_occ,
-    const int num_threads)
+    const int num_threads,
+    ELookupTableBackend backend)
 {
     u64 khao_count = 0;
-    KmerHashAndOffset* khao_array = get_khao_array(db, kmer_size, window_size, &khao_count);
+    KmerHashAndOffset* khao_array = get_khao_array(db, kmer_size, window_size, seed_mode, &khao_count);
     radix_sort(khao_array, 
         sizeof(KmerHashAndOffset), 
         khao_count, 
@@ -289,14 +403,8 @@ build_lookup_table(const text_t* db,
         hash_extractor,
         set_khao_array_item_value);
     for (u64 i = 0; i < khao_count - 1; ++i) hbn_assert(khao_array[i].hash <= khao_array[i+1].hash);
-    khash_t(KmerHashToOffsetMap)* hash_2_offset_map = NULL;
-    u64* offset_array = NULL;
-    build_lktbl_from_khao_array(khao_array, khao_count, max_kmer_occ, &hash_2_offset_map, &offset_array);
+    LookupTable* lktbl = build_lktbl_from_khao_array(khao_array, khao_count, kmer_size, max_kmer_occ, backend);
     free(khao_array);
-
-    LookupTable* lktbl = (LookupTable*)calloc(1, sizeof(LookupTable));
-    lktbl->offset_list = offset_array;
-    lktbl->kmer_stats = hash_2_offset_map;
     return lktbl;
 }
 
@@ -305,11 +413,13 @@ build_lookup_table_from_seq_chunk(BLAST_SequenceBlk* seq_blk,
     BlastQueryInfo* seq_info,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
     const int max_kmer_occ,
-    const int num_threads)
+    const int num_threads,
+    ELookupTableBackend backend)
 {
     u64 khao_count = 0;
-    KmerHashAndOffset* khao_array = get_khao_array_from_seq_chunk(seq_blk, seq_info, kmer_size, window_size, &khao_count);
+    KmerHashAndOffset* khao_array = get_khao_array_from_seq_chunk(seq_blk, seq_info, kmer_size, window_size, seed_mode, &khao_count);
     radix_sort(khao_array, 
         sizeof(KmerHashAndOffset), 
         khao_count, 
@@ -318,23 +428,31 @@ build_lookup_table_from_seq_chunk(BLAST_SequenceBlk* seq_blk,
         hash_extractor,
         set_khao_array_item_value);
     for (u64 i = 0; i < khao_count - 1; ++i) hbn_assert(khao_array[i].hash <= khao_array[i+1].hash);
-    khash_t(KmerHashToOffsetMap)* hash_2_offset_map = NULL;
-    u64* offset_array = NULL;
-    build_lktbl_from_khao_array(khao_array, khao_count, max_kmer_occ, &hash_2_offset_map, &offset_array);
+    LookupTable* lktbl = build_lktbl_from_khao_array(khao_array, khao_count, kmer_size, max_kmer_occ, backend);
     free(khao_array);
-
-    LookupTable* lktbl = (LookupTable*)calloc(1, sizeof(LookupTable));
-    lktbl->offset_list = offset_array;
-    lktbl->kmer_stats = hash_2_offset_map;
     return lktbl;
 }
 
 LookupTable*
 destroy_lookup_table(LookupTable* lktbl)
 {
+	if (lktbl->mmap_addr) {
+		/// every table array and offset_list point into the mapped file,
+		/// only the table headers are on the heap
+		munmap(lktbl->mmap_addr, lktbl->mmap_size);
+		if (lktbl->backend != eLktblDense) free(lktbl->kmer_stats);
+		free(lktbl);
+		return 0;
+	}
 	if (lktbl->offset_list) free(lktbl->offset_list);
-	khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
-	kh_destroy(KmerHashToOffsetMap, hash_2_offset_map);
+	if (lktbl->backend == eLktblDense) {
+		free(lktbl->kmer_stats);
+	} else if (lktbl->backend == eLktblMphf) {
+		KmerMphfFree((KmerMphf*)(lktbl->kmer_stats));
+	} else {
+		khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
+		kh_destroy(KmerHashToOffsetMap, hash_2_offset_map);
+	}
 	free(lktbl);
 	return 0;
 }
@@ -342,19 +460,491 @@ destroy_lookup_table(LookupTable* lktbl)
 u64*
 extract_kmer_list(const LookupTable* lktbl, const u64 hash, u64* n)
 {
-	u64* list = 0;
+	u64 cnt = 0, start = 0;
 	*n = 0;
 
-	khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
-	khiter_t pos = kh_get(KmerHashToOffsetMap, hash_2_offset_map, hash);
-	if (pos == kh_end(hash_2_offset_map)) return NULL;
-	u64 u = kh_value(hash_2_offset_map, pos);
-	u64 cnt = KmerStats_Cnt(u);
-	u64 start = KmerStats_Offset(u);
-	if (cnt) {
-		list = lktbl->offset_list + start;
-		*n = cnt;
+	if (lktbl->backend == eLktblDense) {
+		const u32* kmer_starts = (const u32*)(lktbl->kmer_stats);
+		start = kmer_starts[hash];
+		cnt = kmer_starts[hash + 1] - start;
+	} else if (lktbl->backend == eLktblMphf) {
+		if (!kmer_mphf_lookup((const KmerMphf*)(lktbl->kmer_stats), hash, &start, &cnt)) return NULL;
+	} else {
+		khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
+		khiter_t pos = kh_get(KmerHashToOffsetMap, hash_2_offset_map, hash);
+		if (pos == kh_end(hash_2_offset_map)) return NULL;
+		u64 u = kh_value(hash_2_offset_map, pos);
+		cnt = KmerStats_Cnt(u);
+		start = KmerStats_Offset(u);
 	}
-    return list;
+	if (!cnt) return NULL;
+	*n = cnt;
+	return lktbl->offset_list + start;
+}
+
+void
+prefetch_kmer_list(const LookupTable* lktbl, const u64 hash)
+{
+	if (lktbl->backend == eLktblDense) {
+		const u32* kmer_starts = (const u32*)(lktbl->kmer_stats);
+		__builtin_prefetch(kmer_starts + hash);
+	} else if (lktbl->backend == eLktblMphf) {
+		kmer_mphf_prefetch((const KmerMphf*)(lktbl->kmer_stats), hash);
+	} else {
+		khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
+		if (!hash_2_offset_map->n_buckets) return;
+		khint_t i = kh_int64_hash_func(hash) & (hash_2_offset_map->n_buckets - 1);
+		__builtin_prefetch(hash_2_offset_map->keys + i);
+		__builtin_prefetch(hash_2_offset_map->vals + i);
+	}
+}
+
+size_t
+lookup_table_memory_size(const LookupTable* lktbl)
+{
+	size_t n = sizeof(u64) * lktbl->offset_count;
+	if (lktbl->backend == eLktblDense) {
+		n += sizeof(u32) * ((U64_ONE << (lktbl->kmer_size << 1)) + 1);
+	} else if (lktbl->backend == eLktblMphf) {
+		n += KmerMphfMemorySize((const KmerMphf*)(lktbl->kmer_stats));
+	} else {
+		khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
+		khint_t nb = hash_2_offset_map->n_buckets;
+		n += (nb ? __ac_fsize(nb) * sizeof(khint32_t) : 0) + sizeof(u64) * nb * 2;
+	}
+	return n;
+}
+
+/// persistent lookup table
+///
+/// file layout (every section starts at an 8-byte aligned offset):
+///     LookupTableFileHeader
+///     table sections  (backend dependent, see below)
+///     offset_list     (offset_count x u64)
+/// the table sections are stored verbatim so that the mapped file can be
+/// probed directly without rebuilding anything:
+///     khash   flags (__ac_fsize(n_buckets) x u32), keys, vals (n_buckets x u64)
+///     dense   kmer starts (4^k + 1 x u32)
+///     mphf    bits, ranks, fallback keys, placed keys, starts (u32)
+
+#define LKTBL_MAX_SECTIONS  5
+
+typedef struct {
+    u64 magic;
+    int version;
+    int backend;
+    int kmer_size;
+    int window_size;
+    int seed_mode;
+    int max_kmer_occ;
+    int seq_start_id;
+    int num_seqs;
+    size_t seq_offset_from;
+    size_t seq_offset_to;
+    /// size and modification time of the packed residues (.pac) of the db,
+    /// a db rebuilt with the same numbers of reads and residues differs here
+    size_t pac_size;
+    i64 pac_mtime_sec;
+    i64 pac_mtime_nsec;
+    khint_t n_buckets;
+    khint_t size;
+    khint_t n_occupied;
+    khint_t upper_bound;
+    KmerMphfInfo mphf_info;
+    int num_sections;
+    size_t section_offset[LKTBL_MAX_SECTIONS];
+    size_t section_size[LKTBL_MAX_SECTIONS];
+    size_t offset_list_offset;
+    size_t offset_count;
+    size_t file_size;
+} LookupTableFileHeader;
+
+#define lktbl_align8(n) (((n) + 7) & (~((size_t)7)))
+
+void
+make_lookup_table_path(const char* data_dir, 
+    const char* db_name, 
+    const int vol_id,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    ELookupTableBackend backend,
+    char path[])
+{
+    path[0] = '\0';
+    if (data_dir) sprintf(path, "%s/", data_dir);
+    if (db_name) {
+        strcat(path, db_name);
+        strcat(path, ".");
+    }
+    char vol_buf[64];
+    u64_to_fixed_width_string_r(vol_id, vol_buf, HBN_DIGIT_WIDTH);
+    char* p = path + strlen(path);
+    sprintf(p, "V%s.k%d_%c%d_o%d.%s.lktbl", vol_buf, kmer_size, 
+        (seed_mode == eSeedMinimizer) ? 'm' : 'w', window_size, max_kmer_occ, lktbl_backend_names[backend]);
+}
+
+static void
+setup_lookup_table_file_header(const text_t* db,
+    const char* pac_path,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    LookupTableFileHeader* hdr)
+{
+    memset(hdr, 0, sizeof(LookupTableFileHeader));
+    hdr->magic = HBN_LKTBL_MAGIC;
+    hdr->version = HBN_LKTBL_VERSION;
+    hdr->kmer_size = kmer_size;
+    hdr->window_size = window_size;
+    hdr->seed_mode = seed_mode;
+    hdr->max_kmer_occ = max_kmer_occ;
+    hdr->seq_start_id = db->dbinfo.seq_start_id;
+    hdr->num_seqs = db->dbinfo.num_seqs;
+    hdr->seq_offset_from = db->dbinfo.seq_offset_from;
+    hdr->seq_offset_to = db->dbinfo.seq_offset_to;
+    struct stat sbuf;
+    if (stat(pac_path, &sbuf) == 0) {
+        hdr->pac_size = sbuf.st_size;
+        hdr->pac_mtime_sec = sbuf.st_mtim.tv_sec;
+        hdr->pac_mtime_nsec = sbuf.st_mtim.tv_nsec;
+    } else {
+        HBN_WARN("fail to stat %s: %s", pac_path, strerror(errno));
+    }
+}
+
+static BOOL
+lookup_table_file_header_match(const LookupTableFileHeader* lhs, const LookupTableFileHeader* rhs)
+{
+    return lhs->magic == rhs->magic
+           &&
+           lhs->version == rhs->version
+           &&
+           lhs->kmer_size == rhs->kmer_size
+           &&
+           lhs->window_size == rhs->window_size
+           &&
+           lhs->seed_mode == rhs->seed_mode
+           &&
+           lhs->max_kmer_occ == rhs->max_kmer_occ
+           &&
+           lhs->seq_start_id == rhs->seq_start_id
+           &&
+           lhs->num_seqs == rhs->num_seqs
+           &&
+           lhs->seq_offset_from == rhs->seq_offset_from
+           &&
+           lhs->seq_offset_to == rhs->seq_offset_to
+           &&
+           lhs->pac_size == rhs->pac_size
+           &&
+           lhs->pac_mtime_sec == rhs->pac_mtime_sec
+           &&
+           lhs->pac_mtime_nsec == rhs->pac_mtime_nsec;
+}
+
+/// the sections of a mapped table are probed without bounds checks, so a
+/// table is used only if every section has the size its header implies and
+/// lies inside the file
+static BOOL
+lookup_table_file_layout_is_valid(const LookupTableFileHeader* hdr, const char* base, const size_t file_size)
+{
+    size_t expected_sizes[LKTBL_MAX_SECTIONS];
+    int num_sections = 0;
+    if (hdr->backend == eLktblDense) {
+        if (hdr->kmer_size < 1 || hdr->kmer_size > LKTBL_DENSE_MAX_KMER_SIZE) return FALSE;
+        expected_sizes[num_sections++] = sizeof(u32) * ((U64_ONE << (hdr->kmer_size << 1)) + 1);
+    } else if (hdr->backend == eLktblMphf) {
+        const KmerMphfInfo* info = &hdr->mphf_info;
+        /// every count is below file_size, so the sizes below do not overflow
+        if (info->num_keys >= file_size
+            ||
+            info->num_words >= file_size
+            ||
+            info->num_placed_keys + info->num_fallback_keys != info->num_keys
+            ||
+            info->num_ranks != (info->num_words + KMER_MPHF_RANK_WORDS - 1) / KMER_MPHF_RANK_WORDS
+            ||
+            info->num_levels < 0 
+            || 
+            info->num_levels > KMER_MPHF_MAX_LEVELS) return FALSE;
+        for (int l = 0; l < info->num_levels; ++l) {
+            if (info->level_bits[l] == 0
+                ||
+                (info->level_bits[l] & 63)
+                ||
+                info->level_word_offset[l] > info->num_words
+                ||
+                (info->level_bits[l] >> 6) > info->num_words - info->level_word_offset[l]) return FALSE;
+        }
+        expected_sizes[num_sections++] = sizeof(u64) * info->num_words;
+        expected_sizes[num_sections++] = sizeof(u64) * info->num_ranks;
+        expected_sizes[num_sections++] = sizeof(u64) * info->num_fallback_keys;
+        expected_sizes[num_sections++] = sizeof(u64) * info->num_placed_keys;
+        expected_sizes[num_sections++] = sizeof(u32) * (info->num_keys + 1);
+    } else if (hdr->backend == eLktblKhash) {
+        if (hdr->n_buckets & (hdr->n_buckets - 1)
+            ||
+            hdr->n_buckets >= file_size
+            ||
+            hdr->size > hdr->n_occupied
+            ||
+            hdr->n_occupied > hdr->n_buckets) return FALSE;
+        expected_sizes[num_sections++] = hdr->n_buckets ? __ac_fsize(hdr->n_buckets) * sizeof(khint32_t) : 0;
+        expected_sizes[num_sections++] = sizeof(u64) * hdr->n_buckets;
+        expected_sizes[num_sections++] = sizeof(u64) * hdr->n_buckets;
+    } else {
+        return FALSE;
+    }
+    if (hdr->num_sections != num_sections) return FALSE;
+
+    size_t end = sizeof(LookupTableFileHeader);
+    for (int i = 0; i < num_sections; ++i) {
+        if (hdr->section_size[i] != expected_sizes[i]
+            ||
+            (hdr->section_offset[i] & 7)
+            ||
+            hdr->section_offset[i] < end
+            ||
+            hdr->section_offset[i] > file_size
+            ||
+            hdr->section_size[i] > file_size - hdr->section_offset[i]) return FALSE;
+        end = hdr->section_offset[i] + hdr->section_size[i];
+    }
+    if ((hdr->offset_list_offset & 7)
+        ||
+        hdr->offset_list_offset < end
+        ||
+        hdr->offset_list_offset > file_size
+        ||
+        hdr->offset_count != (file_size - hdr->offset_list_offset) / sizeof(u64)) return FALSE;
+
+    /// the start arrays end at the size of the offset list
+    if (hdr->backend == eLktblDense) {
+        const u32* starts = (const u32*)(base + hdr->section_offset[0]);
+        if (starts[U64_ONE << (hdr->kmer_size << 1)] != hdr->offset_count) return FALSE;
+    } else if (hdr->backend == eLktblMphf) {
+        const u32* starts = (const u32*)(base + hdr->section_offset[4]);
+        if (starts[hdr->mphf_info.num_keys] != hdr->offset_count) return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL
+write_zero_padding(const size_t from, const size_t to, FILE* out)
+{
+    static const char zeros[8] = { 0 };
+    hbn_assert(to >= from && to - from < 8);
+    return to == from || fwrite(zeros, 1, to - from, out) == to - from;
+}
+
+BOOL
+dump_lookup_table(const LookupTable* lktbl,
+    const text_t* db,
+    const char* pac_path,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    const char* path)
+{
+    LookupTableFileHeader hdr;
+    setup_lookup_table_file_header(db, pac_path, kmer_size, window_size, seed_mode, max_kmer_occ, &hdr);
+    hdr.backend = lktbl->backend;
+    const void* sections[LKTBL_MAX_SECTIONS];
+    if (lktbl->backend == eLktblDense) {
+        hdr.num_sections = 1;
+        sections[0] = lktbl->kmer_stats;
+        hdr.section_size[0] = sizeof(u32) * ((U64_ONE << (kmer_size << 1)) + 1);
+    } else if (lktbl->backend == eLktblMphf) {
+        const KmerMphf* mphf = (const KmerMphf*)(lktbl->kmer_stats);
+        hdr.mphf_info = mphf->info;
+        hdr.num_sections = 5;
+        sections[0] = mphf->bits;
+        hdr.section_size[0] = sizeof(u64) * mphf->info.num_words;
+        sections[1] = mphf->ranks;
+        hdr.section_size[1] = sizeof(u64) * mphf->info.num_ranks;
+        sections[2] = mphf->fallback_keys;
+        hdr.section_size[2] = sizeof(u64) * mphf->info.num_fallback_keys;
+        sections[3] = mphf->placed_keys;
+        hdr.section_size[3] = sizeof(u64) * mphf->info.num_placed_keys;
+        sections[4] = mphf->starts;
+        hdr.section_size[4] = sizeof(u32) * (mphf->info.num_keys + 1);
+    } else {
+        khash_t(KmerHashToOffsetMap)* hash_2_offset_map = (khash_t(KmerHashToOffsetMap)*)(lktbl->kmer_stats);
+        hdr.n_buckets = hash_2_offset_map->n_buckets;
+        hdr.size = hash_2_offset_map->size;
+        hdr.n_occupied = hash_2_offset_map->n_occupied;
+        hdr.upper_bound = hash_2_offset_map->upper_bound;
+        hdr.num_sections = 3;
+        sections[0] = hash_2_offset_map->flags;
+        hdr.section_size[0] = hdr.n_buckets ? __ac_fsize(hdr.n_buckets) * sizeof(khint32_t) : 0;
+        sections[1] = hash_2_offset_map->keys;
+        hdr.section_size[1] = sizeof(u64) * hdr.n_buckets;
+        sections[2] = hash_2_offset_map->vals;
+        hdr.section_size[2] = sizeof(u64) * hdr.n_buckets;
+    }
+    size_t offset = lktbl_align8(sizeof(LookupTableFileHeader));
+    for (int i = 0; i < hdr.num_sections; ++i) {
+        hdr.section_offset[i] = offset;
+        offset = lktbl_align8(offset + hdr.section_size[i]);
+    }
+    hdr.offset_list_offset = offset;
+    hdr.offset_count = lktbl->offset_count;
+    hdr.file_size = hdr.offset_list_offset + sizeof(u64) * hdr.offset_count;
+
+    /// write to a private file and rename it, so that concurrent jobs
+    /// never map a partially written table. The file is only a cache, a
+    /// failed write (e.g., a full disk) is reported and the file is removed.
+    char tmp_path[HBN_MAX_PATH_LEN];
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+    sprintf(tmp_path, "%s.%s.%d.tmp", path, host, (int)getpid());
+    FILE* out = fopen(tmp_path, "wb");
+    if (!out) {
+        HBN_WARN("fail to open %s: %s", tmp_path, strerror(errno));
+        return FALSE;
+    }
+    BOOL r = fwrite(&hdr, sizeof(LookupTableFileHeader), 1, out) == 1;
+    size_t pos = sizeof(LookupTableFileHeader);
+    for (int i = 0; r && i < hdr.num_sections; ++i) {
+        r = write_zero_padding(pos, hdr.section_offset[i], out)
+            &&
+            (hdr.section_size[i] == 0 || fwrite(sections[i], 1, hdr.section_size[i], out) == hdr.section_size[i]);
+        pos = hdr.section_offset[i] + hdr.section_size[i];
+    }
+    r = r 
+        && 
+        write_zero_padding(pos, hdr.offset_list_offset, out)
+        &&
+        (hdr.offset_count == 0 || fwrite(lktbl->offset_list, sizeof(u64), hdr.offset_count, out) == hdr.offset_count);
+    if (!r) HBN_WARN("fail to write %s: %s", tmp_path, strerror(errno));
+    if (fclose(out) != 0 && r) {
+        HBN_WARN("fail to write %s: %s", tmp_path, strerror(errno));
+        r = FALSE;
+    }
+    if (r && rename(tmp_path, path) != 0) {
+        HBN_WARN("fail to rename %s to %s: %s", tmp_path, path, strerror(errno));
+        r = FALSE;
+    }
+    if (!r) unlink(tmp_path);
+    return r;
+}
+
+LookupTable*
+load_lookup_table(const text_t* db,
+    const char* pac_path,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    ELookupTableBackend backend,
+    const char* path)
+{
+    if (access(path, F_OK) != 0) return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        HBN_WARN("fail to open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    struct stat sbuf;
+    if (fstat(fd, &sbuf) == -1 || sbuf.st_size < sizeof(LookupTableFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+    const size_t file_size = sbuf.st_size;
+    void* addr = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        HBN_WARN("fail to map %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    const LookupTableFileHeader* hdr = (const LookupTableFileHeader*)(addr);
+    LookupTableFileHeader expected_hdr;
+    setup_lookup_table_file_header(db, pac_path, kmer_size, window_size, seed_mode, max_kmer_occ, &expected_hdr);
+    if (!lookup_table_file_header_match(hdr, &expected_hdr) 
+        || 
+        hdr->file_size != file_size
+        ||
+        hdr->backend != resolve_lktbl_backend(backend, kmer_size, hdr->offset_count)) {
+        HBN_WARN("lookup table %s does not match the current volume or options, it will be rebuilt", path);
+        munmap(addr, file_size);
+        return NULL;
+    }
+    if (!lookup_table_file_layout_is_valid(hdr, (const char*)(addr), file_size)) {
+        HBN_WARN("lookup table %s is corrupt, it will be rebuilt", path);
+        munmap(addr, file_size);
+        return NULL;
+    }
+    madvise(addr, file_size, MADV_WILLNEED);
+
+    const char* base = (const char*)(addr);
+    LookupTable* lktbl = (LookupTable*)calloc(1, sizeof(LookupTable));
+    lktbl->backend = hdr->backend;
+    lktbl->kmer_size = kmer_size;
+    lktbl->offset_list = (u64*)(base + hdr->offset_list_offset);
+    lktbl->offset_count = hdr->offset_count;
+    lktbl->mmap_addr = addr;
+    lktbl->mmap_size = file_size;
+    if (hdr->backend == eLktblDense) {
+        lktbl->kmer_stats = (void*)(base + hdr->section_offset[0]);
+    } else if (hdr->backend == eLktblMphf) {
+        KmerMphf* mphf = (KmerMphf*)calloc(1, sizeof(KmerMphf));
+        mphf->info = hdr->mphf_info;
+        mphf->bits = (u64*)(base + hdr->section_offset[0]);
+        mphf->ranks = (u64*)(base + hdr->section_offset[1]);
+        mphf->fallback_keys = (u64*)(base + hdr->section_offset[2]);
+        mphf->placed_keys = (u64*)(base + hdr->section_offset[3]);
+        mphf->starts = (u32*)(base + hdr->section_offset[4]);
+        lktbl->kmer_stats = mphf;
+    } else {
+        khash_t(KmerHashToOffsetMap)* hash_2_offset_map = 
+            (khash_t(KmerHashToOffsetMap)*)calloc(1, sizeof(khash_t(KmerHashToOffsetMap)));
+        hash_2_offset_map->n_buckets = hdr->n_buckets;
+        hash_2_offset_map->size = hdr->size;
+        hash_2_offset_map->n_occupied = hdr->n_occupied;
+        hash_2_offset_map->upper_bound = hdr->upper_bound;
+        hash_2_offset_map->flags = (khint32_t*)(base + hdr->section_offset[0]);
+        hash_2_offset_map->keys = (u64*)(base + hdr->section_offset[1]);
+        hash_2_offset_map->vals = (u64*)(base + hdr->section_offset[2]);
+        lktbl->kmer_stats = hash_2_offset_map;
+    }
+    return lktbl;
+}
+
+LookupTable*
+build_or_load_lookup_table(const char* data_dir,
+    const char* db_name,
+    const int vol_id,
+    const text_t* db,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    const int num_threads,
+    ELookupTableBackend backend)
+{
+    char path[HBN_MAX_PATH_LEN];
+    make_lookup_table_path(data_dir, db_name, vol_id, kmer_size, window_size, seed_mode, max_kmer_occ, backend, path);
+    char pac_path[HBN_MAX_PATH_LEN];
+    make_packed_seq_path(data_dir, db_name, pac_path);
+    LookupTable* lktbl = load_lookup_table(db, pac_path, kmer_size, window_size, seed_mode, max_kmer_occ, backend, path);
+    if (lktbl) {
+        char buf[64];
+        HBN_LOG("load %s lookup table from %s (%s)", 
+            lktbl_backend_names[lktbl->backend], path, u64_to_string_datasize(lktbl->mmap_size, buf));
+        return lktbl;
+    }
+
+    lktbl = build_lookup_table(db, kmer_size, window_size, seed_mode, max_kmer_occ, num_threads, backend);
+    if (dump_lookup_table(lktbl, db, pac_path, kmer_size, window_size, seed_mode, max_kmer_occ, path)) {
+        HBN_LOG("save %s lookup table to %s", lktbl_backend_names[lktbl->backend], path);
+    } else {
+        HBN_WARN("the %s lookup table is not saved, it will be built again next time", lktbl_backend_names[lktbl->backend]);
+    }
+    return lktbl;
 }
-	
\ No newline at end of file
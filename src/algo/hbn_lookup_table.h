@@ -3,6 +3,7 @@
 
 #include "../corelib/hbn_aux.h"
 #include "../corelib/seqdb.h"
+#include "kmer_hash.h"
 #include "../ncbi_blast/setup/blast_sequence_blk.h"
 #include "../ncbi_blast/setup/blast_query_info.h"
 
@@ -18,14 +19,43 @@ extern "C" {
 #define KmerStats_Offset(u) ((u)&OffsetMask)
 #define KmerStats_Cnt(u)	((u)>>OffsetBits)
 
+/// kmer_stats of each backend:
+///     khash   KmerHashToOffsetMap, kmer hash -> packed (cnt, start)
+///     dense   u32[4^k + 1] start array, the offsets of kmer h are [start[h], start[h+1])
+///     mphf    KmerMphf, minimal perfect hash of the kmer hashes -> u32 start, offset_list in slot order
+typedef enum {
+    eLktblKhash,
+    eLktblDense,
+    eLktblMphf,
+    eLktblInvalid
+} ELookupTableBackend;
+
+extern const char* lktbl_backend_names[eLktblInvalid];
+
+ELookupTableBackend
+string_to_lktbl_backend(const char* str);
+
+#define LKTBL_DENSE_MAX_KMER_SIZE   15
+
 typedef struct {
+    ELookupTableBackend backend;
+    int kmer_size;
     u64* offset_list;
+    u64 offset_count;
     void* kmer_stats;
+    void* mmap_addr;
+    size_t mmap_size;
 } LookupTable;
 
 u64*
 extract_kmer_list(const LookupTable* lktbl, const u64 hash, u64* n);
 
+void
+prefetch_kmer_list(const LookupTable* lktbl, const u64 hash);
+
+size_t
+lookup_table_memory_size(const LookupTable* lktbl);
+
 LookupTable*
 destroy_lookup_table(LookupTable* lktbl);
 
@@ -33,16 +63,69 @@ LookupTable*
 build_lookup_table(const text_t* db,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
     const int max_kmer_occ,
-    const int num_threads);
+    const int num_threads,
+    ELookupTableBackend backend);
 
 LookupTable*
 build_lookup_table_from_seq_chunk(BLAST_SequenceBlk* seq_blk,
     BlastQueryInfo* seq_info,
     const int kmer_size,
     const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    const int num_threads,
+    ELookupTableBackend backend);
+
+/// persistent lookup table of a seqdb volume
+
+#define HBN_LKTBL_MAGIC     ((u64)0x4c42544b4c4e4248)
+#define HBN_LKTBL_VERSION   6
+
+void
+make_lookup_table_path(const char* data_dir, 
+    const char* db_name, 
+    const int vol_id,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    ELookupTableBackend backend,
+    char path[]);
+
+/// returns FALSE and leaves no file if the table can not be written
+BOOL
+dump_lookup_table(const LookupTable* lktbl,
+    const text_t* db,
+    const char* pac_path,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    const char* path);
+
+LookupTable*
+load_lookup_table(const text_t* db,
+    const char* pac_path,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
+    const int max_kmer_occ,
+    ELookupTableBackend backend,
+    const char* path);
+
+LookupTable*
+build_or_load_lookup_table(const char* data_dir,
+    const char* db_name,
+    const int vol_id,
+    const text_t* db,
+    const int kmer_size,
+    const int window_size,
+    ESeedMode seed_mode,
     const int max_kmer_occ,
-    const int num_threads);
+    const int num_threads,
+    ELookupTableBackend backend);
 
 #ifdef __cplusplus
 }
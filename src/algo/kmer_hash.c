@@ -0,0 +1,280 @@
+#include "kmer_hash.h"
+
+#include <immintrin.h>
+
+static void
+fit_word_list(vec_u64* v, const size_t n)
+{
+    if (v->m < n) {
+        v->m = n;
+        kv_roundup32(v->m);
+        v->a = (u64*)realloc(v->a, sizeof(u64) * v->m);
+    }
+    v->n = n;
+}
+
+#define num_kmer_words(seq_size) (((seq_size) + KMER_WORD_BASES - 1) / KMER_WORD_BASES + 1)
+
+/// pack 32 unpacked bases
+
+static inline u64
+pack_word_scalar(const u8* seq)
+{
+    u64 w = 0;
+    for (int i = 0; i < KMER_WORD_BASES; ++i) w = (w << 2) | (seq[i] & 3);
+    return w;
+}
+
+__attribute__((target("sse4.1")))
+static u64
+pack_word_sse41(const u8* seq)
+{
+    /// (b0, b1) -> 4 * b0 + b1, then (x0, x1) -> 16 * x0 + x1, then gather the low byte of each i32
+    const __m128i base_mask = _mm_set1_epi8(3);
+    const __m128i w2 = _mm_set1_epi16(0x0104);
+    const __m128i w4 = _mm_set1_epi32(0x00010010);
+    const __m128i gather = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(seq)), base_mask);
+    v = _mm_madd_epi16(_mm_maddubs_epi16(v, w2), w4);
+    u64 lo = (u32)_mm_extract_epi32(_mm_shuffle_epi8(v, gather), 0);
+    v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(seq + 16)), base_mask);
+    v = _mm_madd_epi16(_mm_maddubs_epi16(v, w2), w4);
+    u64 hi = (u32)_mm_extract_epi32(_mm_shuffle_epi8(v, gather), 0);
+    /// the bytes are in pac order, the first base is in the highest bits of byte 0
+    return __builtin_bswap64(lo | (hi << 32));
+}
+
+__attribute__((target("avx2")))
+static u64
+pack_word_avx2(const u8* seq)
+{
+    const __m256i base_mask = _mm256_set1_epi8(3);
+    const __m256i w2 = _mm256_set1_epi16(0x0104);
+    const __m256i w4 = _mm256_set1_epi32(0x00010010);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(seq)), base_mask);
+    v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, w2), w4);
+    v = _mm256_shuffle_epi8(v, gather);
+    u64 lo = (u32)_mm256_extract_epi32(v, 0);
+    u64 hi = (u32)_mm256_extract_epi32(v, 4);
+    return __builtin_bswap64(lo | (hi << 32));
+}
+
+void
+kmer_words_from_unpacked(const u8* seq, const size_t seq_size, vec_u64* words)
+{
+    const size_t nw = num_kmer_words(seq_size);
+    fit_word_list(words, nw);
+    u64* wa = kv_data(*words);
+    const size_t full_words = seq_size / KMER_WORD_BASES;
+    const ESimdLevel level = hbn_get_simd_level();
+    if (level == eSimdAvx2) {
+        for (size_t i = 0; i < full_words; ++i) wa[i] = pack_word_avx2(seq + i * KMER_WORD_BASES);
+    } else if (level == eSimdSse41) {
+        for (size_t i = 0; i < full_words; ++i) wa[i] = pack_word_sse41(seq + i * KMER_WORD_BASES);
+    } else {
+        for (size_t i = 0; i < full_words; ++i) wa[i] = pack_word_scalar(seq + i * KMER_WORD_BASES);
+    }
+    for (size_t i = full_words; i < nw; ++i) wa[i] = 0;
+    const size_t tail = seq_size % KMER_WORD_BASES;
+    if (tail) {
+        const u8* p = seq + full_words * KMER_WORD_BASES;
+        u64 w = 0;
+        for (size_t i = 0; i < tail; ++i) w = (w << 2) | (p[i] & 3);
+        wa[full_words] = w << ((KMER_WORD_BASES - tail) << 1);
+    }
+}
+
+void
+kmer_words_from_packed(const u8* pac, const size_t from, const size_t seq_size, vec_u64* words)
+{
+    const size_t nw = num_kmer_words(seq_size);
+    fit_word_list(words, nw);
+    u64* wa = kv_data(*words);
+    for (size_t i = 0; i < nw; ++i) wa[i] = 0;
+    if ((from & 3) == 0) {
+        /// a pac byte holds 4 bases with the first one in the highest bits,
+        /// so 8 pac bytes read big-endian are exactly one kmer word
+        const u8* p = pac + (from >> 2);
+        const size_t full_words = seq_size / KMER_WORD_BASES;
+        for (size_t i = 0; i < full_words; ++i) {
+            u64 w;
+            memcpy(&w, p + i * 8, sizeof(u64));
+            wa[i] = __builtin_bswap64(w);
+        }
+        const size_t tail = seq_size % KMER_WORD_BASES;
+        if (tail) {
+            const u8* q = p + full_words * 8;
+            u64 w = 0;
+            for (size_t i = 0; i < (tail + 3) / 4; ++i) w |= ((u64)q[i]) << (56 - (i << 3));
+            /// clear the bases of the next sequence sharing the last pac byte
+            w &= ~(U64_MAX >> (tail << 1));
+            wa[full_words] = w;
+        }
+        return;
+    }
+    for (size_t i = 0; i < seq_size; ++i) {
+        u64 c = _get_pac(pac, from + i);
+        wa[i / KMER_WORD_BASES] |= c << ((KMER_WORD_BASES - 1 - i % KMER_WORD_BASES) << 1);
+    }
+}
+
+/// the kmer starting at base pos
+
+static inline u64
+cut_kmer_scalar(const u64* words, const size_t pos, const int rshift)
+{
+    const size_t i = pos / KMER_WORD_BASES;
+    const int s = (pos % KMER_WORD_BASES) << 1;
+    u64 h = words[i] << s;
+    if (s) h |= words[i + 1] >> (64 - s);
+    return h >> rshift;
+}
+
+static size_t
+kmer_hash_extract_scalar(const u64* words,
+    const size_t from,
+    const size_t n,
+    const int kmer_size,
+    const int window_size,
+    u64* hash_array)
+{
+    const int rshift = 64 - (kmer_size << 1);
+    for (size_t i = 0; i < n; ++i) hash_array[i] = cut_kmer_scalar(words, from + i * window_size, rshift);
+    return n;
+}
+
+__attribute__((target("avx2")))
+static size_t
+kmer_hash_extract_avx2(const u64* words,
+    const size_t from,
+    const size_t n,
+    const int kmer_size,
+    const int window_size,
+    u64* hash_array)
+{
+    const __m128i rshift = _mm_cvtsi32_si128(64 - (kmer_size << 1));
+    const __m256i c64 = _mm256_set1_epi64x(64);
+    const __m256i c31 = _mm256_set1_epi64x(KMER_WORD_BASES - 1);
+    const __m256i c1 = _mm256_set1_epi64x(1);
+    const __m256i step = _mm256_set1_epi64x((i64)window_size * 4);
+    __m256i pos = _mm256_setr_epi64x(from, from + window_size, from + 2 * window_size, from + 3 * window_size);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i wi = _mm256_srli_epi64(pos, 5);
+        __m256i s = _mm256_slli_epi64(_mm256_and_si256(pos, c31), 1);
+        __m256i hi = _mm256_i64gather_epi64((const long long*)(words), wi, 8);
+        __m256i lo = _mm256_i64gather_epi64((const long long*)(words), _mm256_add_epi64(wi, c1), 8);
+        /// a shift count of 64 yields 0, so s == 0 needs no special case
+        __m256i h = _mm256_or_si256(_mm256_sllv_epi64(hi, s), _mm256_srlv_epi64(lo, _mm256_sub_epi64(c64, s)));
+        _mm256_storeu_si256((__m256i*)(hash_array + i), _mm256_srl_epi64(h, rshift));
+        pos = _mm256_add_epi64(pos, step);
+    }
+    const int scalar_rshift = 64 - (kmer_size << 1);
+    for (; i < n; ++i) hash_array[i] = cut_kmer_scalar(words, from + i * window_size, scalar_rshift);
+    return n;
+}
+
+size_t
+kmer_hash_extract(const u64* words,
+    const size_t from,
+    const size_t size,
+    const int kmer_size,
+    const int window_size,
+    u64* hash_array)
+{
+    hbn_assert(kmer_size > 0 && kmer_size <= 32);
+    hbn_assert(window_size > 0);
+    const size_t n = kmer_hash_count(size, kmer_size, window_size);
+    if (hbn_get_simd_level() >= eSimdAvx2) {
+        return kmer_hash_extract_avx2(words, from, n, kmer_size, window_size, hash_array);
+    }
+    return kmer_hash_extract_scalar(words, from, n, kmer_size, window_size, hash_array);
+}
+
+size_t
+kmer_hash_extract_unpacked(const u8* seq,
+    const size_t seq_size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* words,
+    vec_u64* hash_list)
+{
+    kmer_words_from_unpacked(seq, seq_size, words);
+    fit_word_list(hash_list, kmer_hash_count(seq_size, kmer_size, window_size));
+    return kmer_hash_extract(kv_data(*words), 0, seq_size, kmer_size, window_size, kv_data(*hash_list));
+}
+
+size_t
+kmer_hash_extract_packed(const u8* pac,
+    const size_t from,
+    const size_t seq_size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* words,
+    vec_u64* hash_list)
+{
+    kmer_words_from_packed(pac, from, seq_size, words);
+    fit_word_list(hash_list, kmer_hash_count(seq_size, kmer_size, window_size));
+    return kmer_hash_extract(kv_data(*words), 0, seq_size, kmer_size, window_size, kv_data(*hash_list));
+}
+
+const char* seed_mode_names[eSeedInvalid] = {
+    "fixed",
+    "minimizer"
+};
+
+ESeedMode
+string_to_seed_mode(const char* str)
+{
+    for (int i = 0; i < eSeedInvalid; ++i) {
+        if (strcmp(seed_mode_names[i], str) == 0) return i;
+    }
+    return eSeedInvalid;
+}
+
+size_t
+kmer_minimizer_extract(const u64* words,
+    const size_t from,
+    const size_t size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* kmer_list,
+    vec_u64* hash_list,
+    vec_u64* pos_list)
+{
+    hbn_assert(window_size > 0 && window_size <= KMER_MINIMIZER_MAX_WINDOW);
+    kv_clear(*hash_list);
+    kv_clear(*pos_list);
+    const size_t n = kmer_hash_count(size, kmer_size, 1);
+    if (!n) return 0;
+    fit_word_list(kmer_list, n);
+    const u64* kmers = kv_data(*kmer_list);
+    kmer_hash_extract(words, from, size, kmer_size, 1, kv_data(*kmer_list));
+
+    /// a monotone queue of (order, kmer index) in a ring buffer, the front
+    /// is the minimizer of the current window
+    const u64 mask = (kmer_size == 32) ? U64_MAX : ((U64_ONE << (kmer_size << 1)) - 1);
+    const size_t w = hbn_min((size_t)window_size, n);
+    u64 q_order[KMER_MINIMIZER_MAX_WINDOW];
+    size_t q_idx[KMER_MINIMIZER_MAX_WINDOW];
+    const size_t q_mask = KMER_MINIMIZER_MAX_WINDOW - 1;
+    size_t q_head = 0, q_tail = 0;
+    size_t last = U64_MAX;
+    for (size_t i = 0; i < n; ++i) {
+        const u64 order = kmer_minimizer_order(kmers[i], mask);
+        if (q_tail > q_head && q_idx[q_head & q_mask] + w <= i) ++q_head;
+        while (q_tail > q_head && q_order[(q_tail - 1) & q_mask] > order) --q_tail;
+        q_order[q_tail & q_mask] = order;
+        q_idx[q_tail & q_mask] = i;
+        ++q_tail;
+        if (i + 1 < w) continue;
+        const size_t p = q_idx[q_head & q_mask];
+        if (p == last) continue;
+        kv_push(u64, *hash_list, kmers[p]);
+        kv_push(u64, *pos_list, from + p);
+        last = p;
+    }
+    return kv_size(*hash_list);
+}
@@ -0,0 +1,113 @@
+#ifndef __KMER_HASH_H
+#define __KMER_HASH_H
+
+#include "../corelib/hbn_aux.h"
+#include "../corelib/hbn_simd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The hash of a kmer is its 2-bit encoding with the first base in the
+/// highest bits (A = 0, C = 1, G = 2, T = 3), kmer_size <= 32.
+///
+/// Sequences are first converted to a stream of big-endian kmer words,
+/// 32 bases per u64 word with base i at bits [62 - 2 * (i % 32), 63 - 2 * (i % 32)].
+/// Every kmer is then cut out of two adjacent words in O(1), independent
+/// of kmer_size and window_size. The word stream is always followed by one
+/// zero word so that the last kmer can be read without bounds checks.
+
+#define KMER_WORD_BASES     32
+
+/// seq[0, seq_size) are unpacked bases (0, 1, 2, 3)
+void
+kmer_words_from_unpacked(const u8* seq, const size_t seq_size, vec_u64* words);
+
+/// pac is a packed 2-bit sequence (see _get_pac), the bases are pac[from, from + seq_size)
+void
+kmer_words_from_packed(const u8* pac, const size_t from, const size_t seq_size, vec_u64* words);
+
+/// hashes of the kmers starting at from, from + window_size, from + 2 * window_size, ...
+/// that lie entirely inside [from, from + size) of the word stream.
+/// hash_array must hold kmer_hash_count(size, kmer_size, window_size) values.
+size_t
+kmer_hash_extract(const u64* words,
+    const size_t from,
+    const size_t size,
+    const int kmer_size,
+    const int window_size,
+    u64* hash_array);
+
+#define kmer_hash_count(size, kmer_size, window_size) \
+    (((size) < (size_t)(kmer_size)) ? 0 : (((size) - (kmer_size)) / (window_size) + 1))
+
+/// convenient wrappers, the hashes are stored in hash_list
+size_t
+kmer_hash_extract_unpacked(const u8* seq,
+    const size_t seq_size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* words,
+    vec_u64* hash_list);
+
+size_t
+kmer_hash_extract_packed(const u8* pac,
+    const size_t from,
+    const size_t seq_size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* words,
+    vec_u64* hash_list);
+
+/// seeding modes
+///     fixed       the reference is sampled every window_size bases, the query at every base
+///     minimizer   (window_size, kmer_size)-minimizers of both the reference and the query
+
+typedef enum {
+    eSeedFixed,
+    eSeedMinimizer,
+    eSeedInvalid
+} ESeedMode;
+
+extern const char* seed_mode_names[eSeedInvalid];
+
+ESeedMode
+string_to_seed_mode(const char* str);
+
+#define KMER_MINIMIZER_MAX_WINDOW   256
+
+/// The minimizer of a window of window_size consecutive kmers is the kmer
+/// with the smallest kmer_minimizer_order(), the leftmost one on ties.
+/// Every distinct minimizer of [from, from + size) is stored once, its
+/// hash in hash_list and its position in the word stream in pos_list.
+/// kmer_list is a work buffer.
+size_t
+kmer_minimizer_extract(const u64* words,
+    const size_t from,
+    const size_t size,
+    const int kmer_size,
+    const int window_size,
+    vec_u64* kmer_list,
+    vec_u64* hash_list,
+    vec_u64* pos_list);
+
+/// an invertible integer hash, so that distinct kmers never tie and
+/// low complexity kmers such as poly-A are not favoured
+static inline u64
+kmer_minimizer_order(u64 key, const u64 mask)
+{
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KMER_HASH_H
@@ -0,0 +1,110 @@
+#include "kmer_mphf.h"
+
+/// stop building new levels once this few keys are left
+#define KMER_MPHF_MIN_LEVEL_KEYS    64
+
+KmerMphf*
+KmerMphfBuild(const u64* keys, const u64* cnts, const u64 num_keys)
+{
+    KmerMphf* mphf = (KmerMphf*)calloc(1, sizeof(KmerMphf));
+    KmerMphfInfo* info = &mphf->info;
+    info->num_keys = num_keys;
+
+    u64* level_keys = (u64*)malloc(sizeof(u64) * (num_keys + 1));
+    memcpy(level_keys, keys, sizeof(u64) * num_keys);
+    u64 num_level_keys = num_keys;
+    u64* level_bits_array[KMER_MPHF_MAX_LEVELS];
+
+    while (num_level_keys > KMER_MPHF_MIN_LEVEL_KEYS && info->num_levels < KMER_MPHF_MAX_LEVELS) {
+        const int l = info->num_levels;
+        const u64 m = ((num_level_keys * KMER_MPHF_GAMMA + 63) >> 6) << 6;
+        const u64 num_words = m >> 6;
+        u64* seen = (u64*)calloc(num_words, sizeof(u64));
+        u64* collision = (u64*)calloc(num_words, sizeof(u64));
+        for (u64 i = 0; i < num_level_keys; ++i) {
+            u64 p = kmer_mphf_reduce(kmer_mphf_hash(level_keys[i], l), m);
+            u64 bit = U64_ONE << (p & 63);
+            if (seen[p >> 6] & bit) {
+                collision[p >> 6] |= bit;
+            } else {
+                seen[p >> 6] |= bit;
+            }
+        }
+        for (u64 i = 0; i < num_words; ++i) seen[i] &= ~collision[i];
+        u64 n = 0;
+        for (u64 i = 0; i < num_level_keys; ++i) {
+            u64 p = kmer_mphf_reduce(kmer_mphf_hash(level_keys[i], l), m);
+            if (collision[p >> 6] & (U64_ONE << (p & 63))) level_keys[n++] = level_keys[i];
+        }
+        free(collision);
+
+        info->level_bits[l] = m;
+        info->level_word_offset[l] = info->num_words;
+        info->num_words += num_words;
+        level_bits_array[l] = seen;
+        ++info->num_levels;
+        num_level_keys = n;
+    }
+
+    info->num_placed_keys = num_keys - num_level_keys;
+    info->num_fallback_keys = num_level_keys;
+    /// level_keys are a subsequence of the sorted input, so they are still sorted
+    mphf->fallback_keys = (u64*)malloc(sizeof(u64) * (num_level_keys + 1));
+    memcpy(mphf->fallback_keys, level_keys, sizeof(u64) * num_level_keys);
+    free(level_keys);
+
+    mphf->bits = (u64*)malloc(sizeof(u64) * (info->num_words + 1));
+    for (int l = 0; l < info->num_levels; ++l) {
+        memcpy(mphf->bits + info->level_word_offset[l], level_bits_array[l], info->level_bits[l] >> 3);
+        free(level_bits_array[l]);
+    }
+    info->num_ranks = (info->num_words + KMER_MPHF_RANK_WORDS - 1) / KMER_MPHF_RANK_WORDS;
+    mphf->ranks = (u64*)malloc(sizeof(u64) * (info->num_ranks + 1));
+    u64 r = 0;
+    for (u64 i = 0; i < info->num_words; ++i) {
+        if (i % KMER_MPHF_RANK_WORDS == 0) mphf->ranks[i / KMER_MPHF_RANK_WORDS] = r;
+        r += __builtin_popcountll(mphf->bits[i]);
+    }
+    hbn_assert(r == info->num_placed_keys);
+
+    mphf->placed_keys = (u64*)malloc(sizeof(u64) * (info->num_placed_keys + 1));
+    mphf->starts = (u32*)calloc(num_keys + 1, sizeof(u32));
+    for (u64 i = 0; i < num_keys; ++i) {
+        u64 slot = kmer_mphf_slot(mphf, keys[i]);
+        hbn_assert(slot < num_keys);
+        if (slot < info->num_placed_keys) mphf->placed_keys[slot] = keys[i];
+        mphf->starts[slot + 1] = cnts[i];
+    }
+    u64 total = 0;
+    for (u64 slot = 1; slot <= num_keys; ++slot) {
+        total += mphf->starts[slot];
+        hbn_assert(total < U32_MAX);
+        mphf->starts[slot] = total;
+    }
+
+    HBN_LOG("mphf: %zu keys, %d levels, %zu fallback keys, %.2f bits per key",
+        (size_t)num_keys, info->num_levels, (size_t)info->num_fallback_keys,
+        num_keys ? 8.0 * KmerMphfMemorySize(mphf) / num_keys : 0.0);
+    return mphf;
+}
+
+KmerMphf*
+KmerMphfFree(KmerMphf* mphf)
+{
+    free(mphf->bits);
+    free(mphf->ranks);
+    free(mphf->fallback_keys);
+    free(mphf->placed_keys);
+    free(mphf->starts);
+    free(mphf);
+    return NULL;
+}
+
+size_t
+KmerMphfMemorySize(const KmerMphf* mphf)
+{
+    const KmerMphfInfo* info = &mphf->info;
+    size_t n = sizeof(u64) * (info->num_words + info->num_ranks + info->num_keys);
+    n += sizeof(u32) * (info->num_keys + 1);
+    return n;
+}
@@ -0,0 +1,120 @@
+#ifndef __KMER_MPHF_H
+#define __KMER_MPHF_H
+
+#include "../corelib/hbn_aux.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A BBHash-style minimal perfect hash over distinct kmer hash values.
+/// Every key is mapped into a slot in [0, num_keys) by the rank of its bit
+/// in the first level where it does not collide with another key. Keys that
+/// collide on all levels are kept in a sorted fallback list and take the
+/// last slots. The key of every placed slot is stored too, so absent kmers
+/// are rejected exactly as by a hash table. The value of a slot is the range
+/// [starts[slot], starts[slot+1]) of the offset list, which is laid out in
+/// slot order.
+
+#define KMER_MPHF_MAX_LEVELS    24
+#define KMER_MPHF_GAMMA         2
+#define KMER_MPHF_RANK_WORDS    8
+
+typedef struct {
+    u64 num_keys;
+    u64 num_placed_keys;
+    u64 num_fallback_keys;
+    u64 num_words;
+    u64 num_ranks;
+    int num_levels;
+    u64 level_bits[KMER_MPHF_MAX_LEVELS];
+    u64 level_word_offset[KMER_MPHF_MAX_LEVELS];
+} KmerMphfInfo;
+
+typedef struct {
+    KmerMphfInfo info;
+    u64* bits;
+    u64* ranks;
+    u64* fallback_keys;
+    /// the key of slot i < num_placed_keys
+    u64* placed_keys;
+    u32* starts;
+} KmerMphf;
+
+/// keys must be distinct and sorted in ascending order, cnts[i] is the
+/// number of offsets of keys[i] and the total must be less than U32_MAX
+KmerMphf*
+KmerMphfBuild(const u64* keys, const u64* cnts, const u64 num_keys);
+
+KmerMphf*
+KmerMphfFree(KmerMphf* mphf);
+
+size_t
+KmerMphfMemorySize(const KmerMphf* mphf);
+
+static inline u64
+kmer_mphf_hash(u64 key, const int level)
+{
+    key += (u64)(level + 1) * 0x9e3779b97f4a7c15ULL;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+#define kmer_mphf_reduce(h, m) ((u64)(((unsigned __int128)(h) * (m)) >> 64))
+
+static inline void
+kmer_mphf_prefetch(const KmerMphf* mphf, const u64 key)
+{
+    u64 p = kmer_mphf_reduce(kmer_mphf_hash(key, 0), mphf->info.level_bits[0]);
+    __builtin_prefetch(mphf->bits + (p >> 6));
+}
+
+/// returns the slot of key, U64_MAX if key is surely not in the table
+static inline u64
+kmer_mphf_slot(const KmerMphf* mphf, const u64 key)
+{
+    const KmerMphfInfo* info = &mphf->info;
+    for (int l = 0; l < info->num_levels; ++l) {
+        u64 p = kmer_mphf_reduce(kmer_mphf_hash(key, l), info->level_bits[l]);
+        u64 w = info->level_word_offset[l] + (p >> 6);
+        u64 word = mphf->bits[w];
+        u64 bit = U64_ONE << (p & 63);
+        if (!(word & bit)) continue;
+        u64 r = mphf->ranks[w / KMER_MPHF_RANK_WORDS];
+        for (u64 i = w - w % KMER_MPHF_RANK_WORDS; i < w; ++i) r += __builtin_popcountll(mphf->bits[i]);
+        r += __builtin_popcountll(word & (bit - 1));
+        return r;
+    }
+
+    u64 left = 0, right = info->num_fallback_keys;
+    while (left < right) {
+        u64 mid = (left + right) >> 1;
+        if (mphf->fallback_keys[mid] < key) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    if (left == info->num_fallback_keys || mphf->fallback_keys[left] != key) return U64_MAX;
+    return info->num_placed_keys + left;
+}
+
+/// returns 1 and the offset range of key in [*start, *start + *cnt) if key
+/// is in the table, 0 otherwise
+static inline int
+kmer_mphf_lookup(const KmerMphf* mphf, const u64 key, u64* start, u64* cnt)
+{
+    u64 r = kmer_mphf_slot(mphf, key);
+    if (r == U64_MAX) return 0;
+    if (r < mphf->info.num_placed_keys && mphf->placed_keys[r] != key) return 0;
+    *start = mphf->starts[r];
+    *cnt = mphf->starts[r + 1] - mphf->starts[r];
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KMER_MPHF_H
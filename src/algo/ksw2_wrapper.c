@@ -3,6 +3,28 @@
 #include "ksw2.h"
 #include "hbn_traceback_aux.h"
 
+void
+ksw2_extz2(void *km, int qlen, const uint8_t *query, int tlen, const uint8_t *target, int8_t m, const int8_t *mat,
+    int8_t q, int8_t e, int w, int zdrop, int end_bonus, int flag, ksw_extz_t *ez)
+{
+    if (hbn_get_simd_level() >= eSimdAvx2) {
+        ksw_extz2_avx2(km, qlen, query, tlen, target, m, mat, q, e, w, zdrop, end_bonus, flag, ez);
+    } else {
+        ksw_extz2_sse(km, qlen, query, tlen, target, m, mat, q, e, w, zdrop, end_bonus, flag, ez);
+    }
+}
+
+void
+ksw2_extd2(void *km, int qlen, const uint8_t *query, int tlen, const uint8_t *target, int8_t m, const int8_t *mat,
+    int8_t q, int8_t e, int8_t q2, int8_t e2, int w, int zdrop, int end_bonus, int flag, ksw_extz_t *ez)
+{
+    if (hbn_get_simd_level() >= eSimdAvx2) {
+        ksw_extd2_avx2(km, qlen, query, tlen, target, m, mat, q, e, q2, e2, w, zdrop, end_bonus, flag, ez);
+    } else {
+        ksw_extd2_sse(km, qlen, query, tlen, target, m, mat, q, e, q2, e2, w, zdrop, end_bonus, flag, ez);
+    }
+}
+
 static void ksw_gen_simple_mat(int m, int8_t *mat, int8_t a, int8_t b, int8_t sc_ambi)
 {
 	int i, j;
@@ -114,7 +136,7 @@ int nw_ksw2_extd2(Ksw2Data* data,
     const int qsubseq_size = qto - qfrom;
     const u8* ssubseq = subject + sfrom;
     const int ssubseq_size = sto - sfrom;
-    ksw_extd2_sse(data->km, qsubseq_size, qsubseq, ssubseq_size, ssubseq, 5, data->mat,
+    ksw2_extd2(data->km, qsubseq_size, qsubseq, ssubseq_size, ssubseq, 5, data->mat,
         data->go, data->ge, data->go1, data->ge1, max_band_width, data->zdrop, data->end_bonus, flag, &ez);
     if (ez.n_cigar == 0) return 0;
 
@@ -2,11 +2,24 @@
 #define KSW2_WRAPPER_H
 
 #include "../corelib/hbn_aux.h"
+#include "../corelib/hbn_simd.h"
+#include "ksw2.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// ksw_extz2_avx2() at simd level eSimdAvx2 (see hbn_simd.h), ksw_extz2_sse()
+/// below it; both give the same results
+void
+ksw2_extz2(void *km, int qlen, const uint8_t *query, int tlen, const uint8_t *target, int8_t m, const int8_t *mat,
+    int8_t q, int8_t e, int w, int zdrop, int end_bonus, int flag, ksw_extz_t *ez);
+
+/// ksw_extd2_sse() or ksw_extd2_avx2()
+void
+ksw2_extd2(void *km, int qlen, const uint8_t *query, int tlen, const uint8_t *target, int8_t m, const int8_t *mat,
+    int8_t q, int8_t e, int8_t q2, int8_t e2, int w, int zdrop, int end_bonus, int flag, ksw_extz_t *ez);
+
 typedef struct {
     void* km;
     int reward, penalty, ambi_penalty;
@@ -2,7 +2,11 @@
 
 #include <math.h>
 
+#include "../corelib/khash.h"
 #include "../corelib/ksort.h"
+#include "kmer_hash.h"
+
+KHASH_MAP_INIT_INT(DDFKmerMatchBlockIdMap, int);
 
 static int block_size;
 static int block_shift;
@@ -36,6 +40,9 @@ int kmer_block_size_info_is_set()
 #define blk_id_2_offset(blk) ((blk)<<block_shift)
 #define backbone_offset_2_offset(blk_id, blk_offset) (((blk_id)<<block_shift)|blk_offset)
 
+/// number of query kmers whose lookup table entries are prefetched ahead of the probe
+#define KMER_PREFETCH_DISTANCE 8
+
 #define ddfkm_soff_lt(a, b) ( \
     ((a).soff < (b).soff) \
     || \
@@ -49,37 +56,41 @@ KSORT_INIT(kmblk_info_gt, DDFKmerMatchBlockInfo, kmblk_info_gt);
 void
 DDFKmerMatchBackboneClear(DDFKmerMatchBackbone* backbone)
 {
-    for (int i = 0; i < backbone->ddfkm_block_count; ++i) {
-        int block_index = backbone->ddfkm_block_info_array[i].block_index;
-        ddf_km_block_init(backbone->ddfkm_block_array[block_index]);
-    }
-    backbone->ddfkm_block_count = 0;
+    kv_clear(backbone->ddfkm_block_list);
+    kv_clear(backbone->ddfkm_block_info_list);
+    kh_clear(DDFKmerMatchBlockIdMap, (khash_t(DDFKmerMatchBlockIdMap)*)(backbone->ddfkm_block_id_map));
 }
 
 DDFKmerMatchBackbone*
 DDFKmerMatchBackboneFree(DDFKmerMatchBackbone* backbone)
 {
-    free(backbone->_ddfkm_block_array);
-    free(backbone->ddfkm_block_info_array);
+    kv_destroy(backbone->ddfkm_block_list);
+    kv_destroy(backbone->ddfkm_block_info_list);
+    kh_destroy(DDFKmerMatchBlockIdMap, (khash_t(DDFKmerMatchBlockIdMap)*)(backbone->ddfkm_block_id_map));
     free(backbone);
     return NULL;
 }
 
 DDFKmerMatchBackbone*
-DDFKmerMatchBackboneNew(const text_t* reference)
+DDFKmerMatchBackboneNew()
 {
     hbn_assert(kmer_block_size_info_is_set());
-    size_t max_ref_size = seqdb_max_offset(reference);
-    size_t num_block = offset_2_blk_id(max_ref_size) + 5;
     DDFKmerMatchBackbone* backbone = (DDFKmerMatchBackbone*)calloc(1, sizeof(DDFKmerMatchBackbone));
-    backbone->_ddfkm_block_array = (DDFKmerMatchBlock*)calloc(num_block, sizeof(DDFKmerMatchBlock));
-    for (size_t i = 0; i < num_block; ++i) ddf_km_block_init(backbone->_ddfkm_block_array[i]);
-    backbone->ddfkm_block_array = backbone->_ddfkm_block_array + 1;
-    backbone->ddfkm_block_info_array = (DDFKmerMatchBlockInfo*)calloc(num_block, sizeof(DDFKmerMatchBlockInfo));
-    backbone->ddfkm_block_count = 0;
+    kv_init(backbone->ddfkm_block_list);
+    kv_init(backbone->ddfkm_block_info_list);
+    backbone->ddfkm_block_id_map = kh_init(DDFKmerMatchBlockIdMap);
     return backbone;
 }
 
+DDFKmerMatchBlock*
+DDFKmerMatchBackboneGetBlock(DDFKmerMatchBackbone* backbone, const int block_index)
+{
+    khash_t(DDFKmerMatchBlockIdMap)* block_id_map = (khash_t(DDFKmerMatchBlockIdMap)*)(backbone->ddfkm_block_id_map);
+    khiter_t pos = kh_get(DDFKmerMatchBlockIdMap, block_id_map, block_index);
+    if (pos == kh_end(block_id_map)) return NULL;
+    return kv_data(backbone->ddfkm_block_list) + kh_value(block_id_map, pos);
+}
+
 static int
 is_related(int qoff, 
     idx soff, 
@@ -115,86 +126,50 @@ is_related(int qoff,
     return is_related;
 }
 
-static int
-extract_hash_values(const u8* read,
-    const int read_size,
-    const int kmer_size,
-    const int window_size,
-    vec_u64* hash_list)
-{
-    if (read_size < kmer_size) return 0;
-    kv_clear(*hash_list);
-    const int intersect = kmer_size > window_size;
-	u64 intersect_mask = 0;
-	int stride = kmer_size - window_size;
-	if (intersect) intersect_mask = (U64_ONE << (stride << 1)) - 1;
-
-	if (!intersect) {
-		for (size_t j = 0; j <= read_size - kmer_size; j += window_size) {
-			u64 hash = 0;
-			for (int k = 0; k < kmer_size; ++k) {
-				size_t pos = j + k;
-				u8 c = read[pos];
-                hbn_assert(c >= 0 && c < 4);
-				hash = (hash << 2) | c;
-			}
-            kv_push(u64, *hash_list, hash);
-		}
-	} else {
-		u64 hash = 0;
-		for (int j = 0; j < kmer_size; ++j) {
-			size_t pos = j;
-			u8 c = read[pos];
-            hbn_assert(c >= 0 && c < 4);
-			hash = (hash << 2) | c;
-		}
-		kv_push(u64, *hash_list, hash);
-		for (u64 j = window_size; j <= read_size - kmer_size; j += window_size) {
-			hash &= intersect_mask;
-			for (int k = stride; k < kmer_size; ++k) {
-				size_t pos = j + k;
-                hbn_assert(pos < read_size, "p = %d, read_size = %d, j = %d, k = %d, stride = %d", pos, read_size, j, k, stride);
-				u8 c = read[pos];
-                hbn_assert(c >= 0 && c < 4);
-				hash = (hash << 2) | c;
-			}
-			kv_push(u64, *hash_list, hash);
-		}
-	}
-    return kv_size(*hash_list);
-}
-
-static void
+static DDFKmerMatchBlock*
 add_one_block(DDFKmerMatchBackbone* backbone, const int block_index)
 {
-    backbone->ddfkm_block_info_array[backbone->ddfkm_block_count].block_index = block_index;
-    backbone->ddfkm_block_count++;
+    DDFKmerMatchBlockInfo info;
+    info.block_index = block_index;
+    info.score = 0;
+    kv_push(DDFKmerMatchBlockInfo, backbone->ddfkm_block_info_list, info);
+    DDFKmerMatchBlock* block = (kv_pushp(DDFKmerMatchBlock, backbone->ddfkm_block_list));
+    ddf_km_block_init(*block);
+    return block;
 }
 
 static void
 insert_one_ddfkm(DDFKmerMatch* km, DDFKmerMatchBackbone* backbone)
 {
-    size_t block_index = offset_2_blk_id(km->soff);
-    DDFKmerMatchBlock* block = backbone->ddfkm_block_array + block_index;
+    int block_index = offset_2_blk_id(km->soff);
+    khash_t(DDFKmerMatchBlockIdMap)* block_id_map = (khash_t(DDFKmerMatchBlockIdMap)*)(backbone->ddfkm_block_id_map);
+    int r = 0;
+    khiter_t pos = kh_put(DDFKmerMatchBlockIdMap, block_id_map, block_index, &r);
+    DDFKmerMatchBlock* block = NULL;
+    if (r) {
+        kh_value(block_id_map, pos) = kv_size(backbone->ddfkm_block_list);
+        block = add_one_block(backbone, block_index);
+    } else {
+        block = kv_data(backbone->ddfkm_block_list) + kh_value(block_id_map, pos);
+    }
     if (block->ddfkm_count >= BLOCK_DDF_KM_CNT) return;
     if (block->last_qoff == km->qoff) return;
     block->last_qoff = km->qoff;
     block->ddfkm_array[block->ddfkm_count] = *km;
-    if (!block->ddfkm_count) add_one_block(backbone, block_index);
     ++block->ddfkm_count;
 }
 
 static void
-collect_subseq_seeds(vec_u64* hash_list,
-    const u8* read,
+collect_subseq_seeds(WordFindData* word_data,
     const int read_from,
     const int read_to,
-    const idx soff_max,
-    const LookupTable* lktbl,
-    const int kmer_size,
-    const int window_size,
-    DDFKmerMatchBackbone* backbone)
+    const idx soff_max)
 {
+    const LookupTable* lktbl = word_data->lktbl;
+    const u64* kmer_words = kv_data(word_data->kmer_words);
+    const int kmer_size = word_data->kmer_size;
+    const int window_size = word_data->window_size;
+    vec_u64* hash_list = &word_data->hash_list;
     const int SL = 150, SR = 200;
     //const int SL = 300, SR = 200;
     //const int SL = read_to - read_from, SR = 0;
@@ -203,19 +178,34 @@ collect_subseq_seeds(vec_u64* hash_list,
     while (s < n) {
         int e = s + SL;
         e = hbn_min(e, n);
-        int n_kmer = extract_hash_values(read + read_from + s, e - s, kmer_size, window_size, hash_list);
+        int n_kmer = 0;
+        if (word_data->seed_mode == eSeedMinimizer) {
+            n_kmer = kmer_minimizer_extract(kmer_words, read_from + s, e - s, kmer_size, window_size,
+                        &word_data->kmer_list, hash_list, &word_data->seed_pos_list);
+        } else {
+            n_kmer = kmer_hash_count(e - s, kmer_size, window_size);
+            if (kv_max(*hash_list) < n_kmer) kv_reserve(u64, *hash_list, n_kmer);
+            kv_size(*hash_list) = n_kmer;
+            kmer_hash_extract(kmer_words, read_from + s, e - s, kmer_size, window_size, kv_data(*hash_list));
+        }
         DDFKmerMatch ddfkm;
+        for (int i = 0; i < hbn_min(n_kmer, KMER_PREFETCH_DISTANCE); ++i) prefetch_kmer_list(lktbl, kv_A(*hash_list, i));
         for (int i = 0; i < n_kmer; ++i) {
+            if (i + KMER_PREFETCH_DISTANCE < n_kmer) prefetch_kmer_list(lktbl, kv_A(*hash_list, i + KMER_PREFETCH_DISTANCE));
             u64 n_km;
             u64* km_list = extract_kmer_list(lktbl, kv_A(*hash_list, i), &n_km);
-            int qoff = read_from + s + i * window_size;
+            int qoff = (word_data->seed_mode == eSeedMinimizer) 
+                       ? 
+                       kv_A(word_data->seed_pos_list, i) 
+                       : 
+                       read_from + s + i * window_size;
             ddfkm.qoff = qoff;
             for (u64 k = 0; k < n_km; ++k) {
                 idx x = km_list[k];
                 if (x >= soff_max) continue;
                 //if (x <= 9332) HBN_LOG("find kmer match: [%d, %d]", qoff, x);
                 ddfkm.soff = x;
-                insert_one_ddfkm(&ddfkm, backbone);
+                insert_one_ddfkm(&ddfkm, word_data->backbone);
             }
         }
         s = e + SR;                
@@ -223,21 +213,17 @@ collect_subseq_seeds(vec_u64* hash_list,
 }
 
 static void
-collect_seeds(vec_u64* hash_list,
+collect_seeds(WordFindData* word_data,
     const u8* read,
     const int read_id,
     const int read_start_id,
-    const int read_size,
-    const text_t* reference,
-    const LookupTable* lktbl,
-    const int kmer_size,
-    const int window_size,
-    const int map_against_myself,
-    vec_int_pair* seeding_regions,
-    DDFKmerMatchBackbone* backbone)
+    const int read_size)
 {
+    const text_t* reference = word_data->reference;
+    DDFKmerMatchBackbone* backbone = word_data->backbone;
+    vec_int_pair* seeding_regions = &word_data->seeding_subseqs;
     idx soff_max = IDX_MAX;
-    if (map_against_myself) {
+    if (word_data->map_against_myself) {
         const int reference_start_id = reference->dbinfo.seq_start_id;
         int max_refid = reference_start_id + seqdb_num_seqs(reference);
         int g_read_id = read_id + read_start_id;
@@ -247,25 +233,21 @@ collect_seeds(vec_u64* hash_list,
     }
 
     DDFKmerMatchBackboneClear(backbone);
+    kmer_words_from_unpacked(read, read_size, &word_data->kmer_words);
     for (size_t s = 0; s < kv_size(*seeding_regions); ++s) {
         int from = kv_A(*seeding_regions, s).first;
         int to = kv_A(*seeding_regions, s).second;
         hbn_assert(to <= read_size);
-        collect_subseq_seeds(hash_list,
-            read,
-            from,
-            to,
-            soff_max,
-            lktbl,
-            kmer_size,
-            window_size,
-            backbone);
+        collect_subseq_seeds(word_data, from, to, soff_max);
     }
 
-    for (int i = 0; i < backbone->ddfkm_block_count; ++i) {
-        int block_index = backbone->ddfkm_block_info_array[i].block_index;
-        DDFKmerMatchBlock* block = backbone->ddfkm_block_array + block_index;
-        backbone->ddfkm_block_info_array[i].score = block->ddfkm_count + (block-1)->ddfkm_count;
+    /// blocks and their infos are added in the same order
+    DDFKmerMatchBlockInfo* block_info_array = kv_data(backbone->ddfkm_block_info_list);
+    DDFKmerMatchBlock* block_array = kv_data(backbone->ddfkm_block_list);
+    for (size_t i = 0; i < kv_size(backbone->ddfkm_block_info_list); ++i) {
+        int block_index = block_info_array[i].block_index;
+        DDFKmerMatchBlock* prev_block = DDFKmerMatchBackboneGetBlock(backbone, block_index - 1);
+        block_info_array[i].score = block_array[i].ddfkm_count + (prev_block ? prev_block->ddfkm_count : 0);
     }
 }
 
@@ -371,8 +353,8 @@ find_candidate_for_one_ddfkm_list(DDFKmerMatchBackbone* backbone,
         &ql, &qr, &sl, &sr, &block_id_from, &block_id_to);
     int score = 0;
     for (int i = block_id_from; i < block_id_to; ++i) {
-        DDFKmerMatchBlock* block = backbone->ddfkm_block_array + i;
-        score += scoring_one_km_block(block, ql, qr, sl, sr, seed_qoff, seed_soff);
+        DDFKmerMatchBlock* block = DDFKmerMatchBackboneGetBlock(backbone, i);
+        if (block) score += scoring_one_km_block(block, ql, qr, sl, sr, seed_qoff, seed_soff);
     }
 
     HbnInitHit init_hit;
@@ -402,14 +384,15 @@ find_candidate_for_one_block(const text_t* reference,
     int kmer_size,
     vec_init_hit* init_hist_list)
 {
-    DDFKmerMatchBlock* block = backbone->ddfkm_block_array + block_index;
+    DDFKmerMatchBlock* block = DDFKmerMatchBackboneGetBlock(backbone, block_index);
     if (block->ddfkm_count <= ddf_score_cutoff) return 0;
 
     DDFKmerMatch ddfkm_array[BLOCK_DDF_KM_CNT*2];
     int ddfkm_count = 0;
     if (block->ddfkm_count < 20) {
-        --block;
-        if (block->ddfkm_count) {
+        DDFKmerMatchBlock* curr_block = block;
+        block = DDFKmerMatchBackboneGetBlock(backbone, block_index - 1);
+        if (block && block->ddfkm_count) {
             ks_introsort_ddfkm_soff_lt(block->ddfkm_count, block->ddfkm_array);
             int i = 0;
             while (i < block->ddfkm_count) {
@@ -421,7 +404,7 @@ find_candidate_for_one_block(const text_t* reference,
                 i = j;
             }
         }
-        ++block;
+        block = curr_block;
     }
     if (block->ddfkm_count) {
         ks_introsort_ddfkm_soff_lt(block->ddfkm_count, block->ddfkm_array);
@@ -475,30 +458,21 @@ ddfs_find_candidates(WordFindData* word_data,
     const int read_size)
 {
     hbn_assert(block_size_info_is_set);
-    collect_seeds(&word_data->hash_list, 
-        read, 
-        read_id, 
-        read_start_id, 
-        read_size, 
-        word_data->reference, 
-        word_data->lktbl, 
-        word_data->kmer_size, 
-        1, 
-        word_data->map_against_myself, 
-        &word_data->seeding_subseqs,
-        word_data->backbone);
-
-    ks_introsort_kmblk_info_gt(word_data->backbone->ddfkm_block_count, word_data->backbone->ddfkm_block_info_array);
+    collect_seeds(word_data, read, read_id, read_start_id, read_size);
+
+    DDFKmerMatchBlockInfo* block_info_array = kv_data(word_data->backbone->ddfkm_block_info_list);
+    const int block_count = kv_size(word_data->backbone->ddfkm_block_info_list);
+    ks_introsort_kmblk_info_gt(block_count, block_info_array);
     int added_can = 0;
-    for (int i = 0; i < word_data->backbone->ddfkm_block_count; ++i) {
-        int r = (word_data->backbone->ddfkm_block_info_array[i].score >= word_data->min_block_km * 2)
+    for (int i = 0; i < block_count; ++i) {
+        int r = (block_info_array[i].score >= word_data->min_block_km * 2)
                 ||
-                (read_size < block_size * 2 && word_data->backbone->ddfkm_block_info_array[i].score > word_data->min_block_km);
+                (read_size < block_size * 2 && block_info_array[i].score > word_data->min_block_km);
         if (!r) continue;
         added_can += find_candidate_for_one_block(word_data->reference,
             word_data->backbone, 
             word_data->chain_data,
-            word_data->backbone->ddfkm_block_info_array[i].block_index,
+            block_info_array[i].block_index,
             word_data->min_block_km,
             read_id,
             read_dir,
@@ -514,19 +488,24 @@ WordFindDataNew(const text_t* reference,
     int kmer_size,
     int window_size,
     int min_block_km,
-    int map_against_myself)
+    int map_against_myself,
+    ESeedMode seed_mode)
 {
     WordFindData* data = (WordFindData*)calloc(1, sizeof(WordFindData));
     data->reference = reference;
-    data->backbone = DDFKmerMatchBackboneNew(reference);
+    data->backbone = DDFKmerMatchBackboneNew();
     data->lktbl = lktbl;
     data->chain_data = ChainWorkDataNew(min_block_km, min_block_km * kmer_size * 0.8);
     data->map_against_myself = map_against_myself;
     data->kmer_size = kmer_size;
     data->window_size = window_size;
+    data->seed_mode = seed_mode;
     data->min_block_km = min_block_km;
     kv_init(data->seeding_subseqs);
     kv_init(data->hash_list);
+    kv_init(data->kmer_words);
+    kv_init(data->kmer_list);
+    kv_init(data->seed_pos_list);
     kv_init(data->init_hit_list);
 
     return data;
@@ -539,6 +518,9 @@ WordFindDataFree(WordFindData* data)
     ChainWorkDataFree(data->chain_data);
     kv_destroy(data->seeding_subseqs);
     kv_destroy(data->hash_list);
+    kv_destroy(data->kmer_words);
+    kv_destroy(data->kmer_list);
+    kv_destroy(data->seed_pos_list);
     kv_destroy(data->init_hit_list);
     free(data);
     return NULL;
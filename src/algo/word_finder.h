@@ -36,11 +36,16 @@ typedef struct {
 
 void ks_introsort_kmblk_info_gt(size_t n, DDFKmerMatchBlockInfo* a);
 
+typedef kvec_t(DDFKmerMatchBlock) vec_ddfkm_block;
+typedef kvec_t(DDFKmerMatchBlockInfo) vec_ddfkm_block_info;
+
+/// Only the blocks hit by the seeds of the current query are materialised.
+/// ddfkm_block_id_map maps a reference block id to its slot in ddfkm_block_list,
+/// so the memory of the backbone depends on the query, not on the reference.
 typedef struct {
-    DDFKmerMatchBlock*      _ddfkm_block_array;
-    DDFKmerMatchBlock*      ddfkm_block_array;
-    DDFKmerMatchBlockInfo*  ddfkm_block_info_array;
-    int                     ddfkm_block_count;
+    vec_ddfkm_block         ddfkm_block_list;
+    vec_ddfkm_block_info    ddfkm_block_info_list;
+    void*                   ddfkm_block_id_map;
 } DDFKmerMatchBackbone;
 
 void
@@ -50,7 +55,10 @@ DDFKmerMatchBackbone*
 DDFKmerMatchBackboneFree(DDFKmerMatchBackbone* backbone);
 
 DDFKmerMatchBackbone*
-DDFKmerMatchBackboneNew(const text_t* reference);
+DDFKmerMatchBackboneNew();
+
+DDFKmerMatchBlock*
+DDFKmerMatchBackboneGetBlock(DDFKmerMatchBackbone* backbone, const int block_index);
 
 typedef struct {
     const text_t* reference;
@@ -59,10 +67,15 @@ typedef struct {
     ChainWorkData* chain_data;
     int map_against_myself;
     int kmer_size;
+    /// 1 for fixed seeding, the minimizer window for minimizer seeding
     int window_size;
+    ESeedMode seed_mode;
     int min_block_km;
     vec_int_pair seeding_subseqs;
     vec_u64 hash_list;
+    vec_u64 kmer_words;
+    vec_u64 kmer_list;
+    vec_u64 seed_pos_list;
     vec_init_hit init_hit_list;
 } WordFindData;
 
@@ -72,7 +85,8 @@ WordFindDataNew(const text_t* reference,
     int kmer_size,
     int window_size,
     int min_block_km,
-    int map_against_myself);
+    int map_against_myself,
+    ESeedMode seed_mode);
 
 WordFindData*
 WordFindDataFree(WordFindData* data);
@@ -1,6 +1,9 @@
 #include "assembly.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <functional>
 #include <sstream>
 #include <iostream>
 
@@ -27,6 +30,11 @@ void Assembly::Run() {
     LOG(INFO)("Load Overlaps");
     LoadOverlaps(options_.overlap_file);
 
+    if (!options_.bench_thread_sizes.empty()) {
+        BenchStringGraph();
+        return;
+    }
+
     LOG(INFO)("Create StringGraph");
     CreateStringGraph();
 
@@ -61,12 +69,14 @@ ArgumentParser Assembly::GetArgumentParser() {
     ap.AddNamedOption(options_.min_aligned_length, "min_aligned_length", "minimum aligned length of overlaps");
     ap.AddNamedOption(options_.min_contig_length, "min_contig_length", "minimum length of contigs");
     ap.AddNamedOption(options_.read_file, "read_file", "read filename");
-    ap.AddNamedOption(options_.overlap_file_type, "overlap_file_type", "overlap file format. \"\" = filename extension, \"m4\" = M4 format, \"paf\" = PAF format generated by minimap2, \"ovl\" = OVL format generated by FALCON.", "\"|m4|m4a|paf|ovl\"");
+    ap.AddNamedOption(options_.overlap_file_type, "overlap_file_type", "overlap file format. \"\" = filename extension, \"m4\" = M4 format, \"paf\" = PAF format generated by minimap2, \"ovl\" = OVL format generated by FALCON, \"m4x\" = binary records of mecat2map, \"ovb\" = binary overlap format.", "\"|m4|m4a|paf|ovl|m4x|ovb\"");
+    ap.AddNamedOption(options_.m4x_seqdb, "m4x_seqdb", "directory of the sequence database mecat2map built for a m4x file, whose read names give the read ids. Without it the database ordinals are taken as read ids");
     ap.AddNamedOption(options_.output_directory, "output_directory", "directory for output files");
     ap.AddNamedOption(options_.select_branch, "select_branch", "selecting method when encountering branches in the graph, \"no\" = do not select any branch, \"best\" = select the most probable branch", "\"no|best\"");
     ap.AddNamedOption(options_.thread_size, "thread_size", "number of threads");
     ap.AddNamedOption(options_.dump, "dump", "for testing, dump intermediate files");
     ap.AddNamedOption(options_.run_mode, "run_mode", "for testing");
+    ap.AddNamedOption(options_.bench_thread_sizes, "bench_thread_sizes", "for testing, time the string graph passes with each of the comma-separated thread sizes, then exit", "1,8,32,64");
     ap.AddNamedOption(options_.lfc, "lfc", "deprecated, for testing");
     ap.AddNamedOption(options_.remove_chimer, "remove_chimer", "deprecated, remove chimer node");
 
@@ -78,6 +88,7 @@ ArgumentParser Assembly::GetArgumentParser() {
 void Assembly::LoadOverlaps(const std::string &fname) {
     LOG(INFO)("Start Load Overlaps");
 
+    ol_store_.SetM4xSeqdb(options_.m4x_seqdb);
     ol_store_.Load(fname, options_.overlap_file_type);
     LOG(INFO)("End Load Overlaps: size = %d", ol_store_.Size());
     if (ol_store_.Size() == 0) LOG(FATAL)("No overlaps were loaded");
@@ -92,26 +103,74 @@ void Assembly::CreateStringGraph() {
     string_graph_.AddOverlaps(ol_store_.Get(), options_.min_length, options_.min_aligned_length, options_.min_identity);
 
     LOG(INFO)("MarkTransitiveEdges");
-    string_graph_.MarkTransitiveEdges();
+    string_graph_.MarkTransitiveEdges((size_t)options_.thread_size);
 
     LOG(INFO)("MarkChimerEdges");
     if (options_.remove_chimer) {
-        string_graph_.MarkChimerEdges();
+        string_graph_.MarkChimerEdges((size_t)options_.thread_size);
     }
-    string_graph_.MarkSpurEdges();
+    string_graph_.MarkSpurEdges((size_t)options_.thread_size);
 
     LOG(INFO)("MarkBestOverlap");
     if (options_.lfc) {
         string_graph_.ResolveRepeatEdges();
     }
     else {
-        string_graph_.MarkBestOverlap();
+        string_graph_.MarkBestOverlap((size_t)options_.thread_size);
     }
 
-    string_graph_.MarkSpurEdges();
+    string_graph_.MarkSpurEdges((size_t)options_.thread_size);
     string_graph_.IdentifySimplePaths();
 }
 
+// Builds the string graph of CreateStringGraph once per thread size and logs
+// the time of each pass. The number of reduced edges must not depend on the
+// thread size.
+void Assembly::BenchStringGraph() {
+    std::vector<size_t> thread_sizes;
+    std::istringstream iss(options_.bench_thread_sizes);
+    for (std::string s; std::getline(iss, s, ',');) {
+        int t = atoi(s.c_str());
+        if (t <= 0) LOG(FATAL)("Bad thread size in bench_thread_sizes: %s", options_.bench_thread_sizes.c_str());
+        thread_sizes.push_back((size_t)t);
+    }
+
+    size_t reduced = 0;
+    for (size_t thread_size : thread_sizes) {
+        StringGraph graph;
+        std::vector<std::pair<std::string, double>> times;
+        auto time = [&times](const std::string &name, std::function<void()> pass) {
+            auto begin = std::chrono::steady_clock::now();
+            pass();
+            std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+            times.push_back(std::make_pair(name, d.count()));
+        };
+
+        time("AddOverlaps", [&]() { graph.AddOverlaps(ol_store_.Get(), options_.min_length, options_.min_aligned_length, options_.min_identity); });
+        time("MarkTransitiveEdges", [&]() { graph.MarkTransitiveEdges(thread_size); });
+        if (options_.remove_chimer) {
+            time("MarkChimerEdges", [&]() { graph.MarkChimerEdges(thread_size); });
+        }
+        time("MarkSpurEdges", [&]() { graph.MarkSpurEdges(thread_size); });
+        if (!options_.lfc) {
+            time("MarkBestOverlap", [&]() { graph.MarkBestOverlap(thread_size); });
+        }
+        time("MarkSpurEdges", [&]() { graph.MarkSpurEdges(thread_size); });
+
+        double total = 0;
+        for (const auto &t : times) {
+            LOG(INFO)("thread_size = %zd  %-20s %8.3fs", thread_size, t.first.c_str(), t.second);
+            total += t.second;
+        }
+        size_t n = graph.ReducedEdgeSize();
+        LOG(INFO)("thread_size = %zd  %-20s %8.3fs  reduced edges = %zd", thread_size, "total", total, n);
+        if (thread_size != thread_sizes[0] && n != reduced) {
+            LOG(FATAL)("Reduced edges differ from those with thread_size = %zd: %zd, %zd", thread_sizes[0], n, reduced);
+        }
+        reduced = n;
+    }
+}
+
 void Assembly::CreatePathGraph() {
 
     DUMPER.SetDirectory(options_.output_directory);
@@ -507,16 +566,18 @@ std::vector<std::string> Assembly::ConstructContigAll(const std::list<StringEdge
 std::string Assembly::EdgeToSeq(const StringEdge *e) {
 
     int read = e->out_node_->ReadId();
-    std::string readseq = read_store_.GetSeq(read);
 
     std::tuple<int, bool, int, int> area = e->GetSeqArea();
 
+    // only the area is decoded, not the whole read
     if (!std::get<1>(area)) {
         assert(std::get<3>(area) > std::get<2>(area));
-        return readseq.substr(std::get<2>(area), std::get<3>(area)-std::get<2>(area));
+        return read_store_.GetSubSeq(read, std::get<2>(area), std::get<3>(area));
     } else {
         assert(std::get<2>(area) > std::get<3>(area));
-        return Seq::ReverseComplement(readseq.substr(std::get<3>(area), std::get<2>(area)));
+        // as readseq.substr(start, end), which runs to the end of the read
+        size_t end = std::min(read_store_.GetSeqLength(read), (size_t)std::get<3>(area) + std::get<2>(area));
+        return Seq::ReverseComplement(read_store_.GetSubSeq(read, std::get<3>(area), end));
 
     } 
 }
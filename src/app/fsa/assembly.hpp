@@ -30,6 +30,8 @@ struct Options {
     int run_mode{ 4 };                    
     int dump{ 0 };
     std::string overlap_file_type{ "" };
+    std::string m4x_seqdb{ "" };
+    std::string bench_thread_sizes{ "" };
     int thread_size {1};
 };
 
@@ -46,6 +48,7 @@ public:
     void LoadOverlaps(const std::string &fname);
     void LoadReads(const std::string &fname);
     void CreateStringGraph();
+    void BenchStringGraph();
     void CreatePathGraph();
     void SaveGraph();
     void SaveContigs();
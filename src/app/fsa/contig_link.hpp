@@ -23,7 +23,7 @@ public:
     struct Link {
         Link(const Overlap::Read &s, const Overlap::Read &t) : source(s), target(t) {}
 
-        std::array<int, 2> Strand() { return std::array<int, 2>{strand_s2t, target.strand}; }
+        std::array<int, 2> Strand() { return std::array<int, 2>{strand_s2t, (int)target.strand}; }
 
         bool SameStrand() const { return strand_s2t == target.strand; }
         static Loc Reverse(Loc t, bool direct);
@@ -39,26 +39,34 @@ void ContigLinkStore::LoadR2cFile(const std::string &fname) {
     read2ctg_.Load(fname, "", thread_size_, filter_simple);
 
     auto better = [](const Overlap* a, const Overlap *b) { return a->AlignedLength() > b->AlignedLength(); };
-    read2ctg_group_ = read2ctg_.GroupTarget(better);
-
-    for (auto &ctg0 : read2ctg_group_) {
-        for (auto &ctg1 : read2ctg_group_) {
-
-            if (ctg0.first < ctg1.first) {
-
-                auto keys = FindIntersectKeys(ctg0.second, ctg1.second);
-
-                for (auto k : keys) {
-                    auto &o0 = *ctg0.second[k];
-                    auto &o1 = *ctg1.second[k];
-                    
-                    if (ContigLink::SimpleValid(o0, o1, read2ctg_max_overhang_)) {
-                        links_[ctg0.first][ctg1.first].Add(o0, o1);
+    read2ctg_index_.Build(read2ctg_.Get(), [](const Overlap&) { return true; },
+        [better](const Overlap &cand, const Overlap &cur) { return !better(&cur, &cand); }, thread_size_, true);
+
+    // the reads of both contigs are found by merging their sorted groups
+    auto ctgs = read2ctg_index_.Reads();
+    for (size_t i0 = 0; i0 < ctgs.size(); ++i0) {
+        auto g0 = read2ctg_index_.Get(ctgs[i0]);
+        for (size_t i1 = i0 + 1; i1 < ctgs.size(); ++i1) {
+            auto g1 = read2ctg_index_.Get(ctgs[i1]);
+
+            auto it0 = g0.begin();
+            auto it1 = g1.begin();
+            while (it0 != g0.end() && it1 != g1.end()) {
+                auto n0 = *it0;
+                auto n1 = *it1;
+                if (n0.id < n1.id) {
+                    ++it0;
+                } else if (n1.id < n0.id) {
+                    ++it1;
+                } else {
+                    if (ContigLink::SimpleValid(*n0.ol, *n1.ol, read2ctg_max_overhang_)) {
+                        links_[ctgs[i0]][ctgs[i1]].Add(*n0.ol, *n1.ol);
                     }
+                    ++it0;
+                    ++it1;
                 }
             }
         }
-
     }
 }
 
@@ -8,6 +8,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "overlap_index.hpp"
 #include "overlap_store.hpp"
 #include "sequence.hpp"
 #include "read_store.hpp"
@@ -47,7 +48,7 @@ protected:
 
     int thread_size_ {1};
 
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> read2ctg_group_;
+    OverlapIndex read2ctg_index_;
     std::unordered_map<int, std::unordered_map<int, ContigLink>> links_;
 
     ReadStore &read_store_;
@@ -7,7 +7,7 @@ endif
 
 TARGET   := libfsa.a
 SOURCES  := argument_parser.cpp getopt.c logger.cpp overlap.cpp read_store.cpp sequence.cpp\
-             utility.cpp fasta_reader.cpp fastq_reader.cpp overlap_store.cpp \
+             utility.cpp fasta_reader.cpp fastq_reader.cpp overlap_store.cpp seqdb_reader.cpp \
    			 ./simple_align.cpp overlap_filter.cpp overlap_stat.cpp
 
 TGT_CXXFLAGS := -U_GLIBCXX_PARALLEL -std=c++11 -Wall -O3 -D_FILE_OFFSET_BITS=64 
@@ -0,0 +1,15 @@
+#include "overlap_convert.hpp"
+
+
+int main(int argc, char *argv[]) {
+    OverlapConvert oc;
+
+    if (oc.ParseArgument(argc, argv)) {
+        oc.Run();
+    }
+    else {
+        oc.Usage();
+    }
+    return 0;
+
+}
@@ -8,12 +8,13 @@
 
 class Overlap {
 public:
+	// 16 bytes: the strand shares a word with len, lengths are below 2^30
 	struct Read {
 		int id;
-		int strand;
 		int start;
 		int end;
-		int len;
+		int len : 31;
+		unsigned strand : 1;
 	};
 public:
 
@@ -65,9 +66,11 @@ public:
 	Read b_;
 	int score_;
 	double identity_;
-    mutable long long attached {0};   // used by other, and avoid building map (Overlap -> info)
 };
 
+static_assert(sizeof(Overlap::Read) == 16, "Overlap::Read is expected to be 16 bytes");
+static_assert(sizeof(Overlap) == 48, "Overlap is expected to be 48 bytes");
+
 
 template<int N>
 std::array<int, N> Overlap::Mapping(const Read& a, const Read& b, const std::array<int, N> &bpos) {
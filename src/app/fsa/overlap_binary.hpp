@@ -0,0 +1,73 @@
+#ifndef FSA_OVERLAP_BINARY_HPP
+#define FSA_OVERLAP_BINARY_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// Binary overlap file (.ovb): an OvbHeader followed by header.num_records
+// OvbRecords. Read ids are 0-based read indexes as in m4 files loaded by
+// OverlapStore::FromM4Line, and a_.strand is always 0.
+struct OvbHeader {
+    static constexpr const char* kMagic = "FSAOVB\0";
+    static const uint32_t kVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_records;
+
+    void Init(uint64_t n);
+    bool IsValid() const;
+};
+
+struct OvbRecord {
+    int32_t a_id;
+    int32_t a_start;
+    int32_t a_end;
+    int32_t a_len;
+    int32_t b_id;
+    int32_t b_start;
+    int32_t b_end;
+    int32_t b_len;
+    int32_t score;
+    float identity;
+    uint8_t a_strand;
+    uint8_t b_strand;
+    uint8_t reserved[2];
+};
+
+static_assert(sizeof(OvbHeader) == 24, "unexpected size of OvbHeader");
+static_assert(sizeof(OvbRecord) == 44, "unexpected size of OvbRecord");
+
+// A raw M4Record (corelib/m4_record.h) as written by mecat2map -outfmt m4x.
+// Read ids are 0-based database ids.
+struct M4xRecord {
+    int32_t qid;
+    int32_t qdir;
+    int32_t qoff;
+    int32_t qend;
+    int32_t qsize;
+    int32_t sid;
+    int32_t sdir;
+    int32_t soff;
+    int32_t send;
+    int32_t ssize;
+    double ident_perc;
+    int32_t score;
+};
+
+static_assert(sizeof(M4xRecord) == 56, "unexpected size of M4xRecord");
+
+inline void OvbHeader::Init(uint64_t n) {
+    memset(this, 0, sizeof(OvbHeader));
+    memcpy(magic, kMagic, sizeof(magic));
+    version = kVersion;
+    record_size = sizeof(OvbRecord);
+    num_records = n;
+}
+
+inline bool OvbHeader::IsValid() const {
+    return memcmp(magic, kMagic, sizeof(magic)) == 0 && version == kVersion && record_size == sizeof(OvbRecord);
+}
+
+#endif // FSA_OVERLAP_BINARY_HPP
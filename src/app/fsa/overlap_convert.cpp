@@ -0,0 +1,38 @@
+#include "overlap_convert.hpp"
+
+#include <iostream>
+
+#include "logger.hpp"
+
+bool OverlapConvert::ParseArgument(int argc, char *const argv[]) {
+    return GetArgumentParser().ParseArgument(argc, argv);
+}
+
+ArgumentParser OverlapConvert::GetArgumentParser() {
+    ArgumentParser ap("fsa_ol_convert", "Converts overlaps between the text formats and the binary format", "1.0");
+    ap.AddNamedOption(ifile_type_, "ifile_type", "input overlap file format. \"\" = filename extension, \"m4x\" = binary records of mecat2map, \"ovb\" = binary overlap format", "\"|m4|m4a|paf|ovl|m4x|ovb\"");
+    ap.AddNamedOption(ofile_type_, "ofile_type", "output overlap file format. \"\" = filename extension", "\"|m4|m4a|paf|ovb\"");
+    ap.AddNamedOption(m4x_seqdb_, "m4x_seqdb", "directory of the sequence database mecat2map built for a m4x file, whose read names give the read ids. Without it the database ordinals are taken as read ids");
+    ap.AddNamedOption(read_file_, "read_file", "reads, loaded first so that read names map to read indexes. Required for formats using read names (m4a, paf)");
+    ap.AddNamedOption(thread_size_, "thread_size", "number of threads");
+
+    ap.AddPositionOption(ifname_, "overlaps", "input filename");
+    ap.AddPositionOption(ofname_, "converted_overlaps", "output filename");
+    return ap;
+}
+
+void OverlapConvert::Usage() {
+    std::cout << GetArgumentParser().Usage();
+}
+
+void OverlapConvert::Run() {
+    if (!read_file_.empty()) {
+        read_store_.Load(read_file_, "", 4);
+    }
+
+    LOG(INFO)("Load overlaps from %s", ifname_.c_str());
+    ol_store_.SetM4xSeqdb(m4x_seqdb_);
+    ol_store_.Load(ifname_, ifile_type_, (size_t)thread_size_);
+    LOG(INFO)("Save %zd overlaps to %s", ol_store_.Size(), ofname_.c_str());
+    ol_store_.Save(ofname_, ofile_type_);
+}
@@ -0,0 +1,34 @@
+#ifndef FSA_OVERLAP_CONVERT_HPP
+#define FSA_OVERLAP_CONVERT_HPP
+
+#include <string>
+
+#include "overlap_store.hpp"
+#include "read_store.hpp"
+#include "argument_parser.hpp"
+
+class OverlapConvert {
+public:
+    OverlapConvert() : ol_store_(read_store_) {}
+
+    bool ParseArgument(int argc, char *const argv[]);
+    void Run();
+    void Usage();
+
+protected:
+    ArgumentParser GetArgumentParser();
+
+protected:
+    std::string ifname_;
+    std::string ofname_;
+    std::string ifile_type_ { "" };
+    std::string ofile_type_ { "" };
+    std::string read_file_ { "" };
+    std::string m4x_seqdb_ { "" };
+    int thread_size_ { 4 };
+
+    ReadStore read_store_;
+    OverlapStore ol_store_;
+};
+
+#endif // FSA_OVERLAP_CONVERT_HPP
@@ -35,7 +35,8 @@ ArgumentParser OverlapFilter::GetArgumentParser() {
     ap.AddNamedOption(max_coverage_, "max_coverage", "maximum base coverage, negative number = determined by the program");
     ap.AddNamedOption(max_diff_coverage_, "max_diff_coverage", "maximum difference of base coverage, negative number = determined by the program");
     ap.AddNamedOption(coverage_discard_, "coverage_discard", "discard ratio of base coverage. If max_coverage or max_diff_coverage is negative, it will be reset to (100-coverage_discard)th percentile.");
-    ap.AddNamedOption(overlap_file_type_, "overlap_file_type", "overlap file format. \"\" = filename extension, \"m4\" = M4 format, \"paf\" = PAF format generated by minimap2, \"ovl\" = OVL format generated by FALCON.", "\"|m4|m4a|paf|ovl\"");
+    ap.AddNamedOption(overlap_file_type_, "overlap_file_type", "overlap file format. \"\" = filename extension, \"m4\" = M4 format, \"paf\" = PAF format generated by minimap2, \"ovl\" = OVL format generated by FALCON, \"m4x\" = binary records of mecat2map, \"ovb\" = binary overlap format.", "\"|m4|m4a|paf|ovl|m4x|ovb\"");
+    ap.AddNamedOption(m4x_seqdb_, "m4x_seqdb", "directory of the sequence database mecat2map built for a m4x file, whose read names give the read ids. Without it the database ordinals are taken as read ids");
     ap.AddNamedOption(bestn_, "bestn", " output best n overlaps on 5' or 3' end for each read");
     //ap.AddNamedOption(genome_size_, "genome_size", "genome size, working with `--coverage` to determine the maximum length of reads", "\\d+[kKmMgG]?", ParamToGenomeSize);
     ap.AddNamedOption(genome_size_, "genome_size", "genome size. It determines the maximum length of reads with coverage together", "INT", ParamToGenomeSize);
@@ -127,7 +128,9 @@ void OverlapFilter::LoadOverlaps(const std::string &fname) {
         }
     };
 
+    ol_store_.SetM4xSeqdb(m4x_seqdb_);
     ol_store_.Load(fname, overlap_file_type_, (size_t)thread_size_, filter_simple);
+    ol_reasons_.assign(ol_store_.Size(), OlReason::RS_OK);
     
     // MMM
     // for (auto &o : ol_store_.Get()) {
@@ -315,9 +318,9 @@ void OverlapFilter::FilterContainedMt() {
 
 void OverlapFilter::FilterCoverage() {
 
-    for (auto &g : groups_) {
-        auto minmax = CalcMinMaxCoverage(g.first, g.second);
-        coverages_.insert(std::make_pair(g.first, std::array<int,2>{minmax.first, minmax.second}));
+    for (auto i : groups_.Reads()) {
+        auto minmax = CalcMinMaxCoverage(i, groups_.Get(i));
+        coverages_.insert(std::make_pair(i, std::array<int,2>{minmax.first, minmax.second}));
     }
     
        
@@ -327,20 +330,21 @@ void OverlapFilter::FilterCoverage() {
 
 
 void OverlapFilter::FilterCoverageMt() {
-    auto work_func = [&](const std::vector<int>& input) -> std::unordered_map<int, std::array<int, 2>> {
-        std::unordered_map<int, std::array<int, 2>> output;
-        
-        for (auto i : input) {
-            auto minmax = CalcMinMaxCoverage(i, groups_[i]);
-            output.insert(std::make_pair(i, std::array<int,2>{minmax.first, minmax.second}));
+    auto ranges = groups_.SplitReads(thread_size_);
+    std::vector<std::vector<std::pair<int, std::array<int, 2>>>> outputs(ranges.size());
+
+    MultiThreadRun(ranges.size(), [&](size_t t) {
+        for (Seq::Id i = ranges[t][0]; i < ranges[t][1]; ++i) {
+            auto g = groups_.Get(i);
+            if (g.empty()) continue;
+            auto minmax = CalcMinMaxCoverage(i, g);
+            outputs[t].push_back(std::make_pair(i, std::array<int,2>{minmax.first, minmax.second}));
         }
-        return output;
-    };
+    });
 
-    coverages_ = MultiThreadRun(thread_size_, groups_, 
-        SplitMapKeys<decltype(groups_)>, 
-        work_func, 
-        MoveCombineMapOrSet<std::unordered_map<int, std::array<int, 2>>>);   
+    for (auto &output : outputs) {
+        coverages_.insert(output.begin(), output.end());
+    }
     coverage_params_ = CoverageParam1();
     FilterCoverage(coverage_params_[0], coverage_params_[1], coverage_params_[2]);
 }
@@ -382,31 +386,31 @@ void OverlapFilter::FilterLackOfSupportMt() {
 }
 
 void OverlapFilter::FilterLocal() {
-    for (auto &g : groups_) {
-        FilterLocalStep(g.first, g.second);
+    local_thresholds_.assign(groups_.GetIdRange()[1], std::array<int, 2>{{0, 0}});
+    for (auto i : groups_.Reads()) {
+        FilterLocalStep(i, groups_.Get(i));
     }
     
 }
 
 void OverlapFilter::FilterLocalMt() {
-    auto work_func = [&](const std::vector<Seq::Id>& input)  {
-        
-        for (auto i : input) {
-            FilterLocalStep(i, groups_[i]);
-        }
-    };
+    auto ranges = groups_.SplitReads(thread_size_);
+    local_thresholds_.assign(groups_.GetIdRange()[1], std::array<int, 2>{{0, 0}});
 
-    MultiThreadRun(thread_size_, groups_, 
-        SplitMapKeys<decltype(groups_)>, 
-        work_func);   
+    MultiThreadRun(ranges.size(), [&](size_t t) {
+        for (Seq::Id i = ranges[t][0]; i < ranges[t][1]; ++i) {
+            auto g = groups_.Get(i);
+            if (!g.empty()) FilterLocalStep(i, g);
+        }
+    });
 }
 
-void OverlapFilter::FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id, const Overlap*>& g) {
+void OverlapFilter::FilterLocalStep(Seq::Id id, const OverlapIndex::Group& g) {
     std::vector<std::array<double,2>> identities;
     std::vector<std::array<double,2>> overhangs;       // TODO Is it better to distiguish between 3' and 5' 
 
-    for (auto &i : g) {
-        const Overlap &o = *i.second;
+    for (auto i : g) {
+        const Overlap &o = *i.ol;
         if (IsReserved(o)) {
             identities.push_back(std::array<double,2>{o.identity_, o.identity_*o.AlignedLength() / 1000.0});
 
@@ -427,10 +431,11 @@ void OverlapFilter::FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id
         double mad = 0;
         ComputeMedianAbsoluteDeviation(identities, median, mad);
         double th = min_identity_median_ > 0 ? std::min(median - 6*1.4826*mad, min_identity_median_) : min_identity_;
-        for (auto &i : g) {
-            const Overlap &o = *i.second;
+        local_thresholds_[id][0] = (int)th*100;
+        for (auto i : g) {
+            const Overlap &o = *i.ol;
             if (IsReserved(o) && o.identity_ < th) {                
-                SetOlReason(o, OlReason::Local(0, (int)th*100));
+                SetLocalReason(o, id, 0);
             }
         }
     }
@@ -440,9 +445,10 @@ void OverlapFilter::FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id
         double mad = 0;
         ComputeMedianAbsoluteDeviation(overhangs, median, mad);
         double th = max_overhang_median_ > 0 ? std::max(median + 6*1.4826*mad, max_overhang_median_) : max_overhang_;
+        local_thresholds_[id][1] = (int)th;
         //printf("th,median,mad: %f, %f, %f\n", th, median, mad);
-        for (auto &i : g) {
-            const Overlap &o = *i.second;      
+        for (auto i : g) {
+            const Overlap &o = *i.ol;      
             if (IsReserved(o)) {       
                 auto loc = o.Location(max_overhang_);
                 assert(loc != Overlap::Loc::Abnormal);
@@ -451,13 +457,13 @@ void OverlapFilter::FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id
                 if (id == o.a_.id ) {
                     if (ol[0] >= 0 && ol[0] > th)  {
                         //printf("%d %s", id, o.ToM4Line().c_str());
-                        SetOlReason(o, OlReason::Local(1, th));
+                        SetLocalReason(o, id, 1);
                     }
                 } else {
                     assert(id == o.b_.id);
                     if (ol[1] >= 0 && ol[1] > th)  {
                         //printf("%d %s", id, o.ToM4Line().c_str());
-                        SetOlReason(o, OlReason::Local(1, th));
+                        SetLocalReason(o, id, 1);
                     }
                 }
                             
@@ -466,8 +472,8 @@ void OverlapFilter::FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id
 
     }    
     
-    for (auto &i : g) {
-        const Overlap &o = *i.second;
+    for (auto i : g) {
+        const Overlap &o = *i.ol;
         if (IsReserved(o)) {
             ModifyEnd(o);
 	    }
@@ -502,15 +508,16 @@ void OverlapFilter::FilterLongest() {
 }
 
 void OverlapFilter::FilterBestN() {
-    std::unordered_set<const Overlap*> keep;
-    for (auto &g : groups_) {
-        auto k = FindBestN(g);
-        keep.insert(k.begin(), k.end());
-        
+    std::vector<char> keep(ol_store_.Size(), 0);
+    for (auto i : groups_.Reads()) {
+        for (auto k : FindBestN(i, groups_.Get(i))) {
+            keep[k] = 1;
+        }
     }
 
-    for (const auto &o : ol_store_.Get()) {
-        if (IsReserved(o) && keep.find(&o) == keep.end()) {
+    for (size_t i = 0; i < ol_store_.Size(); ++i) {
+        const Overlap &o = ol_store_.Get(i);
+        if (IsReserved(o) && !keep[i]) {
             SetOlReason(o, OlReason::BestN());
         }
 
@@ -519,30 +526,27 @@ void OverlapFilter::FilterBestN() {
 
 
 void OverlapFilter::FilterBestNMt() {
-    auto work_func = [&](const std::vector<int> &input) {
-        
-        std::unordered_set<const Overlap*> output;
-        for (auto &i : input) {
-            if (filtered_reads_.find(i) == filtered_reads_.end()) {
-                auto g = groups_.find(i);
-                assert(g != groups_.end());
-                auto k = FindBestN(*g);
-
-                output.insert(k.begin(), k.end());
+    auto ranges = groups_.SplitReads(thread_size_);
+    std::vector<std::vector<uint32_t>> outputs(ranges.size());
+
+    MultiThreadRun(ranges.size(), [&](size_t t) {
+        for (Seq::Id i = ranges[t][0]; i < ranges[t][1]; ++i) {
+            auto g = groups_.Get(i);
+            if (!g.empty() && filtered_reads_.find(i) == filtered_reads_.end()) {
+                auto k = FindBestN(i, g);
+                outputs[t].insert(outputs[t].end(), k.begin(), k.end());
             }
-            
         }
-        return output;
-    };
-
+    });
 
-    auto keep = MultiThreadRun(thread_size_, groups_, 
-        SplitMapKeys<decltype(groups_)>, 
-        work_func, 
-        MoveCombineMapOrSet<std::unordered_set<const Overlap*>>);
+    std::vector<char> keep(ol_store_.Size(), 0);
+    for (auto &output : outputs) {
+        for (auto k : output) keep[k] = 1;
+    }
 
-    for (const auto &o : ol_store_.Get()) {
-        if (IsReserved(o) && keep.find(&o) == keep.end()) {
+    for (size_t i = 0; i < ol_store_.Size(); ++i) {
+        const Overlap &o = ol_store_.Get(i);
+        if (IsReserved(o) && !keep[i]) {
             SetOlReason(o, OlReason::BestN());
         }
 
@@ -793,101 +797,35 @@ void OverlapFilter::AutoSelectMinAlignedLength(const std::unordered_map<Seq::Id,
 }
 
 void OverlapFilter::GroupAndFilterDuplicate() {
-    for (const auto &o : ol_store_.Get()) {
-        if (IsReserved(o)) {
-
-            auto add_overlap = [&](int a, int b, const Overlap& o) {
-                auto iter = groups_.find(a);
-                if (iter != groups_.end()) {
-                    auto iteriter = iter->second.find(b);
-                    if (iteriter == iter->second.end()) {
-                        iter->second[b] = &o;
-                    } else {
-                        if (BetterAlignedLength(o, *(iteriter->second))) {
-                            SetOlReason(*(iteriter->second), OlReason::Duplicate());
-                            iteriter->second = &o;
-                        } else {
-                            SetOlReason(o, OlReason::Duplicate());
-
-                        }
-                    }
-                }
-                else {
-                    auto iter = groups_.insert(std::make_pair(a, std::unordered_map<int, const Overlap*>()));
-                    iter.first->second[b] = &o;
-                }
-            };
-
-            add_overlap(o.a_.id, o.b_.id, o);
-            add_overlap(o.b_.id, o.a_.id, o);
-        }
-    }
+    GroupAndFilterDuplicate(1);
 }
 
 void OverlapFilter::GroupAndFilterDuplicateMt() {
-    std::vector<std::pair<const Overlap*, OlReason>> ignored;
-    std::mutex mutex;
-
-    auto add_overlap = [](int low, int a, int b, const Overlap& o, std::vector<std::unordered_map<Seq::Id, const Overlap*>>& group) {
-        
-        auto it = group[a-low].find(b);
-        if (it == group[a-low].end()) {
-            group[a-low][b] = &o;
-        } else {
-            if (BetterAlignedLength(o, *(it->second))) {
-                SetOlReason(*(it->second), OlReason::Duplicate());
-                it->second = &o;
-            } else {
-                SetOlReason(o, OlReason::Duplicate());
-            }
-        }
-
-    };
-
-    auto split_func = [this]() {
-        auto r = ol_store_.GetReadIdRange();
-        return SplitRange(thread_size_, r[0], r[1]);
-    };
-    auto comb_func = [this, &ignored, &mutex](int low, std::vector<std::unordered_map<Seq::Id, const Overlap*>>&& group) {
-        std::lock_guard<std::mutex> lock(mutex);
-        for (size_t i=0; i<group.size(); ++i) {
-            if (group[i].size() > 0) {
-                groups_[low+(int)i] = std::move(group[i]);
-            }
-
-        }
-    };
-
-    auto work_func = [this, add_overlap, comb_func](std::array<Seq::Id, 2> r) {
-        std::vector<std::unordered_map<Seq::Id, const Overlap*>> group(r[1] - r[0]);
-        std::vector<std::pair<const Overlap*, OlReason>> ignored;
-
-        for (const auto &o : ol_store_.Get()) {
-            if (IsReserved(o)) {
-                if (o.a_.id >= r[0] && o.a_.id < r[1]) {
-                    add_overlap(r[0], o.a_.id, o.b_.id, o, group);
-                }
-                if (o.b_.id >= r[0] && o.b_.id < r[1]) {
-                    add_overlap(r[0], o.b_.id, o.a_.id, o, group);
-                }
-            }
-        }
-
-        comb_func(r[0], std::move(group));
-    };
-
-    MultiThreadRun((int)thread_size_, split_func, work_func);
+    GroupAndFilterDuplicate((size_t)thread_size_);
+}
 
+void OverlapFilter::GroupAndFilterDuplicate(size_t thread_size) {
+    // Of the overlaps of a pair of reads the longest one is kept, the first
+    // one in the store if there is a tie.
+    std::vector<uint32_t> duplicates;
+    groups_.Build(ol_store_.Get(), 
+        [this](const Overlap &o) { return IsReserved(o); }, 
+        [](const Overlap &cand, const Overlap &cur) { return BetterAlignedLength(cand, cur); },
+        thread_size, false, &duplicates);
+
+    for (auto i : duplicates) {
+        SetOlReason(ol_store_.Get(i), OlReason::Duplicate());
+    }
 }
 
 
-std::pair<int, int> OverlapFilter::CalcMinMaxCoverage(int id, const std::unordered_map<int, const Overlap*>& group) {
+std::pair<int, int> OverlapFilter::CalcMinMaxCoverage(int id, const OverlapIndex::Group& group) {
     if (group.size() > 0) {
-        std::vector<int> cov((group.begin()->second->a_.id == id ? group.begin()->second->a_.len :
-            group.begin()->second->b_.len) + 1, 0);
+        const Overlap &first = *(*group.begin()).ol;
+        std::vector<int> cov((first.a_.id == id ? first.a_.len : first.b_.len) + 1, 0);
 
-        for (const auto &ig : group) {
-            const Overlap& o = *ig.second;
+        for (auto ig : group) {
+            const Overlap& o = *ig.ol;
             if (IsReserved(o)) {
                 if (o.a_.id == id) {
                     cov[o.a_.start] ++;
@@ -1174,38 +1112,38 @@ bool OverlapFilter::HasSupport(const Overlap &o, int count) const {
 }
 
 bool OverlapFilter::HasAlignment(int a, int b, int end, int count, bool exceeding) const {
-    auto agroup = groups_.find(a);
-    auto bgroup = groups_.find(b);
+    auto agroup = groups_.Get(a);
+    auto bgroup = groups_.Get(b);
 
-    assert(agroup != groups_.end() && bgroup != groups_.end());
+    assert(!agroup.empty() && !bgroup.empty());
     int at0 = 0;
     int at1 = 0;
     int reserved_at0 = 0;
     int reserved_at1 = 0;
-    for (const auto &i : agroup->second) {
-        //if (i.first == b || !IsReserved(*i.second)) continue; // skip self
-        if (i.first == b ) continue; // skip self
+    for (auto i : agroup) {
+        //if (i.id == b || !IsReserved(*i.ol)) continue; // skip self
+        if (i.id == b ) continue; // skip self
 
         if (end == 0) {
             bool qualified = false;
          
             if (exceeding) {
-                if (i.second->SameDirect()) {
-                    qualified = i.second->a_.id == a ? i.second->b_.start > max_overhang_ 
-                                                     : i.second->a_.start > max_overhang_;
+                if (i.ol->SameDirect()) {
+                    qualified = i.ol->a_.id == a ? i.ol->b_.start > max_overhang_ 
+                                                     : i.ol->a_.start > max_overhang_;
                 } else {
-                    qualified = i.second->a_.id == a ? i.second->b_.len - i.second->b_.end > max_overhang_ 
-                                                     : i.second->a_.len - i.second->a_.end > max_overhang_;
+                    qualified = i.ol->a_.id == a ? i.ol->b_.len - i.ol->b_.end > max_overhang_ 
+                                                     : i.ol->a_.len - i.ol->a_.end > max_overhang_;
                 }
             } else {
-                qualified = i.second->a_.id == a ? i.second->a_.start <= max_overhang_ 
-                                                 : i.second->b_.start <= max_overhang_;
+                qualified = i.ol->a_.id == a ? i.ol->a_.start <= max_overhang_ 
+                                                 : i.ol->b_.start <= max_overhang_;
             }
-            auto inbgroup = bgroup->second.find(i.first);
-            //if ( qualified && inbgroup != bgroup->second.end() && IsReserved(*(inbgroup->second))) {
-            if ( qualified && inbgroup != bgroup->second.end()) {
+            auto inbgroup = bgroup.Find(i.id);
+            //if ( qualified && inbgroup != nullptr && IsReserved(*inbgroup)) {
+            if ( qualified && inbgroup != nullptr) {
                 at0 ++;
-                if (IsReserved(*(inbgroup->second)) && IsReserved(*i.second)) reserved_at0 ++;
+                if (IsReserved(*inbgroup) && IsReserved(*i.ol)) reserved_at0 ++;
                 if (at0 >= count && reserved_at0 >= 1) return true;
             }
         } else {
@@ -1213,22 +1151,22 @@ bool OverlapFilter::HasAlignment(int a, int b, int end, int count, bool exceedin
             bool qualified = false;
          
             if (exceeding) {
-                if (i.second->SameDirect()) {
-                    qualified = i.second->a_.id == a ? i.second->b_.len - i.second->b_.end > max_overhang_ 
-                                                     : i.second->a_.len - i.second->a_.end > max_overhang_;
+                if (i.ol->SameDirect()) {
+                    qualified = i.ol->a_.id == a ? i.ol->b_.len - i.ol->b_.end > max_overhang_ 
+                                                     : i.ol->a_.len - i.ol->a_.end > max_overhang_;
                 } else {
-                    qualified = i.second->a_.id == a ? i.second->b_.start > max_overhang_ 
-                                                     : i.second->a_.start > max_overhang_;
+                    qualified = i.ol->a_.id == a ? i.ol->b_.start > max_overhang_ 
+                                                     : i.ol->a_.start > max_overhang_;
                 }
             } else {
-                qualified = i.second->a_.id == a ? i.second->a_.len - i.second->a_.end <= max_overhang_ 
-                                                 : i.second->b_.len - i.second->b_.end <= max_overhang_;
+                qualified = i.ol->a_.id == a ? i.ol->a_.len - i.ol->a_.end <= max_overhang_ 
+                                                 : i.ol->b_.len - i.ol->b_.end <= max_overhang_;
             }
-            auto inbgroup = bgroup->second.find(i.first);
-            //if ( qualified && inbgroup != bgroup->second.end() && IsReserved(*(inbgroup->second))) {
-            if ( qualified && inbgroup != bgroup->second.end()) {
+            auto inbgroup = bgroup.Find(i.id);
+            //if ( qualified && inbgroup != nullptr && IsReserved(*inbgroup)) {
+            if ( qualified && inbgroup != nullptr) {
                 at1 ++;
-                if (IsReserved(*(inbgroup->second)) && IsReserved(*i.second)) reserved_at1 ++; 
+                if (IsReserved(*inbgroup) && IsReserved(*i.ol)) reserved_at1 ++; 
                 if (at1 >= count && reserved_at1 >= 1) return true;
             }
         }
@@ -1237,42 +1175,36 @@ bool OverlapFilter::HasAlignment(int a, int b, int end, int count, bool exceedin
     return false;
 }
 
-std::unordered_set<const Overlap*> OverlapFilter::FindBestN(const std::pair<int, std::unordered_map<int, const Overlap*>> &g) const {
-    std::unordered_set<const Overlap*> keep;
-    std::vector<const Overlap*> left, right;
-    for (auto &i : g.second) {
-        const Overlap& o = *(i.second);
+std::vector<uint32_t> OverlapFilter::FindBestN(Seq::Id id, const OverlapIndex::Group& g) const {
+    std::vector<uint32_t> keep;
+    std::vector<OverlapIndex::Neighbour> left, right;
+    for (auto i : g) {
+        const Overlap& o = *i.ol;
 
         if (IsReserved(o)) {
-            auto loc = o.Location(i.first, 0);
+            auto loc = o.Location(i.id, 0);
             if (loc == Overlap::Loc::Left) {
-                left.push_back(&o);
+                left.push_back(i);
             } else {
                 assert(loc == Overlap::Loc::Right);
-                right.push_back(&o);
+                right.push_back(i);
             }
             
         }
     }
 
+    auto better = [](const OverlapIndex::Neighbour &a, const OverlapIndex::Neighbour &b) { return BetterAlignedLength(*a.ol, *b.ol); };
     if (left.size() > (size_t)bestn_) {
-        std::sort(left.begin(), left.end(), [](const Overlap* a, const Overlap *b){ return BetterAlignedLength(*a, *b); });
-
-        keep.insert(left.begin(), left.begin() + bestn_);
-    }
-    else {
-        keep.insert(left.begin(), left.end());
+        std::sort(left.begin(), left.end(), better);
+        left.resize(bestn_);
     }
     if (right.size() > (size_t)bestn_) {
-        std::sort(right.begin(), right.end(), [](const Overlap* a, const Overlap *b) { return BetterAlignedLength(*a, *b);} );
-
-        keep.insert(right.begin(), right.begin() + bestn_);
-
-    }
-    else {
-        keep.insert(right.begin(), right.end());
+        std::sort(right.begin(), right.end(), better);
+        right.resize(bestn_);
     }
 
+    for (auto &i : left) keep.push_back(i.index);
+    for (auto &i : right) keep.push_back(i.index);
     return keep;
 }
 
@@ -1385,17 +1317,40 @@ void OverlapFilter::DumpFilteredOverlaps(const std::string &fname) const {
 }
 
 
+// A reason is stored in one byte: bits 0-2 hold the type, bit 3 tells
+// whether the read of the reason is b_ rather than a_, and bit 4 holds the
+// kind of a Local reason, whose threshold is kept by read in local_thresholds_.
 void OverlapFilter::SetOlReason(const Overlap &o, OlReason rs) {
-    o.attached = ((long long)(rs.type) << 32) + rs.sub[0];
-    assert(rs.sub[1] == 0);
+    assert(rs.type != OlReason::RS_LOCAL && rs.sub[1] == 0);
+    uint8_t v = (uint8_t)rs.type;
+    if (rs.type == OlReason::RS_FILTERED_READ) {
+        assert(rs.sub[0] == o.a_.id || rs.sub[0] == o.b_.id);
+        if (rs.sub[0] != o.a_.id) v |= 0x08;
+    } else {
+        assert(rs.sub[0] == 0);
+    }
+    ol_reasons_[ol_store_.IndexOf(o)] = v;
+}
+
+void OverlapFilter::SetLocalReason(const Overlap &o, Seq::Id id, int t) {
+    assert(id == o.a_.id || id == o.b_.id);
+    assert(t == 0 || t == 1);
+    uint8_t v = (uint8_t)OlReason::RS_LOCAL | (uint8_t)(t << 4);
+    if (id != o.a_.id) v |= 0x08;
+    ol_reasons_[ol_store_.IndexOf(o)] = v;
 }
 
-OverlapFilter::OlReason OverlapFilter::GetOlReason(const Overlap &o) {
-    OlReason rs; 
-    rs.type = (OlReason::Type)(o.attached >> 32);
-    assert(rs.type >= OlReason::RS_OK && rs.type <= OlReason::RS_UNKNOWN);
+OverlapFilter::OlReason OverlapFilter::GetOlReason(const Overlap &o) const {
+    uint8_t v = ol_reasons_[ol_store_.IndexOf(o)];
+    OlReason rs((OlReason::Type)(v & 0x07));
+    Seq::Id id = (v & 0x08) ? o.b_.id : o.a_.id;
 
-    rs.sub[0] = o.attached & 0xFFFFFFFF;
+    if (rs.type == OlReason::RS_FILTERED_READ) {
+        rs.sub[0] = id;
+    } else if (rs.type == OlReason::RS_LOCAL) {
+        int t = (v >> 4) & 1;
+        rs = OlReason::Local(t, local_thresholds_[id][t]);
+    }
     return rs;
 }
 
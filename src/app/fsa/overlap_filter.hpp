@@ -6,6 +6,7 @@
 #include <sstream>
 #include <array>
 
+#include "overlap_index.hpp"
 #include "overlap_store.hpp"
 #include "argument_parser.hpp"
 
@@ -85,6 +86,7 @@ protected:
     void FilterSimpleMt();
     void GroupAndFilterDuplicate();
     void GroupAndFilterDuplicateMt();
+    void GroupAndFilterDuplicate(size_t thread_size);
     void FilterContained();
     void FilterContainedMt();
     void FilterCoverage();
@@ -93,7 +95,7 @@ protected:
     void FilterLackOfSupportMt();
     void FilterLocal();
     void FilterLocalMt();
-    void FilterLocalStep(Seq::Id id, const std::unordered_map<Seq::Id, const Overlap*>& g);
+    void FilterLocalStep(Seq::Id id, const OverlapIndex::Group& g);
     void FilterLongest();
     void FilterBestN();
     void FilterBestNMt();
@@ -122,7 +124,7 @@ protected:
         return o.AlignedLength() >= (size_t)min_aligned_length_;
     }
 
-    std::pair<int, int> CalcMinMaxCoverage(int id, const std::unordered_map<int, const Overlap*>& group);
+    std::pair<int, int> CalcMinMaxCoverage(int id, const OverlapIndex::Group& group);
 
     std::string OutputPath(const std::string &fname) const { return output_directory_+"/"+fname; }
     void PrintArguments();
@@ -139,11 +141,11 @@ protected:
 
     bool HasSupport(const Overlap &o, int count) const;
     bool HasAlignment(int a, int b, int end, int count, bool exceeding) const;
-    std::unordered_set<const Overlap*> FindBestN(const std::pair<int, std::unordered_map<int, const Overlap*>> &groud) const;
+    std::vector<uint32_t> FindBestN(Seq::Id id, const OverlapIndex::Group& g) const;
   
     bool IsContained(const Overlap& o, std::array<int, 2> &rel);
     bool IsReserved(const Overlap &o) const {
-        return GetOlReason(o).type == OlReason::RS_OK;
+        return ol_reasons_[ol_store_.IndexOf(o)] == OlReason::RS_OK;
     }
     void UpdateFilteredRead(const std::unordered_map<Seq::Id, RdReason> &ignored);
 
@@ -155,8 +157,9 @@ protected:
     void DumpFilteredOverlaps(const std::string &fname) const;
 
     static bool BetterAlignedLength(const Overlap &o0, const Overlap &o1) { return o0.AlignedLength() > o1.AlignedLength(); }
-    static void SetOlReason(const Overlap &o, OlReason rs);
-    static OlReason GetOlReason(const Overlap &o);
+    void SetOlReason(const Overlap &o, OlReason rs);
+    void SetLocalReason(const Overlap &o, Seq::Id id, int t);
+    OlReason GetOlReason(const Overlap &o) const;
 
 public:
     static bool ParamToGenomeSize(const std::string& str, long long *v);
@@ -174,6 +177,7 @@ protected:
     double coverage_discard_ { 0.01 };
     int bestn_{ 10 };                   //!< 
     std::string overlap_file_type_{ "" };
+    std::string m4x_seqdb_{ "" };
     int thread_size_{ 4 };           //!< 
     std::string output_directory_ {"."};
     std::string coverage_fname_ { "coverage.txt" };  //!< variable this->coverages_
@@ -190,7 +194,9 @@ protected:
     std::array<int, 3> coverage_params_;
 
     OverlapStore ol_store_;
-    std::unordered_map<int, std::unordered_map<int, const Overlap*>> groups_;
+    OverlapIndex groups_;
+    std::vector<uint8_t> ol_reasons_;                                                   //!< OlReason of the overlaps in one byte, by overlap index
+    std::vector<std::array<int, 2>> local_thresholds_;                                  //!< identity and overhang thresholds of FilterLocal, by read id
 
     std::unordered_map<Seq::Id, std::array<int, 2>> coverages_;                         //!< record min and max base coverages of the reads
     std::unordered_map<Seq::Id, RdReason> filtered_reads_;                              //!< record filtered reads and reason for filtering
@@ -0,0 +1,248 @@
+#ifndef FSA_OVERLAP_INDEX_HPP
+#define FSA_OVERLAP_INDEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include "overlap.hpp"
+#include "sequence.hpp"
+#include "utility.hpp"
+
+// Overlaps grouped by read in compressed sparse row form. The links of read
+// r are links_[offsets_[r-low_], offsets_[r-low_+1]), sorted by the id of
+// the other read, and each holds the index of the overlap in the store. At
+// most one overlap is kept per pair of reads.
+class OverlapIndex {
+public:
+    struct Link {
+        Seq::Id id;         // the other read
+        uint32_t ol;        // index of the overlap in the store
+    };
+
+    struct Neighbour {
+        Seq::Id id;
+        Overlap *ol;
+        uint32_t index;     // index of ol in the store
+    };
+
+    // the overlaps of one read
+    class Group {
+    public:
+        class const_iterator {
+        public:
+            const_iterator(const Link *l, std::vector<Overlap> *ols) : l_(l), ols_(ols) {}
+            Neighbour operator*() const { return Neighbour{ l_->id, &(*ols_)[l_->ol], l_->ol }; }
+            const_iterator& operator++() { ++l_; return *this; }
+            bool operator!=(const const_iterator &i) const { return l_ != i.l_; }
+            bool operator==(const const_iterator &i) const { return l_ == i.l_; }
+        protected:
+            const Link *l_;
+            std::vector<Overlap> *ols_;
+        };
+
+        Group(const Link *begin, const Link *end, std::vector<Overlap> *ols) : begin_(begin), end_(end), ols_(ols) {}
+
+        const_iterator begin() const { return const_iterator(begin_, ols_); }
+        const_iterator end() const { return const_iterator(end_, ols_); }
+        size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_ == end_; }
+
+        // the overlap with read id, nullptr if there is none
+        Overlap* Find(Seq::Id id) const {
+            auto it = std::lower_bound(begin_, end_, id, [](const Link &l, Seq::Id i) { return l.id < i; });
+            return it != end_ && it->id == id ? &(*ols_)[it->ol] : nullptr;
+        }
+
+    protected:
+        const Link *begin_;
+        const Link *end_;
+        std::vector<Overlap> *ols_;
+    };
+
+    // Indexes the overlaps passing keep under both reads, or under the
+    // target read b_ only. Of the overlaps of a pair of reads, taken in
+    // store order, a later one replaces the current one if replace(later,
+    // current) holds. The indexes of the overlaps replaced or not taken
+    // are appended to dropped if it is given.
+    template<typename K, typename R>
+    void Build(std::vector<Overlap> &ols, K keep, R replace, size_t thread_size=1, bool target_only=false,
+               std::vector<uint32_t> *dropped=nullptr);
+
+    Group Get(Seq::Id id) const {
+        if (id < low_ || id >= high_) return Group(nullptr, nullptr, ols_);
+        return Group(links_.data() + offsets_[id-low_], links_.data() + offsets_[id-low_+1], ols_);
+    }
+    Group operator[](Seq::Id id) const { return Get(id); }
+
+    // the overlap of reads a and b, nullptr if there is none
+    Overlap* Find(Seq::Id a, Seq::Id b) const { return Get(a).Find(b); }
+
+    // [low, high) covers the reads having overlaps
+    std::array<Seq::Id, 2> GetIdRange() const { return std::array<Seq::Id, 2>{{ low_, high_ }}; }
+
+    // reads having overlaps
+    std::vector<Seq::Id> Reads() const;
+    size_t ReadSize() const;
+    size_t LinkSize() const { return links_.size(); }
+
+    // thread_size read ranges holding about as many links each
+    std::vector<std::array<Seq::Id, 2>> SplitReads(size_t thread_size) const;
+
+protected:
+    std::vector<Overlap> *ols_ { nullptr };
+    Seq::Id low_ { 0 };
+    Seq::Id high_ { 0 };
+    std::vector<size_t> offsets_;
+    std::vector<Link> links_;
+};
+
+inline std::vector<Seq::Id> OverlapIndex::Reads() const {
+    std::vector<Seq::Id> reads;
+    for (Seq::Id i = low_; i < high_; ++i) {
+        if (offsets_[i-low_] < offsets_[i-low_+1]) reads.push_back(i);
+    }
+    return reads;
+}
+
+inline size_t OverlapIndex::ReadSize() const {
+    size_t n = 0;
+    for (Seq::Id i = low_; i < high_; ++i) {
+        if (offsets_[i-low_] < offsets_[i-low_+1]) ++n;
+    }
+    return n;
+}
+
+inline std::vector<std::array<Seq::Id, 2>> OverlapIndex::SplitReads(size_t thread_size) const {
+    assert(thread_size >= 1);
+    std::vector<std::array<Seq::Id, 2>> ranges(thread_size);
+    Seq::Id r = low_;
+    for (size_t t = 0; t < thread_size; ++t) {
+        ranges[t][0] = r;
+        if (t + 1 == thread_size) {
+            r = high_;
+        } else {
+            const size_t goal = links_.size() * (t + 1) / thread_size;
+            while (r < high_ && offsets_[r-low_+1] <= goal) ++r;
+        }
+        ranges[t][1] = r;
+    }
+    return ranges;
+}
+
+// Counting sort: the links are counted and put in place by the threads with
+// atomic cursors, which leaves each group in some order, so every group is
+// then sorted by (read, overlap) before the duplicates are removed. The
+// result does not depend on thread_size.
+template<typename K, typename R>
+void OverlapIndex::Build(std::vector<Overlap> &ols, K keep, R replace, size_t thread_size, bool target_only,
+                         std::vector<uint32_t> *dropped) {
+    assert(ols.size() < UINT32_MAX);
+    ols_ = &ols;
+    thread_size = std::max<size_t>(1, std::min(thread_size, ols.size()));
+    auto ol_ranges = SplitRange(thread_size, (size_t)0, ols.size());
+
+    std::vector<char> kept(ols.size());
+    std::vector<std::array<Seq::Id, 2>> id_ranges(thread_size, std::array<Seq::Id, 2>{{ INT32_MAX, INT32_MIN }});
+    MultiThreadRun(thread_size, [&](size_t t) {
+        for (size_t i = ol_ranges[t][0]; i < ol_ranges[t][1]; ++i) {
+            const Overlap &o = ols[i];
+            kept[i] = keep(o);
+            if (!kept[i]) continue;
+            id_ranges[t][0] = std::min(id_ranges[t][0], target_only ? o.b_.id : std::min(o.a_.id, o.b_.id));
+            id_ranges[t][1] = std::max(id_ranges[t][1], target_only ? o.b_.id : std::max(o.a_.id, o.b_.id));
+        }
+    });
+    low_ = INT32_MAX;
+    high_ = INT32_MIN;
+    for (auto &r : id_ranges) {
+        low_ = std::min(low_, r[0]);
+        high_ = std::max(high_, r[1]);
+    }
+    if (low_ > high_) {
+        low_ = high_ = 0;
+        offsets_.assign(1, 0);
+        links_.clear();
+        return;
+    }
+    ++high_;
+
+    const size_t read_size = high_ - low_;
+    std::vector<std::atomic<size_t>> cursors(read_size + 1);
+    for (auto &c : cursors) c.store(0, std::memory_order_relaxed);
+    MultiThreadRun(thread_size, [&](size_t t) {
+        for (size_t i = ol_ranges[t][0]; i < ol_ranges[t][1]; ++i) {
+            if (!kept[i]) continue;
+            const Overlap &o = ols[i];
+            cursors[o.b_.id-low_+1].fetch_add(1, std::memory_order_relaxed);
+            if (!target_only && o.a_.id != o.b_.id) cursors[o.a_.id-low_+1].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    offsets_.assign(read_size + 1, 0);
+    for (size_t i = 1; i <= read_size; ++i) {
+        offsets_[i] = offsets_[i-1] + cursors[i].load(std::memory_order_relaxed);
+        cursors[i-1].store(offsets_[i-1], std::memory_order_relaxed);
+    }
+    links_.resize(offsets_[read_size]);
+    MultiThreadRun(thread_size, [&](size_t t) {
+        for (size_t i = ol_ranges[t][0]; i < ol_ranges[t][1]; ++i) {
+            if (!kept[i]) continue;
+            const Overlap &o = ols[i];
+            links_[cursors[o.b_.id-low_].fetch_add(1, std::memory_order_relaxed)] = Link{ o.a_.id, (uint32_t)i };
+            if (!target_only && o.a_.id != o.b_.id) {
+                links_[cursors[o.a_.id-low_].fetch_add(1, std::memory_order_relaxed)] = Link{ o.b_.id, (uint32_t)i };
+            }
+        }
+    });
+
+    // sort the groups and keep one overlap per pair in place
+    std::vector<size_t> sizes(read_size);
+    std::vector<std::vector<uint32_t>> drops(thread_size);
+    auto read_ranges = SplitReads(thread_size);
+    MultiThreadRun(thread_size, [&](size_t t) {
+        for (Seq::Id r = read_ranges[t][0]; r < read_ranges[t][1]; ++r) {
+            Link *b = links_.data() + offsets_[r-low_];
+            Link *e = links_.data() + offsets_[r-low_+1];
+            std::sort(b, e, [](const Link &x, const Link &y) { return x.id < y.id || (x.id == y.id && x.ol < y.ol); });
+            Link *out = b;
+            for (Link *l = b; l < e; ++l) {
+                if (out > b && (out-1)->id == l->id) {
+                    // the same decision is made in the group of the other
+                    // read, which reports it if it comes first
+                    const bool report = target_only || r < l->id;
+                    if (replace(ols[l->ol], ols[(out-1)->ol])) {
+                        if (report) drops[t].push_back((out-1)->ol);
+                        *(out-1) = *l;
+                    } else {
+                        if (report) drops[t].push_back(l->ol);
+                    }
+                } else {
+                    *out++ = *l;
+                }
+            }
+            sizes[r-low_] = out - b;
+        }
+    });
+
+    size_t n = 0;
+    for (size_t i = 0; i < read_size; ++i) {
+        const size_t from = offsets_[i];
+        offsets_[i] = n;
+        if (n != from) std::copy(links_.begin() + from, links_.begin() + from + sizes[i], links_.begin() + n);
+        n += sizes[i];
+    }
+    offsets_[read_size] = n;
+    links_.resize(n);
+    links_.shrink_to_fit();
+
+    if (dropped != nullptr) {
+        for (auto &d : drops) dropped->insert(dropped->end(), d.begin(), d.end());
+    }
+}
+
+#endif // FSA_OVERLAP_INDEX_HPP
@@ -6,8 +6,11 @@
 #include <cstring>
 #include <cstdio>
 #include <cassert>
+#include <climits>
+#include <cstdlib>
 
 #include "read_store.hpp"
+#include "seqdb_reader.hpp"
 #include "logger.hpp"
 
 
@@ -40,34 +43,38 @@ std::string OverlapStore::DetectFileType(const std::string &fname) {
         return "paf";
     } else if (fname.size() >= 4 && fname.substr(fname.size()-4) == ".ovl") {
         return "ovl";
+    } else if (fname.size() >= 4 && fname.substr(fname.size()-4) == ".m4x") {
+        return "m4x";
+    } else if (fname.size() >= 4 && fname.substr(fname.size()-4) == ".ovb") {
+        return "ovb";
     } else {
         auto i = fname.find_last_of('.');
         return fname.substr(i == fname.npos ? 0 : i+1);
     }
 }
 
-bool OverlapStore::FromM4Line(const std::string &line, Overlap& o) {
+bool OverlapStore::FromM4Line(const char *begin, const char *end, Overlap& o, StringRef *names) {
 
-    std::vector<std::string> items = SplitStringBySpace(line);
+    StringRef items[12];
 
-    if (items.size() >= 12) {
+    if (SplitBySpace(begin, end, items, 12) >= 12) {
 
         // M4文件的Id就是read在fasta文件的序号。
-        o.a_.id = atoi(items[0].c_str()) - 1;
-        o.b_.id = atoi(items[1].c_str()) - 1;
+        o.a_.id = ParseInt(items[0]) - 1;
+        o.b_.id = ParseInt(items[1]) - 1;
 
-        o.identity_ = atof(items[2].c_str());
-        o.score_ = atoi(items[3].c_str());
+        o.identity_ = ParseDouble(items[2]);
+        o.score_ = ParseInt(items[3]);
 
-        o.a_.strand = atoi(items[4].c_str());
-        o.a_.start = atoi(items[5].c_str());
-        o.a_.end = atoi(items[6].c_str());
-        o.a_.len = atoi(items[7].c_str());
+        o.a_.strand = ParseInt(items[4]);
+        o.a_.start = ParseInt(items[5]);
+        o.a_.end = ParseInt(items[6]);
+        o.a_.len = ParseInt(items[7]);
 
-        o.b_.strand = atoi(items[8].c_str());
-        o.b_.start = atoi(items[9].c_str());
-        o.b_.end = atoi(items[10].c_str());
-        o.b_.len = atoi(items[11].c_str());
+        o.b_.strand = ParseInt(items[8]);
+        o.b_.start = ParseInt(items[9]);
+        o.b_.end = ParseInt(items[10]);
+        o.b_.len = ParseInt(items[11]);
 
         // 调整strand，保证a.strand = 0, 先设置b，再设置a
         o.b_.strand = o.a_.strand == o.b_.strand ? 0 : 1;
@@ -83,27 +90,32 @@ bool OverlapStore::FromM4Line(const std::string &line, Overlap& o) {
 }
 
 
-bool OverlapStore::FromM4aLine(const std::string &line, Overlap& o) {
+bool OverlapStore::FromM4aLine(const char *begin, const char *end, Overlap& o, StringRef *names) {
 
-    std::vector<std::string> items = SplitStringBySpace(line);
+    StringRef items[12];
 
-    if (items.size() >= 12) {
+    if (SplitBySpace(begin, end, items, 12) >= 12) {
 
-        o.a_.id = read_store_.NameToId(items[0]);
-        o.b_.id = read_store_.NameToId(items[1]);
+        if (names != nullptr) {
+            names[0] = items[0];
+            names[1] = items[1];
+        } else {
+            o.a_.id = read_store_.NameToId(items[0].ToString());
+            o.b_.id = read_store_.NameToId(items[1].ToString());
+        }
 
-        o.identity_ = atof(items[2].c_str());
-        o.score_ = atoi(items[3].c_str());
+        o.identity_ = ParseDouble(items[2]);
+        o.score_ = ParseInt(items[3]);
 
-        o.a_.strand = atoi(items[4].c_str());
-        o.a_.start = atoi(items[5].c_str());
-        o.a_.end = atoi(items[6].c_str());
-        o.a_.len = atoi(items[7].c_str());
+        o.a_.strand = ParseInt(items[4]);
+        o.a_.start = ParseInt(items[5]);
+        o.a_.end = ParseInt(items[6]);
+        o.a_.len = ParseInt(items[7]);
 
-        o.b_.strand = atoi(items[8].c_str());
-        o.b_.start = atoi(items[9].c_str());
-        o.b_.end = atoi(items[10].c_str());
-        o.b_.len = atoi(items[11].c_str());
+        o.b_.strand = ParseInt(items[8]);
+        o.b_.start = ParseInt(items[9]);
+        o.b_.end = ParseInt(items[10]);
+        o.b_.len = ParseInt(items[11]);
 
         o.score_ = -((o.a_.end - o.a_.start) + (o.b_.end - o.b_.start)) / 2;
 
@@ -114,28 +126,28 @@ bool OverlapStore::FromM4aLine(const std::string &line, Overlap& o) {
     }
 }
 
-bool OverlapStore::FromOvlLine(const std::string &line, Overlap& o) {
-    std::vector<std::string> items = SplitStringBySpace(line);
+bool OverlapStore::FromOvlLine(const char *begin, const char *end, Overlap& o, StringRef *names) {
+    StringRef items[13];
 
-    if (items.size() >= 13) {
+    if (SplitBySpace(begin, end, items, 13) >= 13) {
 
-        o.a_.id = atoi(items[0].c_str());
-        o.b_.id = atoi(items[1].c_str());
+        o.a_.id = ParseInt(items[0]);
+        o.b_.id = ParseInt(items[1]);
         //o.a_.id = read_store_.NameToId(items[0]);
         //o.b_.id = read_store_.NameToId(items[1]);
 
-        o.score_ = atoi(items[2].c_str());
-        o.identity_ = atof(items[3].c_str());
+        o.score_ = ParseInt(items[2]);
+        o.identity_ = ParseDouble(items[3]);
 
-        o.a_.strand = atoi(items[4].c_str());
-        o.a_.start = atoi(items[5].c_str());
-        o.a_.end = atoi(items[6].c_str());
-        o.a_.len = atoi(items[7].c_str());
+        o.a_.strand = ParseInt(items[4]);
+        o.a_.start = ParseInt(items[5]);
+        o.a_.end = ParseInt(items[6]);
+        o.a_.len = ParseInt(items[7]);
 
-        o.b_.strand = atoi(items[8].c_str());
-        o.b_.start = atoi(items[9].c_str());
-        o.b_.end = atoi(items[10].c_str());
-        o.b_.len = atoi(items[11].c_str());
+        o.b_.strand = ParseInt(items[8]);
+        o.b_.start = ParseInt(items[9]);
+        o.b_.end = ParseInt(items[10]);
+        o.b_.len = ParseInt(items[11]);
 
         return true;
     } else {
@@ -144,36 +156,41 @@ bool OverlapStore::FromOvlLine(const std::string &line, Overlap& o) {
 }
 
 
-bool OverlapStore::FromPafLine(const std::string &line, Overlap& o) {
-    std::vector<std::string> items = SplitStringBySpace(line);
+bool OverlapStore::FromPafLine(const char *begin, const char *end, Overlap& o, StringRef *names) {
+    StringRef items[12];
 
-    if (items.size() >= 12) {
+    if (SplitBySpace(begin, end, items, 12) >= 12) {
         // query_name, query_length, query_start, query_end, 
         // relative_strand, 
         // target_name, target_lenght, target_start, target_end, 
         // number_residue_matches, alignment_block_length, mapping_quality
 
+        if (names != nullptr) {
+            names[0] = items[0];
+            names[1] = items[5];
+        } else {
+            o.a_.id = read_store_.NameToId(items[0].ToString());
+            o.b_.id = read_store_.NameToId(items[5].ToString());
+        }
 
         // query_name, query_length, query_start, query_end, 
-        o.a_.id = read_store_.NameToId(items[0]);
-        o.a_.len = atoi(items[1].c_str());
-        o.a_.start = atoi(items[2].c_str());
-        o.a_.end = atoi(items[3].c_str());
+        o.a_.len = ParseInt(items[1]);
+        o.a_.start = ParseInt(items[2]);
+        o.a_.end = ParseInt(items[3]);
         
         // relative_strand, 
         o.a_.strand = items[4] == "+" ? 0 : 1;
         o.b_.strand = 0;
         
         // target_name, target_lenght, target_start, target_end, 
-        o.b_.id = read_store_.NameToId(items[5]);
-        o.b_.len = atoi(items[6].c_str());
-        o.b_.start = atoi(items[7].c_str());
-        o.b_.end = atoi(items[8].c_str());
+        o.b_.len = ParseInt(items[6]);
+        o.b_.start = ParseInt(items[7]);
+        o.b_.end = ParseInt(items[8]);
 
         // number_residue_matches, alignment_block_length, mapping_quality
         
-        o.identity_ = atof(items[9].c_str())*100 / atoi(items[10].c_str());
-        o.score_ = -atoi(items[10].c_str());
+        o.identity_ = ParseDouble(items[9])*100 / ParseInt(items[10]);
+        o.score_ = -ParseInt(items[10]);
         // items[11]
 
         return true;
@@ -182,107 +199,143 @@ bool OverlapStore::FromPafLine(const std::string &line, Overlap& o) {
     }
 }
 
- std::array<Seq::Id, 2> OverlapStore::GetReadIdRange() const { 
-    auto range = read_store_.GetIdRange(); 
-    if (range[1] == 0) {
-        auto cmp_range = [&range](Seq::Id i) {
-            if (i < range[0]) range[0] = i;
-            else if (i >= range[1]) range[1] = i+1;
-        };
-        for (auto &o : overlaps_) {
-            cmp_range(o.a_.id);
-            cmp_range(o.b_.id);
-            
+void OverlapStore::LoadM4xReads() {
+    m4x_reads_.clear();
+    if (m4x_seqdb_.empty()) {
+        LOG(WARNING)("No database is given for the m4x file, its ordinals are taken as read ids, which is right only if mecat2map dropped no reads");
+        return;
+    }
+
+    std::string dir, title;
+    if (!SeqdbReader::IsSeqdb(m4x_seqdb_, &dir, &title)) {
+        LOG(FATAL)("Not a sequence database: %s", m4x_seqdb_.c_str());
+    }
+    SeqdbReader db(dir, title);
+    if (!db.IsValid()) {
+        LOG(FATAL)("Failed to load sequence database: %s", m4x_seqdb_.c_str());
+    }
+
+    m4x_reads_.resize(db.Size());
+    for (size_t i = 0; i < db.Size(); ++i) {
+        // the ids of M4 files, see FromM4Line
+        const char *name = db.Name(i);
+        char *end = nullptr;
+        long n = strtol(name, &end, 10);
+        if (end == name || n <= 0 || n > INT_MAX) {
+            LOG(FATAL)("Read names of the m4x database must be numbers as in M4 files: %s", name);
         }
+        m4x_reads_[i] = std::array<int, 2>{{ (int)n - 1, (int)db.SeqLength(i) }};
     }
+    LOG(INFO)("Load %zd read ids of the m4x file from %s", m4x_reads_.size(), db.Path().c_str());
+}
 
-    return range;
+bool OverlapStore::FromM4xRecord(const M4xRecord &r, Overlap& o) {
+    // the same as FromM4Line, but the ids are ordinals in the database
+    if (!m4x_reads_.empty()) {
+        if ((size_t)r.qid >= m4x_reads_.size() || (size_t)r.sid >= m4x_reads_.size() ||
+            m4x_reads_[r.qid][1] != r.qsize || m4x_reads_[r.sid][1] != r.ssize) {
+            LOG(ERROR)("m4x record of reads %d and %d does not match database %s", r.qid, r.sid, m4x_seqdb_.c_str());
+            return false;
+        }
+        o.a_.id = m4x_reads_[r.qid][0];
+        o.b_.id = m4x_reads_[r.sid][0];
+    } else {
+        o.a_.id = r.qid;
+        o.b_.id = r.sid;
+    }
+
+    o.identity_ = r.ident_perc;
+
+    o.a_.start = r.qoff;
+    o.a_.end = r.qend;
+    o.a_.len = r.qsize;
+
+    o.b_.start = r.soff;
+    o.b_.end = r.send;
+    o.b_.len = r.ssize;
+
+    o.b_.strand = r.qdir == r.sdir ? 0 : 1;
+    o.a_.strand = 0;
+
+    o.score_ = -((o.a_.end - o.a_.start) + (o.b_.end - o.b_.start)) / 2;
+
+    return true;
 }
 
-std::unordered_map<int, std::unordered_map<int, Overlap*>> OverlapStore::Group() {
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> groups;
-
-    for (auto &o : overlaps_) {
-
-        auto add_overlap = [&](int a, int b, Overlap& o) {
-            auto iter = groups.find(a);
-            if (iter != groups.end()) {
-                assert(iter->second.find(b) == iter->second.end()); // 已经删除了重复的overlap
-                iter->second[b] = &o;
-            }
-            else {
-                auto iter = groups.insert(std::make_pair(a, std::unordered_map<int, Overlap*>()));
-                iter.first->second[b] = &o;
-            }
-        };
+bool OverlapStore::FromOvbRecord(const OvbRecord &r, Overlap& o) {
+    o.a_.id = r.a_id;
+    o.a_.strand = r.a_strand;
+    o.a_.start = r.a_start;
+    o.a_.end = r.a_end;
+    o.a_.len = r.a_len;
 
-        add_overlap(o.a_.id, o.b_.id, o);
-        add_overlap(o.b_.id, o.a_.id, o);
-        
-    }
+    o.b_.id = r.b_id;
+    o.b_.strand = r.b_strand;
+    o.b_.start = r.b_start;
+    o.b_.end = r.b_end;
+    o.b_.len = r.b_len;
 
-    return groups;
+    o.score_ = r.score;
+    o.identity_ = r.identity;
+
+    return true;
 }
 
-std::unordered_map<int, std::unordered_map<int, const Overlap*>> OverlapStore::Group(bool(*better)(const Overlap& a, const Overlap &b)) const {
-    std::unordered_map<int, std::unordered_map<int, const Overlap*>> groups;
-
-    for (auto &o : overlaps_) {
-
-        auto add_overlap = [&](int a, int b, const Overlap& o) {
-            auto iter = groups.find(a);
-            if (iter != groups.end()) {
-                auto itit = iter->second.find(b);
-                if (itit == iter->second.end()) {
-                    iter->second.insert(std::make_pair(b, &o));
-                } else {
-                    if (better(o, *itit->second)) {
-                        itit->second = &o;
-                    }
-                }
-            }
-            else {
-                auto iter = groups.insert(std::make_pair(a, std::unordered_map<int, const Overlap*>()));
-                iter.first->second[b] = &o;
-            }
-        };
+OvbRecord OverlapStore::ToOvbRecord(const Overlap &o) {
+    OvbRecord r;
+    memset(&r, 0, sizeof(r));
 
-        add_overlap(o.a_.id, o.b_.id, o);
-        add_overlap(o.b_.id, o.a_.id, o);
-        
+    r.a_id = o.a_.id;
+    r.a_strand = o.a_.strand;
+    r.a_start = o.a_.start;
+    r.a_end = o.a_.end;
+    r.a_len = o.a_.len;
+
+    r.b_id = o.b_.id;
+    r.b_strand = o.b_.strand;
+    r.b_start = o.b_.start;
+    r.b_end = o.b_.end;
+    r.b_len = o.b_.len;
+
+    r.score = o.score_;
+    r.identity = (float)o.identity_;
+
+    return r;
+}
+
+OvbHeader OverlapStore::ReadOvbHeader(const std::string &fname) {
+    OvbHeader header;
+    std::ifstream in(fname, std::ifstream::binary);
+    if (!in.is_open()) {
+        LOG(FATAL)("Failed to load file: %s", fname.c_str());
+    }
+    if (!in.read((char*)&header, sizeof(header)) || !header.IsValid()) {
+        LOG(FATAL)("Not a binary overlap file of version %u: %s", OvbHeader::kVersion, fname.c_str());
     }
 
-    return groups;
+    in.seekg(0, std::ifstream::end);
+    size_t file_size = in.tellg();
+    if (file_size != sizeof(header) + header.num_records * header.record_size) {
+        LOG(FATAL)("Binary overlap file is truncated, %zd records expected: %s", (size_t)header.num_records, fname.c_str());
+    }
+    return header;
 }
 
-std::unordered_map<int, std::unordered_map<int, Overlap*>> OverlapStore::GroupTarget(bool(*better)(const Overlap* a, const Overlap *b)) {
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> groups;
-
-    for (auto &o : overlaps_) {
-        auto add_overlap = [&](int a, int b, Overlap& o) {
-            auto iter = groups.find(a);
-            if (iter != groups.end()) {
-                auto biter = iter->second.find(b);
-                if (biter == iter->second.end()) {
-                    iter->second[b] = &o;
-                }
-                else {
-                    if (!better(biter->second, &o)) {
-                        iter->second[b] = &o;
-                    }
-                }
-            }
-            else {
-                auto iter = groups.insert(std::make_pair(a, std::unordered_map<int, Overlap*>()));
-                iter.first->second[b] = &o;
-            }
+ std::array<Seq::Id, 2> OverlapStore::GetReadIdRange() const { 
+    auto range = read_store_.GetIdRange(); 
+    if (range[1] == 0) {
+        auto cmp_range = [&range](Seq::Id i) {
+            if (i < range[0]) range[0] = i;
+            else if (i >= range[1]) range[1] = i+1;
         };
-
-        add_overlap(o.b_.id, o.a_.id, o);
-    
+        for (auto &o : overlaps_) {
+            cmp_range(o.a_.id);
+            cmp_range(o.b_.id);
+            
+        }
     }
 
-    return groups;
+    return range;
 }
 
 std::string OverlapStore::ToM4aLine(const Overlap& o) const{
@@ -3,15 +3,19 @@
 
 
 #include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <list>
-#include <deque>
 #include <unordered_map>
 #include <string>
 #include <fstream>
 #include <sstream>
 
 #include "overlap.hpp"
+#include "overlap_binary.hpp"
 #include "logger.hpp"
 #include "read_store.hpp"
 #include "sequence.hpp"
@@ -33,26 +37,40 @@ public:
 
     template<typename C=bool (*)(Overlap &o)>
     void LoadM4aFile(const std::string &fname, size_t thread_size=1, C check= [](Overlap &o) {return true; }) {
-        if (thread_size > 1) LoadFileMt(fname, &OverlapStore::FromM4aLine, check, thread_size);
-        else                 LoadFile(fname, &OverlapStore::FromM4aLine, check);
+        LoadTextFile(fname, &OverlapStore::FromM4aLine, check, thread_size, true);
     }
 
     template<typename C = bool(*)(Overlap &o)>
     void LoadM4File(const std::string &fname, size_t thread_size=1,  C check = [](Overlap &o) {return true; }) {
-        if (thread_size > 1) LoadFileMt(fname, &OverlapStore::FromM4Line, check, thread_size);
-        else                 LoadFile(fname, &OverlapStore::FromM4Line, check);
+        LoadTextFile(fname, &OverlapStore::FromM4Line, check, thread_size, false);
     }
     
     template<typename C = bool(*)(Overlap &o)>
     void LoadOvlFile(const std::string &fname, size_t thread_size=1, C check = [](Overlap &o) {return true; }) {        
-        if (thread_size > 1) LoadFileMt(fname, &OverlapStore::FromOvlLine, check, thread_size);
-        else                 LoadFile(fname, &OverlapStore::FromOvlLine, check);
+        LoadTextFile(fname, &OverlapStore::FromOvlLine, check, thread_size, false);
     }
     
     template<typename C = bool(*)(Overlap &o)>
     void LoadPafFile(const std::string &fname, size_t thread_size=1, C check = [](Overlap &o) {return true; }) {
-        if (thread_size > 1) LoadFileMt(fname, &OverlapStore::FromPafLine, check, thread_size);
-        else                 LoadFile(fname, &OverlapStore::FromPafLine, check);
+        LoadTextFile(fname, &OverlapStore::FromPafLine, check, thread_size, true);
+    }
+    
+    template<typename C = bool(*)(Overlap &o)>
+    void LoadM4xFile(const std::string &fname, size_t thread_size=1, C check = [](Overlap &o) {return true; }) {
+        LoadM4xReads();
+        LoadBinaryFile<M4xRecord>(fname, 0, &OverlapStore::FromM4xRecord, check, thread_size);
+    }
+
+    // The read ids of m4x records are ordinals in the database of mecat2map,
+    // which are the M4 ids (read name - 1) only if it dropped no reads, as
+    // with -min_query_size. Given the database, the ids are taken from the
+    // read names there and the read lengths of the records are checked.
+    void SetM4xSeqdb(const std::string &path) { m4x_seqdb_ = path; }
+
+    template<typename C = bool(*)(Overlap &o)>
+    void LoadOvbFile(const std::string &fname, size_t thread_size=1, C check = [](Overlap &o) {return true; }) {
+        ReadOvbHeader(fname);
+        LoadBinaryFile<OvbRecord>(fname, sizeof(OvbHeader), &OverlapStore::FromOvbRecord, check, thread_size);
     }
     
     template<typename C = bool(*)(const Overlap &o)>
@@ -73,6 +91,12 @@ public:
         SaveFile(fname, &OverlapStore::ToPafLine, check);
     }
 
+    template<typename C =bool (*)(const Overlap &o)>
+    void SaveOvbFile(const std::string &fname, C check=[](const Overlap &o){return true;}) const {
+        std::remove(fname.c_str());
+        AppendOvbFile(fname, overlaps_, check);
+    }
+
 
     template<typename S, typename C>
     void AppendM4File(const std::string &fname, const S& s, C check) {
@@ -90,12 +114,23 @@ public:
         AppendFile(fname, s, &OverlapStore::ToPafLine, check);
     }
 
+    template<typename S, typename C>
+    void AppendOvbFile(const std::string &fname, const S& s, C check) const;
+
 
 
     size_t Size() const { return overlaps_.size(); }
     Overlap& Get(size_t i) { return  overlaps_[i]; }
-    const std::deque<Overlap>& Get() const { return overlaps_; }
-    std::deque<Overlap>& Get() { return overlaps_; }
+    const Overlap& Get(size_t i) const { return  overlaps_[i]; }
+    const std::vector<Overlap>& Get() const { return overlaps_; }
+    std::vector<Overlap>& Get() { return overlaps_; }
+
+    // Overlaps are kept contiguous and addressed by 32-bit indexes, so that
+    // per-overlap state can live in side arrays instead of in Overlap.
+    uint32_t IndexOf(const Overlap &o) const { 
+        assert(&o >= overlaps_.data() && &o < overlaps_.data() + overlaps_.size());
+        return (uint32_t)(&o - overlaps_.data()); 
+    }
 
     std::string GetReadName(int id) {
         return read_store_.IdToName(id);
@@ -108,17 +143,11 @@ public:
     std::array<Seq::Id, 2> GetReadIdRange() const;
     const ReadStore& GetReadStore() const { return read_store_; }
 
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> Group() const;
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> Group();
-    std::unordered_map<int, std::unordered_map<int, const Overlap*>> Group(bool (*better)(const Overlap&, const Overlap&)) const;
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> GroupTarget(bool (*better)(const Overlap* a, const Overlap *b));
-    std::unordered_map<int, std::unordered_map<int, Overlap*>> GroupQuery();
-
     template<typename F, typename C>
-    void LoadFile(const std::string &fname, F lineToOl, C check);
+    void LoadTextFile(const std::string &fname, F lineToOl, C check, size_t thread_size=1, bool has_names=false);
 
-    template<typename F, typename C>
-    void LoadFileMt(const std::string &fname, F lineToOl, C check, size_t thread_size=1);
+    template<typename R, typename F, typename C>
+    void LoadBinaryFile(const std::string &fname, size_t offset, F recordToOl, C check, size_t thread_size=1);
 
     template<typename L, typename C>
     void SaveFile(const std::string &fname, L toLine, C check) const;
@@ -126,17 +155,52 @@ public:
     template<typename S, typename L, typename C>
     void AppendFile(const std::string &fname, const S& s, L toLine, C check);
 
-    bool FromM4Line(const std::string &line, Overlap &o);
-    bool FromM4aLine(const std::string &line, Overlap &o);
-    bool FromOvlLine(const std::string &line, Overlap &o);
-    bool FromPafLine(const std::string &line, Overlap &o);
+    // A line is [begin, end). Given names, formats naming the reads store
+    // the two name fields there and leave the read ids unset.
+    bool FromM4Line(const char *begin, const char *end, Overlap &o, StringRef *names=nullptr);
+    bool FromM4aLine(const char *begin, const char *end, Overlap &o, StringRef *names=nullptr);
+    bool FromOvlLine(const char *begin, const char *end, Overlap &o, StringRef *names=nullptr);
+    bool FromPafLine(const char *begin, const char *end, Overlap &o, StringRef *names=nullptr);
+    bool FromM4xRecord(const M4xRecord &r, Overlap &o);
+    void LoadM4xReads();
+    bool FromOvbRecord(const OvbRecord &r, Overlap &o);
+    static OvbHeader ReadOvbHeader(const std::string &fname);
+    static OvbRecord ToOvbRecord(const Overlap &o);
     
     std::string ToM4aLine(const Overlap& o) const;
     std::string ToM4Line(const Overlap& o) const;
     std::string ToPafLine(const Overlap &o) const;
 
 protected:
-    std::deque<Overlap> overlaps_;
+    // grows the storage to exactly count overlaps, not by doubling
+    void Reserve(size_t count) {
+        if (count >= UINT32_MAX) {
+            LOG(FATAL)("Too many overlaps to index with 32 bits: %zd", count);
+        }
+        overlaps_.reserve(count);
+    }
+
+    // Moves the kepts[i] overlaps parsed from slots[i] down to follow each
+    // other, and gives the slots of the rejected ones back if there are many.
+    void Compact(const std::vector<size_t> &slots, const std::vector<size_t> &kepts) {
+        size_t count = slots[0];
+        for (size_t i = 0; i < kepts.size(); ++i) {
+            if (count != slots[i]) {
+                std::copy(overlaps_.begin() + slots[i], overlaps_.begin() + slots[i] + kepts[i], overlaps_.begin() + count);
+            }
+            count += kepts[i];
+        }
+        overlaps_.resize(count);
+        if (overlaps_.size() < overlaps_.capacity() / 4 * 3) {
+            overlaps_.shrink_to_fit();
+        }
+    }
+
+protected:
+    std::vector<Overlap> overlaps_;
+
+    std::string m4x_seqdb_;
+    std::vector<std::array<int, 2>> m4x_reads_;     // id and length of the reads of m4x_seqdb_, by ordinal
 
     ReadStore &read_store_;
     ReadStore empty_read_store_;
@@ -153,6 +217,8 @@ void OverlapStore::Append(const std::string &fname, const std::string &type, con
         AppendM4aFile(fname, s, check);
     } else if (t == "paf") {
         AppendPafFile(fname, s, check);
+    } else if (t == "ovb") {
+        AppendOvbFile(fname, s, check);
     } else if (t == "ovl") {
         //SaveOvlFile(fname, check);
         LOG(FATAL)("TODO");
@@ -162,85 +228,159 @@ void OverlapStore::Append(const std::string &fname, const std::string &type, con
 }
 
 
+// The file is mapped and cut into thread_size ranges of whole lines, which
+// are parsed in place and appended in file order. Read names are turned into
+// ids afterwards, in file order, so the ids do not depend on thread_size;
+// the check then has to wait for the ids too.
 template<typename F, typename C>
-void OverlapStore::LoadFile(const std::string &fname, F lineToOl, C check) {
-    std::string line;
-    std::ifstream in(fname);
-    if (in.is_open()) {
-        while (std::getline(in, line)) {
-            Overlap o;
-            if ((this->*lineToOl)(line, o)) {
-                if (check(o)) {
-                    overlaps_.push_back(o);
-                }
-            }
-            else {
-                LOG(FATAL)("Failed to convert line to overlap \n   %s", line.c_str());
+void OverlapStore::LoadTextFile(const std::string &fname, F lineToOl, C check, size_t thread_size, bool has_names) {
+    MmapFile file(fname);
+    if (!file.IsValid()) {
+        LOG(FATAL)("Failed to load file: %s", fname.c_str());
+    }
 
-            }
+    const char *data = file.Data();
+    const size_t size = file.Size();
+    if (size == 0) return;
+    thread_size = std::max<size_t>(1, std::min(thread_size, size));
+    auto ranges = SplitRange(thread_size, (size_t)0, size);
+    for (size_t i = 1; i < thread_size; ++i) {
+        // a range starts right after a newline
+        size_t b = std::max(ranges[i][0], ranges[i-1][0]);
+        if (b > 0 && data[b-1] != '\n') {
+            const char *eol = (const char*)memchr(data + b, '\n', size - b);
+            b = eol != nullptr ? eol + 1 - data : size;
         }
+        ranges[i-1][1] = ranges[i][0] = b;
     }
-    else {
-        LOG(FATAL)("Failed to load file: %s", fname.c_str());
-    }
-}
 
-template<typename F, typename C>
-void OverlapStore::LoadFileMt(const std::string &fname, F lineToOl, C check, size_t thread_size) {
-    std::mutex mutex_gen;
-    std::mutex mutex_comb;
-    std::ifstream in(fname);
-    const size_t block_size = 500;
-
-    auto generate_func = [&mutex_gen, &in](std::vector<std::string> &lines) {
-        std::lock_guard<std::mutex> lock(mutex_gen);
-
-        // std::string line; TODO check whether it is faster using variable line.
-        size_t index = 0;
-        for (; index<lines.size(); ++index) {
-            if (!std::getline(in, lines[index])) break;
+    // a line holds at most one overlap, so the lines are counted first and
+    // the overlaps are parsed in place, without growing any vector
+    std::vector<size_t> slots(thread_size+1, overlaps_.size());
+    auto count_func = [&](size_t id) {
+        const char *p = data + ranges[id][0];
+        const char *end = data + ranges[id][1];
+        size_t n = 0;
+        for (; p < end; ++n) {
+            const char *eol = (const char*)memchr(p, '\n', end - p);
+            p = eol != nullptr ? eol + 1 : end;
         }
-        return index;
+        slots[id+1] = n;
     };
 
-    auto combine_func = [&mutex_comb, this](const std::vector<Overlap> &ols, size_t sz) {
-        std::lock_guard<std::mutex> lock(mutex_comb);
-        overlaps_.insert(overlaps_.end(), ols.begin(), ols.begin()+sz);
+    if (thread_size > 1) MultiThreadRun(thread_size, count_func);
+    else                 count_func(0);
+
+    for (size_t id = 0; id < thread_size; ++id) slots[id+1] += slots[id];
+    Reserve(slots[thread_size]);
+    overlaps_.resize(slots[thread_size]);
+
+    std::vector<size_t> kepts(thread_size, 0);
+    std::vector<std::vector<std::array<StringRef, 2>>> names(thread_size);
+
+    auto work_func = [&](size_t id) {
+        const char *p = data + ranges[id][0];
+        const char *end = data + ranges[id][1];
+        Overlap *ols = overlaps_.data() + slots[id];
+        size_t &kept = kepts[id];
+        if (has_names) names[id].reserve(slots[id+1] - slots[id]);
+        while (p < end) {
+            const char *eol = (const char*)memchr(p, '\n', end - p);
+            if (eol == nullptr) eol = end;
+            Overlap &o = ols[kept];
+            std::array<StringRef, 2> n;
+            if ((this->*lineToOl)(p, eol, o, has_names ? n.data() : nullptr)) {
+                if (has_names) {
+                    names[id].push_back(n);
+                    ++kept;
+                } else if (check(o)) {
+                    ++kept;
+                }
+            }
+            else {
+                LOG(FATAL)("Failed to convert line to overlap \n   %s", std::string(p, eol).c_str());
+            }
+            p = eol + 1;
+        }
     };
 
-    auto work_func = [&check, this, lineToOl, block_size, generate_func, combine_func](size_t id) {
-        std::vector<std::string> lines(block_size);
-        std::vector<Overlap> ols(block_size);
-        while (true) {
-            size_t line_size = generate_func(lines);
-            
-            if (line_size > 0) {
-                size_t ol_size = 0;
-                for (size_t i=0; i<line_size; ++i) {
-                    Overlap o;
-                    if ((this->*lineToOl)(lines[i], o)) {
-                        if (check(o)) {
-                            ols[ol_size++] = o;
-                        }
-                    }
-                    else {
-                        LOG(FATAL)("Failed to convert line to overlap \n   %s", lines[i].c_str());
-                    }
+    if (thread_size > 1) MultiThreadRun(thread_size, work_func);
+    else                 work_func(0);
+
+    // consecutive lines mostly share the first read
+    std::array<StringRef, 2> last_names;
+    std::array<Seq::Id, 2> last_ids {{ -1, -1 }};
+    for (size_t id = 0; has_names && id < thread_size; ++id) {
+        Overlap *ols = overlaps_.data() + slots[id];
+        size_t kept = 0;
+        for (size_t i = 0; i < kepts[id]; ++i) {
+            Overlap &o = ols[i];
+            std::array<Seq::Id, 2> ids;
+            for (size_t k = 0; k < 2; ++k) {
+                const StringRef &n = names[id][i][k];
+                if (last_names[k].begin == nullptr || !(n == last_names[k])) {
+                    last_names[k] = n;
+                    last_ids[k] = read_store_.NameToId(n.ToString());
                 }
-                combine_func(ols, ol_size);;
-            } else {
-                break;
+                ids[k] = last_ids[k];
             }
+            o.a_.id = ids[0];
+            o.b_.id = ids[1];
+            if (check(o)) ols[kept++] = o;
+        }
+        kepts[id] = kept;
+        std::vector<std::array<StringRef, 2>>().swap(names[id]);
+    }
 
-        }   
-    };
+    Compact(slots, kepts);
+}
 
-    if (in.is_open()) {
-        MultiThreadRun(thread_size, work_func);
-    }
-    else {
+// Records are converted in thread_size contiguous blocks, which are
+// appended in file order.
+template<typename R, typename F, typename C>
+void OverlapStore::LoadBinaryFile(const std::string &fname, size_t offset, F recordToOl, C check, size_t thread_size) {
+    MmapFile file(fname);
+    if (!file.IsValid()) {
         LOG(FATAL)("Failed to load file: %s", fname.c_str());
     }
+    if (file.Size() < offset || (file.Size() - offset) % sizeof(R) != 0) {
+        LOG(FATAL)("Size of binary overlap file is not a multiple of record size %zd: %s", sizeof(R), fname.c_str());
+    }
+
+    const R* records = reinterpret_cast<const R*>(file.Data() + offset);
+    const size_t record_size = (file.Size() - offset) / sizeof(R);
+    thread_size = std::max<size_t>(1, std::min(thread_size, record_size));
+    auto ranges = SplitRange(thread_size, (size_t)0, record_size);
+
+    // the overlaps are converted in place, range id to the slots from slots[id]
+    std::vector<size_t> slots(thread_size+1);
+    for (size_t id = 0; id <= thread_size; ++id) {
+        slots[id] = overlaps_.size() + (id < thread_size ? ranges[id][0] : record_size);
+    }
+    Reserve(slots[thread_size]);
+    overlaps_.resize(slots[thread_size]);
+    std::vector<size_t> kepts(thread_size, 0);
+
+    auto work_func = [&](size_t id) {
+        Overlap *ols = overlaps_.data() + slots[id];
+        size_t &kept = kepts[id];
+        for (size_t i = ranges[id][0]; i < ranges[id][1]; ++i) {
+            Overlap &o = ols[kept];
+            if ((this->*recordToOl)(records[i], o)) {
+                if (check(o)) {
+                    ++kept;
+                }
+            }
+            else {
+                LOG(FATAL)("Failed to convert record %zd to overlap: %s", i, fname.c_str());
+            }
+        }
+    };
+
+    if (thread_size > 1) MultiThreadRun(thread_size, work_func);
+    else                 work_func(0);
+
+    Compact(slots, kepts);
 }
 
 template<typename L, typename C>
@@ -268,6 +408,10 @@ void OverlapStore::Load(const std::string &fname, const std::string &type, size_
         LoadPafFile(fname, thread_size, check);
     } else if (t == "ovl") {
         LoadOvlFile(fname, thread_size, check);
+    } else if (t == "m4x") {
+        LoadM4xFile(fname, thread_size, check);
+    } else if (t == "ovb") {
+        LoadOvbFile(fname, thread_size, check);
     } else {
         LOG(ERROR)("Failed to recognize overlap files type: %s", t.c_str());
     }
@@ -282,6 +426,8 @@ void OverlapStore::Save(const std::string &fname, const std::string &type, C che
         SaveM4aFile(fname, check);
     } else if (t == "paf") {
         SavePafFile(fname, check);
+    } else if (t == "ovb") {
+        SaveOvbFile(fname, check);
     } else if (t == "ovl") {
         //SaveOvlFile(fname, check);
         LOG(FATAL)("TODO");
@@ -305,5 +451,43 @@ void OverlapStore::AppendFile(const std::string &fname, const S& s, L toLine, C
     }
 }
 
+template<typename S, typename C>
+void OverlapStore::AppendOvbFile(const std::string &fname, const S& s, C check) const {
+    OvbHeader header;
+    std::fstream of(fname, std::fstream::in | std::fstream::out | std::fstream::binary);
+    if (of.is_open()) {
+        header = ReadOvbHeader(fname);
+    } else {
+        of.open(fname, std::fstream::out | std::fstream::binary);
+        if (!of.is_open()) {
+            LOG(FATAL)("Failed to open file: %s", fname.c_str());
+        }
+        header.Init(0);
+        of.write((const char*)&header, sizeof(header));
+    }
+
+    of.seekp(sizeof(header) + header.num_records * sizeof(OvbRecord));
+    const size_t block_size = 4096;
+    std::vector<OvbRecord> records;
+    records.reserve(block_size);
+    for (const auto &o : s) {
+        if (check(o)) {
+            records.push_back(ToOvbRecord(o));
+            if (records.size() == block_size) {
+                of.write((const char*)records.data(), records.size() * sizeof(OvbRecord));
+                header.num_records += records.size();
+                records.clear();
+            }
+        }
+    }
+    of.write((const char*)records.data(), records.size() * sizeof(OvbRecord));
+    header.num_records += records.size();
+
+    of.seekp(0);
+    of.write((const char*)&header, sizeof(header));
+    if (!of) {
+        LOG(FATAL)("Failed to write file: %s", fname.c_str());
+    }
+}
 
 #endif // FSA_OVERLAP_STORE_HPP
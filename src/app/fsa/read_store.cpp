@@ -53,6 +53,8 @@ void ReadStore::Load(const std::string &fname, const std::string &type, int mode
         LoadFofn(fname, mode);
     } else if (t == "txt") {
         LoadTxt(fname, mode);
+    } else if (t == "seqdb") {
+        LoadSeqdb(fname);
     } else {
         LOG(ERROR)("Failed to recognize read files type: %s", t.c_str());
     }
@@ -105,6 +107,41 @@ void ReadStore::LoadFastq(const std::string &fname, int mode) {
     LOG(INFO)("Load %zd reads from fastq file: %s", ids.size(), fname.c_str());
 }
 
+// The names and lengths are read from the database files, which are mapped
+// and not parsed, and the residues are decoded when they are asked for.
+void ReadStore::LoadSeqdb(const std::string &path) {
+    std::string dir, title;
+    if (!SeqdbReader::IsSeqdb(path, &dir, &title)) {
+        LOG(FATAL)("Failed to find sequence database: %s", path.c_str());
+    }
+    SeqdbReader* db = new SeqdbReader(dir, title);
+    seqdbs_.push_back(std::unique_ptr<SeqdbReader>(db));
+    if (!db->IsValid()) {
+        LOG(FATAL)("Failed to open sequence database: %s", db->Path().c_str());
+    }
+
+    std::unordered_set<Seq::Id> ids;
+    names_.reserve(names_.size() + db->Size());
+    items_.reserve(items_.size() + db->Size());
+    for (size_t i = 0; i < db->Size(); ++i) {
+        std::string name = db->Name(i);
+        Seq::Id id;
+        auto it = names_to_ids_.find(name);
+        if (it != names_to_ids_.end()) {
+            items_[it->second] = Item(i, db);
+            id = it->second;
+        } else {
+            names_.push_back(name);
+            items_.push_back(Item(i, db));
+            id = (Seq::Id)names_.size() - 1;
+            names_to_ids_[name] = id;
+        }
+        ids.insert(id);
+    }
+    ids_in_file_[path] = ids;
+    LOG(INFO)("Load %zd reads from sequence database: %s", ids.size(), db->Path().c_str());
+}
+
 void ReadStore::LoadFofn(const std::string &fname, int mode) {
     std::ifstream in(fname);
     if (in.is_open()) {
@@ -130,7 +167,9 @@ const std::unordered_set<Seq::Id>& ReadStore::IdsInFile(const std::string &fname
 
 std::string ReadStore::DetectFileType(const std::string &fname) {
 
-    if (fname.size() >= 6 && fname.substr(fname.size()-6) == ".fasta") {
+    if (SeqdbReader::IsSeqdb(fname)) {
+        return "seqdb";
+    } else if (fname.size() >= 6 && fname.substr(fname.size()-6) == ".fasta") {
         return "fasta";
     } else if (fname.size() >= 3 && fname.substr(fname.size()-3) == ".fa") {
         return "fasta";
@@ -171,6 +210,7 @@ Seq::Id ReadStore::Insert(const SeqReader::Item &item, SeqReader *reader, int mo
         items_[it->second].seq = mode == 0 ? item.seq : "";
         items_[it->second].id = item.id;
         items_[it->second].reader = reader;
+        items_[it->second].seqdb = nullptr;
         std::transform(items_[it->second].seq.begin(), items_[it->second].seq.end(), items_[it->second].seq.begin(), ::toupper);
         id = it->second;
     } else {
@@ -212,13 +252,45 @@ void ReadStore::SaveIdToName(const std::string &fname) const {
 }
 
 
+std::string ReadStore::GetSeq(Seq::Id id) const {
+    Item &item = items_[id];
+    if (item.seqdb != nullptr) {
+        return item.seqdb->Decode(item.id, 0, item.seqdb->SeqLength(item.id));
+    }
+    LoadItem(item); 
+    return item.seq;
+}
+
+std::string ReadStore::GetSubSeq(Seq::Id id, size_t start, size_t end) const {
+    Item &item = items_[id];
+    if (item.seqdb != nullptr) {
+        // clipped at the end of the read, as std::string::substr does
+        size_t len = item.seqdb->SeqLength(item.id);
+        end = std::min(end, len);
+        return item.seqdb->Decode(item.id, std::min(start, end), end);
+    }
+    LoadItem(item); 
+    return item.seq.substr(start, end - start);
+}
+
+size_t ReadStore::GetSeqLength(Seq::Id id) const {
+    const Item &item = items_[id];
+    if (item.seqdb != nullptr) {
+        return item.seqdb->SeqLength(item.id);
+    }
+    LoadItem(items_[id]);
+    return item.seq.size();
+}
+
 std::string ReadStore::GetSeq(const Seq::Area& sa) {
-    const std::string &seq = GetSeq(sa.id);
+    // as seq.substr(sa.start, sa.end): the length is sa.end, clipped at the end of the read
+    size_t end = std::min(GetSeqLength(sa.id), (size_t)sa.start + sa.end);
+    std::string seq = GetSubSeq(sa.id, sa.start, end);
 
     if (sa.strand == 0) {
-        return seq.substr(sa.start, sa.end);
+        return seq;
     }
     else {
-        return Seq::ReverseComplement(seq.substr(sa.start, sa.end));
+        return Seq::ReverseComplement(seq);
     }
 }
\ No newline at end of file
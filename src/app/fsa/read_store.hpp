@@ -2,31 +2,37 @@
 #define FSA_READ_STORE_HPP
 
 #include <array>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
 #include "sequence.hpp"
+#include "seqdb_reader.hpp"
 
 class ReadStore {
 public:
     struct Item {
         Item(){}
         Item(const std::string &s, SeqReader::ItemId i, SeqReader* r) : seq(s), id(i), reader(r) {}
+        Item(SeqReader::ItemId i, const SeqdbReader* db) : id(i), seqdb(db) {}
         std::string seq;
         SeqReader::ItemId id {-1};
         SeqReader* reader {nullptr};
+        const SeqdbReader* seqdb {nullptr};     // the read stays packed in seqdb, id is its id there
     };
 
     void SetNameToId(const std::string &name, Seq::Id id);
     int NameToId(const std::string &name);
     std::string IdToName(Seq::Id id);
-    const std::string& GetSeq(Seq::Id id) const { LoadItem(items_[id]); return items_[id].seq;  }
-    const std::string& GetSeq(const std::string &name) { return GetSeq(names_to_ids_[name]); }
+    std::string GetSeq(Seq::Id id) const;
+    std::string GetSeq(const std::string &name) { return GetSeq(names_to_ids_[name]); }
+    // the forward strand in [start, end), end is clipped at the end of the read
+    std::string GetSubSeq(Seq::Id id, size_t start, size_t end) const;
 
     std::string GetSeq(const Seq::Area& sa);
-    size_t GetSeqLength(Seq::Id id) const { return GetSeq(id).size(); }
+    size_t GetSeqLength(Seq::Id id) const;
 
     void SaveIdToName(const std::string& fname) const;
     std::array<Seq::Id, 2> GetIdRange() const { return std::array<Seq::Id, 2>{0, (int)names_.size()}; }
@@ -36,6 +42,7 @@ public:
     void LoadFastq(const std::string &fname, int mode=0);
     void LoadFofn(const std::string &fname, int mode=0);
     void LoadTxt(const std::string &fname, int mode=0) { LoadFofn(fname, mode); }
+    void LoadSeqdb(const std::string &path);
     void LoadItem(Item &item) const;
     
 
@@ -54,6 +61,7 @@ protected:
     mutable std::vector<Item> items_;
     std::unordered_map<std::string, std::unordered_set<Seq::Id>> ids_in_file_;
     std::vector<SeqReader*> readers_;
+    std::vector<std::unique_ptr<SeqdbReader>> seqdbs_;
 };
 
 #endif // FSA_READ_STORE_HPP
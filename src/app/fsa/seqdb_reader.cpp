@@ -0,0 +1,144 @@
+#include "seqdb_reader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "logger.hpp"
+
+namespace {
+
+const char* const kVolumeInfoSuffix = "volume_info.bin";
+
+// the four bases of each packed byte, the first one in the high bits
+struct PacTable {
+    PacTable() {
+        const char bases[] = "ACGT";
+        for (int i = 0; i < 256; ++i) {
+            for (int k = 0; k < 4; ++k) {
+                chars[i][k] = bases[(i >> ((3 - k) * 2)) & 3];
+            }
+        }
+    }
+    char chars[256][4];
+};
+
+const PacTable kPacTable;
+
+bool IsDirectory(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool IsFile(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+}
+
+SeqdbReader::SeqdbReader(const std::string &dir, const std::string &title) : dir_(dir), title_(title) {
+    if (title_.empty()) title_ = FindTitle(dir_);
+    path_ = dir_ + "/" + title_;
+    if (title_.empty()) return;
+
+    MmapFile vol_file(FilePath(kVolumeInfoSuffix));
+    if (!vol_file.IsValid() || vol_file.Size() < sizeof(DbInfo)) return;
+    // the first entry describes the whole database, the volumes follow
+    DbInfo info;
+    memcpy(&info, vol_file.Data(), sizeof(DbInfo));
+    num_seqs_ = info.num_seqs;
+
+    info_file_.reset(new MmapFile(FilePath("seq_info"), false));
+    hdrs_.reset(new MmapFile(FilePath("hdr"), false));
+    pac_file_.reset(new MmapFile(FilePath("pac"), false));
+    ambig_file_.reset(new MmapFile(FilePath("ambig"), false));
+    if (!info_file_->IsValid() || !hdrs_->IsValid() || !pac_file_->IsValid() || !ambig_file_->IsValid()) return;
+    if (info_file_->Size() < sizeof(SeqInfo) * num_seqs_ || pac_file_->Size() < (info.seq_offset_to + 3) / 4 ||
+        ambig_file_->Size() % sizeof(AmbigSubseq) != 0) {
+        LOG(WARNING)("Sequence database is truncated: %s", path_.c_str());
+        return;
+    }
+
+    infos_ = reinterpret_cast<const SeqInfo*>(info_file_->Data());
+    pac_ = reinterpret_cast<const uint8_t*>(pac_file_->Data());
+    ambigs_ = reinterpret_cast<const AmbigSubseq*>(ambig_file_->Data());
+    ambig_size_ = ambig_file_->Size() / sizeof(AmbigSubseq);
+    valid_ = true;
+}
+
+std::string SeqdbReader::FilePath(const std::string &suffix) const {
+    return dir_ + "/" + title_ + "." + suffix;
+}
+
+void SeqdbReader::Decode(size_t id, size_t from, size_t to, std::string &seq) const {
+    assert(id < Size());
+    const SeqInfo &info = infos_[id];
+    assert(from <= to && to <= info.seq_size);
+
+    seq.resize(to - from);
+    char *out = &seq[0];
+    size_t i = info.seq_offset + from;
+    const size_t end = info.seq_offset + to;
+    for (; i < end && (i & 3) != 0; ++i) *out++ = kPacTable.chars[pac_[i >> 2]][i & 3];
+    for (; i + 4 <= end; i += 4) {
+        memcpy(out, kPacTable.chars[pac_[i >> 2]], 4);
+        out += 4;
+    }
+    for (; i < end; ++i) *out++ = kPacTable.chars[pac_[i >> 2]][i & 3];
+
+    // ambiguous residues were packed as 0
+    const AmbigSubseq *ab = ambigs_ + info.ambig_offset;
+    const AmbigSubseq *ae = ab + info.ambig_size;
+    assert(info.ambig_offset + info.ambig_size <= ambig_size_);
+    ab = std::lower_bound(ab, ae, from, [](const AmbigSubseq &a, size_t pos) { return a.offset + a.count <= pos; });
+    for (; ab < ae && ab->offset < to; ++ab) {
+        const size_t b = std::max<size_t>(ab->offset, from);
+        const size_t e = std::min<size_t>(ab->offset + ab->count, to);
+        std::fill(seq.begin() + (b - from), seq.begin() + (e - from), (char)::toupper(ab->ambig_residue));
+    }
+}
+
+std::string SeqdbReader::FindTitle(const std::string &dir) {
+    std::string title;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) return title;
+
+    const size_t n = strlen(kVolumeInfoSuffix) + 1;
+    size_t count = 0;
+    for (struct dirent *e = readdir(d); e != nullptr; e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > n && name.compare(name.size() - n, n, std::string(".") + kVolumeInfoSuffix) == 0) {
+            title = name.substr(0, name.size() - n);
+            ++count;
+        }
+    }
+    closedir(d);
+
+    if (count > 1) {
+        LOG(WARNING)("More than one sequence database in %s, the title should be given", dir.c_str());
+        title.clear();
+    }
+    return title;
+}
+
+bool SeqdbReader::IsSeqdb(const std::string &path, std::string *dir, std::string *title) {
+    std::string d, t;
+    if (IsDirectory(path)) {
+        d = path;
+        t = FindTitle(path);
+    } else if (IsFile(path + "." + kVolumeInfoSuffix)) {
+        size_t slash = path.rfind('/');
+        d = slash != std::string::npos ? path.substr(0, slash) : ".";
+        t = slash != std::string::npos ? path.substr(slash + 1) : path;
+    }
+
+    if (t.empty()) return false;
+    if (dir != nullptr) *dir = d;
+    if (title != nullptr) *title = t;
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef FSA_SEQDB_READER_HPP
+#define FSA_SEQDB_READER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "utility.hpp"
+
+// Read-only view of a sequence database built by mecat2map or makehbndb
+// (corelib/seqdb.h), mapped into memory. The residues stay 2-bit packed and
+// only the ranges asked for are decoded. The ids are the database ids, which
+// follow the order of the reads in the input files.
+class SeqdbReader {
+public:
+    // The layouts of CSeqDBInfo, CSeqInfo and CAmbigSubseq in corelib/seqdb.h
+    struct DbInfo {
+        int32_t seq_start_id;
+        int32_t num_seqs;
+        uint64_t db_size;
+        uint64_t seq_offset_from;
+        uint64_t seq_offset_to;
+        uint64_t hdr_offset_from;
+        uint64_t hdr_offset_to;
+        uint64_t ambig_offset_from;
+        uint64_t ambig_offset_to;
+    };
+
+    struct SeqInfo {
+        uint64_t seq_offset;
+        uint64_t seq_size;
+        uint64_t hdr_offset;
+        uint64_t hdr_size;
+        uint64_t ambig_offset;
+        uint64_t ambig_size;
+    };
+
+    struct AmbigSubseq {
+        uint64_t offset;        // in the sequence
+        char ambig_residue;
+        int32_t count;
+    };
+
+public:
+    // title is the prefix of the files in dir, "" for the only one there
+    SeqdbReader(const std::string &dir, const std::string &title="");
+
+    bool IsValid() const { return valid_; }
+    const std::string& Path() const { return path_; }
+
+    size_t Size() const { return (size_t)num_seqs_; }
+    const char* Name(size_t id) const { return hdrs_->Data() + infos_[id].hdr_offset; }
+    size_t SeqLength(size_t id) const { return infos_[id].seq_size; }
+
+    // Decodes [from, to) of the forward strand of sequence id, in upper case
+    void Decode(size_t id, size_t from, size_t to, std::string &seq) const;
+    std::string Decode(size_t id, size_t from, size_t to) const { std::string s; Decode(id, from, to, s); return s; }
+
+    // Whether path names a database: a directory holding one, or the path of
+    // its files without the suffixes, as in dir/title.
+    static bool IsSeqdb(const std::string &path, std::string *dir=nullptr, std::string *title=nullptr);
+
+protected:
+    std::string FilePath(const std::string &suffix) const;
+    static std::string FindTitle(const std::string &dir);
+
+protected:
+    std::string dir_;
+    std::string title_;
+    std::string path_;
+    bool valid_ { false };
+
+    int32_t num_seqs_ { 0 };
+    std::unique_ptr<MmapFile> info_file_;
+    std::unique_ptr<MmapFile> hdrs_;
+    std::unique_ptr<MmapFile> pac_file_;
+    std::unique_ptr<MmapFile> ambig_file_;
+    const SeqInfo *infos_ { nullptr };
+    const uint8_t *pac_ { nullptr };
+    const AmbigSubseq *ambigs_ { nullptr };
+    size_t ambig_size_ { 0 };
+};
+
+static_assert(sizeof(SeqdbReader::DbInfo) == 64, "unexpected size of DbInfo");
+static_assert(sizeof(SeqdbReader::SeqInfo) == 48, "unexpected size of SeqInfo");
+static_assert(sizeof(SeqdbReader::AmbigSubseq) == 16, "unexpected size of AmbigSubseq");
+
+#endif // FSA_SEQDB_READER_HPP
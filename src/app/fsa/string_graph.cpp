@@ -151,7 +151,7 @@ void StringGraph::AddOverlap(const Overlap* overlap) {
 
 }
 
-void StringGraph::AddOverlaps(const std::deque<Overlap> &overlaps, int min_length, int min_aligned_lenght, float min_identity) {
+void StringGraph::AddOverlaps(const std::vector<Overlap> &overlaps, int min_length, int min_aligned_lenght, float min_identity) {
 
     std::unordered_set<StringNode::ID> contained;
 
@@ -228,68 +228,87 @@ void StringGraph::AddEdge(int in_node, int out_node, int len, int score, double
     out->second->in_edges_.push_back(e);
 }
 
-void StringGraph::MarkTransitiveEdges() {
+// Myers' transitive reduction. The out edges of every node are sorted first,
+// after which the graph is only read while the edges to reduce are found, so
+// the nodes are split among the threads, each marking the out nodes of its
+// node in a local array. The edges found are applied in the order of nodes_,
+// and the result does not depend on thread_size.
+void StringGraph::MarkTransitiveEdges(size_t thread_size) {
 
 	const int FUZZ = 500;
+    thread_size = std::max<size_t>(1, std::min(thread_size, nodes_.size()));
+    using NodeRange = std::array<decltype(nodes_)::const_iterator, 2>;
 
-	for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
-		it->second->mark_ = 'V';
-	}
-
-	for (auto it : nodes_) {
-		if (it.second->out_edges_.size() == 0) continue;
-
-
-		std::vector<StringEdge*> &out_edges = it.second->out_edges_;
-
-
+    auto sort_func = [](const NodeRange &range) {
+        for (auto it = range[0]; it != range[1]; ++it) {
+            std::vector<StringEdge*> &out_edges = it->second->out_edges_;
+            std::sort(out_edges.begin(), out_edges.end(), [](StringEdge* a, StringEdge *b) { return a->length_ < b->length_; });
+        }
+    };
+    MultiThreadRun(thread_size, nodes_, SplitConstIterater<decltype(nodes_)>, sort_func);
+
+    auto work_func = [FUZZ](const NodeRange &range) {
+        std::vector<StringEdge*> reduced;
+        // the out nodes of the current node, sorted by address, and their marks
+        std::vector<std::pair<StringNode*, char>> marks;
+        auto mark = [&marks](StringNode* n) -> char* {
+            auto m = std::lower_bound(marks.begin(), marks.end(), n, [](const std::pair<StringNode*, char> &a, StringNode* b) { return a.first < b; });
+            return m != marks.end() && m->first == n ? &m->second : nullptr;
+        };
+        auto eliminate = [&mark](StringNode* n) {
+            char *m = mark(n);
+            if (m != nullptr && *m == 'I') *m = 'E';
+        };
+
+        for (auto it = range[0]; it != range[1]; ++it) {
+            const std::vector<StringEdge*> &out_edges = it->second->out_edges_;
+            if (out_edges.size() == 0) continue;
+
+            marks.clear();
+            for (auto e : out_edges) {
+                marks.push_back(std::make_pair(e->out_node_, 'I'));
+            }
+            std::sort(marks.begin(), marks.end());
+            marks.erase(std::unique(marks.begin(), marks.end()), marks.end());
 
-		std::sort(out_edges.begin(), out_edges.end(), [](StringEdge* a, StringEdge *b) { return a->length_ < b->length_; });
+            int max_len = out_edges.back()->length_  + FUZZ;
 
-		for (auto e : out_edges) {
-			e->out_node_->mark_ = 'I';
-		}
+            for (auto e : out_edges) {
+                StringNode* w = e->out_node_;
+                if (*mark(w) == 'I') {
+                    for (auto e2 : w->out_edges_) {
+                        if (e2->length_ + e->length_ < max_len) {
+                            eliminate(e2->out_node_);
+                        }
+                    }
+                }
+            }
+            for (auto e : out_edges) {
+                StringNode* w = e->out_node_;
+                if (w->out_edges_.size() > 0) {
+                    eliminate(w->out_edges_.front()->out_node_);
+                }
+                for (auto e2 : w->out_edges_) {
+                    if (e2->length_ < FUZZ) {
+                        eliminate(e2->out_node_);
+                    }
+                }
+            }
 
-		int max_len = out_edges.back()->length_  + FUZZ;
-
-		for (auto e : out_edges) {
-			StringNode* w = e->out_node_;
-			if (w->mark_ == 'I') {
-				std::sort(w->out_edges_.begin(), w->out_edges_.end(), [](StringEdge* a, StringEdge *b) { return a->length_ < b->length_; });
-				for (auto e2 : w->out_edges_) {
-					if (e2->length_ + e->length_ < max_len) {
-						if (e2->out_node_->mark_ == 'I') {
-							e2->out_node_->mark_ = 'E';
-						}
-					}
-				}
-			}
-		}
-		for (auto e : out_edges) {
-			StringNode* w = e->out_node_;
-			std::sort(w->out_edges_.begin(), w->out_edges_.end(), [](StringEdge* a, StringEdge *b) { return a->length_ < b->length_; });
-			if (w->out_edges_.size() > 0) {
-				if (w->out_edges_.front()->out_node_->mark_ == 'I') {
-					w->out_edges_.front()->out_node_->mark_ = 'E';
+            for (auto e : out_edges) {
+                if (*mark(e->out_node_) == 'E') {
+                    reduced.push_back(e);
                 }
-			}				
-			for (auto e2 : w->out_edges_) {
-				if (e2->length_ < FUZZ) {
-					if (e2->out_node_->mark_ == 'I') {
-						e2->out_node_->mark_ = 'E';
-					}
-				}
-			}
-		}
+            }
+        }
+        return reduced;
+    };
 
-		for (auto e : out_edges) {
-			if (e->out_node_->mark_ == 'E') {
-                e->reduce_ = true;
-                StringGraph::ReverseEdge(e)->reduce_ = true;
-			}
-			e->out_node_->mark_ = 'V';
-		}
-	}
+    std::vector<StringEdge*> reduced = MultiThreadRun(thread_size, nodes_, SplitConstIterater<decltype(nodes_)>, work_func, MoveCombineVector<std::vector<StringEdge*>>);
+    for (auto e : reduced) {
+        e->reduce_ = true;
+        ReverseEdge(e)->reduce_ = true;
+    }
 
     for (auto& i : edges_) {
         if (i.second->reduce_) i.second->Reduce(StringEdge::TRANSITIVE);
@@ -300,37 +319,46 @@ void StringGraph::MarkTransitiveEdges() {
 /** 
  * 移除毛刺节点：有多个入（出）节点，它入（出）节点没有入（出）节点则认为是毛刺。
  */
-void StringGraph::MarkSpurEdges() {
+void StringGraph::MarkSpurEdges(size_t thread_size) {
 
-    std::unordered_set<StringEdge*> removed;
-    for (auto &n :  nodes_) {
-        
-        if (n.second->out_edges_.size() > 1) {
-           
-            for (auto e : n.second->out_edges_) {
-                assert(!e->reduce_);
-                if (!e->reduce_) { // TODO 
-                    if (e->out_node_->out_edges_.size()+ e->out_node_->reduced_out_edges_.size() == 0) {
-                        removed.insert(e);
-                        removed.insert(ReverseEdge(e));
+    thread_size = std::max<size_t>(1, std::min(thread_size, nodes_.size()));
+    auto work_func = [](const std::array<decltype(nodes_)::const_iterator, 2> &range) {
+        std::vector<StringEdge*> spurs;
+        for (auto n = range[0]; n != range[1]; ++n) {
+
+            if (n->second->out_edges_.size() > 1) {
+
+                for (auto e : n->second->out_edges_) {
+                    assert(!e->reduce_);
+                    if (!e->reduce_) { // TODO 
+                        if (e->out_node_->out_edges_.size()+ e->out_node_->reduced_out_edges_.size() == 0) {
+                            spurs.push_back(e);
+                        }
                     }
                 }
             }
-        }
 
-        if (n.second->in_edges_.size() > 1) {
-            for (auto e : n.second->in_edges_) {
+            if (n->second->in_edges_.size() > 1) {
+                for (auto e : n->second->in_edges_) {
 
-                assert(!e->reduce_);
-                if (!e->reduce_) {  // TODO assert(!e->reduce_);
-                    
-                    if (e->in_node_->in_edges_.size() + e->in_node_->reduced_in_edges_.size() == 0) {
-                        removed.insert(e);
-                        removed.insert(ReverseEdge(e));
+                    assert(!e->reduce_);
+                    if (!e->reduce_) {  // TODO assert(!e->reduce_);
+
+                        if (e->in_node_->in_edges_.size() + e->in_node_->reduced_in_edges_.size() == 0) {
+                            spurs.push_back(e);
+                        }
                     }
-                }
-             }
+                 }
+            }
         }
+        return spurs;
+    };
+
+    std::vector<StringEdge*> spurs = MultiThreadRun(thread_size, nodes_, SplitConstIterater<decltype(nodes_)>, work_func, MoveCombineVector<std::vector<StringEdge*>>);
+    std::unordered_set<StringEdge*> removed;
+    for (auto e : spurs) {
+        removed.insert(e);
+        removed.insert(ReverseEdge(e));
     }
 
     for (auto e : removed) {
@@ -362,7 +390,7 @@ void Intersection(const std::unordered_set<T> &a, std::unordered_set<T> &b, std:
  * 延伸：指一定深度的出节点
  * TODO：是否需要考虑所有的边，reduce的边是否需要考虑。（初步判断应该考虑）
  */
-void StringGraph::MarkChimerEdges() {
+void StringGraph::MarkChimerEdges(size_t thread_size) {
     
     std::unordered_set<StringEdge*> removed;
     std::unordered_set<StringNode*> multi_in_nodes;
@@ -383,43 +411,54 @@ void StringGraph::MarkChimerEdges() {
 
     Intersection(multi_out_nodes, multi_in_nodes, chimer_candidates);
 
-    for (auto n : chimer_candidates) {
-        std::vector<StringNode*>&& out_nodes = n->GetAllOutNodes();
-        std::vector<StringNode*>&& in_nodes = n->GetAllInNodes();
+    // the candidates are only tested here, the edges are reduced below
+    auto work_func = [this](const std::array<decltype(chimer_candidates)::const_iterator, 2> &range) {
+        std::vector<StringNode*> chimers;
+        for (auto it = range[0]; it != range[1]; ++it) {
+            StringNode *n = *it;
+            std::vector<StringNode*>&& out_nodes = n->GetAllOutNodes();
+            std::vector<StringNode*>&& in_nodes = n->GetAllInNodes();
+
+            std::unordered_set<StringNode*> test;
+            for (auto in_node : in_nodes) {
+                std::vector<StringNode*>&& nodes = in_node->GetAllOutNodes();
+                test.insert(nodes.begin(), nodes.end());
+            }
 
-        std::unordered_set<StringNode*> test;
-        for (auto in_node : in_nodes) {
-            std::vector<StringNode*>&& nodes = in_node->GetAllOutNodes();
-            test.insert(nodes.begin(), nodes.end());
-        }
+            test.erase(n);
 
-        test.erase(n);
-        
-        if (!HasCommon(test, out_nodes)) {
-            std::unordered_set<StringNode*> flow_node1;
-            for (auto v : out_nodes) {
-                std::unordered_set<StringNode*>&& nodes = BfsNodes(v, n, 5);
-                flow_node1.insert(nodes.begin(), nodes.end());
-            }
-            std::unordered_set<StringNode*> flow_node2;
-            for (auto v : test) {
-                std::unordered_set<StringNode*>&& nodes = BfsNodes(v, n, 5);
-                flow_node2.insert(nodes.begin(), nodes.end());
-            }
-            
-            if (!HasCommon(flow_node1, flow_node2)) {
-                for (auto e : n->out_edges_) {
-                    assert(!e->reduce_);
-                    removed.insert(e);
-                    removed.insert(ReverseEdge(e));
+            if (!HasCommon(test, out_nodes)) {
+                std::unordered_set<StringNode*> flow_node1;
+                for (auto v : out_nodes) {
+                    std::unordered_set<StringNode*>&& nodes = BfsNodes(v, n, 5);
+                    flow_node1.insert(nodes.begin(), nodes.end());
                 }
-                for (auto e : n->in_edges_) {
-                    assert(!e->reduce_);
-                    removed.insert(e);
-                    removed.insert(ReverseEdge(e));
+                std::unordered_set<StringNode*> flow_node2;
+                for (auto v : test) {
+                    std::unordered_set<StringNode*>&& nodes = BfsNodes(v, n, 5);
+                    flow_node2.insert(nodes.begin(), nodes.end());
+                }
+
+                if (!HasCommon(flow_node1, flow_node2)) {
+                    chimers.push_back(n);
                 }
             }
-            
+        }
+        return chimers;
+    };
+
+    thread_size = std::max<size_t>(1, std::min(thread_size, chimer_candidates.size()));
+    std::vector<StringNode*> chimers = MultiThreadRun(thread_size, chimer_candidates, SplitConstIterater<decltype(chimer_candidates)>, work_func, MoveCombineVector<std::vector<StringNode*>>);
+    for (auto n : chimers) {
+        for (auto e : n->out_edges_) {
+            assert(!e->reduce_);
+            removed.insert(e);
+            removed.insert(ReverseEdge(e));
+        }
+        for (auto e : n->in_edges_) {
+            assert(!e->reduce_);
+            removed.insert(e);
+            removed.insert(ReverseEdge(e));
         }
     }
 
@@ -473,32 +512,37 @@ std::unordered_set<StringNode*> StringGraph::BfsNodes(StringNode* n, StringNode
 }
 
 
-void StringGraph::MarkBestOverlap() {
-    std::unordered_set<StringEdge*> best_edges;
+// An edge is one of the best if it is the best out edge of its in node or
+// the best in edge of its out node, so the nodes can be split among the
+// threads, each setting the best edges of its nodes.
+void StringGraph::MarkBestOverlap(size_t thread_size) {
 
     auto best_cmp_func = [](StringEdge *a, StringEdge *b) { return a->score_ < b->score_; };
     //auto best_cmp_func = [](StringEdge *a, StringEdge *b) { return a->score_ * a->identity_ > b->score_ * b->identity_; };
-     
-    for (auto &n : nodes_) {
-        if (n.second->out_edges_.size() > 0) {
-            const std::vector<StringEdge*>& edges = n.second->out_edges_;
-            auto m = std::max_element(edges.begin(), edges.end(), best_cmp_func);
-            assert(!(*m)->reduce_);
-            best_edges.insert(*m);
-            n.second->best_out_ = *m;
-        }
-        if (n.second->in_edges_.size() > 0) {
-            const std::vector<StringEdge*>& edges = n.second->in_edges_;
-            auto m = std::max_element(edges.begin(), edges.end(), best_cmp_func);
-            assert(!(*m)->reduce_);
-            best_edges.insert(*m);
-            n.second->best_in_ = *m;
+
+    auto work_func = [best_cmp_func](const std::array<decltype(nodes_)::const_iterator, 2> &range) {
+        for (auto n = range[0]; n != range[1]; ++n) {
+            if (n->second->out_edges_.size() > 0) {
+                const std::vector<StringEdge*>& edges = n->second->out_edges_;
+                auto m = std::max_element(edges.begin(), edges.end(), best_cmp_func);
+                assert(!(*m)->reduce_);
+                n->second->best_out_ = *m;
+            }
+            if (n->second->in_edges_.size() > 0) {
+                const std::vector<StringEdge*>& edges = n->second->in_edges_;
+                auto m = std::max_element(edges.begin(), edges.end(), best_cmp_func);
+                assert(!(*m)->reduce_);
+                n->second->best_in_ = *m;
+            }
         }
-    }
+    };
+    thread_size = std::max<size_t>(1, std::min(thread_size, nodes_.size()));
+    MultiThreadRun(thread_size, nodes_, SplitConstIterater<decltype(nodes_)>, work_func);
 
     for (auto &e : edges_) { // TODO check if the condition can be removed
         if (!e.second->reduce_) {
-            if (best_edges.find(e.second) == best_edges.end()) {
+            // an active edge is in the edges of its nodes, whose best edges were set above
+            if (e.second != e.second->in_node_->best_out_ && e.second != e.second->out_node_->best_in_) {
                 e.second->Reduce(StringEdge::NO_BEST);
                 ReverseEdge(e.second)->Reduce(StringEdge::NO_BEST);
             }
@@ -789,6 +833,14 @@ void StringGraph::SaveChimerNode(const std::string &fname) {
         fclose(file);
     }
 }
+size_t StringGraph::ReducedEdgeSize() const {
+    size_t n = 0;
+    for (const auto &i : edges_) {
+        if (i.second->reduce_) ++n;
+    }
+    return n;
+}
+
 void StringGraph::SaveEdges(const std::string &fname) {
     FILE *file = fopen(fname.c_str(), "w");
     if (file != NULL) {
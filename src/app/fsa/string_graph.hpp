@@ -52,7 +52,6 @@ public:
     std::vector<StringEdge*> reduced_out_edges_;
     std::vector<StringEdge*> reduced_in_edges_;
 
-    int mark_;
     StringEdge* best_in_{ nullptr };
     StringEdge* best_out_{ nullptr };
 };
@@ -142,17 +141,17 @@ public:
     }
 
 	void AddOverlap(const Overlap* overlap);
-	void AddOverlaps(const std::deque<Overlap> &ovlps, int min_length, int min_aligned_lenght, float min_identity);
+	void AddOverlaps(const std::vector<Overlap> &ovlps, int min_length, int min_aligned_lenght, float min_identity);
     bool FilterOverlap(const Overlap &ovlp, const std::unordered_set<StringNode::ID> &contained, int min_length, int min_aligned_length, float min_identity);
 	void AddEdge(int in_node, int out_node, int len, int score, double identity, int read, int start, int end);
 
-	void MarkTransitiveEdges();
+	void MarkTransitiveEdges(size_t thread_size=1);
 
-	void MarkChimerEdges();
-	void MarkSpurEdges();
+	void MarkChimerEdges(size_t thread_size=1);
+	void MarkSpurEdges(size_t thread_size=1);
 	std::unordered_set<StringNode*> BfsNodes(StringNode* n, StringNode* exclude=nullptr, int depth=5);
 	
-	void MarkBestOverlap();
+	void MarkBestOverlap(size_t thread_size=1);
 	void ResolveRepeatEdges();
 
 	void IdentifySimplePaths();
@@ -171,6 +170,7 @@ public:
 	void DumpPaths();
     void SaveChimerNode(const std::string &fname);
     void SaveEdges(const std::string &fname);
+    size_t ReducedEdgeSize() const;
 
 protected:
 	std::unordered_map<StringNode::ID, StringNode*> nodes_;
@@ -1,9 +1,16 @@
 #include "utility.hpp"
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 std::vector<std::string> SplitStringBySpace(const std::string &str) {
     std::vector<std::string> substrs;
 
@@ -20,3 +27,67 @@ std::vector<std::string> SplitStringBySpace(const std::string &str) {
 
     return substrs;
 }
+
+bool StringRef::operator==(const char *s) const {
+    size_t n = strlen(s);
+    return size() == n && std::equal(begin, end, s);
+}
+
+size_t SplitBySpace(const char *begin, const char *end, StringRef *fields, size_t max_size) {
+    size_t n = 0;
+    const char *p = begin;
+    while (n < max_size) {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (p == end) break;
+        fields[n].begin = p;
+        while (p < end && *p != ' ' && *p != '\t') ++p;
+        fields[n].end = p;
+        ++n;
+    }
+    return n;
+}
+
+int ParseInt(const StringRef &s) {
+    const char *p = s.begin;
+    bool neg = false;
+    if (p < s.end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    long v = 0;
+    for (; p < s.end && *p >= '0' && *p <= '9'; ++p) v = v * 10 + (*p - '0');
+    return (int)(neg ? -v : v);
+}
+
+double ParseDouble(const StringRef &s) {
+    // strtod needs a terminated string, fields are short enough for the stack
+    char buf[64];
+    if (s.size() < sizeof(buf)) {
+        std::copy(s.begin, s.end, buf);
+        buf[s.size()] = '\0';
+        return strtod(buf, nullptr);
+    }
+    return strtod(s.ToString().c_str(), nullptr);
+}
+
+MmapFile::MmapFile(const std::string &fname, bool sequential) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size_ = st.st_size;
+        if (size_ == 0) {
+            valid_ = true;
+        } else {
+            void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                data_ = (const char*)addr;
+                valid_ = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+MmapFile::~MmapFile() {
+    if (data_ != nullptr) munmap((void*)data_, size_);
+}
@@ -8,6 +8,7 @@
 #include <cassert>
 #include <algorithm>
 #include <numeric>
+#include <string>
 
 template<typename T>
 auto SplitConstIterater(size_t sz, const T& container) -> std::vector<std::array<typename T::const_iterator, 2>> {
@@ -208,6 +209,44 @@ auto FindIntersectKeys(const M &a, const M &b) -> std::unordered_set<typename M:
 
 std::vector<std::string> SplitStringBySpace(const std::string &str);
 
+// A piece of a buffer that outlives it, e.g. a field of a mapped file
+struct StringRef {
+    const char *begin { nullptr };
+    const char *end { nullptr };
+
+    size_t size() const { return end - begin; }
+    std::string ToString() const { return std::string(begin, end); }
+    bool operator==(const StringRef &r) const { return size() == r.size() && std::equal(begin, end, r.begin); }
+    bool operator==(const char *s) const;
+};
+
+// In-place SplitStringBySpace: stores at most max_size fields of [begin, end)
+// and returns their number.
+size_t SplitBySpace(const char *begin, const char *end, StringRef *fields, size_t max_size);
+
+// atoi and atof of a field, without copying it into a std::string.
+int ParseInt(const StringRef &s);
+double ParseDouble(const StringRef &s);
+
+// Read-only memory mapping of a whole file
+class MmapFile {
+public:
+    // sequential=false for files read at random
+    MmapFile(const std::string &fname, bool sequential=true);
+    ~MmapFile();
+    MmapFile(const MmapFile&) = delete;
+    MmapFile& operator=(const MmapFile&) = delete;
+
+    bool IsValid() const { return valid_; }
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+protected:
+    const char* data_ { nullptr };
+    size_t size_ { 0 };
+    bool valid_ { false };
+};
+
 template<typename T>
 void DeletePtrContainer(T & c) {
     for (auto e : c) {
@@ -157,7 +157,7 @@ int main(int argc, char* argv[])
         HBN_LOG("HBN database is already built. Exit normally.");
         return EXIT_SUCCESS;
     }
-    build_db(SEQDB_BUILD_ARGS);
+    build_db(SEQDB_BUILD_ARGS, 1);
     hbndb_make_built(SEQDB_BUILD_ARGS);
 
     return EXIT_SUCCESS;
@@ -24,10 +24,14 @@ const string kArgMaxSubjectVolSeqs("max_subject_vol_seqs");
 const int kDfltMaxSubjectVolSeqs = numeric_limits<int>::max();
 const string kArgMaxSubjectVolRes("max_subject_vol_res");
 const size_t kDfltMaxSubjectVolRes = static_cast<size_t>(4000000000);
+const string kArgSubjectVolMem("subject_vol_mem");
+const size_t kDfltSubjectVolMem = 0;
 const string kArgDbDir("db_dir");
 const string kDfltDbDir("hbndb");
 const string kArgKeepDb("keep_db");
 const bool kDfltKeepDb = false;
+const string kArgSaveLktbl("save_lktbl");
+const bool kDfltSaveLktbl = false;
 
 const string kArgKmerSize("kmer_size");
 const int kDfltKmerSize = 15;
@@ -35,6 +39,10 @@ const string kArgKmerWindowSize("kmer_window");
 const int kDfltKmerWindowSize = 10;
 const string kArgMaxKmerOcc("max_kmer_occ");
 const int kDfltMaxKmerOcc = 200;
+const string kArgLktblBackend("lktbl_backend");
+const string kDfltLktblBackend("khash");
+const string kArgSeedMode("seed_mode");
+const string kDfltSeedMode("fixed");
 const string kArgBlockSize("block_size");
 const int kDfltBlockSize = 2000;
 const string kArgMinDDFS("min_ddfs");
@@ -56,11 +64,16 @@ const int kDfltQueryCovHspRes = 100;
 const string kDfltHbnOutput("-");
 const string kArgSkipOverhang("skip_overhang");
 const bool kDfltSkipOverhang = false;
+const string kArgEdFilterRate("ed_filter_rate");
+/// off until a threshold is validated on real reads, see necat2test ed_filter_check
+const double kDfltEdFilterRate = 0.0;
 
 const string kArgOutputCigar("cigar");
 const bool kDfltOutputCigar = false;
 const string kArgOutputMd("md");
 const bool kDfltOutputMd = false;
+const string kArgOrderedOutput("ordered_output");
+const bool kDfltOrderedOutput = false;
 
 static const char* kGroupGeneralSearchOptions = "General search options";
 static const char* kGroupInputQuery = "Input query options";
@@ -180,6 +193,11 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
 
     arg_desc.AddFlag(kArgKeepDb, "Do not delete the database after search?", true);
 
+    arg_desc.AddFlag(kArgSaveLktbl, 
+                "Save the lookup table of each subject volume in the database directory\n"
+                "and map it instead of building it again in later runs (with -keep_db)", 
+                true);
+
     arg_desc.AddOptionalKey(kArgMinQuerySize, "int_value",
                 "Skip query sequences shorter than this value",
                 CArgDescriptions::eInteger);
@@ -212,6 +230,13 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
                 NStr::UInt8ToString_DataSize(kDfltMaxSubjectVolRes));
     arg_desc.SetConstraint(kArgMaxSubjectVolRes, CArgAllowValuesGreaterThanOrEqual(1));
 
+    arg_desc.AddDefaultKey(kArgSubjectVolMem, "memory_size",
+                "Memory budget for subject volumes and their lookup tables.\n"
+                "If it holds more than one volume, the next volumes are loaded and indexed\n"
+                "in the background while the current one is being searched. 0 = no overlap",
+                CArgDescriptions::eDataSize,
+                NStr::UInt8ToString_DataSize(kDfltSubjectVolMem));
+
     /// DDF scoring options
     arg_desc.SetCurrentGroup(kGroupDDFSc);
 
@@ -241,6 +266,21 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
                 NStr::IntToString(kDfltMaxKmerOcc));
     arg_desc.SetConstraint(kArgMaxKmerOcc, CArgAllowValuesGreaterThanOrEqual(1));
 
+    arg_desc.AddDefaultKey(kArgLktblBackend, "string",
+                "Kmer lookup table backend:\n"
+                "  khash = hash table of kmer hash values,\n"
+                "  dense = direct-addressed array of 4^k entries (kmer size <= 15),\n"
+                "  mphf  = minimal perfect hash of kmer hash values",
+                CArgDescriptions::eString,
+                kDfltLktblBackend);
+
+    arg_desc.AddDefaultKey(kArgSeedMode, "string",
+                "Kmer seeding mode:\n"
+                "  fixed     = reference kmers every kmer_window bases, query kmers at every base,\n"
+                "  minimizer = (kmer_window, kmer_size)-minimizers of both reference and query",
+                CArgDescriptions::eString,
+                kDfltSeedMode);
+
     /// output format
     arg_desc.SetCurrentGroup(kGroupFormat);
 
@@ -265,6 +305,9 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
     arg_desc.AddFlag(kArgOutputMd,
                 "Output the MD tag in m4, paf or sam format",
                 true);
+    arg_desc.AddFlag(kArgOrderedOutput,
+                "Output the results in query order, independent of the number of threads",
+                true);
 
     /// query filtering options
     arg_desc.SetCurrentGroup(kGroupQueryFiltering);
@@ -314,6 +357,13 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
 
     arg_desc.AddFlag(kArgSkipOverhang, "Skip overhangs in alignments", true);
 
+    arg_desc.AddDefaultKey(kArgEdFilterRate, "float_value",
+                "Skip candidates whose seed window needs more than this many edits per base "
+                "before extending them (0 to disable)",
+                CArgDescriptions::eDouble,
+                NStr::DoubleToString(kDfltEdFilterRate));
+    arg_desc.SetConstraint(kArgEdFilterRate, CArgAllow_Doubles(0.0, 1.0));
+
     /// statistical options
     arg_desc.SetCurrentGroup(kGroupStatistics);
 
@@ -402,6 +452,9 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
     if (args.Exist(kArgKeepDb))
         m_Options->keep_db = static_cast<bool>(args[kArgKeepDb]);
 
+    if (args.Exist(kArgSaveLktbl))
+        m_Options->save_lktbl = static_cast<bool>(args[kArgSaveLktbl]);
+
     if (args.Exist(kArgMinQuerySize) && args[kArgMinQuerySize].HasValue()) {
         m_Options->min_query_size = args[kArgMinQuerySize].AsInteger();
     }
@@ -426,6 +479,10 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
         m_Options->max_subject_vol_res = args[kArgMaxSubjectVolRes].AsInt8();
     }
 
+    if (args.Exist(kArgSubjectVolMem) && args[kArgSubjectVolMem].HasValue()) {
+        m_Options->subject_vol_mem = args[kArgSubjectVolMem].AsInt8();
+    }
+
     /// ddf scoring options
     if (args.Exist(kArgKmerSize) && args[kArgKmerSize].HasValue()) {
         m_Options->kmer_size = args[kArgKmerSize].AsInteger();
@@ -447,6 +504,27 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
         m_Options->max_kmer_occ = args[kArgMaxKmerOcc].AsInteger();
     }
 
+    if (args.Exist(kArgLktblBackend) && args[kArgLktblBackend].HasValue()) {
+        string backend_str = args[kArgLktblBackend].AsString();
+        ELookupTableBackend backend = string_to_lktbl_backend(backend_str.c_str());
+        if (backend == eLktblInvalid) {
+            HBN_ERR("Invalid lookup table backend: %s", backend_str.c_str());
+        }
+        m_Options->lktbl_backend = backend;
+    }
+
+    if (args.Exist(kArgSeedMode) && args[kArgSeedMode].HasValue()) {
+        string seed_mode_str = args[kArgSeedMode].AsString();
+        ESeedMode seed_mode = string_to_seed_mode(seed_mode_str.c_str());
+        if (seed_mode == eSeedInvalid) {
+            HBN_ERR("Invalid seeding mode: %s", seed_mode_str.c_str());
+        }
+        if (seed_mode == eSeedMinimizer && m_Options->kmer_window_size > KMER_MINIMIZER_MAX_WINDOW) {
+            HBN_ERR("kmer_window must not exceed %d in minimizer seeding mode", KMER_MINIMIZER_MAX_WINDOW);
+        }
+        m_Options->seed_mode = seed_mode;
+    }
+
     /// mem chaining scoring options
     if (args.Exist(kArgMemScKmerSize) && args[kArgMemScKmerSize].HasValue()) {
         m_Options->memsc_kmer_size = args[kArgMemScKmerSize].AsInteger();
@@ -480,6 +558,9 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
     if (args.Exist(kArgOutputMd))
         m_Options->dump_md = static_cast<bool>(args[kArgOutputMd]);
 
+    if (args.Exist(kArgOrderedOutput))
+        m_Options->ordered_output = static_cast<bool>(args[kArgOrderedOutput]);
+
     /// query filtering options
     if (args.Exist(kArgDustFiltering) && args[kArgDustFiltering].HasValue()) {
         string duststr = args[kArgDustFiltering].AsString();
@@ -536,6 +617,10 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
     if (args.Exist(kArgSkipOverhang))
         m_Options->skip_overhang = static_cast<bool>(args[kArgSkipOverhang]);
 
+    if (args.Exist(kArgEdFilterRate) && args[kArgEdFilterRate].HasValue()) {
+        m_Options->ed_filter_rate = args[kArgEdFilterRate].AsDouble();
+    }
+
     /// statistical options
     if (args.Exist(kArgEffSearchSpace) && args[kArgEffSearchSpace].HasValue()) {
         m_Options->searchsp_eff = args[kArgEffSearchSpace].AsInt8();
@@ -600,17 +685,21 @@ void Init_HbnProgramOptions(HbnProgramOptions* opts, const EHbnTask task)
     /// database options
     opts->db_dir = strdup(kDfltDbDir.c_str());
     opts->keep_db = kDfltKeepDb;
+    opts->save_lktbl = kDfltSaveLktbl;
     opts->min_query_size = kDfltMinQuerySize;
     opts->max_query_vol_seqs = kDfltMaxQueryVolSeqs;
     opts->max_query_vol_res = kDfltMaxQueryVolRes;
     opts->min_subject_size = kDfltMinSubjectSize;
     opts->max_subject_vol_seqs = kDfltMaxSubjectVolSeqs;
     opts->max_subject_vol_res = kDfltMaxSubjectVolRes;
+    opts->subject_vol_mem = kDfltSubjectVolMem;
 
     /// ddf scoring options
     opts->kmer_size = kDfltKmerSize;
     opts->kmer_window_size = kDfltKmerWindowSize;
     opts->max_kmer_occ = kDfltMaxKmerOcc;
+    opts->lktbl_backend = string_to_lktbl_backend(kDfltLktblBackend.c_str());
+    opts->seed_mode = string_to_seed_mode(kDfltSeedMode.c_str());
     opts->block_size = kDfltBlockSize;
     opts->min_ddfs = kDfltMinDDFS;
 
@@ -624,6 +713,7 @@ void Init_HbnProgramOptions(HbnProgramOptions* opts, const EHbnTask task)
     opts->outfmt = kDfltHbnOutfmt;
     opts->dump_cigar = kDfltOutputCigar;
     opts->dump_md = kDfltOutputMd;
+    opts->ordered_output = kDfltOrderedOutput;
 
     /// query filtering options
     opts->use_dust_masker = 1;
@@ -640,6 +730,7 @@ void Init_HbnProgramOptions(HbnProgramOptions* opts, const EHbnTask task)
     opts->hitlist_size = BLAST_HITLIST_SIZE;
     opts->keep_best_hsp_per_subject = 0;
     opts->skip_overhang = kDfltSkipOverhang;
+    opts->ed_filter_rate = kDfltEdFilterRate;
 
     if (task == eHbnTask_pm) {
         opts->max_hsps_per_subject = 2;
@@ -795,6 +886,7 @@ char* HbnProgramOptions2String(const HbnProgramOptions* opts)
     /// database options
     os_one_option_value(kArgDbDir, opts->db_dir);
     if (opts->keep_db) os_one_flag_option(kArgKeepDb);
+    if (opts->save_lktbl) os_one_flag_option(kArgSaveLktbl);
     if (opts->min_query_size) os_one_option_value(kArgMinQuerySize, opts->min_query_size);
     if (opts->max_query_vol_seqs != kDfltMaxQueryVolSeqs) os_one_option_value(kArgMaxQueryVolSeqs, opts->max_query_vol_seqs);
     string size_str = NStr::UInt8ToString_DataSize(opts->max_query_vol_res);
@@ -803,11 +895,17 @@ char* HbnProgramOptions2String(const HbnProgramOptions* opts)
     if (opts->max_subject_vol_seqs != kDfltMaxSubjectVolSeqs) os_one_option_value(kArgMaxSubjectVolSeqs, opts->max_subject_vol_seqs);
     size_str = NStr::UInt8ToString_DataSize(opts->max_subject_vol_res);
     os_one_option_value(kArgMaxSubjectVolRes, size_str);
+    if (opts->subject_vol_mem) {
+        size_str = NStr::UInt8ToString_DataSize(opts->subject_vol_mem);
+        os_one_option_value(kArgSubjectVolMem, size_str);
+    }
 
     /// ddf scoring
     os_one_option_value(kArgKmerSize, opts->kmer_size);
     os_one_option_value(kArgKmerWindowSize, opts->kmer_window_size);
     os_one_option_value(kArgMaxKmerOcc, opts->max_kmer_occ);
+    os_one_option_value(kArgLktblBackend, lktbl_backend_names[opts->lktbl_backend]);
+    os_one_option_value(kArgSeedMode, seed_mode_names[opts->seed_mode]);
     os_one_option_value(kArgBlockSize, opts->block_size);
     os_one_option_value(kArgMinDDFS, opts->min_ddfs);
 
@@ -819,6 +917,7 @@ char* HbnProgramOptions2String(const HbnProgramOptions* opts)
 
     /// output format
     os_one_option_value(kArgOutputFormat, opts->outfmt);
+    if (opts->ordered_output) os_one_flag_option(kArgOrderedOutput);
 
     /// query filtering options
     if (opts->use_dust_masker) {
@@ -837,6 +936,7 @@ char* HbnProgramOptions2String(const HbnProgramOptions* opts)
     os_one_option_value(kArgMaxHSPsPerSubject, opts->max_hsps_per_subject);
     os_one_option_value(kArgMaxTargetSequences, opts->hitlist_size);
     if (opts->keep_best_hsp_per_subject) os_one_flag_option(kArgSubjectBestHit);
+    os_one_option_value(kArgEdFilterRate, opts->ed_filter_rate);
 
     /// misc options
     os_one_option_value(kArgNumThreads, opts->num_threads);
@@ -2,17 +2,34 @@
 
 #include "hbn_find_subseq_hit.h"
 #include "hbn_extend_subseq_hit.h"
+#include "hbn_results_writer.h"
 #include "mecat_results.h"
 #include "../../corelib/m4_record.h"
+#include "../../corelib/cstr_util.h"
+#include "../../corelib/unpack_pac.h"
 #include "../../ncbi_blast/setup/hsp2string.h"
 
 #include <pthread.h>
 
+typedef struct {
+    int num_chunks;
+    int num_queries;
+    size_t num_residues;
+    double busy_time;
+    double wall_time;
+    size_t peak_mem;
+    size_t num_ed_checked;
+    size_t num_ed_rejected;
+    size_t num_extended;
+} AlignThreadStats;
+
 static hbn_task_struct* g_task_struct = NULL;
 static int g_thread_index = 0;
 static pthread_mutex_t g_thread_index_lock;
 static int g_query_index = 0;
-static pthread_mutex_t g_query_index_lock;
+static int g_num_processed_queries = 0;
+static AlignThreadStats* g_thread_stats = NULL;
+static ResultsWriter* g_results_writer = NULL;
 
 static void
 init_global_values(hbn_task_struct* task_struct)
@@ -21,24 +38,48 @@ init_global_values(hbn_task_struct* task_struct)
     g_thread_index = 0;
     pthread_mutex_init(&g_thread_index_lock, NULL);
     g_query_index = 0;
-    pthread_mutex_init(&g_query_index_lock, NULL);
+    g_num_processed_queries = 0;
+    g_thread_stats = (AlignThreadStats*)calloc(task_struct->opts->num_threads, sizeof(AlignThreadStats));
+}
+
+/// Guided self-scheduling: the end of the next chunk is claimed with a
+/// single compare-and-swap on *next_query_id. A chunk holds up to
+/// HBN_QUERY_CHUNK_SIZE queries but no more than a shrinking share of the
+/// residues left, so chunks get smaller towards the end of the volume and
+/// an ultra-long read is never queued behind other queries.
+static int
+claim_next_query_chunk(const text_t* queries, const int num_threads, int* next_query_id, int* chunk_to)
+{
+    const int num_queries = queries->dbinfo.num_seqs;
+    if (num_queries == 0) return -1;
+    const size_t res_end = seqdb_seq_offset(queries, num_queries - 1) + seqdb_seq_size(queries, num_queries - 1);
+    while (1) {
+        int from = *next_query_id;
+        if (from >= num_queries) return -1;
+        const size_t res_from = seqdb_seq_offset(queries, from);
+        size_t max_res = (res_end - res_from) / (HBN_QUERY_CHUNK_SPLIT * num_threads);
+        max_res = hbn_min(max_res, (size_t)HBN_QUERY_CHUNK_RES);
+        const int max_to = hbn_min(from + HBN_QUERY_CHUNK_SIZE, num_queries);
+        int to = from + 1;
+        while (to < max_to && seqdb_seq_offset(queries, to) + seqdb_seq_size(queries, to) - res_from <= max_res) ++to;
+        if (__sync_bool_compare_and_swap(next_query_id, from, to)) {
+            *chunk_to = to;
+            return from;
+        }
+    }
 }
 
 static int
 get_next_query_chunk(
     const text_t* queries, 
+    const int num_threads,
     int* next_query_id,
-    pthread_mutex_t* query_id_lock,
     BLAST_SequenceBlk* query_blk, 
     BlastQueryInfo* query_info)
 {
-    int from = 0, to = 0;
-    pthread_mutex_lock(query_id_lock);
-    from = *next_query_id;
-    *next_query_id += HBN_QUERY_CHUNK_SIZE;
-    pthread_mutex_unlock(query_id_lock);
-    if (from >= queries->dbinfo.num_seqs) return 0;
-    to = hbn_min(from + HBN_QUERY_CHUNK_SIZE, queries->dbinfo.num_seqs);
+    int to = 0;
+    int from = claim_next_query_chunk(queries, num_threads, next_query_id, &to);
+    if (from < 0) return 0;
     int num_queries = to - from;
 
     int length = 0;
@@ -69,20 +110,13 @@ get_next_query_chunk(
         size_t seq_to = seq_from + seqdb_seq_size(queries, i);
         ctx_info.query_offset = seq_idx;
         query_info->contexts[ctx_idx++] = ctx_info;
-        for (size_t k = seq_from; k < seq_to; ++k) {
-            Uint1 c = _get_pac(queries->packed_seq, k);
-            query_blk->sequence[seq_idx++] = c;
-        }
+        unpack_pac_fwd(queries->packed_seq, seq_from, seq_to - seq_from, query_blk->sequence + seq_idx);
+        seq_idx += seq_to - seq_from;
 
         ctx_info.query_offset = seq_idx;
         query_info->contexts[ctx_idx++] = ctx_info;
-        size_t k = seq_to;
-        while (k > seq_from) {
-            --k;
-            Uint1 c = _get_pac(queries->packed_seq, k);
-            c = c ^ 3;
-            query_blk->sequence[seq_idx++] = c;
-        }
+        unpack_pac_rev(queries->packed_seq, seq_from, seq_to - seq_from, query_blk->sequence + seq_idx);
+        seq_idx += seq_to - seq_from;
     }
     hbn_assert(seq_idx == length);
 
@@ -198,8 +232,14 @@ dump_m4_hits(const text_t* query_vol,
 }
 
 static void
-align_one_block(hbn_task_struct* task_struct, const int thread_id, BLAST_SequenceBlk* query_blk, BlastQueryInfo* query_info)
+align_one_block(hbn_task_struct* task_struct, 
+    const int thread_id, 
+    BLAST_SequenceBlk* query_blk, 
+    BlastQueryInfo* query_info,
+    AlignThreadStats* stats)
 {
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
     hbn_assert(thread_id < task_struct->opts->num_threads);
     CSeqDB* query_vol = task_struct->query_vol;
     CSeqDB* subject_vol = task_struct->subject_vol;
@@ -280,18 +320,19 @@ align_one_block(hbn_task_struct* task_struct, const int thread_id, BLAST_Sequenc
         dump_m4_hits(query_vol, subject_vol, results, opts);
     }
 
-    pthread_mutex_lock(&task_struct->out_lock);
-    if (task_struct->out) {
-        hbn_fwrite(ks_s(results->output_buf), 1, ks_size(results->output_buf), task_struct->out);
-    }
-    if (task_struct->qi_vs_sj_out) {
-        hbn_fwrite(ks_s(results->output_buf), 1, ks_size(results->output_buf), task_struct->qi_vs_sj_out);
-    }
-    pthread_mutex_unlock(&task_struct->out_lock);
+    /// waiting for the writer is not counted as busy time
+    gettimeofday(&end, NULL);
+    stats->busy_time += hbn_time_diff(&begin, &end);
+    ++stats->num_chunks;
+    stats->num_queries += query_info->num_queries;
+    stats->num_residues += query_blk->length / 2;
+
+    const int query_from = query_info->contexts[0].query_index;
+    ResultsWriterSubmit(g_results_writer, query_from, query_from + query_info->num_queries, &results->output_buf);
 
     kv_destroy(subseq_hit_sink);
-    int gid = query_info->contexts[0].query_index;
-    if (gid && (gid % 1000 == 0)) HBN_LOG("%8d queries processed", gid);
+    int n = __sync_add_and_fetch(&g_num_processed_queries, query_info->num_queries);
+    if (n / 1000 != (n - query_info->num_queries) / 1000) HBN_LOG("%8d queries processed", n / 1000 * 1000);
 }
 
 static void*
@@ -304,26 +345,71 @@ hbn_align_worker()
     hbn_assert(thread_id < g_task_struct->opts->num_threads);
     BLAST_SequenceBlk* query_blk = BLAST_SequenceBlkNew();
     BlastQueryInfo* query_info = BlastQueryInfoNew(HBN_QUERY_CHUNK_SIZE * 2);
+    AlignThreadStats* stats = g_thread_stats + thread_id;
+    HbnSubseqHitExtnData* extn_data = g_task_struct->hit_extn_data_array[thread_id];
+    extn_data->num_ed_checked = 0;
+    extn_data->num_ed_rejected = 0;
+    extn_data->num_extended = 0;
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
 
     while (get_next_query_chunk(g_task_struct->query_vol,
+                g_task_struct->opts->num_threads,
                 &g_query_index,
-                &g_query_index_lock,
                 query_blk,
                 query_info)) {
         //HBN_LOG("mapping 20 reads");
-        align_one_block(g_task_struct, thread_id, query_blk, query_info);
+        align_one_block(g_task_struct, thread_id, query_blk, query_info, stats);
         //break;
     }
     BLAST_SequenceBlkFree(query_blk);
     BlastQueryInfoFree(query_info);
+    gettimeofday(&end, NULL);
+    stats->wall_time = hbn_time_diff(&begin, &end);
+    stats->peak_mem = DiffGapAlignDataMemSize(extn_data->diff_data);
+    stats->num_ed_checked = extn_data->num_ed_checked;
+    stats->num_ed_rejected = extn_data->num_ed_rejected;
+    stats->num_extended = extn_data->num_extended;
     return NULL;
 }
 
+static void
+report_thread_stats(const int num_threads)
+{
+    double wall_time = 0.0, busy_time = 0.0;
+    size_t num_ed_checked = 0, num_ed_rejected = 0, num_extended = 0;
+    char mem_buf[64];
+    for (int i = 0; i < num_threads; ++i) wall_time = hbn_max(wall_time, g_thread_stats[i].wall_time);
+    for (int i = 0; i < num_threads; ++i) {
+        AlignThreadStats* stats = g_thread_stats + i;
+        double idle_time = wall_time - stats->busy_time;
+        busy_time += stats->busy_time;
+        num_ed_checked += stats->num_ed_checked;
+        num_ed_rejected += stats->num_ed_rejected;
+        num_extended += stats->num_extended;
+        HBN_LOG("thread %3d: %6d chunks, %8d queries, %12zu residues, busy %8.2fs, idle %8.2fs (%.1f%%), peak alignment memory %s",
+            i, stats->num_chunks, stats->num_queries, stats->num_residues,
+            stats->busy_time, idle_time, wall_time > 0.0 ? 100.0 * idle_time / wall_time : 0.0,
+            u64_to_string_datasize(stats->peak_mem, mem_buf));
+    }
+    HBN_LOG("%d threads, %.2fs, utilisation %.1f%%",
+        num_threads, wall_time, wall_time > 0.0 ? 100.0 * busy_time / (wall_time * num_threads) : 0.0);
+    if (num_ed_checked) {
+        HBN_LOG("edit distance filter: %zu of %zu candidates dropped (%.1f%%), %zu extended",
+            num_ed_rejected, num_ed_checked, 100.0 * num_ed_rejected / num_ed_checked, num_extended);
+    }
+}
+
 void
 hbn_align_one_volume(hbn_task_struct* task_struct)
 {
     init_global_values(task_struct);
     const int num_threads = task_struct->opts->num_threads;
+    g_results_writer = ResultsWriterNew(task_struct->out,
+                            task_struct->qi_vs_sj_out,
+                            task_struct->opts->ordered_output,
+                            HBN_RESULTS_WRITER_QUEUE_SIZE * num_threads,
+                            0);
     pthread_t job_ids[num_threads];
     for (int i = 0; i < num_threads; ++i) {
         pthread_create(job_ids + i, NULL, hbn_align_worker, NULL);
@@ -331,4 +417,8 @@ hbn_align_one_volume(hbn_task_struct* task_struct)
     for (int i = 0; i < num_threads; ++i) {
         pthread_join(job_ids[i], NULL);
     }
+    g_results_writer = ResultsWriterFree(g_results_writer);
+    report_thread_stats(num_threads);
+    free(g_thread_stats);
+    g_thread_stats = NULL;
 }
\ No newline at end of file
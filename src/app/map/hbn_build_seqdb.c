@@ -1,6 +1,7 @@
 #include "hbn_build_seqdb.h"
 
 #include "../../corelib/build_db.h"
+#include "../../corelib/gz_reader.h"
 #include "../../corelib/seqdb_summary.h"
 
 #include <errno.h>
@@ -16,7 +17,6 @@ hbn_build_seqdb(const HbnProgramOptions* opts,
         (mkdir(opts->db_dir, S_IRWXU) != 0)) {
         HBN_ERR("Failed to create directory %s: %s", opts->db_dir, strerror(errno));
     }
-
     if (!hbndb_is_built(opts->query,
             opts->db_dir,
             query_db_title,
@@ -30,7 +30,8 @@ hbn_build_seqdb(const HbnProgramOptions* opts,
             opts->min_query_size,
             opts->max_query_vol_seqs,
             opts->max_query_vol_res,
-            FALSE);
+            FALSE,
+            opts->num_threads);
         hbndb_make_built(opts->query,
             opts->db_dir,
             query_db_title,
@@ -63,7 +64,8 @@ hbn_build_seqdb(const HbnProgramOptions* opts,
             opts->min_subject_size,
             opts->max_subject_vol_seqs,
             opts->max_subject_vol_res,
-            FALSE);
+            FALSE,
+            opts->num_threads);
         hbndb_make_built(opts->subject,
             opts->db_dir,
             subject_db_title,
@@ -1,5 +1,6 @@
 #include "hbn_extend_subseq_hit.h"
 
+#include "../../algo/bit_parallel_ed.h"
 #include "../../ncbi_blast/setup/hsp2string.h"
 
 HbnSubseqHitExtnData*
@@ -45,6 +46,39 @@ hsp_is_contained(const BlastHSP* hsp_array,
     return FALSE;
 }
 
+/// windows shorter than this say too little about the candidate
+#define ED_FILTER_MIN_PATTERN   64
+
+/// Cheap check run before diff_align(). The query window of up to
+/// BPED_MAX_PATTERN bases around the seed is aligned semi-globally to the
+/// subject window on the same diagonal, widened on both sides by the number
+/// of edits allowed. Returns FALSE if the window needs more than
+/// max_ed_rate edits per query base, i.e. the candidate is hopeless.
+static BOOL
+subseq_hit_passes_ed_filter(const u8* query,
+    const int qoff,
+    const int query_length,
+    const u8* subject,
+    const int soff,
+    const int subject_length,
+    const double max_ed_rate)
+{
+    /// keep the query window on the part of the diagonal that the subject covers
+    int qfrom = hbn_max(0, qoff - soff);
+    int qto = hbn_min(query_length, qoff + subject_length - soff);
+    qfrom = hbn_max(qfrom, qoff - BPED_MAX_PATTERN / 2);
+    qto = hbn_min(qto, qfrom + BPED_MAX_PATTERN);
+    qfrom = hbn_max(hbn_max(0, qoff - soff), qto - BPED_MAX_PATTERN);
+    const int m = qto - qfrom;
+    if (m < ED_FILTER_MIN_PATTERN) return TRUE;
+
+    const int max_ed = (int)(max_ed_rate * m);
+    const int sfrom = hbn_max(0, soff - (qoff - qfrom) - max_ed);
+    const int sto = hbn_min(subject_length, soff + (qto - qoff) + max_ed);
+    const int ed = semi_global_edit_distance(query + qfrom, m, subject + sfrom, sto - sfrom);
+    return ed <= max_ed;
+}
+
 static void
 hbn_extend_subject_subseq_hit_list(HbnSubseqHitExtnData* data,
     const text_t* db,
@@ -74,6 +108,15 @@ hbn_extend_subject_subseq_hit_list(HbnSubseqHitExtnData* data,
         const u8* subject = db->unpacked_seq + seqdb_seq_offset(db, hit->sid) + hit->sfrom;
         const int subject_length = hit->sto - hit->sfrom;
         const u8* query = (hit->qdir == FWD) ? fwd_query : rev_query;
+        if (opts->ed_filter_rate > 0.0) {
+            ++data->num_ed_checked;
+            if (!subseq_hit_passes_ed_filter(query, hit->qoff, query_length,
+                    subject, hit->soff, subject_length, opts->ed_filter_rate)) {
+                ++data->num_ed_rejected;
+                continue;
+            }
+        }
+        ++data->num_extended;
         data->diff_data->qid = query_id;
         data->diff_data->sid = hit->sid;
         int r = diff_align(data->diff_data,
@@ -16,6 +16,10 @@ typedef struct {
     vec_subseq_hit rev_sbjct_subseq_list;
     vec_subseq_hit sbjct_subseq_list;
     DiffGapAlignData* diff_data;
+    /// edit distance prefilter (see -ed_filter_rate)
+    size_t num_ed_checked;
+    size_t num_ed_rejected;
+    size_t num_extended;
 } HbnSubseqHitExtnData;
 
 HbnSubseqHitExtnData*
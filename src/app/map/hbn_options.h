@@ -3,12 +3,20 @@
 
 #include "../../ncbi_blast/setup/blast_options.h"
 #include "../../ncbi_blast/setup/blast_types.h"
+#include "../../algo/hbn_lookup_table.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// maximum number of queries in a query chunk
 #define HBN_QUERY_CHUNK_SIZE    20
+/// maximum number of residues in a query chunk, a single longer query forms its own chunk
+#define HBN_QUERY_CHUNK_RES     1000000
+/// a chunk holds at most 1 / (HBN_QUERY_CHUNK_SPLIT * num_threads) of the residues left
+#define HBN_QUERY_CHUNK_SPLIT   4
+/// filled output buffers that may wait for the writer, per thread
+#define HBN_RESULTS_WRITER_QUEUE_SIZE   2
 
 typedef enum {
     eSeqid,
@@ -53,17 +61,21 @@ typedef struct {
     /// database options
     const char*     db_dir;
     int             keep_db;
+    int             save_lktbl;
     int             min_query_size;
     int             max_query_vol_seqs;
     size_t          max_query_vol_res;
     int             min_subject_size;
     int             max_subject_vol_seqs;
     size_t          max_subject_vol_res;
+    size_t          subject_vol_mem;
 
     /// ddf scoring options
     int             kmer_size;
     int             kmer_window_size;
     int             max_kmer_occ;
+    ELookupTableBackend lktbl_backend;
+    ESeedMode       seed_mode;
     int             block_size;
     int             min_ddfs;
 
@@ -77,6 +89,7 @@ typedef struct {
     EOutputFormat   outfmt;
     int             dump_cigar;
     int             dump_md;
+    int             ordered_output;
 
     /// query filtering options
     int             use_dust_masker;
@@ -93,6 +106,7 @@ typedef struct {
     int             hitlist_size;
     int             keep_best_hsp_per_subject;
     int             skip_overhang;
+    double          ed_filter_rate;
 
     /// statistical options
     i64             searchsp_eff;
@@ -0,0 +1,118 @@
+#include "hbn_results_writer.h"
+
+static int
+find_writable_item(ResultsWriter* writer)
+{
+    const int n = kv_size(writer->pending);
+    if (!writer->ordered) return n ? 0 : -1;
+    for (int i = 0; i < n; ++i) {
+        if (kv_A(writer->pending, i).query_from == writer->next_query_id) return i;
+    }
+    return -1;
+}
+
+static void*
+results_writer_worker(void* params)
+{
+    ResultsWriter* writer = (ResultsWriter*)(params);
+    struct timeval begin, end;
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        int i = find_writable_item(writer);
+        if (i < 0) {
+            if (writer->done) break;
+            pthread_cond_wait(&writer->cond, &writer->lock);
+            continue;
+        }
+        ResultsWriterItem item = kv_A(writer->pending, i);
+        /// keep the remaining chunks in arrival order
+        for (size_t k = i; k + 1 < kv_size(writer->pending); ++k) kv_A(writer->pending, k) = kv_A(writer->pending, k + 1);
+        --kv_size(writer->pending);
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->lock);
+
+        gettimeofday(&begin, NULL);
+        if (ks_size(item.buf)) {
+            if (writer->out) hbn_fwrite(ks_s(item.buf), 1, ks_size(item.buf), writer->out);
+            if (writer->backup_out) hbn_fwrite(ks_s(item.buf), 1, ks_size(item.buf), writer->backup_out);
+        }
+        gettimeofday(&end, NULL);
+
+        pthread_mutex_lock(&writer->lock);
+        writer->write_time += hbn_time_diff(&begin, &end);
+        writer->bytes_written += ks_size(item.buf);
+        writer->next_query_id = item.query_to;
+        ks_clear(item.buf);
+        kv_push(kstring_t, writer->free_bufs, item.buf);
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+ResultsWriter*
+ResultsWriterNew(FILE* out, FILE* backup_out, const int ordered, const int max_pending, const int first_query_id)
+{
+    ResultsWriter* writer = (ResultsWriter*)calloc(1, sizeof(ResultsWriter));
+    writer->out = out;
+    writer->backup_out = backup_out;
+    writer->ordered = ordered;
+    writer->max_pending = hbn_max(1, max_pending);
+    kv_init(writer->pending);
+    kv_init(writer->free_bufs);
+    writer->next_query_id = first_query_id;
+    writer->done = 0;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    pthread_create(&writer->job_id, NULL, results_writer_worker, writer);
+    return writer;
+}
+
+ResultsWriter*
+ResultsWriterFree(ResultsWriter* writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->done = 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->job_id, NULL);
+    hbn_assert(kv_size(writer->pending) == 0, "%zu result chunks were never written", kv_size(writer->pending));
+    HBN_LOG("%zu bytes written in %.2fs, workers waited %.2fs for the writer",
+        writer->bytes_written, writer->write_time, writer->submit_wait_time);
+
+    for (size_t i = 0; i < kv_size(writer->free_bufs); ++i) ks_destroy(kv_A(writer->free_bufs, i));
+    kv_destroy(writer->free_bufs);
+    kv_destroy(writer->pending);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer);
+    return NULL;
+}
+
+void
+ResultsWriterSubmit(ResultsWriter* writer, const int query_from, const int query_to, kstring_t* buf)
+{
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
+    pthread_mutex_lock(&writer->lock);
+    while (kv_size(writer->pending) >= writer->max_pending
+           &&
+           !(writer->ordered && query_from == writer->next_query_id)) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    gettimeofday(&end, NULL);
+    writer->submit_wait_time += hbn_time_diff(&begin, &end);
+
+    ResultsWriterItem* item = (kv_pushp(ResultsWriterItem, writer->pending));
+    item->query_from = query_from;
+    item->query_to = query_to;
+    item->buf = *buf;
+    if (kv_size(writer->free_bufs)) {
+        *buf = kv_pop(writer->free_bufs);
+    } else {
+        buf->l = buf->m = 0;
+        buf->s = NULL;
+    }
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+}
@@ -0,0 +1,64 @@
+#ifndef __HBN_RESULTS_WRITER_H
+#define __HBN_RESULTS_WRITER_H
+
+#include "../../corelib/hbn_aux.h"
+#include "../../corelib/kstring.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// results of the query chunk [query_from, query_to)
+typedef struct {
+    int         query_from;
+    int         query_to;
+    kstring_t   buf;
+} ResultsWriterItem;
+
+typedef kvec_t(ResultsWriterItem) vec_results_writer_item;
+typedef kvec_t(kstring_t) vec_kstring;
+
+/// A writer thread fed by a bounded queue of filled output buffers.
+/// Every buffer is written once to out and teed to backup_out.
+///
+/// In ordered mode the chunks are written in query order, so the output
+/// does not depend on the number of threads. The chunk that is due next
+/// is always accepted, even if the queue is full, so that the writer can
+/// never starve while the queue is held up by later chunks.
+typedef struct {
+    FILE*           out;
+    FILE*           backup_out;
+    int             ordered;
+    int             max_pending;
+    vec_results_writer_item pending;
+    vec_kstring     free_bufs;
+    int             next_query_id;
+    int             done;
+
+    size_t          bytes_written;
+    double          write_time;
+    double          submit_wait_time;
+
+    pthread_t       job_id;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} ResultsWriter;
+
+ResultsWriter*
+ResultsWriterNew(FILE* out, FILE* backup_out, const int ordered, const int max_pending, const int first_query_id);
+
+/// waits for all pending buffers to be written
+ResultsWriter*
+ResultsWriterFree(ResultsWriter* writer);
+
+/// takes over the content of buf and leaves an empty buffer in it
+void
+ResultsWriterSubmit(ResultsWriter* writer, const int query_from, const int query_to, kstring_t* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HBN_RESULTS_WRITER_H
@@ -0,0 +1,173 @@
+#include "hbn_subject_vol_loader.h"
+
+SubjectVolContext*
+SubjectVolContextNew(const HbnProgramOptions* opts, 
+    const char* subject_db_title, 
+    const int subject_vol_index,
+    const int num_threads)
+{
+    SubjectVolContext* ctx = (SubjectVolContext*)calloc(1, sizeof(SubjectVolContext));
+    ctx->subject_vol_index = subject_vol_index;
+    ctx->subject_vol = seqdb_load_unpacked(opts->db_dir, subject_db_title, subject_vol_index);
+    if (opts->save_lktbl) {
+        ctx->lktbl = build_or_load_lookup_table(opts->db_dir,
+                        subject_db_title,
+                        subject_vol_index,
+                        ctx->subject_vol,
+                        opts->kmer_size,
+                        opts->kmer_window_size,
+                        opts->seed_mode,
+                        opts->max_kmer_occ,
+                        num_threads,
+                        opts->lktbl_backend);
+    } else {
+        ctx->lktbl = build_lookup_table(ctx->subject_vol,
+                        opts->kmer_size,
+                        opts->kmer_window_size,
+                        opts->seed_mode,
+                        opts->max_kmer_occ,
+                        num_threads,
+                        opts->lktbl_backend);
+    }
+
+    const CSeqDBInfo* dbinfo = &ctx->subject_vol->dbinfo;
+    ctx->mem_size = seqdb_max_offset(ctx->subject_vol)
+                    + sizeof(CSeqInfo) * dbinfo->num_seqs
+                    + (dbinfo->hdr_offset_to - dbinfo->hdr_offset_from)
+                    + (dbinfo->ambig_offset_to - dbinfo->ambig_offset_from)
+                    + lookup_table_memory_size(ctx->lktbl);
+    return ctx;
+}
+
+SubjectVolContext*
+SubjectVolContextFree(SubjectVolContext* ctx)
+{
+    CSeqDBFree(ctx->subject_vol);
+    destroy_lookup_table(ctx->lktbl);
+    free(ctx);
+    return NULL;
+}
+
+static void*
+subject_vol_loader_worker(void* params)
+{
+    SubjectVolLoader* loader = (SubjectVolLoader*)(params);
+    for (int i = 0; i < loader->svid_count; ++i) {
+        pthread_mutex_lock(&loader->lock);
+        while (!loader->stop
+               &&
+               loader->num_resident
+               &&
+               loader->resident_mem + loader->max_vol_mem > loader->mem_budget) {
+            pthread_cond_wait(&loader->cond, &loader->lock);
+        }
+        if (loader->stop) {
+            pthread_mutex_unlock(&loader->lock);
+            break;
+        }
+        /// the workers are idle only if no other volume is resident
+        const int num_threads = (loader->num_resident == 0) ? loader->opts->num_threads : 1;
+        ++loader->num_resident;
+        pthread_mutex_unlock(&loader->lock);
+
+        SubjectVolContext* ctx = SubjectVolContextNew(loader->opts, 
+                                    loader->subject_db_title, 
+                                    loader->svid_array[i],
+                                    num_threads);
+
+        pthread_mutex_lock(&loader->lock);
+        loader->ctx_array[i] = ctx;
+        loader->resident_mem += ctx->mem_size;
+        loader->max_vol_mem = hbn_max(loader->max_vol_mem, ctx->mem_size);
+        pthread_cond_broadcast(&loader->cond);
+        pthread_mutex_unlock(&loader->lock);
+    }
+    return NULL;
+}
+
+SubjectVolLoader*
+SubjectVolLoaderNew(const HbnProgramOptions* opts,
+    const char* subject_db_title,
+    const int* svid_array,
+    const int svid_count)
+{
+    SubjectVolLoader* loader = (SubjectVolLoader*)calloc(1, sizeof(SubjectVolLoader));
+    loader->opts = opts;
+    loader->subject_db_title = subject_db_title;
+    loader->svid_array = (int*)malloc(sizeof(int) * (svid_count + 1));
+    memcpy(loader->svid_array, svid_array, sizeof(int) * svid_count);
+    loader->svid_count = svid_count;
+    loader->next_get_idx = 0;
+    loader->ctx_array = (SubjectVolContext**)calloc(svid_count + 1, sizeof(SubjectVolContext*));
+    loader->mem_budget = opts->subject_vol_mem;
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+
+    /// with a single volume there is nothing to overlap
+    loader->has_job = (loader->mem_budget > 0) && (svid_count > 1);
+    if (loader->has_job) {
+        HBN_LOG("prepare subject volumes in the background, memory budget: %zu bytes", loader->mem_budget);
+        pthread_create(&loader->job_id, NULL, subject_vol_loader_worker, loader);
+    }
+    return loader;
+}
+
+SubjectVolLoader*
+SubjectVolLoaderFree(SubjectVolLoader* loader)
+{
+    if (loader->has_job) {
+        pthread_mutex_lock(&loader->lock);
+        loader->stop = 1;
+        pthread_cond_broadcast(&loader->cond);
+        pthread_mutex_unlock(&loader->lock);
+        pthread_join(loader->job_id, NULL);
+        HBN_LOG("waited %.2fs for subject volumes to be prepared", loader->wait_time);
+    }
+    for (int i = 0; i < loader->svid_count; ++i) {
+        if (loader->ctx_array[i]) SubjectVolContextFree(loader->ctx_array[i]);
+    }
+    free(loader->ctx_array);
+    free(loader->svid_array);
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->cond);
+    free(loader);
+    return NULL;
+}
+
+SubjectVolContext*
+SubjectVolLoaderGet(SubjectVolLoader* loader, const int subject_vol_index)
+{
+    hbn_assert(loader->next_get_idx < loader->svid_count);
+    const int i = loader->next_get_idx++;
+    hbn_assert(loader->svid_array[i] == subject_vol_index,
+        "subject volumes must be requested in order (%d, %d)", loader->svid_array[i], subject_vol_index);
+    if (!loader->has_job) {
+        return SubjectVolContextNew(loader->opts, loader->subject_db_title, subject_vol_index, loader->opts->num_threads);
+    }
+
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
+    pthread_mutex_lock(&loader->lock);
+    while (!loader->ctx_array[i]) pthread_cond_wait(&loader->cond, &loader->lock);
+    SubjectVolContext* ctx = loader->ctx_array[i];
+    loader->ctx_array[i] = NULL;
+    pthread_mutex_unlock(&loader->lock);
+    gettimeofday(&end, NULL);
+    loader->wait_time += hbn_time_diff(&begin, &end);
+    return ctx;
+}
+
+void
+SubjectVolLoaderRelease(SubjectVolLoader* loader, SubjectVolContext* ctx)
+{
+    const size_t mem_size = ctx->mem_size;
+    SubjectVolContextFree(ctx);
+    if (!loader->has_job) return;
+    pthread_mutex_lock(&loader->lock);
+    hbn_assert(loader->num_resident > 0);
+    hbn_assert(loader->resident_mem >= mem_size);
+    --loader->num_resident;
+    loader->resident_mem -= mem_size;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+}
@@ -0,0 +1,84 @@
+#ifndef __HBN_SUBJECT_VOL_LOADER_H
+#define __HBN_SUBJECT_VOL_LOADER_H
+
+#include "hbn_options.h"
+#include "../../corelib/seqdb.h"
+#include "../../algo/hbn_lookup_table.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// a subject volume together with its kmer lookup table
+typedef struct {
+    int             subject_vol_index;
+    CSeqDB*         subject_vol;
+    LookupTable*    lktbl;
+    size_t          mem_size;
+} SubjectVolContext;
+
+/// the lookup table is built with num_threads threads
+SubjectVolContext*
+SubjectVolContextNew(const HbnProgramOptions* opts, 
+    const char* subject_db_title, 
+    const int subject_vol_index,
+    const int num_threads);
+
+SubjectVolContext*
+SubjectVolContextFree(SubjectVolContext* ctx);
+
+/// Hands out the subject volumes in svid_array in order.
+///
+/// If mem_budget is zero a volume is prepared (loaded, unpacked and
+/// indexed) when it is requested. Otherwise a background thread prepares
+/// the following volumes while the current one is being aligned, as long
+/// as the volumes resident at the same time, including the one being
+/// prepared, fit into mem_budget. The size of a volume that is not loaded
+/// yet is taken to be that of the largest volume seen so far. At least one
+/// volume is always allowed to be resident. A volume prepared while another
+/// one is resident is indexed with a single thread, as the alignment
+/// workers already use all of them.
+typedef struct {
+    const HbnProgramOptions* opts;
+    const char*     subject_db_title;
+    int*            svid_array;
+    int             svid_count;
+    int             next_get_idx;
+    SubjectVolContext** ctx_array;
+
+    size_t          mem_budget;
+    size_t          resident_mem;
+    int             num_resident;
+    size_t          max_vol_mem;
+    double          wait_time;
+
+    int             stop;
+    int             has_job;
+    pthread_t       job_id;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} SubjectVolLoader;
+
+SubjectVolLoader*
+SubjectVolLoaderNew(const HbnProgramOptions* opts,
+    const char* subject_db_title,
+    const int* svid_array,
+    const int svid_count);
+
+SubjectVolLoader*
+SubjectVolLoaderFree(SubjectVolLoader* loader);
+
+/// the next volume in svid_array, which must be subject_vol_index
+SubjectVolContext*
+SubjectVolLoaderGet(SubjectVolLoader* loader, const int subject_vol_index);
+
+void
+SubjectVolLoaderRelease(SubjectVolLoader* loader, SubjectVolContext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HBN_SUBJECT_VOL_LOADER_H
@@ -7,7 +7,6 @@ hbn_task_struct_new(const HbnProgramOptions* opts)
 
     ht_struct->qi_vs_sj_out = NULL;
     ht_struct->out = NULL;
-    pthread_mutex_init(&ht_struct->out_lock , NULL);
 
     const int query_and_subject_are_the_same = strcmp(opts->query, opts->subject) == 0;
 
@@ -21,6 +20,8 @@ hbn_task_struct_new(const HbnProgramOptions* opts)
 
     ht_struct->opts = opts;
     ht_struct->query_and_subject_are_the_same = query_and_subject_are_the_same;
+    ht_struct->subject_vol_loader = NULL;
+    ht_struct->subject_vol_ctx = NULL;
     ht_struct->lktbl = NULL;
     hbn_assert(ht_struct->opts->num_threads > 0);
     ht_struct->word_data_array = (WordFindData**)calloc(ht_struct->opts->num_threads, sizeof(WordFindData*));
@@ -44,6 +45,7 @@ hbn_task_struct_free(hbn_task_struct* ht_struct)
 
     hbn_task_struct_destroy_query_vol_context(ht_struct);
     hbn_task_struct_destroy_subject_vol_context(ht_struct);
+    if (ht_struct->subject_vol_loader) ht_struct->subject_vol_loader = SubjectVolLoaderFree(ht_struct->subject_vol_loader);
 
     if (!ht_struct->opts->keep_db) {
         char cmd[HBN_MAX_PATH_LEN];
@@ -90,19 +92,30 @@ hbn_task_struct_build_query_vol_context(hbn_task_struct* ht_struct, int query_vo
                                 ht_struct->subject_vol_index);
 }
 
+void
+hbn_task_struct_set_subject_vol_list(hbn_task_struct* ht_struct, const int* svid_array, const int svid_count)
+{
+    hbn_task_struct_destroy_subject_vol_context(ht_struct);
+    if (ht_struct->subject_vol_loader) SubjectVolLoaderFree(ht_struct->subject_vol_loader);
+    ht_struct->subject_vol_loader = SubjectVolLoaderNew(ht_struct->opts,
+                                        ht_struct->subject_db_title,
+                                        svid_array,
+                                        svid_count);
+}
+
 void
 hbn_task_struct_destroy_subject_vol_context(hbn_task_struct* ht_struct)
 {
     if (ht_struct->subject_vol) {
         hbn_assert(ht_struct->subject_vol_index >= 0);
-        hbn_assert(ht_struct->lktbl);
+        hbn_assert(ht_struct->subject_vol_ctx);
         hbn_assert(ht_struct->word_data_array);
-        CSeqDBFree(ht_struct->subject_vol);
-        destroy_lookup_table(ht_struct->lktbl);
+        SubjectVolLoaderRelease(ht_struct->subject_vol_loader, ht_struct->subject_vol_ctx);
         for (int i = 0; i < ht_struct->opts->num_threads; ++i) {
             ht_struct->word_data_array[i] = WordFindDataFree(ht_struct->word_data_array[i]);
         }
     }
+    ht_struct->subject_vol_ctx = NULL;
     ht_struct->subject_vol = NULL;
     ht_struct->subject_vol_index = -1;
     ht_struct->lktbl = NULL;
@@ -112,20 +125,25 @@ void
 hbn_task_struct_build_subject_vol_context(hbn_task_struct* ht_struct, int subject_vol_index)
 {
     hbn_task_struct_destroy_subject_vol_context(ht_struct);
+    hbn_assert(ht_struct->subject_vol_loader);
+    ht_struct->subject_vol_ctx = SubjectVolLoaderGet(ht_struct->subject_vol_loader, subject_vol_index);
     ht_struct->subject_vol_index = subject_vol_index;
-    ht_struct->subject_vol = seqdb_load_unpacked(ht_struct->opts->db_dir, ht_struct->subject_db_title, subject_vol_index);
-    ht_struct->lktbl = build_lookup_table(ht_struct->subject_vol,
-                            ht_struct->opts->kmer_size,
-                            ht_struct->opts->kmer_window_size,
-                            ht_struct->opts->max_kmer_occ,
-                            ht_struct->opts->num_threads);
+    ht_struct->subject_vol = ht_struct->subject_vol_ctx->subject_vol;
+    ht_struct->lktbl = ht_struct->subject_vol_ctx->lktbl;
     set_kmer_block_size_info(ht_struct->opts->block_size);
+    /// minimizers are sampled with the same window on both sides
+    const int query_window_size = (ht_struct->opts->seed_mode == eSeedMinimizer)
+                                  ?
+                                  ht_struct->opts->kmer_window_size
+                                  :
+                                  1;
     for (int i = 0; i < ht_struct->opts->num_threads; ++i) {
         ht_struct->word_data_array[i] = WordFindDataNew(ht_struct->subject_vol, 
                                     ht_struct->lktbl, 
                                     ht_struct->opts->kmer_size, 
-                                    1, 
+                                    query_window_size, 
                                     ht_struct->opts->min_ddfs, 
-                                    ht_struct->query_and_subject_are_the_same);
+                                    ht_struct->query_and_subject_are_the_same,
+                                    ht_struct->opts->seed_mode);
     }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "cmdline_args.h"
 #include "hbn_extend_subseq_hit.h"
 #include "hbn_job_control.h"
+#include "hbn_subject_vol_loader.h"
 #include "../../corelib/seqdb.h"
 #include "../../corelib/build_db.h"
 #include "../../algo/hbn_lookup_table.h"
@@ -23,7 +24,6 @@ extern "C" {
 typedef struct {
     FILE*               qi_vs_sj_out;
     FILE*               out;
-    pthread_mutex_t     out_lock;
 
     const char*         query_db_title;
     int                 query_vol_index;
@@ -36,6 +36,8 @@ typedef struct {
     const HbnProgramOptions*  opts;
 
     BOOL                query_and_subject_are_the_same;
+    SubjectVolLoader*   subject_vol_loader;
+    SubjectVolContext*  subject_vol_ctx;
     LookupTable*        lktbl;
     WordFindData**      word_data_array;
     HbnSubseqHitExtnData** hit_extn_data_array;
@@ -54,6 +56,10 @@ hbn_task_struct_destroy_query_vol_context(hbn_task_struct* ht_struct);
 void
 hbn_task_struct_build_query_vol_context(hbn_task_struct* ht_struct, int query_vol_index);
 
+/// the subject volumes that will be searched, in order
+void
+hbn_task_struct_set_subject_vol_list(hbn_task_struct* ht_struct, const int* svid_array, const int svid_count);
+
 void
 hbn_task_struct_destroy_subject_vol_context(hbn_task_struct* ht_struct);
 
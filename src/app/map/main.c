@@ -66,6 +66,16 @@ int main(int argc, char* argv[])
     const int subject_vol_stride = 1;
     char job_name[256];
 
+    kv_dinit(vec_int, svid_list);
+    for (int svid = 0; svid < num_subject_vols; svid += subject_vol_stride) {
+        int qvid = (task_struct->query_and_subject_are_the_same ? svid : 0) + opts->node_id;
+        if (!all_vs_sj_is_mapped(opts->db_dir, kBackupAlignResultsDir, qvid, num_query_vols, svid, opts->num_nodes)) {
+            kv_push(int, svid_list, svid);
+        }
+    }
+    hbn_task_struct_set_subject_vol_list(task_struct, kv_data(svid_list), kv_size(svid_list));
+    kv_destroy(svid_list);
+
     for (int svid = 0; svid < num_subject_vols; svid += subject_vol_stride) {
         HBN_LOG("Searching against S%s", u64_to_fixed_width_string(svid, HBN_DIGIT_WIDTH));
         int qvid = (task_struct->query_and_subject_are_the_same ? svid : 0) + opts->node_id;
@@ -14,6 +14,8 @@ SOURCES  := \
 	hbn_find_subseq_hit.c \
 	hbn_job_control.c \
 	hbn_options.c \
+	hbn_results_writer.c \
+	hbn_subject_vol_loader.c \
 	hbn_subseq_hit.c \
 	hbn_task_struct.c \
 	main.c \
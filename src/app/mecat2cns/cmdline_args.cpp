@@ -28,6 +28,8 @@ const string kArgBatchSize("batch_size");
 const int kDfltBatchSize = 5000;
 const string kArgUseBatchMode("use_batch_mode");
 const bool kDfltUseBatchMode = false;
+const string kArgUseMmap("use_mmap");
+const bool kDfltUseMmap = false;
 const string kArgOvlpCovPerc("ovlp_cov_perc");
 const double kDfltOvlpCovPerc = 60.0;
 const string kArgOvlpCovRes("ovlp_cov_res");
@@ -82,6 +84,10 @@ void CommandLineArguments::SetArgumentDescriptions(CArgDescriptions& arg_desc)
 
     arg_desc.AddFlag(kArgUseBatchMode, "Load raw reads into main memory in batches", true);
 
+    arg_desc.AddFlag(kArgUseMmap, 
+                "Map the raw reads file into memory instead of reading it,\n"
+                "so that all the processes on one node share one page cached copy", true);
+
     arg_desc.AddDefaultKey(kArgOvlpCovPerc, "real_value",
                 "Overlaps should cover at least this fraction of residues of the template or supporting read",
                 CArgDescriptions::eDouble,
@@ -159,6 +165,10 @@ void CommandLineArguments::ExtractAlgorithmOptions(const CArgs& args, CBlastOpti
         m_Options->use_batch_mode = static_cast<bool>(args[kArgUseBatchMode]);
     }
 
+    if (args.Exist(kArgUseMmap)) {
+        m_Options->use_mmap = static_cast<bool>(args[kArgUseMmap]);
+    }
+
     if (args.Exist(kArgOvlpCovPerc) && args[kArgOvlpCovPerc].HasValue()) {
         m_Options->ovlp_cov_perc = args[kArgOvlpCovPerc].AsDouble();
     }
@@ -245,6 +255,7 @@ void Init_HbnProgramOptions(HbnProgramOptions* opts)
 
     opts->batch_size = kDfltBatchSize;
     opts->use_batch_mode = kDfltUseBatchMode;
+    opts->use_mmap = kDfltUseMmap;
     opts->ovlp_cov_perc = kDfltOvlpCovPerc;
     opts->ovlp_cov_res = kDfltOvlpCovRes;
     opts->perc_identity = kDfltPercIdentity;
@@ -374,6 +385,7 @@ char* HbnProgramOptions2String(const HbnProgramOptions* opts)
 
     os_one_option_value(kArgBatchSize, opts->batch_size);
     if (opts->use_batch_mode) os_one_flag_option(kArgUseBatchMode);
+    if (opts->use_mmap) os_one_flag_option(kArgUseMmap);
     os_one_option_value(kArgOvlpCovPerc, opts->ovlp_cov_perc);
     os_one_option_value(kArgOvlpCovRes, opts->ovlp_cov_res);
     os_one_option_value(kArgPercentIdentity, opts->perc_identity);
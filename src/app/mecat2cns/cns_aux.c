@@ -159,27 +159,19 @@ set_next_raw_read_batch_info(RawReadCnsInfo* cns_info_array,
 }
 
 CnsThreadData*
-CnsThreadDataNew(const HbnProgramOptions* opts,
-    RawReadsReader* raw_reads,
-    RawReadCnsInfo* cns_info_array,
-    int* cns_info_idx,
-    pthread_mutex_t* cns_info_idx_lock,
-    kstring_t* cns_out,
+CnsThreadDataNew(const HbnProgramOptions* opts, 
+    struct hbn_task_struct* ht_struct, 
     pthread_mutex_t* out_lock)
 {
     CnsThreadData* data = (CnsThreadData*)calloc(1, sizeof(CnsThreadData));
     data->opts = opts;
-    data->raw_reads = raw_reads;
-    data->cns_info_array = cns_info_array;
-    data->cns_info_idx = cns_info_idx;
-    data->cns_info_idx_lock = cns_info_idx_lock;
+    data->ht_struct = ht_struct;
     ks_init(data->qaux);
     ks_init(data->saux);
     kv_init(data->fwd_read);
     kv_init(data->rev_read);
     kv_init(data->fwd_subject);
     kv_init(data->rev_subject);
-    data->cns_out = cns_out;
     data->cns_out_lock = out_lock;
     kv_init(data->cov_stats);
     data->cns_data = FCCnsDataNew();
@@ -25,19 +25,22 @@ typedef struct {
     size_t can_to;
     size_t cns_fasta_offset;
     size_t cns_fasta_size;
+    int finished;
 } RawReadCnsInfo;
 
 typedef struct {
     int start, end;
 } MappingRange;
 
+struct hbn_task_struct;
+
 typedef struct {
     const HbnProgramOptions* opts;
+    /// the task whose batches the worker takes reads from
+    struct hbn_task_struct* ht_struct;
     RawReadsReader* raw_reads;
     RawReadCnsInfo* cns_info_array;
     int cns_info_count;
-    int* cns_info_idx;
-    pthread_mutex_t* cns_info_idx_lock;
     HbnConsensusInitHit* cns_hit_array;
     size_t cns_hit_count;
     kstring_t qaux;
@@ -54,13 +57,11 @@ typedef struct {
     Ksw2Data* ksw;
 } CnsThreadData;
 
+/// raw_reads, cns_info_array, cns_info_count and cns_out are set to the
+/// batch of every read before it is corrected
 CnsThreadData*
-CnsThreadDataNew(const HbnProgramOptions* opts,
-    RawReadsReader* raw_reads,
-    RawReadCnsInfo* cns_info_array,
-    int* cns_info_idx,
-    pthread_mutex_t* cns_info_idx_lock,
-    kstring_t* cns_out,
+CnsThreadDataNew(const HbnProgramOptions* opts, 
+    struct hbn_task_struct* ht_struct, 
     pthread_mutex_t* out_lock);
 
 CnsThreadData*
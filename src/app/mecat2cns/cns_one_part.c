@@ -1,50 +1,154 @@
 #include "cns_one_part.h"
 
 #include "cns_one_read.h"
+#include "../../corelib/cstr_util.h"
 
 #include <pthread.h>
 
+/// The workers live as long as the partition. The main thread loads the
+/// next batch into the free slot while the workers correct the current one,
+/// the workers move on to the next batch as soon as every read of the
+/// current one has been handed out, and the main thread writes the
+/// corrected reads in batch order as soon as all the reads before them
+/// are done.
+
+#define batch_slot(ht_struct, i) ((ht_struct)->batch_array + (i) % CNS_NUM_BATCH_SLOTS)
+
 static void*
 cns_thread_worker(void* params)
 {
     CnsThreadData* data = (CnsThreadData*)(params);
+    hbn_task_struct* ht_struct = data->ht_struct;
+    pthread_mutex_lock(&ht_struct->batch_lock);
     while (1) {
-        int cns_info_idx = -1;
-        pthread_mutex_lock(data->cns_info_idx_lock);
-        cns_info_idx = *data->cns_info_idx;
-        ++(*data->cns_info_idx);
-        pthread_mutex_unlock(data->cns_info_idx_lock);
-        if (cns_info_idx >= data->cns_info_count) break;
+        CnsBatch* batch = NULL;
+        while (ht_struct->worker_batch_idx < ht_struct->num_loaded_batches) {
+            CnsBatch* b = batch_slot(ht_struct, ht_struct->worker_batch_idx);
+            if (b->cns_info_idx < b->cns_info_count) {
+                batch = b;
+                break;
+            }
+            ++ht_struct->worker_batch_idx;
+        }
+        if (!batch) {
+            if (ht_struct->all_batches_loaded) break;
+            pthread_cond_wait(&ht_struct->batch_cond, &ht_struct->batch_lock);
+            continue;
+        }
+        const int cns_info_idx = batch->cns_info_idx++;
+        pthread_mutex_unlock(&ht_struct->batch_lock);
+
+        data->raw_reads = batch->raw_reads;
+        data->cns_info_array = batch->cns_info_array;
+        data->cns_info_count = batch->cns_info_count;
+        data->cns_out = &batch->output_buf;
         consensus_one_read(data, cns_info_idx);
-        //exit(0);
+
+        pthread_mutex_lock(&ht_struct->batch_lock);
+        batch->cns_info_array[cns_info_idx].finished = 1;
+        pthread_cond_broadcast(&ht_struct->batch_cond);
     }
+    pthread_mutex_unlock(&ht_struct->batch_lock);
     return NULL;
 }
 
+/// returns the time spent waiting for the workers
+static double
+write_one_batch(hbn_task_struct* ht_struct, CnsBatch* batch, kstring_t* buf)
+{
+    struct timeval begin, end;
+    double wait_time = 0.0;
+    pthread_mutex_lock(&ht_struct->batch_lock);
+    while (batch->num_written < batch->cns_info_count) {
+        int i = batch->num_written;
+        if (!batch->cns_info_array[i].finished) {
+            gettimeofday(&begin, NULL);
+            pthread_cond_wait(&ht_struct->batch_cond, &ht_struct->batch_lock);
+            gettimeofday(&end, NULL);
+            wait_time += hbn_time_diff(&begin, &end);
+            continue;
+        }
+        /// the output buffer grows while we write, copy out the finished reads
+        ks_clear(*buf);
+        for (; i < batch->cns_info_count && batch->cns_info_array[i].finished; ++i) {
+            RawReadCnsInfo* cns_info = batch->cns_info_array + i;
+            if (cns_info->cns_fasta_size == 0) continue;
+            hbn_assert(cns_info->cns_fasta_offset < ks_size(batch->output_buf));
+            kputsn(ks_s(batch->output_buf) + cns_info->cns_fasta_offset, cns_info->cns_fasta_size, buf);
+        }
+        batch->num_written = i;
+        pthread_mutex_unlock(&ht_struct->batch_lock);
+        if (ks_size(*buf)) hbn_fwrite(ks_s(*buf), 1, ks_size(*buf), ht_struct->out);
+        pthread_mutex_lock(&ht_struct->batch_lock);
+    }
+    pthread_mutex_unlock(&ht_struct->batch_lock);
+
+    char buf1[64];
+    char buf2[64];
+    int min_subject_id = batch->cns_info_array[0].oid;
+    int max_subject_id = batch->cns_info_array[batch->cns_info_count-1].oid + 1;
+    u64_to_fixed_width_string_r(min_subject_id, buf1, HBN_DIGIT_WIDTH);
+    u64_to_fixed_width_string_r(max_subject_id, buf2, HBN_DIGIT_WIDTH);
+    gettimeofday(&end, NULL);
+    HBN_LOG("subject %s --- %s corrected in %.2fs", buf1, buf2, hbn_time_diff(&batch->load_time, &end));
+    return wait_time;
+}
+
 void
 cns_one_part(hbn_task_struct* ht_struct, const int pid)
 {
     hbn_task_struct_load_partition_info(ht_struct, pid);
     const int num_threads = ht_struct->opts->num_threads;
     pthread_t jobid_array[num_threads];
-    char job_name[1000];
     char buf1[64];
-    char buf2[64];
-    while (hbn_task_struct_load_batch_info(ht_struct)) {
-        int min_subject_id = ht_struct->cns_info_array[0].oid;
-        int max_subject_id = ht_struct->cns_info_array[ht_struct->cns_info_count-1].oid + 1;
-        u64_to_fixed_width_string_r(min_subject_id, buf1, HBN_DIGIT_WIDTH);
-        u64_to_fixed_width_string_r(max_subject_id, buf2, HBN_DIGIT_WIDTH);
-        sprintf(job_name, "correcting subject %s --- %s", buf1, buf2);
-        hbn_timing_begin(job_name);
-        for (int i = 0; i < num_threads; ++i) {
-            pthread_create(jobid_array + i, NULL, cns_thread_worker, ht_struct->thread_data_array[i]);
-        }
-        for (int i = 0; i < num_threads; ++i) {
-            pthread_join(jobid_array[i], NULL);
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(jobid_array + i, NULL, cns_thread_worker, ht_struct->thread_data_array[i]);
+    }
+
+    kstring_t write_buf; ks_init(write_buf);
+    struct timeval begin, end;
+    double load_time = 0.0, wait_time = 0.0;
+    int num_written_batches = 0;
+    while (1) {
+        if (!ht_struct->all_batches_loaded
+            &&
+            ht_struct->num_loaded_batches - num_written_batches < CNS_NUM_BATCH_SLOTS) {
+            /// the slot is free: every read of the batch it held has been written.
+            /// Keep the workers, which may not have noticed yet that this batch
+            /// was used up, off the slot while it is loaded.
+            pthread_mutex_lock(&ht_struct->batch_lock);
+            ht_struct->worker_batch_idx = hbn_max(ht_struct->worker_batch_idx,
+                                            ht_struct->num_loaded_batches - CNS_NUM_BATCH_SLOTS + 1);
+            pthread_mutex_unlock(&ht_struct->batch_lock);
+            CnsBatch* batch = batch_slot(ht_struct, ht_struct->num_loaded_batches);
+            gettimeofday(&begin, NULL);
+            BOOL r = hbn_task_struct_load_batch_info(ht_struct, batch);
+            gettimeofday(&end, NULL);
+            load_time += hbn_time_diff(&begin, &end);
+            batch->load_time = end;
+            pthread_mutex_lock(&ht_struct->batch_lock);
+            if (r) {
+                ++ht_struct->num_loaded_batches;
+            } else {
+                ht_struct->all_batches_loaded = TRUE;
+            }
+            pthread_cond_broadcast(&ht_struct->batch_cond);
+            pthread_mutex_unlock(&ht_struct->batch_lock);
+            continue;
         }
-        hbn_task_struct_dump_results(ht_struct);
-        hbn_timing_end(job_name);
-        //break;
+        if (num_written_batches == ht_struct->num_loaded_batches) break;
+        wait_time += write_one_batch(ht_struct, batch_slot(ht_struct, num_written_batches), &write_buf);
+        ++num_written_batches;
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(jobid_array[i], NULL);
+    }
+    ks_destroy(write_buf);
+    HBN_LOG("%d batches, loading reads took %.2fs, waited %.2fs for the workers",
+        num_written_batches, load_time, wait_time);
+    for (int i = 0; i < num_threads; ++i) {
+        HBN_LOG("thread %3d: peak alignment memory %s",
+            i, u64_to_string_datasize(DiffGapAlignDataMemSize(ht_struct->thread_data_array[i]->diff_data), buf1));
     }
-}
\ No newline at end of file
+}
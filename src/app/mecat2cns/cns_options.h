@@ -16,6 +16,7 @@ typedef struct {
     int     num_nodes;
     int     batch_size;
     int     use_batch_mode;
+    int     use_mmap;
     double  ovlp_cov_perc;
     int     ovlp_cov_res;
     double  perc_identity;
@@ -8,20 +8,18 @@ hbn_task_struct_new(const HbnProgramOptions* opts)
 {
     hbn_task_struct* ht_struct = (hbn_task_struct*)calloc(1, sizeof(hbn_task_struct));
     ht_struct->opts = opts;
-    ht_struct->raw_reads = RawReadsReaderNew(opts->db_dir, opts->db_title, opts->use_batch_mode);
-    ht_struct->cns_info_array = (RawReadCnsInfo*)calloc(opts->batch_size, sizeof(RawReadCnsInfo));
-    pthread_mutex_init(&ht_struct->cns_info_lock, NULL);
-    ks_init(ht_struct->output_buf);
-    pthread_mutex_init(&ht_struct->out_lock, NULL);
+    ht_struct->raw_reads = RawReadsReaderNew(opts->db_dir, opts->db_title, opts->use_batch_mode, opts->use_mmap);
+    for (int i = 0; i < CNS_NUM_BATCH_SLOTS; ++i) {
+        CnsBatch* batch = ht_struct->batch_array + i;
+        batch->raw_reads = RawReadsReaderNewBatchBuffer(ht_struct->raw_reads);
+        batch->cns_info_array = (RawReadCnsInfo*)calloc(opts->batch_size, sizeof(RawReadCnsInfo));
+        ks_init(batch->output_buf);
+    }
+    pthread_mutex_init(&ht_struct->batch_lock, NULL);
+    pthread_cond_init(&ht_struct->batch_cond, NULL);
     ht_struct->thread_data_array = (CnsThreadData**)calloc(opts->num_threads, sizeof(CnsThreadData*));
     for (int i = 0; i < opts->num_threads; ++i) {
-        ht_struct->thread_data_array[i] = CnsThreadDataNew(opts,
-                                                ht_struct->raw_reads,
-                                                ht_struct->cns_info_array,
-                                                &ht_struct->cns_info_idx,
-                                                &ht_struct->cns_info_lock,
-                                                &ht_struct->output_buf,
-                                                &ht_struct->out_lock);
+        ht_struct->thread_data_array[i] = CnsThreadDataNew(opts, ht_struct, &ht_struct->batch_lock);
     }
     return ht_struct;
 }
@@ -29,9 +27,15 @@ hbn_task_struct_new(const HbnProgramOptions* opts)
 hbn_task_struct*
 hbn_task_struct_free(hbn_task_struct* ht_struct)
 {
+    for (int i = 0; i < CNS_NUM_BATCH_SLOTS; ++i) {
+        CnsBatch* batch = ht_struct->batch_array + i;
+        RawReadsReaderFree(batch->raw_reads);
+        free(batch->cns_info_array);
+        ks_destroy(batch->output_buf);
+    }
     RawReadsReaderFree(ht_struct->raw_reads);
-    free(ht_struct->cns_info_array);
-    ks_destroy(ht_struct->output_buf);
+    pthread_mutex_destroy(&ht_struct->batch_lock);
+    pthread_cond_destroy(&ht_struct->batch_cond);
     for (int i = 0; i < ht_struct->opts->num_threads; ++i) {
         ht_struct->thread_data_array[i] = CnsThreadDataFree(ht_struct->thread_data_array[i]);
     }
@@ -51,6 +55,9 @@ hbn_task_struct_load_partition_info(hbn_task_struct* ht_struct, const int pid)
         &ht_struct->cns_hit_count);
     ht_struct->cns_hit_idx = 0;
     ht_struct->pid = pid;
+    ht_struct->num_loaded_batches = 0;
+    ht_struct->all_batches_loaded = FALSE;
+    ht_struct->worker_batch_idx = 0;
     for (int i = 0; i < ht_struct->opts->num_threads; ++i) {
         ht_struct->thread_data_array[i]->cns_hit_array = ht_struct->cns_hit_array;
         ht_struct->thread_data_array[i]->cns_hit_count = ht_struct->cns_hit_count;
@@ -67,33 +74,19 @@ hbn_task_struct_load_partition_info(hbn_task_struct* ht_struct, const int pid)
 }
 
 BOOL
-hbn_task_struct_load_batch_info(hbn_task_struct* ht_struct)
+hbn_task_struct_load_batch_info(hbn_task_struct* ht_struct, CnsBatch* batch)
 {
-    BOOL r = set_next_raw_read_batch_info(ht_struct->cns_info_array,
-                &ht_struct->cns_info_count,
+    BOOL r = set_next_raw_read_batch_info(batch->cns_info_array,
+                &batch->cns_info_count,
                 ht_struct->cns_hit_array,
                 ht_struct->cns_hit_count,
                 &ht_struct->cns_hit_idx,
-                ht_struct->raw_reads,
+                batch->raw_reads,
                 ht_struct->opts->batch_size);
 
     if (!r) return r;
-    ht_struct->cns_info_idx = 0;
-    for (int i = 0; i < ht_struct->opts->num_threads; ++i) {
-        ht_struct->thread_data_array[i]->cns_info_count = ht_struct->cns_info_count;
-    }
+    batch->cns_info_idx = 0;
+    batch->num_written = 0;
+    ks_clear(batch->output_buf);
     return TRUE;
 }
-
-void
-hbn_task_struct_dump_results(hbn_task_struct* ht_struct)
-{
-    for (int i = 0; i < ht_struct->cns_info_count; ++i) {
-        RawReadCnsInfo* cns_info = ht_struct->cns_info_array + i;
-        if (cns_info->cns_fasta_size == 0) continue;
-        hbn_assert(cns_info->cns_fasta_offset < ks_size(ht_struct->output_buf));
-        const char* s = ks_s(ht_struct->output_buf) + cns_info->cns_fasta_offset;
-        hbn_fwrite(s, 1, cns_info->cns_fasta_size, ht_struct->out);
-    }
-    ks_clear(ht_struct->output_buf);
-}
\ No newline at end of file
@@ -9,19 +9,37 @@
 extern "C" {
 #endif
 
+/// the next batch is loaded while the previous one is corrected
+#define CNS_NUM_BATCH_SLOTS 2
+
 typedef struct {
+    RawReadsReader* raw_reads;
+    RawReadCnsInfo* cns_info_array;
+    int cns_info_count;
+    /// the next read handed to a worker
+    int cns_info_idx;
+    /// reads [0, num_written) are in the output file
+    int num_written;
+    kstring_t output_buf;
+    struct timeval load_time;
+} CnsBatch;
+
+typedef struct hbn_task_struct {
     const HbnProgramOptions* opts;
     int pid;
     HbnConsensusInitHit* cns_hit_array;
     size_t cns_hit_count;
     size_t cns_hit_idx;
     RawReadsReader* raw_reads;
-    RawReadCnsInfo* cns_info_array;
-    int cns_info_count;
-    int cns_info_idx;
-    pthread_mutex_t cns_info_lock;
-    kstring_t output_buf;
-    pthread_mutex_t out_lock;
+    /// batch i of the partition is in batch_array[i % CNS_NUM_BATCH_SLOTS]
+    CnsBatch batch_array[CNS_NUM_BATCH_SLOTS];
+    int num_loaded_batches;
+    BOOL all_batches_loaded;
+    /// the batch the workers take reads from
+    int worker_batch_idx;
+    /// guards the batches and the output buffers
+    pthread_mutex_t batch_lock;
+    pthread_cond_t batch_cond;
     FILE* out;
     CnsThreadData** thread_data_array;
 } hbn_task_struct;
@@ -35,11 +53,10 @@ hbn_task_struct_free(hbn_task_struct* ht_struct);
 void
 hbn_task_struct_load_partition_info(hbn_task_struct* ht_struct, const int pid);
 
+/// loads the next batch of the partition and its raw reads into batch,
+/// which must not be in use by the workers
 BOOL
-hbn_task_struct_load_batch_info(hbn_task_struct* ht_struct);
-
-void
-hbn_task_struct_dump_results(hbn_task_struct* ht_struct);
+hbn_task_struct_load_batch_info(hbn_task_struct* ht_struct, CnsBatch* batch);
 
 #ifdef __cplusplus
 }
@@ -1,9 +1,45 @@
 #include "raw_reads_reader.h"
 
+#include "../../corelib/unpack_pac.h"
 #include "../../ncbi_blast/c_ncbi_blast_aux.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// in batch mode, needed reads closer than this are prefetched as one range
+#define PAC_PREFETCH_MERGE_GAP  (64 * 1024)
+
+static void
+map_packed_seq(RawReadsReader* reader)
+{
+    char path[HBN_MAX_PATH_LEN];
+    make_packed_seq_path(reader->db_dir, reader->db_title, path);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) HBN_ERR("fail to open %s: %s", path, strerror(errno));
+    struct stat sbuf;
+    if (fstat(fd, &sbuf) == -1) HBN_ERR("fail to stat %s: %s", path, strerror(errno));
+    const size_t num_bytes = (reader->dbinfo.seq_offset_to + 3) / 4;
+    if ((size_t)sbuf.st_size < num_bytes) {
+        HBN_ERR("%s is truncated: %zu bytes are expected but it has %zu",
+            path, num_bytes, (size_t)sbuf.st_size);
+    }
+    reader->pac_map_size = sbuf.st_size;
+    void* addr = mmap(NULL, reader->pac_map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) HBN_ERR("fail to map %s: %s", path, strerror(errno));
+    reader->pac_map = (u8*)(addr);
+    reader->packed_seq = reader->pac_map;
+    /// in batch mode only the reads of the current batch are touched and
+    /// they are prefetched explicitly, readahead would only pull in pages
+    /// of reads that are not needed
+    madvise(addr, reader->pac_map_size, reader->use_batch_mode ? MADV_RANDOM : MADV_WILLNEED);
+}
+
 RawReadsReader*
-RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch_mode)
+RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch_mode, const BOOL use_mmap)
 {
     RawReadsReader* reader = (RawReadsReader*)calloc(1, sizeof(RawReadsReader));
     reader->db_dir = db_dir;
@@ -16,7 +52,10 @@ RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch
     reader->seqinfo_array = load_seq_infos(db_dir, db_title, 0, reader->dbinfo.num_seqs);
     reader->raw_reads_offset_array = NULL;
     reader->use_batch_mode = use_batch_mode;
-    if (!use_batch_mode) {
+    if (use_mmap) {
+        map_packed_seq(reader);
+        if (use_batch_mode) reader->raw_reads_offset_array = (size_t*)malloc(sizeof(size_t) * reader->dbinfo.num_seqs);
+    } else if (!use_batch_mode) {
         reader->packed_seq = seqdb_load_pac(db_dir, db_title, 0, reader->dbinfo.seq_offset_to);
         reader->pac_stream = NULL;
     } else {
@@ -28,28 +67,52 @@ RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch
     return reader;
 }
 
+RawReadsReader*
+RawReadsReaderNewBatchBuffer(const RawReadsReader* reader)
+{
+    RawReadsReader* buffer = (RawReadsReader*)calloc(1, sizeof(RawReadsReader));
+    memcpy(buffer, reader, sizeof(RawReadsReader));
+    buffer->is_batch_buffer = TRUE;
+    if (reader->use_batch_mode) {
+        if (!reader->pac_map) buffer->packed_seq = NULL;
+        buffer->raw_reads_offset_array = (size_t*)malloc(sizeof(size_t) * reader->dbinfo.num_seqs);
+    }
+    return buffer;
+}
+
 RawReadsReader*
 RawReadsReaderFree(RawReadsReader* reader)
 {
     if (!reader) return NULL;
+    if (reader->is_batch_buffer) {
+        if (reader->use_batch_mode) {
+            if (reader->raw_reads_offset_array) sfree(reader->raw_reads_offset_array);
+            if (reader->packed_seq && !reader->pac_map) sfree(reader->packed_seq);
+        }
+        sfree(reader);
+        return NULL;
+    }
     if (reader->seq_names) sfree(reader->seq_names);
     if (reader->seqinfo_array) sfree(reader->seqinfo_array);
     if (reader->raw_reads_offset_array) sfree(reader->raw_reads_offset_array);
-    if (reader->packed_seq) sfree(reader->packed_seq);
+    if (reader->pac_map) {
+        munmap(reader->pac_map, reader->pac_map_size);
+    } else if (reader->packed_seq) {
+        sfree(reader->packed_seq);
+    }
     if (reader->pac_stream) hbn_fclose(reader->pac_stream);
     sfree(reader);
     return NULL;
 }
 
-void
-RawReadsReaderLoadRawReads(const HbnConsensusInitHit* cns_hit_array, 
+/// marks the templates and the supporting reads of the batch with 1 in
+/// raw_reads_offset_array, returns their number of residues, each rounded
+/// up to whole bytes
+static size_t
+mark_batch_raw_reads(const HbnConsensusInitHit* cns_hit_array,
     const size_t cns_hit_count,
     RawReadsReader* reader)
 {
-    if (!reader->use_batch_mode) return;
-    if (reader->packed_seq) sfree(reader->packed_seq);
-    hbn_assert(reader->raw_reads_offset_array);
-
     memset(reader->raw_reads_offset_array, 0, sizeof(size_t) * reader->dbinfo.num_seqs);
     size_t num_res = 0;
     int min_template_id = cns_hit_array[0].sid;
@@ -72,7 +135,67 @@ RawReadsReaderLoadRawReads(const HbnConsensusInitHit* cns_hit_array,
         num_res += s;
     }
     hbn_assert((num_res % 4) == 0);
+    return num_res;
+}
 
+/// The reads stay in the mapping. Walking the reads by id walks the file
+/// from front to back, so the byte ranges of the needed reads come out
+/// sorted; nearby ranges are merged and every merged range is handed to
+/// the kernel once, so the batch is read with a few large requests instead
+/// of one seek per read.
+static void
+prefetch_raw_reads(const HbnConsensusInitHit* cns_hit_array,
+    const size_t cns_hit_count,
+    RawReadsReader* reader)
+{
+    mark_batch_raw_reads(cns_hit_array, cns_hit_count, reader);
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t range_from = 0, range_to = 0;
+    int loaded_seqs = 0, num_ranges = 0;
+    size_t loaded_res = 0, prefetched_bytes = 0;
+    for (int i = 0; i <= reader->dbinfo.num_seqs; ++i) {
+        /// i == num_seqs flushes the last range
+        size_t from = reader->pac_map_size + PAC_PREFETCH_MERGE_GAP + 1, to = from;
+        if (i < reader->dbinfo.num_seqs) {
+            if (!reader->raw_reads_offset_array[i]) continue;
+            const size_t res_from = reader->seqinfo_array[i].seq_offset;
+            const size_t res_cnt = reader->seqinfo_array[i].seq_size;
+            hbn_assert((res_from % 4) == 0);
+            reader->raw_reads_offset_array[i] = res_from + 1;
+            ++loaded_seqs;
+            loaded_res += res_cnt;
+            from = res_from / 4;
+            to = (res_from + res_cnt + 3) / 4;
+        }
+        if (range_to > range_from && from > range_to + PAC_PREFETCH_MERGE_GAP) {
+            const size_t page_from = range_from / page_size * page_size;
+            madvise(reader->pac_map + page_from, range_to - page_from, MADV_WILLNEED);
+            prefetched_bytes += range_to - page_from;
+            ++num_ranges;
+            range_from = range_to = 0;
+        }
+        if (range_to == range_from) range_from = from;
+        range_to = hbn_max(range_to, to);
+    }
+
+    HBN_LOG("map %d sequences, %zu residues, prefetch %zu bytes in %d ranges",
+        loaded_seqs, loaded_res, prefetched_bytes, num_ranges);
+}
+
+void
+RawReadsReaderLoadRawReads(const HbnConsensusInitHit* cns_hit_array,
+    const size_t cns_hit_count,
+    RawReadsReader* reader)
+{
+    if (!reader->use_batch_mode) return;
+    hbn_assert(reader->raw_reads_offset_array);
+    if (reader->pac_map) {
+        prefetch_raw_reads(cns_hit_array, cns_hit_count, reader);
+        return;
+    }
+    if (reader->packed_seq) sfree(reader->packed_seq);
+
+    size_t num_res = mark_batch_raw_reads(cns_hit_array, cns_hit_count, reader);
     size_t num_bytes = num_res / 4;
     reader->packed_seq = (u8*)calloc(num_bytes, 1);
     size_t bytes_idx = 0;
@@ -103,35 +226,22 @@ RawReadsReaderExtractRead(RawReadsReader* reader, int id, int strand, vec_u8* se
 {
     hbn_assert(id < reader->dbinfo.num_seqs);
     hbn_assert(strand == FWD || strand == REV);
-    size_t res_from, res_to, res_cnt;
+    size_t res_from, res_cnt;
     if (!reader->use_batch_mode) {
         hbn_assert(reader->raw_reads_offset_array == NULL);
         res_from = reader->seqinfo_array[id].seq_offset;
         res_cnt = reader->seqinfo_array[id].seq_size;
-        res_to = res_from + res_cnt;
     } else {
         hbn_assert(reader->raw_reads_offset_array[id] > 0, "id = %d", id);
         res_from = reader->raw_reads_offset_array[id] - 1;
         res_cnt = reader->seqinfo_array[id].seq_size;
-        res_to = res_from + res_cnt;
     }
     hbn_assert((res_from % 4) == 0);
 
     kv_resize(u8, *seqv, res_cnt);
-    int pos = 0;
     if (strand == FWD) {
-        for (size_t i = res_from; i < res_to; ++i) {
-            u8 c = _get_pac(reader->packed_seq, i);
-            kv_A(*seqv, pos) = c;
-            ++pos;
-        }
+        unpack_pac_fwd(reader->packed_seq, res_from, res_cnt, kv_data(*seqv));
     } else {
-        size_t i = res_to;
-        while (i > res_from) {
-            --i;
-            u8 c = _get_pac(reader->packed_seq, i);
-            kv_A(*seqv, pos) = 3 - c;
-            ++pos;
-        }
+        unpack_pac_rev(reader->packed_seq, res_from, res_cnt, kv_data(*seqv));
     }
-}
\ No newline at end of file
+}
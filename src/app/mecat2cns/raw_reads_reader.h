@@ -18,6 +18,12 @@ typedef struct {
     u8* packed_seq;
     BOOL use_batch_mode;
     size_t* raw_reads_offset_array;
+    /// the packed sequence file mapped into memory, packed_seq points
+    /// into it and nothing is copied in batch mode
+    u8* pac_map;
+    size_t pac_map_size;
+    /// sequence names, infos and the pac stream belong to another reader
+    BOOL is_batch_buffer;
 } RawReadsReader;
 
 void
@@ -32,7 +38,13 @@ RawReadsReader*
 RawReadsReaderFree(RawReadsReader* reader);
 
 RawReadsReader*
-RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch_mode);
+RawReadsReaderNew(const char* db_dir, const char* db_title, const BOOL use_batch_mode, const BOOL use_mmap);
+
+/// A reader sharing everything of reader but the loaded reads, so that one
+/// batch of reads can be loaded while another one is in use. Batches must
+/// not be loaded concurrently as the pac stream is shared.
+RawReadsReader*
+RawReadsReaderNewBatchBuffer(const RawReadsReader* reader);
 
 #ifdef __cplusplus
 }
@@ -60,7 +60,8 @@ int main(int argc, char* argv[])
         0,
         INT32_MAX,
         kVolSize,
-        FALSE);
+        FALSE,
+        1);
 
     const int num_seqs = seqdb_load_num_reads(seqdb_path, INIT_QUERY_DB_TITLE);
     CSeqInfo* seqinfo_array = load_seq_infos(seqdb_path, INIT_QUERY_DB_TITLE, 0, num_seqs);
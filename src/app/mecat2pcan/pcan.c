@@ -15,12 +15,14 @@ static const HbnAppInfo sAppInfo = {
 typedef struct {
     int part_size;
     int part_count;
+    int mem_size;
     int num_threads;
 } PartCnsHitOptions;
 
 static const PartCnsHitOptions init_pcan_opts = {
     .part_size = 100000,
     .part_count = 100,
+    .mem_size = 2048,
     .num_threads = 1,
 };
 
@@ -42,10 +44,12 @@ print_usage(const char* prog)
     fprintf(out, "    Number of reads in each part\n");
     fprintf(out, "    Default = '%d'\n", init_pcan_opts.part_size);
 
-    fprintf(out, "  -k <Integer, >0>\n");
-    fprintf(out, "    Number of parts processed at each round\n");
-    fprintf(out, "    (If <0, then it will be set to system limit value)\n");
-    fprintf(out, "    Default = '%d'\n", init_pcan_opts.part_count);
+    fprintf(out, "  -k <Integer>\n");
+    fprintf(out, "    Ignored, all parts are written in one pass (kept for old command lines)\n");
+
+    fprintf(out, "  -m <Integer, >0>\n");
+    fprintf(out, "    Memory (in MB) for buffering records before they are appended to the part files\n");
+    fprintf(out, "    Default = '%d'\n", init_pcan_opts.mem_size);
 
     fprintf(out, "  -t <Integer, >0>\n");
     fprintf(out, "    Number of CPU threads\n");
@@ -87,6 +91,14 @@ parse_cmd_args(int argc,
             continue;
         }   
 
+        if (strcmp(argv[i], "-m") == 0) {
+            if (validate_cmd_arg_cnt(__func__, argv[i], argc, i, 1) == eCmdArgParseError) return eCmdArgParseError;
+            if (parse_int_arg(__func__, argv[i], argv[i+1], &ix) == eCmdArgParseError) return eCmdArgParseError;
+            opts->mem_size = ix;
+            i += 2;
+            continue;
+        }   
+
         if (strcmp(argv[i], "-t") == 0) {
             if (validate_cmd_arg_cnt(__func__, argv[i], argc, i, 1) == eCmdArgParseError) return eCmdArgParseError;
             if (parse_int_arg(__func__, argv[i], argv[i+1], &ix) == eCmdArgParseError) return eCmdArgParseError;
@@ -109,7 +121,7 @@ parse_cmd_args(int argc,
     *cns_hits = argv[i+2];
 
     hbn_assert(opts->part_size > 0);
-    hbn_assert(opts->part_count > 0);
+    hbn_assert(opts->mem_size > 0);
     hbn_assert(opts->num_threads > 0);
     
     const int kMaxThreads = 8;
@@ -121,23 +133,9 @@ parse_cmd_args(int argc,
     return eCmdArgParseSuccess;
 }
 
-int cns_hit_qid(void* r)
+static inline void
+cns_hit_change_roles(const HbnConsensusInitHit* s, HbnConsensusInitHit* d)
 {
-    HbnConsensusInitHit* hit = (HbnConsensusInitHit*)(r);
-    return hit->qid;
-}
-
-int cns_hit_sid(void* r)
-{
-    HbnConsensusInitHit* hit = (HbnConsensusInitHit*)(r);
-    return hit->sid;
-}
-
-void cns_hit_change_roles(void* src, void* dst)
-{
-    HbnConsensusInitHit* s = (HbnConsensusInitHit*)(src);
-    HbnConsensusInitHit* d = (HbnConsensusInitHit*)(dst);
-
     d->qid = s->sid;
     d->qoff = s->soff;
     d->sid = s->qid;
@@ -146,31 +144,10 @@ void cns_hit_change_roles(void* src, void* dst)
     d->strand = s->strand;
 }
 
-void cns_hit_sort_by_sid(size_t n, void* a)
-{
-    HbnConsensusInitHit* hit_array = (HbnConsensusInitHit*)(a);
-    ks_introsort_cns_hit_sid_lt(n, hit_array);
-}
-
-void cns_hit_normalise_sdir(void* r)
-{
-}
+/// consensus hits carry no subject direction
+#define cns_hit_normalise_sdir(r)
 
-int
-fix_part_counts(int num_files) {
-    const int kMaxAllowedNumFiles = sysconf(_SC_OPEN_MAX) - 8;
-	if (num_files < 0) {
-		num_files = kMaxAllowedNumFiles;
-        HBN_LOG("Set value of argument '-k' to its maximal allowed value %d", num_files);
-	} else {
-        if (num_files > kMaxAllowedNumFiles) {
-            HBN_LOG("The value (%d) of argument '-k' exceeds the system limits, we reset it to %d", 
-                num_files, kMaxAllowedNumFiles);
-            num_files = kMaxAllowedNumFiles;
-        }
-    }
-	return num_files;
-}
+PART_RECORD_INIT(cns_hit, HbnConsensusInitHit, cns_hit_change_roles, cns_hit_normalise_sdir)
 
 static void
 make_pcan_wrk_dir(const char* path)
@@ -210,24 +187,17 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
     if (pcan_is_done(pcan_dir)) return 0;
-    opts.part_count = fix_part_counts(opts.part_count);
     make_pcan_wrk_dir(pcan_dir);
 
     const int num_reads = seqdb_load_num_reads(seqdb_dir, INIT_QUERY_DB_TITLE);
     const int num_parts = (num_reads + opts.part_size - 1) / opts.part_size;
     dump_partition_count(pcan_dir, NULL, num_parts);
-    part_record_main(pcan_dir,
+    part_record_main_cns_hit(pcan_dir,
         cns_hits,
         num_parts,
         opts.part_size,
         opts.num_threads,
-        opts.part_count,
-        sizeof(HbnConsensusInitHit),
-        cns_hit_qid,
-        cns_hit_sid,
-        cns_hit_change_roles,
-        cns_hit_normalise_sdir,
-        cns_hit_sort_by_sid);
+        U64_ONE * opts.mem_size * 1024 * 1024);
 
     pcan_make_done(pcan_dir);
     return EXIT_SUCCESS;
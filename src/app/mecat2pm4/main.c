@@ -17,12 +17,14 @@ static const HbnAppInfo sAppInfo = {
 typedef struct {
     int part_size;
     int part_count;
+    int mem_size;
     int num_threads;
 } PartCnsHitOptions;
 
 static const PartCnsHitOptions init_pcan_opts = {
     .part_size = 100000,
     .part_count = 100,
+    .mem_size = 2048,
     .num_threads = 1,
 };
 
@@ -44,10 +46,12 @@ print_usage(const char* prog)
     fprintf(out, "    Number of reads in each part\n");
     fprintf(out, "    Default = '%d'\n", init_pcan_opts.part_size);
 
-    fprintf(out, "  -k <Integer, >0>\n");
-    fprintf(out, "    Number of parts processed at each round\n");
-    fprintf(out, "    (If <0, then it will be set to system limit value)\n");
-    fprintf(out, "    Default = '%d'\n", init_pcan_opts.part_count);
+    fprintf(out, "  -k <Integer>\n");
+    fprintf(out, "    Ignored, all parts are written in one pass (kept for old command lines)\n");
+
+    fprintf(out, "  -m <Integer, >0>\n");
+    fprintf(out, "    Memory (in MB) for buffering records before they are appended to the part files\n");
+    fprintf(out, "    Default = '%d'\n", init_pcan_opts.mem_size);
 
     fprintf(out, "  -t <Integer, >0>\n");
     fprintf(out, "    Number of CPU threads\n");
@@ -89,6 +93,14 @@ parse_cmd_args(int argc,
             continue;
         }   
 
+        if (strcmp(argv[i], "-m") == 0) {
+            if (validate_cmd_arg_cnt(__func__, argv[i], argc, i, 1) == eCmdArgParseError) return eCmdArgParseError;
+            if (parse_int_arg(__func__, argv[i], argv[i+1], &ix) == eCmdArgParseError) return eCmdArgParseError;
+            opts->mem_size = ix;
+            i += 2;
+            continue;
+        }   
+
         if (strcmp(argv[i], "-t") == 0) {
             if (validate_cmd_arg_cnt(__func__, argv[i], argc, i, 1) == eCmdArgParseError) return eCmdArgParseError;
             if (parse_int_arg(__func__, argv[i], argv[i+1], &ix) == eCmdArgParseError) return eCmdArgParseError;
@@ -111,7 +123,7 @@ parse_cmd_args(int argc,
     *m4_path = argv[i+2];
 
     hbn_assert(opts->part_size > 0);
-    hbn_assert(opts->part_count > 0);
+    hbn_assert(opts->mem_size > 0);
     hbn_assert(opts->num_threads > 0);
     
     const int kMaxThreads = 8;
@@ -123,22 +135,9 @@ parse_cmd_args(int argc,
     return eCmdArgParseSuccess;
 }
 
-int m4_qid(void* r)
-{
-    return ((M4Record*)(r))->qid;
-}
-
-int m4_sid(void* r)
+static inline void
+change_m4_roles(const M4Record* min, M4Record* mout)
 {
-    return ((M4Record*)(r))->sid;
-}
-
-void
-change_m4_roles(void* src, void* dst)
-{
-    M4Record* min = (M4Record*)(src);
-    M4Record* mout = (M4Record*)(dst);
-    
     mout->qid = min->sid;
     mout->qdir = min->sdir;
     mout->qoff = min->soff;
@@ -153,37 +152,16 @@ change_m4_roles(void* src, void* dst)
     mout->score = min->score;
 }
 
-void 
-normalise_m4_sdir(void* r)
+static inline void
+normalise_m4_sdir(M4Record* m)
 {
-    M4Record* m = (M4Record*)(r);
     if (m->sdir == REV) {
         m->sdir = FWD;
         m->qdir = 1 - m->qdir;
     }
 }
 
-void
-sort_m4_by_sid(size_t n, void* a)
-{
-    ks_introsort_m4_sid_lt(n, (M4Record*)(a));
-}
-
-int
-fix_part_counts(int num_files) {
-    const int kMaxAllowedNumFiles = sysconf(_SC_OPEN_MAX) - 8;
-	if (num_files < 0) {
-		num_files = kMaxAllowedNumFiles;
-        HBN_LOG("Set value of argument '-k' to its maximal allowed value %d", num_files);
-	} else {
-        if (num_files > kMaxAllowedNumFiles) {
-            HBN_LOG("The value (%d) of argument '-k' exceeds the system limits, we reset it to %d", 
-                num_files, kMaxAllowedNumFiles);
-            num_files = kMaxAllowedNumFiles;
-        }
-    }
-	return num_files;
-}
+PART_RECORD_INIT(m4, M4Record, change_m4_roles, normalise_m4_sdir)
 
 static void
 make_pm4_wrk_dir(const char* path)
@@ -223,24 +201,17 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
     if (pm4_is_done(pm4_dir)) return 0;
-    opts.part_count = fix_part_counts(opts.part_count);
     make_pm4_wrk_dir(pm4_dir);
 
     int num_reads = seqdb_load_num_reads(seqdb_dir, INIT_QUERY_DB_TITLE);
     int num_batches = (num_reads + opts.part_size - 1) / opts.part_size;
     dump_partition_count(pm4_dir, NULL, num_batches);
-    part_record_main(pm4_dir,
+    part_record_main_m4(pm4_dir,
         m4_path,
         num_batches,
         opts.part_size,
         opts.num_threads,
-        opts.part_count,
-        sizeof(M4Record),
-        m4_qid,
-        m4_sid,
-        change_m4_roles,
-        normalise_m4_sdir,
-        sort_m4_by_sid);
+        U64_ONE * opts.mem_size * 1024 * 1024);
     
     pm4_make_done(pm4_dir);
     return 0;
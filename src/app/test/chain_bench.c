@@ -0,0 +1,180 @@
+#include "test_app.h"
+
+#include "../../algo/chain_dp.h"
+#include "../../algo/hbn_lookup_table.h"
+#include "../../algo/word_finder.h"
+#include "../../corelib/build_db.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Times scoring_chain_seeds() at every simd level on the seed sets that
+/// find_best_kmer_match() sees while mapping real queries with the default
+/// mecat2map seeding, and checks that all levels give the same scores and
+/// predecessors. The seed sets are saved to BENCH_SEEDS_PATH so that later
+/// runs (or runs on another machine) can be fed the same sets.
+
+#define BENCH_DB_DIR            "chain_bench_db"
+#define BENCH_SEEDS_PATH        BENCH_DB_DIR "/chain_seeds.bin"
+#define BENCH_KMER_WINDOW       10
+#define BENCH_MAX_KMER_OCC      200
+#define BENCH_BLOCK_SIZE        2000
+#define BENCH_MIN_DDFS          3
+#define BENCH_ROUNDS            20
+
+static void
+collect_seed_sets(const char* subject_path,
+    const char* query_path,
+    const int kmer_size,
+    vec_chain_seed* seeds,
+    vec_int* seed_counts)
+{
+    if ((access(BENCH_DB_DIR, F_OK) != 0)
+        &&
+        (mkdir(BENCH_DB_DIR, S_IRWXU) != 0)) {
+        HBN_ERR("Failed to create directory %s: %s", BENCH_DB_DIR, strerror(errno));
+    }
+    build_db(subject_path, BENCH_DB_DIR, INIT_SUBJECT_DB_TITLE, 0, I32_MAX, U64_MAX, 0, 1);
+    build_db(query_path, BENCH_DB_DIR, INIT_QUERY_DB_TITLE, 0, I32_MAX, U64_MAX, 0, 1);
+    text_t* subjects = seqdb_load_unpacked(BENCH_DB_DIR, INIT_SUBJECT_DB_TITLE, 0);
+    text_t* queries = seqdb_load_unpacked(BENCH_DB_DIR, INIT_QUERY_DB_TITLE, 0);
+    LookupTable* lktbl = build_lookup_table(subjects, kmer_size, BENCH_KMER_WINDOW,
+                            eSeedFixed, BENCH_MAX_KMER_OCC, 1, eLktblKhash);
+    set_kmer_block_size_info(BENCH_BLOCK_SIZE);
+    WordFindData* word_data = WordFindDataNew(subjects, lktbl, kmer_size, 1, BENCH_MIN_DDFS, 0, eSeedFixed);
+    word_data->chain_data->dump_seeds = seeds;
+    word_data->chain_data->dump_seed_counts = seed_counts;
+
+    kv_dinit(vec_u8, rev_query);
+    kv_resize(IntPair, word_data->seeding_subseqs, 1);
+    for (int i = 0; i < seqdb_num_seqs(queries); ++i) {
+        const u8* fwd_query = queries->unpacked_seq + seqdb_seq_offset(queries, i);
+        const int query_size = seqdb_seq_size(queries, i);
+        kv_resize(u8, rev_query, query_size);
+        for (int k = 0; k < query_size; ++k) kv_A(rev_query, k) = 3 - fwd_query[query_size - 1 - k];
+        IntPair ip = { 0, query_size };
+        kv_front(word_data->seeding_subseqs) = ip;
+        kv_clear(word_data->init_hit_list);
+        ddfs_find_candidates(word_data, fwd_query, i, 0, FWD, query_size);
+        ddfs_find_candidates(word_data, kv_data(rev_query), i, 0, REV, query_size);
+    }
+
+    kv_destroy(rev_query);
+    WordFindDataFree(word_data);
+    destroy_lookup_table(lktbl);
+    CSeqDBFree(subjects);
+    CSeqDBFree(queries);
+
+    hbn_dfopen(out, BENCH_SEEDS_PATH, "wb");
+    size_t n = kv_size(*seed_counts);
+    hbn_fwrite(&n, sizeof(size_t), 1, out);
+    hbn_fwrite(kv_data(*seed_counts), sizeof(int), n, out);
+    n = kv_size(*seeds);
+    hbn_fwrite(&n, sizeof(size_t), 1, out);
+    hbn_fwrite(kv_data(*seeds), sizeof(ChainSeed), n, out);
+    hbn_fclose(out);
+    HBN_LOG("seed sets saved to %s", BENCH_SEEDS_PATH);
+}
+
+static void
+load_seed_sets(const char* path, vec_chain_seed* seeds, vec_int* seed_counts)
+{
+    hbn_dfopen(in, path, "rb");
+    size_t n = 0;
+    hbn_fread(&n, sizeof(size_t), 1, in);
+    kv_resize(int, *seed_counts, n);
+    hbn_fread(kv_data(*seed_counts), sizeof(int), n, in);
+    hbn_fread(&n, sizeof(size_t), 1, in);
+    kv_resize(ChainSeed, *seeds, n);
+    hbn_fread(kv_data(*seeds), sizeof(ChainSeed), n, in);
+    hbn_fclose(in);
+}
+
+/// scores every seed set BENCH_ROUNDS times, f, p and v of the first round
+/// are appended to results
+static double
+bench_one_level(ChainWorkData* data,
+    const vec_chain_seed* seeds,
+    const vec_int* seed_counts,
+    ESimdLevel level,
+    vec_int* results)
+{
+    hbn_set_simd_level(level);
+    struct timeval begin, end;
+    kv_clear(*results);
+    gettimeofday(&begin, NULL);
+    for (int r = 0; r < BENCH_ROUNDS; ++r) {
+        const ChainSeed* set = kv_data(*seeds);
+        for (size_t i = 0; i < kv_size(*seed_counts); ++i) {
+            const int n = kv_A(*seed_counts, i);
+            scoring_chain_seeds(data, set, n, FALSE);
+            if (r == 0) {
+                kv_push_v(int, *results, kv_data(data->f), n);
+                kv_push_v(int, *results, kv_data(data->p), n);
+                kv_push_v(int, *results, kv_data(data->v), n);
+            }
+            set += n;
+        }
+    }
+    gettimeofday(&end, NULL);
+    return hbn_time_diff(&begin, &end);
+}
+
+int chain_bench_main(int argc, char* argv[])
+{
+    if (argc != 2 && argc < 3) {
+        fprintf(stderr, "USAGE:\n");
+        fprintf(stderr, "  %s subject.fasta query.fasta [kmer_size]\n", argv[0]);
+        fprintf(stderr, "  %s chain_seeds.bin\n", argv[0]);
+        return 1;
+    }
+    kv_dinit(vec_chain_seed, seeds);
+    kv_dinit(vec_int, seed_counts);
+    if (argc == 2) {
+        load_seed_sets(argv[1], &seeds, &seed_counts);
+    } else {
+        const int kmer_size = (argc > 3) ? atoi(argv[3]) : 15;
+        collect_seed_sets(argv[1], argv[2], kmer_size, &seeds, &seed_counts);
+    }
+    if (kv_empty(seed_counts)) {
+        fprintf(stderr, "there are no seed sets to score\n");
+        return 0;
+    }
+
+    int max_n = 0;
+    size_t num_pairs = 0;
+    for (size_t i = 0; i < kv_size(seed_counts); ++i) {
+        const size_t n = kv_A(seed_counts, i);
+        max_n = hbn_max(max_n, (int)n);
+        num_pairs += n * (n - 1) / 2;
+    }
+    fprintf(stderr, "%zu seed sets, %zu seeds, at most %d seeds per set, %zu seed pairs\n",
+        kv_size(seed_counts), kv_size(seeds), max_n, num_pairs);
+
+    ChainWorkData* data = ChainWorkDataNew(BENCH_MIN_DDFS, 0);
+    kv_dinit(vec_int, scalar_results);
+    kv_dinit(vec_int, results);
+    const double scalar_time = bench_one_level(data, &seeds, &seed_counts, eSimdScalar, &scalar_results);
+    fprintf(stderr, "%-6s  %8.3fs\n", simd_level_names[eSimdScalar], scalar_time);
+    int num_diffs = 0;
+    /// the predecessor scan has no sse4.1 kernel
+    for (int level = eSimdAvx2; level <= hbn_detect_simd_level(); ++level) {
+        const double time = bench_one_level(data, &seeds, &seed_counts, level, &results);
+        const int same = kv_size(results) == kv_size(scalar_results)
+                         &&
+                         memcmp(kv_data(results), kv_data(scalar_results), sizeof(int) * kv_size(results)) == 0;
+        fprintf(stderr, "%-6s  %8.3fs  speedup %5.2f  %s\n",
+            simd_level_names[level], time, time > 0.0 ? scalar_time / time : 0.0,
+            same ? "identical" : "DIFFERENT");
+        num_diffs += !same;
+    }
+    hbn_set_simd_level(hbn_detect_simd_level());
+
+    ChainWorkDataFree(data);
+    kv_destroy(scalar_results);
+    kv_destroy(results);
+    kv_destroy(seeds);
+    kv_destroy(seed_counts);
+    return num_diffs ? 1 : 0;
+}
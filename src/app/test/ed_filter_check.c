@@ -0,0 +1,151 @@
+#include "test_app.h"
+
+#include "../../algo/bit_parallel_ed.h"
+#include "../../corelib/ksort.h"
+
+KSORT_INIT_GENERIC(double)
+
+/// Checks the scalar and the avx2 bit-parallel edit distance kernels
+/// against a plain dynamic programming on windows like the ones the
+/// mecat2map prefilter (-ed_filter_rate) sees, and prints the edit
+/// distance per base of related windows at several error rates next to
+/// that of unrelated windows to help choosing the filter threshold.
+
+#define ED_CHECK_SLACK_RATE 0.5
+
+static u32
+check_rand(u64* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return (u32)(*s >> 16);
+}
+
+static int
+naive_semi_global_edit_distance(const u8* pattern, const int m, const u8* text, const int n)
+{
+    int* col = (int*)malloc(sizeof(int) * (m + 1));
+    for (int i = 0; i <= m; ++i) col[i] = i;
+    int min_score = m;
+    for (int j = 0; j < n; ++j) {
+        int diag = col[0];
+        col[0] = 0;
+        for (int i = 1; i <= m; ++i) {
+            int s = diag + (pattern[i - 1] != text[j]);
+            s = hbn_min(s, col[i] + 1);
+            s = hbn_min(s, col[i - 1] + 1);
+            diag = col[i];
+            col[i] = s;
+        }
+        min_score = hbn_min(min_score, col[m]);
+    }
+    free(col);
+    return min_score;
+}
+
+/// text is random, pattern is text[slack, slack + size) with substitutions,
+/// insertions and deletions at rate err, or a random sequence if err < 0.
+static void
+make_check_window(u64* rng, const int size, const double err, vec_u8* pattern, vec_u8* text)
+{
+    const int slack = size * ED_CHECK_SLACK_RATE;
+    kv_clear(*pattern);
+    kv_clear(*text);
+    for (int i = 0; i < size + 2 * slack; ++i) kv_push(u8, *text, check_rand(rng) % 4);
+    for (int i = slack; i < slack + size && kv_size(*pattern) < BPED_MAX_PATTERN; ++i) {
+        const double r = (check_rand(rng) % 10000) / 10000.0;
+        const u8 c = (err < 0.0) ? check_rand(rng) % 4 : kv_A(*text, i);
+        if (r < err / 3) {
+            kv_push(u8, *pattern, (c + 1 + check_rand(rng) % 3) % 4);
+        } else if (r < err * 2 / 3) {
+            continue;
+        } else if (r < err) {
+            kv_push(u8, *pattern, check_rand(rng) % 4);
+            if (kv_size(*pattern) < BPED_MAX_PATTERN) kv_push(u8, *pattern, c);
+        } else {
+            kv_push(u8, *pattern, c);
+        }
+    }
+    if (kv_empty(*pattern)) kv_push(u8, *pattern, 0);
+}
+
+int ed_filter_check_main(int argc, char* argv[])
+{
+    const int num_windows = (argc > 1) ? atoi(argv[1]) : 1000;
+    u64 rng = (argc > 2) ? strtoull(argv[2], NULL, 10) : 1;
+    hbn_assert(num_windows > 0);
+    if (rng == 0) rng = 1;
+    const int has_avx2 = hbn_detect_simd_level() >= eSimdAvx2;
+    if (!has_avx2) fprintf(stderr, "the cpu does not support avx2, only the scalar kernel is checked\n");
+
+    const double err_list[] = { 0.10, 0.20, 0.30, 0.40, -1.0 };
+    const int num_errs = sizeof(err_list) / sizeof(err_list[0]);
+    kv_dinit(vec_u8, pattern);
+    kv_dinit(vec_u8, text);
+    double* rates = (double*)malloc(sizeof(double) * num_windows);
+    struct timeval begin, end;
+    int num_diffs = 0;
+
+    for (int e = 0; e < num_errs; ++e) {
+        double naive_time = 0.0, scalar_time = 0.0, avx2_time = 0.0;
+        for (int i = 0; i < num_windows; ++i) {
+            const int size = 64 + check_rand(&rng) % (BPED_MAX_PATTERN - 63);
+            make_check_window(&rng, size, err_list[e], &pattern, &text);
+            const u8* p = kv_data(pattern);
+            const int m = kv_size(pattern);
+            const u8* t = kv_data(text);
+            const int n = kv_size(text);
+
+            gettimeofday(&begin, NULL);
+            const int naive_ed = naive_semi_global_edit_distance(p, m, t, n);
+            gettimeofday(&end, NULL);
+            naive_time += hbn_time_diff(&begin, &end);
+
+            gettimeofday(&begin, NULL);
+            const int scalar_ed = semi_global_edit_distance_scalar(p, m, t, n);
+            gettimeofday(&end, NULL);
+            scalar_time += hbn_time_diff(&begin, &end);
+
+            int avx2_ed = naive_ed;
+            if (has_avx2) {
+                gettimeofday(&begin, NULL);
+                avx2_ed = semi_global_edit_distance_avx2(p, m, t, n);
+                gettimeofday(&end, NULL);
+                avx2_time += hbn_time_diff(&begin, &end);
+            }
+
+            if (scalar_ed != naive_ed || avx2_ed != naive_ed) {
+                if (num_diffs == 0) {
+                    HBN_WARN("window %d (%d x %d): naive = %d, scalar = %d, avx2 = %d",
+                        i, m, n, naive_ed, scalar_ed, avx2_ed);
+                }
+                ++num_diffs;
+            }
+            rates[i] = 1.0 * naive_ed / m;
+        }
+        ks_introsort_double(num_windows, rates);
+        char err_buf[64];
+        if (err_list[e] < 0.0) {
+            sprintf(err_buf, "unrelated");
+        } else {
+            sprintf(err_buf, "err %.2f", err_list[e]);
+        }
+        fprintf(stderr, "%-9s  edits per base: min %.3f  1%% %.3f  median %.3f  99%% %.3f  max %.3f"
+            "  naive %.3fs  scalar %.3fs  avx2 %.3fs\n",
+            err_buf, rates[0], rates[num_windows / 100], rates[num_windows / 2],
+            rates[num_windows - 1 - num_windows / 100], rates[num_windows - 1],
+            naive_time, scalar_time, avx2_time);
+    }
+
+    kv_destroy(pattern);
+    kv_destroy(text);
+    free(rates);
+
+    if (num_diffs) {
+        fprintf(stderr, "the bit-parallel kernels differ from the dynamic programming on %d windows\n", num_diffs);
+        return 1;
+    }
+    fprintf(stderr, "the bit-parallel kernels agree with the dynamic programming\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "test_app.h"
+
+#include "../../corelib/gz_reader.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+/// Writes BGZF files with data member counts around multiples of the
+/// chunk size of the reader (32 members) followed by the empty EOF member,
+/// and checks that HbnGzReader returns the original data with 0, 1 and 3
+/// inflate threads. A chunk holding only the EOF member once failed to
+/// inflate.
+
+#define GZ_CHECK_MEMBER_DATA    4096
+#define GZ_CHECK_BGZF_HEADER    18
+
+static u32
+check_rand(u64* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return (u32)(*s >> 16);
+}
+
+static void
+store_u16_le(u8* p, const u32 x)
+{
+    p[0] = x & 0xff;
+    p[1] = (x >> 8) & 0xff;
+}
+
+static void
+store_u32_le(u8* p, const u32 x)
+{
+    store_u16_le(p, x & 0xffff);
+    store_u16_le(p + 2, x >> 16);
+}
+
+/// one member as written by bgzip, size = 0 gives the standard 28-byte EOF member
+static void
+write_bgzf_member(FILE* out, const u8* data, const u32 size)
+{
+    u8 member[GZ_CHECK_BGZF_HEADER + 2 * GZ_CHECK_MEMBER_DATA + 8];
+    z_stream zs;
+    memset(&zs, 0, sizeof(z_stream));
+    if (deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) HBN_ERR("fail to initialise zlib");
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = size;
+    zs.next_out = member + GZ_CHECK_BGZF_HEADER;
+    zs.avail_out = sizeof(member) - GZ_CHECK_BGZF_HEADER - 8;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) HBN_ERR("fail to deflate a BGZF member");
+    const u32 comp_size = zs.total_out;
+    deflateEnd(&zs);
+
+    const u32 member_size = GZ_CHECK_BGZF_HEADER + comp_size + 8;
+    const u8 header[GZ_CHECK_BGZF_HEADER - 2] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0 };
+    memcpy(member, header, sizeof(header));
+    store_u16_le(member + GZ_CHECK_BGZF_HEADER - 2, member_size - 1);
+    store_u32_le(member + member_size - 8, crc32(crc32(0L, Z_NULL, 0), data, size));
+    store_u32_le(member + member_size - 4, size);
+    hbn_fwrite(member, 1, member_size, out);
+}
+
+static void
+make_check_data(u64* rng, const int num_members, vec_u8* data)
+{
+    kv_clear(*data);
+    for (int i = 0; i < num_members * GZ_CHECK_MEMBER_DATA; ++i) {
+        kv_push(u8, *data, (i % 80 == 79) ? '\n' : "ACGT"[check_rand(rng) % 4]);
+    }
+}
+
+static void
+write_bgzf_file(const char* path, const vec_u8* data)
+{
+    hbn_dfopen(out, path, "wb");
+    for (size_t i = 0; i < kv_size(*data); i += GZ_CHECK_MEMBER_DATA) {
+        write_bgzf_member(out, kv_data(*data) + i, hbn_min(kv_size(*data) - i, (size_t)GZ_CHECK_MEMBER_DATA));
+    }
+    write_bgzf_member(out, NULL, 0);
+    hbn_fclose(out);
+}
+
+/// reads in odd sized pieces so that the reads straddle the chunks
+static BOOL
+check_one_file(const char* path, const vec_u8* data, const int num_threads)
+{
+    HbnGzReader* reader = HbnGzReaderNew(path, num_threads);
+    u8 buffer[7919];
+    size_t pos = 0;
+    BOOL same = TRUE;
+    while (same) {
+        const size_t n = HbnGzReaderRead(reader, buffer, sizeof(buffer));
+        if (pos + n > kv_size(*data) || memcmp(buffer, kv_data(*data) + pos, n)) same = FALSE;
+        pos += n;
+        if (n < sizeof(buffer)) break;
+    }
+    if (pos != kv_size(*data) || !HbnGzReaderEof(reader)) same = FALSE;
+    HbnGzReaderFree(reader);
+    return same;
+}
+
+int gz_reader_check_main(int argc, char* argv[])
+{
+    const char* tmp_dir = (argc > 1) ? argv[1] : "/tmp";
+    char path[HBN_MAX_PATH_LEN];
+    sprintf(path, "%s/gz_reader_check_XXXXXX", tmp_dir);
+    int fd = mkstemp(path);
+    if (fd < 0) HBN_ERR("fail to create a temporary file in %s: %s", tmp_dir, strerror(errno));
+    close(fd);
+
+    const int num_members_list[] = { 0, 1, 31, 32, 33, 64, 96, 288 };
+    const int num_threads_list[] = { 0, 1, 3 };
+    kv_dinit(vec_u8, data);
+    u64 rng = 1;
+    int num_diffs = 0;
+    for (size_t i = 0; i < sizeof(num_members_list) / sizeof(num_members_list[0]); ++i) {
+        make_check_data(&rng, num_members_list[i], &data);
+        write_bgzf_file(path, &data);
+        hbn_assert(num_members_list[i] == 0 || hbn_gz_file_is_bgzf(path));
+        for (size_t j = 0; j < sizeof(num_threads_list) / sizeof(num_threads_list[0]); ++j) {
+            const BOOL same = check_one_file(path, &data, num_threads_list[j]);
+            fprintf(stderr, "%3d members + EOF  %d threads  %s\n",
+                num_members_list[i], num_threads_list[j], same ? "ok" : "DIFFERS");
+            if (!same) ++num_diffs;
+        }
+    }
+    kv_destroy(data);
+    unlink(path);
+
+    if (num_diffs) {
+        fprintf(stderr, "the gz reader differs from the input on %d files\n", num_diffs);
+        return 1;
+    }
+    fprintf(stderr, "the gz reader returns the input of every file\n");
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "test_app.h"
+
+#include "../../algo/kmer_hash.h"
+#include "../../corelib/fasta.h"
+#include "../../corelib/line_reader.h"
+
+/// Compares the kmer extractor at every simd level with the naive
+/// per-kmer loop it replaces, on unpacked and on packed sequences.
+
+#define BENCH_ROUNDS 5
+
+typedef struct {
+    u8* unpacked_seq;
+    u8* packed_seq;
+    size_t* seq_offset_list;
+    size_t* seq_size_list;
+    int num_seqs;
+    size_t num_res;
+} BenchSeqs;
+
+static void
+load_bench_seqs(const char* path, BenchSeqs* seqs)
+{
+    kv_dinit(vec_u8, unpacked_seq);
+    kv_dinit(vec_size_t, seq_offset_list);
+    kv_dinit(vec_size_t, seq_size_list);
+    HbnFastaReader* reader = HbnFastaReaderNew(path);
+    while (!HbnLineReaderAtEof(reader->line_reader)) {
+        HbnFastaReaderReadOneSeq(reader);
+        const kstring_t* seq = HbnFastaReaderSequence(reader);
+        if (ks_empty(*seq)) continue;
+        /// sequences start at 4-aligned offsets as in a seqdb volume
+        while (kv_size(unpacked_seq) & 3) kv_push(u8, unpacked_seq, 0);
+        kv_push(size_t, seq_offset_list, kv_size(unpacked_seq));
+        kv_push(size_t, seq_size_list, ks_size(*seq));
+        for (size_t i = 0; i < ks_size(*seq); ++i) {
+            u8 c = nst_nt4_table[(u8)ks_A(*seq, i)];
+            kv_push(u8, unpacked_seq, c & 3);
+        }
+    }
+    HbnFastaReaderFree(reader);
+
+    seqs->num_seqs = kv_size(seq_size_list);
+    seqs->num_res = kv_size(unpacked_seq);
+    seqs->unpacked_seq = kv_data(unpacked_seq);
+    seqs->seq_offset_list = kv_data(seq_offset_list);
+    seqs->seq_size_list = kv_data(seq_size_list);
+    seqs->packed_seq = (u8*)calloc(seqs->num_res / 4 + 1, 1);
+    for (size_t i = 0; i < seqs->num_res; ++i) _set_pac(seqs->packed_seq, i, seqs->unpacked_seq[i]);
+}
+
+static void
+free_bench_seqs(BenchSeqs* seqs)
+{
+    free(seqs->unpacked_seq);
+    free(seqs->packed_seq);
+    free(seqs->seq_offset_list);
+    free(seqs->seq_size_list);
+}
+
+/// the loop of the former extract_hash_values()
+static size_t
+naive_extract(const u8* seq, const size_t seq_size, const int kmer_size, const int window_size, vec_u64* hash_list)
+{
+    kv_clear(*hash_list);
+    if (seq_size < kmer_size) return 0;
+    for (size_t j = 0; j <= seq_size - kmer_size; j += window_size) {
+        u64 hash = 0;
+        for (int k = 0; k < kmer_size; ++k) hash = (hash << 2) | seq[j + k];
+        kv_push(u64, *hash_list, hash);
+    }
+    return kv_size(*hash_list);
+}
+
+static void
+bench_one_config(const BenchSeqs* seqs, const int kmer_size, const int window_size, const char* mode)
+{
+    kv_dinit(vec_u64, words);
+    kv_dinit(vec_u64, hash_list);
+    kv_dinit(vec_u64, ref_hash_list);
+    size_t num_kmers = 0;
+    struct timeval begin, end;
+    /// round 0 checks the results and is not timed
+    for (int r = 0; r <= BENCH_ROUNDS; ++r) {
+        if (r == 1) gettimeofday(&begin, NULL);
+        for (int i = 0; i < seqs->num_seqs; ++i) {
+            const size_t offset = seqs->seq_offset_list[i];
+            const size_t size = seqs->seq_size_list[i];
+            size_t n = 0;
+            if (strcmp(mode, "naive") == 0) {
+                n = naive_extract(seqs->unpacked_seq + offset, size, kmer_size, window_size, &hash_list);
+            } else if (strcmp(mode, "unpacked") == 0) {
+                n = kmer_hash_extract_unpacked(seqs->unpacked_seq + offset, size, kmer_size, window_size, &words, &hash_list);
+            } else {
+                n = kmer_hash_extract_packed(seqs->packed_seq, offset, size, kmer_size, window_size, &words, &hash_list);
+            }
+            if (r) {
+                num_kmers += n;
+                continue;
+            }
+            naive_extract(seqs->unpacked_seq + offset, size, kmer_size, window_size, &ref_hash_list);
+            if (kv_size(hash_list) != kv_size(ref_hash_list)
+                ||
+                memcmp(kv_data(hash_list), kv_data(ref_hash_list), sizeof(u64) * kv_size(hash_list))) {
+                HBN_ERR("%s %s extractor differs from the naive one at sequence %d (k = %d, w = %d)",
+                    simd_level_names[hbn_get_simd_level()], mode, i, kmer_size, window_size);
+            }
+        }
+    }
+    gettimeofday(&end, NULL);
+    const double dur = hbn_time_diff(&begin, &end);
+    fprintf(stderr, "k = %2d  w = %2d  %-6s  %-8s  %8.2f Mbases/s  %8.2f Mkmers/s\n",
+        kmer_size, window_size,
+        strcmp(mode, "naive") ? simd_level_names[hbn_get_simd_level()] : "-",
+        mode,
+        dur > 0 ? seqs->num_res * BENCH_ROUNDS / dur / 1e6 : 0.0,
+        dur > 0 ? num_kmers / dur / 1e6 : 0.0);
+    kv_destroy(words);
+    kv_destroy(hash_list);
+    kv_destroy(ref_hash_list);
+}
+
+int kmer_bench_main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "USAGE:\n");
+        fprintf(stderr, "  %s seqs.fasta [kmer_size]\n", argv[0]);
+        return 1;
+    }
+    const int kmer_size = (argc > 2) ? atoi(argv[2]) : 15;
+    hbn_assert(kmer_size > 0 && kmer_size <= 32);
+    BenchSeqs seqs;
+    load_bench_seqs(argv[1], &seqs);
+    fprintf(stderr, "%d sequences, %zu residues, cpu supports %s\n",
+        seqs.num_seqs, seqs.num_res, simd_level_names[hbn_detect_simd_level()]);
+
+    const ESimdLevel max_level = hbn_detect_simd_level();
+    const int window_size_list[] = { 1, 10 };
+    for (int w = 0; w < 2; ++w) {
+        bench_one_config(&seqs, kmer_size, window_size_list[w], "naive");
+        for (int level = eSimdScalar; level <= max_level; ++level) {
+            hbn_set_simd_level(level);
+            bench_one_config(&seqs, kmer_size, window_size_list[w], "unpacked");
+            bench_one_config(&seqs, kmer_size, window_size_list[w], "packed");
+        }
+    }
+    hbn_set_simd_level(max_level);
+    free_bench_seqs(&seqs);
+    return 0;
+}
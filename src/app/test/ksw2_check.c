@@ -0,0 +1,199 @@
+#include "test_app.h"
+
+#include "../../algo/ksw2_wrapper.h"
+
+/// Runs the sse and the avx2 ksw2 kernels on the same random noisy pairs
+/// of sequences and checks that every field of the results, including the
+/// cigar, is identical. Also reports how long each kernel takes.
+
+#define KSW2_CHECK_ERR  0.15
+
+typedef struct {
+    u8* query;
+    int qlen;
+    u8* target;
+    int tlen;
+} Ksw2CheckPair;
+
+static u32
+check_rand(u64* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return (u32)(*s >> 16);
+}
+
+/// target is random, query is target with substitutions, insertions and
+/// deletions at rate err, as in noisy long reads. A few bases are N.
+static void
+make_check_pair(u64* rng, const int size, const double err, Ksw2CheckPair* pair)
+{
+    kv_dinit(vec_u8, target);
+    kv_dinit(vec_u8, query);
+    for (int i = 0; i < size; ++i) {
+        u8 c = (check_rand(rng) % 500 == 0) ? 4 : check_rand(rng) % 4;
+        kv_push(u8, target, c);
+    }
+    for (int i = 0; i < size; ++i) {
+        const double r = (check_rand(rng) % 10000) / 10000.0;
+        const u8 c = kv_A(target, i);
+        if (r < err / 3) {
+            kv_push(u8, query, (c + 1 + check_rand(rng) % 3) % 4);
+        } else if (r < err * 2 / 3) {
+            continue;
+        } else if (r < err) {
+            kv_push(u8, query, check_rand(rng) % 4);
+            kv_push(u8, query, c);
+        } else {
+            kv_push(u8, query, c);
+        }
+    }
+    if (kv_empty(query)) kv_push(u8, query, 0);
+    pair->query = kv_data(query);
+    pair->qlen = kv_size(query);
+    pair->target = kv_data(target);
+    pair->tlen = kv_size(target);
+}
+
+static int
+same_ksw_extz(const ksw_extz_t* a, const ksw_extz_t* b)
+{
+    return a->max == b->max
+           && a->zdropped == b->zdropped
+           && a->max_q == b->max_q
+           && a->max_t == b->max_t
+           && a->mqe == b->mqe
+           && a->mqe_t == b->mqe_t
+           && a->mte == b->mte
+           && a->mte_q == b->mte_q
+           && a->score == b->score
+           && a->reach_end == b->reach_end
+           && a->n_cigar == b->n_cigar
+           && (a->n_cigar == 0 || memcmp(a->cigar, b->cigar, sizeof(uint32_t) * a->n_cigar) == 0);
+}
+
+static void
+run_ksw2(const int extd, const Ksw2Data* data, const Ksw2CheckPair* pair, int w, int zdrop, int flag, ksw_extz_t* ez)
+{
+    memset(ez, 0, sizeof(ksw_extz_t));
+    if (extd) {
+        ksw2_extd2(NULL, pair->qlen, pair->query, pair->tlen, pair->target, 5, data->mat,
+            data->go, data->ge, data->go1, data->ge1, w, zdrop, data->end_bonus, flag, ez);
+    } else {
+        ksw2_extz2(NULL, pair->qlen, pair->query, pair->tlen, pair->target, 5, data->mat,
+            data->go, data->ge, w, zdrop, data->end_bonus, flag, ez);
+    }
+}
+
+/// returns the number of pairs on which the kernels differ
+static int
+check_one_config(const int extd,
+    const Ksw2Data* data,
+    const Ksw2CheckPair* pairs,
+    const int num_pairs,
+    const int w,
+    const int zdrop,
+    const int flag)
+{
+    ksw_extz_t* sse_results = (ksw_extz_t*)calloc(num_pairs, sizeof(ksw_extz_t));
+    ksw_extz_t ez;
+    struct timeval begin, end;
+    int num_diffs = 0;
+
+    hbn_set_simd_level(eSimdSse41);
+    gettimeofday(&begin, NULL);
+    for (int i = 0; i < num_pairs; ++i) run_ksw2(extd, data, pairs + i, w, zdrop, flag, sse_results + i);
+    gettimeofday(&end, NULL);
+    const double sse_time = hbn_time_diff(&begin, &end);
+
+    hbn_set_simd_level(eSimdAvx2);
+    double avx2_time = 0.0;
+    for (int i = 0; i < num_pairs; ++i) {
+        gettimeofday(&begin, NULL);
+        run_ksw2(extd, data, pairs + i, w, zdrop, flag, &ez);
+        gettimeofday(&end, NULL);
+        avx2_time += hbn_time_diff(&begin, &end);
+        if (!same_ksw_extz(sse_results + i, &ez)) {
+            if (num_diffs == 0) {
+                HBN_WARN("pair %d (%d x %d): sse score = %d, max = %d, n_cigar = %d; avx2 score = %d, max = %d, n_cigar = %d",
+                    i, pairs[i].qlen, pairs[i].tlen,
+                    sse_results[i].score, sse_results[i].max, sse_results[i].n_cigar,
+                    ez.score, ez.max, ez.n_cigar);
+            }
+            ++num_diffs;
+        }
+        free(ez.cigar);
+        free(sse_results[i].cigar);
+    }
+    free(sse_results);
+
+    fprintf(stderr, "%-5s  flag = 0x%02x  w = %5d  zdrop = %4d  sse %7.3fs  avx2 %7.3fs  speedup %5.2f  %s\n",
+        extd ? "extd2" : "extz2", flag, w, zdrop, sse_time, avx2_time,
+        avx2_time > 0 ? sse_time / avx2_time : 0.0,
+        num_diffs ? "DIFFERENT" : "identical");
+    return num_diffs;
+}
+
+int ksw2_check_main(int argc, char* argv[])
+{
+    const int num_pairs = (argc > 1) ? atoi(argv[1]) : 200;
+    const int max_size = (argc > 2) ? atoi(argv[2]) : 2000;
+    u64 rng = (argc > 3) ? strtoull(argv[3], NULL, 10) : 1;
+    hbn_assert(num_pairs > 0 && max_size > 0);
+    if (rng == 0) rng = 1;
+    if (hbn_detect_simd_level() < eSimdAvx2) {
+        fprintf(stderr, "the cpu does not support avx2, there is nothing to compare\n");
+        return 0;
+    }
+
+    Ksw2CheckPair* pairs = (Ksw2CheckPair*)calloc(num_pairs, sizeof(Ksw2CheckPair));
+    for (int i = 0; i < num_pairs; ++i) {
+        make_check_pair(&rng, 1 + check_rand(&rng) % max_size, KSW2_CHECK_ERR, pairs + i);
+    }
+
+    /// the parameters used by diff_gapalign and by nw_ksw2_extd2()
+    Ksw2Data* extz = Ksw2DataNew();
+    ksw2_set_params(extz, MATCH_REWARD, MISMATCH_PENALTY,
+        AMB_PENALTY, GAP_OPEN, GAP_EXTEND, KSW_ZDROP, KSW_BAND_WIDTH);
+    Ksw2Data* extd = Ksw2DataNew();
+    ksw2_extd2_set_params(extd);
+
+    const int flag_list[] = {
+        0,
+        KSW_EZ_RIGHT,
+        KSW_EZ_RIGHT | KSW_EZ_EXTZ_ONLY,
+        KSW_EZ_EXTZ_ONLY | KSW_EZ_REV_CIGAR,
+        KSW_EZ_SCORE_ONLY,
+        KSW_EZ_APPROX_MAX | KSW_EZ_APPROX_DROP,
+        KSW_EZ_GENERIC_SC,
+    };
+    const int band_width_list[] = { -1, 17, KSW_BAND_WIDTH, 500 };
+    const int num_flags = sizeof(flag_list) / sizeof(flag_list[0]);
+    const int num_band_widths = sizeof(band_width_list) / sizeof(band_width_list[0]);
+    int num_diffs = 0;
+    for (int i = 0; i < num_flags; ++i) {
+        for (int k = 0; k < num_band_widths; ++k) {
+            num_diffs += check_one_config(0, extz, pairs, num_pairs, band_width_list[k], extz->zdrop, flag_list[i]);
+            num_diffs += check_one_config(0, extz, pairs, num_pairs, band_width_list[k], -1, flag_list[i]);
+            num_diffs += check_one_config(1, extd, pairs, num_pairs, band_width_list[k], extd->zdrop, flag_list[i]);
+            num_diffs += check_one_config(1, extd, pairs, num_pairs, band_width_list[k], 400, flag_list[i]);
+        }
+    }
+    hbn_set_simd_level(hbn_detect_simd_level());
+
+    for (int i = 0; i < num_pairs; ++i) {
+        free(pairs[i].query);
+        free(pairs[i].target);
+    }
+    free(pairs);
+    Ksw2DataFree(extz);
+    Ksw2DataFree(extd);
+
+    if (num_diffs) {
+        fprintf(stderr, "the avx2 kernels differ from the sse kernels on %d alignments\n", num_diffs);
+        return 1;
+    }
+    fprintf(stderr, "the avx2 kernels agree with the sse kernels\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "test_app.h"
+
+#include "../../algo/hbn_lookup_table.h"
+#include "../../corelib/build_db.h"
+#include "../../corelib/cstr_util.h"
+#include "../../corelib/kvec.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Compares the seeding throughput of the lookup table backends. The
+/// subject is indexed with the default kmer window of mecat2map and every
+/// query kmer is probed the way collect_subseq_seeds() does. Every backend
+/// must return the seeds of the khash backend.
+
+#define BENCH_DB_DIR            "lktbl_bench_db"
+#define BENCH_KMER_WINDOW       10
+#define BENCH_PREFETCH_DISTANCE 8
+#define BENCH_ROUNDS            3
+
+static void
+extract_query_hashes(const text_t* queries, const int kmer_size, vec_u64* hash_list)
+{
+    const u64 kmer_mask = (kmer_size == 32) ? U64_MAX : ((U64_ONE << (kmer_size << 1)) - 1);
+    kv_clear(*hash_list);
+    for (int i = 0; i < seqdb_num_seqs(queries); ++i) {
+        const u8* seq = queries->unpacked_seq + seqdb_seq_offset(queries, i);
+        const int seq_size = seqdb_seq_size(queries, i);
+        u64 hash = 0;
+        for (int k = 0; k < seq_size; ++k) {
+            hash = ((hash << 2) | seq[k]) & kmer_mask;
+            if (k + 1 >= kmer_size) kv_push(u64, *hash_list, hash);
+        }
+    }
+}
+
+static void
+bench_one_backend(const text_t* subjects,
+    const vec_u64* hash_list,
+    const int kmer_size,
+    const int max_kmer_occ,
+    ELookupTableBackend backend,
+    size_t* seed_count,
+    size_t* seed_checksum)
+{
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
+    LookupTable* lktbl = build_lookup_table(subjects, kmer_size, BENCH_KMER_WINDOW, eSeedFixed, max_kmer_occ, 1, backend);
+    gettimeofday(&end, NULL);
+    const double build_time = hbn_time_diff(&begin, &end);
+
+    const u64* hash_array = kv_data(*hash_list);
+    const size_t hash_count = kv_size(*hash_list);
+    size_t num_seeds = 0;
+    idx checksum = 0;
+    gettimeofday(&begin, NULL);
+    for (int r = 0; r < BENCH_ROUNDS; ++r) {
+        for (size_t i = 0; i < hash_count; ++i) {
+            if (i + BENCH_PREFETCH_DISTANCE < hash_count) prefetch_kmer_list(lktbl, hash_array[i + BENCH_PREFETCH_DISTANCE]);
+            u64 n = 0;
+            u64* list = extract_kmer_list(lktbl, hash_array[i], &n);
+            for (u64 k = 0; k < n; ++k) checksum += list[k];
+            num_seeds += n;
+        }
+    }
+    gettimeofday(&end, NULL);
+    const double probe_time = hbn_time_diff(&begin, &end);
+
+    char mem_buf[64];
+    u64_to_string_datasize(lookup_table_memory_size(lktbl), mem_buf);
+    fprintf(stderr, "%-6s build %8.2fs  memory %10s  probes/s %12.0f  seeds/s %12.0f  seeds %zu  checksum %zu\n",
+        lktbl_backend_names[lktbl->backend],
+        build_time,
+        mem_buf,
+        probe_time > 0 ? hash_count * BENCH_ROUNDS / probe_time : 0.0,
+        probe_time > 0 ? num_seeds / probe_time : 0.0,
+        num_seeds / BENCH_ROUNDS,
+        (size_t)checksum);
+    destroy_lookup_table(lktbl);
+    *seed_count = num_seeds / BENCH_ROUNDS;
+    *seed_checksum = checksum;
+}
+
+int lktbl_bench_main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "USAGE:\n");
+        fprintf(stderr, "  %s subject.fasta query.fasta [kmer_size] [max_kmer_occ]\n", argv[0]);
+        return 1;
+    }
+    const char* subject_path = argv[1];
+    const char* query_path = argv[2];
+    const int kmer_size = (argc > 3) ? atoi(argv[3]) : 15;
+    const int max_kmer_occ = (argc > 4) ? atoi(argv[4]) : 200;
+
+    if ((access(BENCH_DB_DIR, F_OK) != 0)
+        &&
+        (mkdir(BENCH_DB_DIR, S_IRWXU) != 0)) {
+        HBN_ERR("Failed to create directory %s: %s", BENCH_DB_DIR, strerror(errno));
+    }
+    build_db(subject_path, BENCH_DB_DIR, INIT_SUBJECT_DB_TITLE, 0, I32_MAX, U64_MAX, 0, 1);
+    build_db(query_path, BENCH_DB_DIR, INIT_QUERY_DB_TITLE, 0, I32_MAX, U64_MAX, 0, 1);
+    text_t* subjects = seqdb_load_unpacked(BENCH_DB_DIR, INIT_SUBJECT_DB_TITLE, 0);
+    text_t* queries = seqdb_load_unpacked(BENCH_DB_DIR, INIT_QUERY_DB_TITLE, 0);
+
+    kv_dinit(vec_u64, hash_list);
+    extract_query_hashes(queries, kmer_size, &hash_list);
+    fprintf(stderr, "kmer size = %d, max kmer occ = %d, subject residues = %zu, query kmers = %zu\n",
+        kmer_size, max_kmer_occ, subjects->dbinfo.db_size, kv_size(hash_list));
+
+    size_t khash_seed_count = 0, khash_seed_checksum = 0;
+    int num_diffs = 0;
+    for (int i = 0; i < eLktblInvalid; ++i) {
+        if (i == eLktblDense && kmer_size > LKTBL_DENSE_MAX_KMER_SIZE) continue;
+        size_t seed_count, seed_checksum;
+        bench_one_backend(subjects, &hash_list, kmer_size, max_kmer_occ, i, &seed_count, &seed_checksum);
+        if (i == eLktblKhash) {
+            khash_seed_count = seed_count;
+            khash_seed_checksum = seed_checksum;
+        } else if (seed_count != khash_seed_count || seed_checksum != khash_seed_checksum) {
+            fprintf(stderr, "%s returns %+ld seeds compared to khash\n", 
+                lktbl_backend_names[i], (long)seed_count - (long)khash_seed_count);
+            ++num_diffs;
+        }
+    }
+
+    kv_destroy(hash_list);
+    CSeqDBFree(subjects);
+    CSeqDBFree(queries);
+    return num_diffs ? 1 : 0;
+}
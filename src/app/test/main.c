@@ -6,6 +6,7 @@
 #include "../../corelib/string2hsp.h"
 #include "../../corelib/ksort.h"
 #include "../../corelib/cstr_util.h"
+#include "test_app.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -78,6 +79,7 @@ int examine_one_hsp_list(HbnHSP* hsp_array, int hsp_count, NameToIdMap* subject_
     int n_perfect = 0;
     int n_ovlp = 0;
     HbnHSP hsp;
+    memset(&hsp, 0, sizeof(HbnHSP));
     for (int i = 0; i < hsp_count; ++i) {
         if (is_perfect_hsp(hsp_array + i)) {
             ++n_perfect;
@@ -124,14 +126,14 @@ examine_name:
 
 void dump_chr21_queries(const char* seqdb_dir_path, int* chr21_query_flag_array)
 {
-    int nvol = seqdb_load_num_volumes(seqdb_dir_path, INIT_QUERY_TITLE);
+    int nvol = seqdb_load_num_volumes(seqdb_dir_path, INIT_QUERY_DB_TITLE);
     int qid = -1;
     kv_dinit(vec_u8, query);
     hbn_dfopen(out, "chr21_queries.fasta", "w");
     int seq = 0;
     size_t res =0;
     for (int i = 0; i < nvol; ++i) {
-        CSeqDB* vol = seqdb_load(seqdb_dir_path, INIT_QUERY_TITLE, i);
+        CSeqDB* vol = seqdb_load(seqdb_dir_path, INIT_QUERY_DB_TITLE, i);
         for (int k = 0; k < seqdb_num_seqs(vol); ++k) {
             ++qid;
             if (!chr21_query_flag_array[qid]) continue;
@@ -157,13 +159,13 @@ void dump_chr21_queries(const char* seqdb_dir_path, int* chr21_query_flag_array)
 
 void dump_chr21(const char* seqdb_dir_path)
 {
-    int nvol = seqdb_load_num_volumes(seqdb_dir_path, INIT_DB_TITLE);
+    int nvol = seqdb_load_num_volumes(seqdb_dir_path, INIT_SUBJECT_DB_TITLE);
     kv_dinit(vec_u8, subject);
     hbn_dfopen(out, "chr21_subject.fasta", "w");
     int seq = 0;
     size_t res =0;
     for (int i = 0; i < nvol; ++i) {
-        CSeqDB* vol = seqdb_load(seqdb_dir_path, INIT_DB_TITLE, i);
+        CSeqDB* vol = seqdb_load(seqdb_dir_path, INIT_SUBJECT_DB_TITLE, i);
         for (int k = 0; k < seqdb_num_seqs(vol); ++k) {
             if (!is_chr21(seqdb_seq_name(vol, k))) continue;
             seqdb_extract_sequence(vol, k, FWD, &subject);
@@ -195,29 +197,29 @@ print_seq_info(CSeqInfo* seqinfo_array, int num_seqs, const char* names)
     ks_introsort_seqinfo_size_gt(num_seqs, seqinfo_array);
     char size_buf[256];
     for (int i = 0; i < num_seqs; ++i) {
-        char* name = names + seqinfo_array[i].hdr_offset;
-        char* size = u64_to_string_datasize(seqinfo_array[i].seq_size, size_buf);
+        const char* name = names + seqinfo_array[i].hdr_offset;
+        const char* size = u64_to_string_datasize(seqinfo_array[i].seq_size, size_buf);
         fprintf(stderr, "%s    %s\n", name, size);
     }
 }
 
 #if 1
-int main(int argc, char* argv[])
+static int chr21_main(int argc, char* argv[])
 {
     hbn_assert(argc == 3);
     const char* seqdb_dir_path = argv[1];
     const char* hsp_path = argv[2];
 
-    CSeqDBInfo db_info = seqdb_load_volume_info(seqdb_dir_path, INIT_DB_TITLE, 0);
+    CSeqDBInfo db_info = seqdb_load_volume_info(seqdb_dir_path, INIT_SUBJECT_DB_TITLE, 0);
     hbn_assert(db_info.hdr_offset_from == 0);
-    char* subject_names = load_seq_headers(seqdb_dir_path, INIT_DB_TITLE, 0, db_info.hdr_offset_to);
-    CSeqInfo* seqinfo_array = load_seq_infos(seqdb_dir_path, INIT_DB_TITLE, 0, db_info.num_seqs);
+    char* subject_names = load_seq_headers(seqdb_dir_path, INIT_SUBJECT_DB_TITLE, 0, db_info.hdr_offset_to);
+    CSeqInfo* seqinfo_array = load_seq_infos(seqdb_dir_path, INIT_SUBJECT_DB_TITLE, 0, db_info.num_seqs);
     print_seq_info(seqinfo_array, db_info.num_seqs, subject_names);
     return 0;
 
-    CSeqDBInfo query_info = seqdb_load_volume_info(seqdb_dir_path, INIT_QUERY_TITLE, 0);
+    CSeqDBInfo query_info = seqdb_load_volume_info(seqdb_dir_path, INIT_QUERY_DB_TITLE, 0);
     hbn_assert(query_info.hdr_offset_from == 0);
-    char* query_names = load_seq_headers(seqdb_dir_path, INIT_QUERY_TITLE, 0, query_info.hdr_offset_to);
+    char* query_names = load_seq_headers(seqdb_dir_path, INIT_QUERY_DB_TITLE, 0, query_info.hdr_offset_to);
     int* chr21_query_flag_array = (int*)calloc(query_info.num_seqs, sizeof(int));
 
     HbnHspReader* hspreader = HbnHspReaderNew(hsp_path, query_names, query_info.num_seqs, subject_names, db_info.num_seqs);
@@ -266,12 +268,13 @@ int main(int argc, char* argv[])
 
     dump_chr21_queries(seqdb_dir_path, chr21_query_flag_array);
     dump_chr21(seqdb_dir_path);
+    return 0;
 }
 #else
 
 extern int find_chr21_name(const char* name);
 
-int main(int argc, char* argv[])
+static int chr21_main(int argc, char* argv[])
 {
     HbnFastaReader* reader = HbnFastaReaderNew(argv[1]);
     size_t total_res = 0;
@@ -288,5 +291,47 @@ int main(int argc, char* argv[])
         }
     }
     HBN_LOG("total res: %zu", total_res);
+    return 0;
+}
+#endif
+
+typedef struct {
+    const char* name;
+    int (*main)(int argc, char* argv[]);
+    const char* usage;
+} TestAppCommand;
+
+static const TestAppCommand test_app_commands[] = {
+    { "chr21", chr21_main, "seqdb_dir hsp_path" },
+    { "lktbl_bench", lktbl_bench_main, "subject.fasta query.fasta [kmer_size] [max_kmer_occ]" },
+    { "kmer_bench", kmer_bench_main, "seqs.fasta [kmer_size]" },
+    { "ksw2_check", ksw2_check_main, "[num_pairs] [max_size] [seed]" },
+    { "ed_filter_check", ed_filter_check_main, "[num_windows] [seed]" },
+    { "chain_bench", chain_bench_main, "subject.fasta query.fasta [kmer_size] | chain_seeds.bin" },
+    { "unpack_bench", unpack_bench_main, "[num_bases] [seed]" },
+    { "gz_reader_check", gz_reader_check_main, "[tmp_dir]" },
+};
+
+static void
+print_usage(const char* prog)
+{
+    fprintf(stderr, "USAGE:\n");
+    for (size_t i = 0; i < sizeof(test_app_commands) / sizeof(test_app_commands[0]); ++i) {
+        fprintf(stderr, "  %s %s %s\n", prog, test_app_commands[i].name, test_app_commands[i].usage);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(test_app_commands) / sizeof(test_app_commands[0]); ++i) {
+        if (strcmp(argv[1], test_app_commands[i].name) == 0) {
+            return test_app_commands[i].main(argc - 1, argv + 1);
+        }
+    }
+    print_usage(argv[0]);
+    return 1;
 }
-#endif
\ No newline at end of file
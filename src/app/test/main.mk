@@ -6,7 +6,7 @@ ifeq "$(strip ${TARGET_DIR})" ""
 endif
 
 TARGET   := necat2test
-SOURCES  := main.c find_name.cpp
+SOURCES  := main.c find_name.cpp lktbl_bench.c kmer_bench.c ksw2_check.c ed_filter_check.c chain_bench.c unpack_bench.c gz_reader_check.c
 
 SRC_INCDIRS  := .
 
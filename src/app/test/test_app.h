@@ -0,0 +1,28 @@
+#ifndef __TEST_APP_H
+#define __TEST_APP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// entry points of the necat2test commands, argv[0] is the command name
+
+int lktbl_bench_main(int argc, char* argv[]);
+
+int kmer_bench_main(int argc, char* argv[]);
+
+int ksw2_check_main(int argc, char* argv[]);
+
+int ed_filter_check_main(int argc, char* argv[]);
+
+int chain_bench_main(int argc, char* argv[]);
+
+int unpack_bench_main(int argc, char* argv[]);
+
+int gz_reader_check_main(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TEST_APP_H
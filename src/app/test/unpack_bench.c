@@ -0,0 +1,132 @@
+#include "test_app.h"
+
+#include "../../corelib/unpack_pac.h"
+
+/// Checks the bulk 2-bit decoders at every simd level against the per-base
+/// _get_pac loops they replace, on random ranges of a random packed
+/// sequence, and reports the decoding throughput of each in bases per
+/// second on read sized ranges.
+
+#define BENCH_NUM_CHECKS    100000
+#define BENCH_MAX_CHECK_CNT 300
+#define BENCH_READ_SIZE     10000
+#define BENCH_ROUNDS        5
+
+static u32
+bench_rand(u64* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return (u32)(*s >> 16);
+}
+
+static void
+naive_unpack_fwd(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    for (size_t i = from; i < from + cnt; ++i) *dst++ = _get_pac(pac, i);
+}
+
+static void
+naive_unpack_rev(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    size_t i = from + cnt;
+    while (i > from) {
+        --i;
+        *dst++ = 3 - _get_pac(pac, i);
+    }
+}
+
+typedef void (*unpack_func)(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+typedef struct {
+    const char* name;
+    unpack_func fwd;
+    unpack_func rev;
+    int needs_avx2;
+} BenchDecoder;
+
+static const BenchDecoder bench_decoders[] = {
+    { "per-base", naive_unpack_fwd, naive_unpack_rev, 0 },
+    { "scalar", unpack_pac_fwd_scalar, unpack_pac_rev_scalar, 0 },
+    { "avx2", unpack_pac_fwd_avx2, unpack_pac_rev_avx2, 1 },
+};
+
+static int
+check_one_decoder(const BenchDecoder* decoder, const u8* pac, const size_t num_bases, u64* rng)
+{
+    u8 ref[BENCH_MAX_CHECK_CNT + 1];
+    u8 out[BENCH_MAX_CHECK_CNT + 2];
+    int num_diffs = 0;
+    for (int i = 0; i < BENCH_NUM_CHECKS; ++i) {
+        const size_t cnt = bench_rand(rng) % (BENCH_MAX_CHECK_CNT + 1);
+        const size_t from = ((size_t)(bench_rand(rng)) << 16 | bench_rand(rng)) % (num_bases - cnt + 1);
+        const int rev = i & 1;
+        if (rev) {
+            naive_unpack_rev(pac, from, cnt, ref);
+            decoder->rev(pac, from, cnt, out);
+        } else {
+            naive_unpack_fwd(pac, from, cnt, ref);
+            decoder->fwd(pac, from, cnt, out);
+        }
+        if (memcmp(ref, out, cnt)) {
+            if (num_diffs == 0) {
+                HBN_WARN("%s %s [%zu, %zu) differs from the per-base loop",
+                    decoder->name, rev ? "rev" : "fwd", from, from + cnt);
+            }
+            ++num_diffs;
+        }
+    }
+    return num_diffs;
+}
+
+static double
+bench_one_strand(unpack_func f, const u8* pac, const size_t num_bases, u8* dst)
+{
+    struct timeval begin, end;
+    gettimeofday(&begin, NULL);
+    for (int r = 0; r < BENCH_ROUNDS; ++r) {
+        for (size_t from = 0; from < num_bases; from += BENCH_READ_SIZE) {
+            const size_t cnt = hbn_min((size_t)BENCH_READ_SIZE, num_bases - from);
+            f(pac, from, cnt, dst + from);
+        }
+    }
+    gettimeofday(&end, NULL);
+    return hbn_time_diff(&begin, &end);
+}
+
+int unpack_bench_main(int argc, char* argv[])
+{
+    const size_t num_bases = (argc > 1) ? strtoull(argv[1], NULL, 10) : 64 * 1024 * 1024;
+    u64 rng = (argc > 2) ? strtoull(argv[2], NULL, 10) : 1;
+    hbn_assert(num_bases > BENCH_MAX_CHECK_CNT);
+    if (rng == 0) rng = 1;
+    const int has_avx2 = hbn_detect_simd_level() >= eSimdAvx2;
+    if (!has_avx2) fprintf(stderr, "the cpu does not support avx2, only the scalar decoder is benchmarked\n");
+
+    const size_t num_bytes = (num_bases + 3) / 4;
+    u8* pac = (u8*)malloc(num_bytes);
+    for (size_t i = 0; i < num_bytes; ++i) pac[i] = bench_rand(&rng);
+    u8* dst = (u8*)malloc(num_bases);
+
+    int num_diffs = 0;
+    const int num_decoders = sizeof(bench_decoders) / sizeof(bench_decoders[0]);
+    for (int i = 0; i < num_decoders; ++i) {
+        const BenchDecoder* decoder = bench_decoders + i;
+        if (decoder->needs_avx2 && !has_avx2) continue;
+        const int diffs = check_one_decoder(decoder, pac, num_bases, &rng);
+        const double fwd_time = bench_one_strand(decoder->fwd, pac, num_bases, dst);
+        const double rev_time = bench_one_strand(decoder->rev, pac, num_bases, dst);
+        const double num_decoded = 1.0 * num_bases * BENCH_ROUNDS;
+        fprintf(stderr, "%-8s  fwd %8.1f Mbases/s  rev %8.1f Mbases/s  %s\n",
+            decoder->name,
+            fwd_time > 0.0 ? num_decoded / fwd_time / 1e6 : 0.0,
+            rev_time > 0.0 ? num_decoded / rev_time / 1e6 : 0.0,
+            diffs ? "DIFFERENT" : "identical");
+        num_diffs += diffs;
+    }
+
+    free(pac);
+    free(dst);
+    return num_diffs ? 1 : 0;
+}
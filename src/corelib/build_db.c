@@ -1,6 +1,7 @@
 #include "build_db.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/stat.h>   
 #include <unistd.h>
@@ -12,128 +13,240 @@
 #include "seqdb.h"
 #include "fasta.h"
 
+/// The sequences are parsed by one reader thread, which cuts them into
+/// blocks of whole records. The packers turn a block into its headers,
+/// packed residues, sequence infos and ambiguous subsequences, with offsets
+/// relative to the block, and the main thread writes the packed blocks in
+/// input order, shifting their offsets by those of the blocks before them.
+/// Block k lives in slot k % num_slots, so a slot is reused only after its
+/// previous block has been written.
+
+#define SEQDB_BLOCK_MAX_RES     (8 * 1024 * 1024)
+#define SEQDB_BLOCK_MAX_SEQS    4096
+
+typedef kvec_t(CSeqInfo) vec_seq_info;
+typedef kvec_t(CAmbigSubseq) vec_ambig_subseq;
+
+typedef enum {
+    eSeqdbBlockFree,
+    eSeqdbBlockRead,
+    eSeqdbBlockPacking,
+    eSeqdbBlockPacked
+} ESeqdbBlockState;
+
+typedef struct {
+    ESeqdbBlockState state;
+    /// id of the first sequence of the block
+    int first_id;
+    /// reader output, every name is followed by '\0'
+    kstring_t names;
+    kstring_t seqs;
+    vec_size_t name_offsets;
+    vec_size_t seq_offsets;
+    /// packer output
+    kstring_t hdrs;
+    vec_u8 pac;
+    vec_seq_info seq_infos;
+    vec_ambig_subseq ambigs;
+} SeqdbBlock;
+
+typedef struct {
+    const char* input;
+    EDbFormat fmt;
+    int min_seq_size;
+    int rename_seq;
+    /// threads decompressing each input file
+    int num_threads;
+    SeqdbBlock* blocks;
+    int num_slots;
+    /// blocks handed over by the reader, and blocks taken by the packers
+    int num_read_blocks;
+    int num_packing_blocks;
+    BOOL all_blocks_read;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /// the block being filled by the reader
+    SeqdbBlock* curr_block;
+    size_t seq_count;
+    size_t res_count;
+} SeqdbBuildData;
+
+#define seqdb_block_slot(data, i) ((data)->blocks + (i) % (data)->num_slots)
+
 static void
-pack_one_seq(int* id_in_seqdb,
-    size_t* seq_offset_in_seqdb,
-    size_t* hdr_offset_in_seqdb,
-    kstring_t* seq_name,
-    kstring_t* seq_data,
-    FILE* hdr_file,
-    FILE* seq_info_file,
-    FILE* packed_seq_file,
-    size_t* ambig_offset_in_seqdb,
-    FILE* ambig_subseq_file)
+seqdb_block_clear(SeqdbBlock* block)
+{
+    ks_clear(block->names);
+    ks_clear(block->seqs);
+    kv_clear(block->name_offsets);
+    kv_clear(block->seq_offsets);
+    kv_push(size_t, block->seq_offsets, 0);
+    ks_clear(block->hdrs);
+    kv_clear(block->pac);
+    kv_clear(block->seq_infos);
+    kv_clear(block->ambigs);
+}
+
+static void
+seqdb_block_destroy(SeqdbBlock* block)
+{
+    ks_destroy(block->names);
+    ks_destroy(block->seqs);
+    kv_destroy(block->name_offsets);
+    kv_destroy(block->seq_offsets);
+    ks_destroy(block->hdrs);
+    kv_destroy(block->pac);
+    kv_destroy(block->seq_infos);
+    kv_destroy(block->ambigs);
+}
+
+static size_t
+seqdb_block_num_seqs(const SeqdbBlock* block)
+{
+    return kv_size(block->name_offsets);
+}
+
+static void
+pack_one_seq(SeqdbBlock* block, const size_t k, const int rename_seq)
 {
-    CSeqInfo seq_info;
-    seq_info.seq_offset = *seq_offset_in_seqdb;
-    seq_info.seq_size = ks_size(*seq_data);
-    seq_info.hdr_offset = *hdr_offset_in_seqdb;
-    seq_info.ambig_offset = *ambig_offset_in_seqdb;
-    seq_info.ambig_size = 0;
-
-    /// dump header
-    if (id_in_seqdb) {  // rename sequence
+    const char* name = ks_s(block->names) + kv_A(block->name_offsets, k);
+    const char* seq = ks_s(block->seqs) + kv_A(block->seq_offsets, k);
+    const size_t seq_size = kv_A(block->seq_offsets, k + 1) - kv_A(block->seq_offsets, k);
+    CSeqInfo* seq_info = kv_data(block->seq_infos) + k;
+    seq_info->seq_offset = kv_size(block->pac) << 2;
+    seq_info->seq_size = seq_size;
+    seq_info->hdr_offset = ks_size(block->hdrs);
+    seq_info->ambig_offset = kv_size(block->ambigs);
+    seq_info->ambig_size = 0;
+
+    /// header
+    if (rename_seq) {
         char buf[64];
-        u64_to_fixed_width_string_r(*id_in_seqdb, buf, HBN_DIGIT_WIDTH);
-        ++(*id_in_seqdb);
+        u64_to_fixed_width_string_r(block->first_id + k, buf, HBN_DIGIT_WIDTH);
         buf[HBN_DIGIT_WIDTH] = '\0';
-        hbn_fwrite(buf, 1, HBN_DIGIT_WIDTH+1, hdr_file);
-        seq_info.hdr_size = HBN_DIGIT_WIDTH;
-        *hdr_offset_in_seqdb += (HBN_DIGIT_WIDTH + 1);
+        kputsn(buf, HBN_DIGIT_WIDTH + 1, &block->hdrs);
+        seq_info->hdr_size = HBN_DIGIT_WIDTH;
     } else { // use the orignal header
         size_t n = 0;
-        while (n < ks_size(*seq_name)) {
-            int c = ks_A(*seq_name, n);
-            if (isspace(c)) break;
-            ++n;
-        }
+        while (name[n] != '\0' && !isspace((u8)name[n])) ++n;
         hbn_assert(n > 0);
-        seq_info.hdr_size = n;
-        if (n == ks_size(*seq_name)) {
-            kputc('\0', seq_name);
-            hbn_fwrite(ks_s(*seq_name), 1, n+1, hdr_file);
-            ks_pop_back(*seq_name);
-        } else {
-            int c = ks_A(*seq_name, n);
-            ks_A(*seq_name, n) = '\0';
-            hbn_fwrite(ks_s(*seq_name), 1, n+1, hdr_file);
-            ks_A(*seq_name, n) = c;
-        }
-        *hdr_offset_in_seqdb += (n + 1);
+        kputsn(name, n, &block->hdrs);
+        kputc('\0', &block->hdrs);
+        seq_info->hdr_size = n;
     }
 
-    /// dump packed sequence
-    const size_t ubytes = (seq_info.seq_size + 3) >> 2;
-    u8* es = (u8*)calloc(ubytes, 1);
+    /// packed sequence, ambiguous residues are packed as 0
+    const size_t ubytes = (seq_size + 3) >> 2;
+    const size_t pac_size = kv_size(block->pac);
+    u8* es = kv_data(block->pac) + pac_size;
+    memset(es, 0, ubytes);
+    kv_size(block->pac) = pac_size + ubytes;
     size_t i = 0;
-    int c, c1;
-    u8 ec, ec1;
-    while (i < seq_info.seq_size) {
-        c = ks_A(*seq_data, i);
-        ec = nst_nt16_table[c];
+    while (i < seq_size) {
+        if ((i & 3) == 0 && i + 4 <= seq_size) {
+            /// four unambiguous residues fill a whole byte
+            const u8 e0 = nst_nt16_table[(u8)seq[i]];
+            const u8 e1 = nst_nt16_table[(u8)seq[i+1]];
+            const u8 e2 = nst_nt16_table[(u8)seq[i+2]];
+            const u8 e3 = nst_nt16_table[(u8)seq[i+3]];
+            if ((e0 | e1 | e2 | e3) <= 3) {
+                es[i >> 2] = (e0 << 6) | (e1 << 4) | (e2 << 2) | e3;
+                i += 4;
+                continue;
+            }
+        }
+        const char c = seq[i];
+        const u8 ec = nst_nt16_table[(u8)c];
         if (ec > 3) {
-            CAmbigSubseq ambig = { i, c, 1 };
-            ec1 = 0;
-            _set_pac(es, i, ec1);
+            CAmbigSubseq ambig;
+            /// no garbage in the struct padding
+            memset(&ambig, 0, sizeof(CAmbigSubseq));
+            ambig.offset = i;
+            ambig.ambig_residue = c;
+            ambig.count = 1;
             ++i;
-            while (i < seq_info.seq_size) {
-                c1 = ks_A(*seq_data, i);
-                ec1 = nst_nt16_table[c1];
-                if (ec != ec1) break;
-                ec1 = 0;
-                _set_pac(es, i, ec1);
+            while (i < seq_size && nst_nt16_table[(u8)seq[i]] == ec) {
                 ++ambig.count;
                 ++i;
             }
-            ++seq_info.ambig_size;
-            hbn_fwrite(&ambig, sizeof(CAmbigSubseq), 1, ambig_subseq_file);
-            ++(*ambig_offset_in_seqdb);
+            ++seq_info->ambig_size;
+            kv_push(CAmbigSubseq, block->ambigs, ambig);
         } else {
             _set_pac(es, i, ec);
             ++i;
         }
     }
-    hbn_fwrite(es, 1, ubytes, packed_seq_file);
+}
 
-    /// dump sequence info
-    hbn_fwrite(&seq_info, sizeof(CSeqInfo), 1, seq_info_file);
+static void
+pack_one_block(SeqdbBlock* block, const int rename_seq)
+{
+    const size_t num_seqs = seqdb_block_num_seqs(block);
+    size_t num_bytes = 0;
+    for (size_t k = 0; k < num_seqs; ++k) {
+        const size_t seq_size = kv_A(block->seq_offsets, k + 1) - kv_A(block->seq_offsets, k);
+        num_bytes += (seq_size + 3) >> 2;
+    }
+    if (kv_max(block->pac) < num_bytes) kv_reserve(u8, block->pac, num_bytes);
+    if (kv_max(block->seq_infos) < num_seqs) kv_reserve(CSeqInfo, block->seq_infos, num_seqs);
+    kv_size(block->seq_infos) = num_seqs;
+    for (size_t k = 0; k < num_seqs; ++k) pack_one_seq(block, k, rename_seq);
+    hbn_assert(kv_size(block->pac) == num_bytes);
+}
 
-    *seq_offset_in_seqdb += (ubytes << 2);
-    free(es);
+/// hands the filled block over to the packers
+static void
+submit_curr_block(SeqdbBuildData* data)
+{
+    SeqdbBlock* block = data->curr_block;
+    if (!block) return;
+    data->curr_block = NULL;
+    pthread_mutex_lock(&data->lock);
+    block->state = eSeqdbBlockRead;
+    ++data->num_read_blocks;
+    pthread_cond_broadcast(&data->cond);
+    pthread_mutex_unlock(&data->lock);
 }
 
 static void
-pack_one_file(const char* file_path,
-    int* id_in_seqdb,
-    size_t* seq_offset_in_seqdb,
-    size_t* hdr_offset_in_seqdb,
-    FILE* hdr_file,
-    FILE* seq_info_file,
-    FILE* packed_seq_file,
-    size_t* ambig_offset_in_seqdb,
-    FILE* ambig_subseq_file,
-    const int min_seq_size,
-    size_t* total_seq_count,
-    size_t* total_res_count)
+add_one_seq(SeqdbBuildData* data, const kstring_t* name, const kstring_t* seq)
+{
+    SeqdbBlock* block = data->curr_block;
+    if (!block) {
+        block = seqdb_block_slot(data, data->num_read_blocks);
+        pthread_mutex_lock(&data->lock);
+        while (block->state != eSeqdbBlockFree) pthread_cond_wait(&data->cond, &data->lock);
+        pthread_mutex_unlock(&data->lock);
+        seqdb_block_clear(block);
+        block->first_id = data->seq_count;
+        data->curr_block = block;
+    }
+    kv_push(size_t, block->name_offsets, ks_size(block->names));
+    kputsn(ks_s(*name), ks_size(*name), &block->names);
+    kputc('\0', &block->names);
+    kputsn(ks_s(*seq), ks_size(*seq), &block->seqs);
+    kv_push(size_t, block->seq_offsets, ks_size(block->seqs));
+    ++data->seq_count;
+    data->res_count += ks_size(*seq);
+    if (ks_size(block->seqs) >= SEQDB_BLOCK_MAX_RES
+        ||
+        seqdb_block_num_seqs(block) >= SEQDB_BLOCK_MAX_SEQS) {
+        submit_curr_block(data);
+    }
+}
+
+static void
+read_one_file(SeqdbBuildData* data, const char* file_path)
 {
     HBN_LOG("pack %s", file_path);
     size_t file_seq_count = 0;
     size_t file_res_count = 0;
-    HbnFastaReader* reader = HbnFastaReaderNew(file_path);
+    HbnFastaReader* reader = HbnFastaReaderNewWithThreads(file_path, data->num_threads);
     HbnFastaReaderSkipErrorFormatedSequences(reader);
     while (!HbnLineReaderAtEof(reader->line_reader)) {
         if (!HbnFastaReaderReadOneSeq(reader)) continue;
-        if (ks_size(reader->sequence) < min_seq_size) continue;
-        pack_one_seq(id_in_seqdb,
-            seq_offset_in_seqdb,
-            hdr_offset_in_seqdb,
-            &reader->name,
-            &reader->sequence,
-            hdr_file,
-            seq_info_file,
-            packed_seq_file,
-            ambig_offset_in_seqdb,
-            ambig_subseq_file);
+        if (ks_size(reader->sequence) < data->min_seq_size) continue;
+        add_one_seq(data, &reader->name, &reader->sequence);
         ++file_seq_count;
         file_res_count += ks_size(reader->sequence);
     }
@@ -141,8 +254,84 @@ pack_one_file(const char* file_path,
 
     char buf1[64], buf2[64];
     HBN_LOG("pack %s sequences (%s)", u64_to_string_comma(file_seq_count, buf1), u64_to_string_datasize(file_res_count, buf2));
-    *total_seq_count += file_seq_count;
-    *total_res_count += file_res_count;
+}
+
+static void*
+seqdb_reader_thread(void* params)
+{
+    SeqdbBuildData* data = (SeqdbBuildData*)(params);
+    if (data->fmt == eDbFormatUnknown) {
+        HbnLineReader* line_reader = HbnLineReaderNew(data->input);
+        while (!HbnLineReaderAtEof(line_reader)) {
+            HbnLineReaderReadOneLine(line_reader);
+            kstring_t* line = &line_reader->line;
+            if (ks_empty(*line)) continue;
+            kputc('\0', line);
+            if (truncate_both_end_spaces(ks_s(*line)) == 0) continue;
+            read_one_file(data, ks_s(*line));
+        }
+        HbnLineReaderFree(line_reader);
+    } else {
+        read_one_file(data, data->input);
+    }
+    submit_curr_block(data);
+
+    pthread_mutex_lock(&data->lock);
+    data->all_blocks_read = TRUE;
+    pthread_cond_broadcast(&data->cond);
+    pthread_mutex_unlock(&data->lock);
+    return NULL;
+}
+
+static void*
+seqdb_packer_thread(void* params)
+{
+    SeqdbBuildData* data = (SeqdbBuildData*)(params);
+    pthread_mutex_lock(&data->lock);
+    while (1) {
+        if (data->num_packing_blocks < data->num_read_blocks) {
+            SeqdbBlock* block = seqdb_block_slot(data, data->num_packing_blocks);
+            ++data->num_packing_blocks;
+            block->state = eSeqdbBlockPacking;
+            pthread_mutex_unlock(&data->lock);
+            pack_one_block(block, data->rename_seq);
+            pthread_mutex_lock(&data->lock);
+            block->state = eSeqdbBlockPacked;
+            pthread_cond_broadcast(&data->cond);
+            continue;
+        }
+        if (data->all_blocks_read) break;
+        pthread_cond_wait(&data->cond, &data->lock);
+    }
+    pthread_mutex_unlock(&data->lock);
+    return NULL;
+}
+
+static void
+write_one_block(SeqdbBlock* block,
+    size_t* seq_offset_in_seqdb,
+    size_t* hdr_offset_in_seqdb,
+    size_t* ambig_offset_in_seqdb,
+    FILE* hdr_file,
+    FILE* seq_info_file,
+    FILE* packed_seq_file,
+    FILE* ambig_subseq_file)
+{
+    for (size_t k = 0; k < kv_size(block->seq_infos); ++k) {
+        CSeqInfo* seq_info = kv_data(block->seq_infos) + k;
+        seq_info->seq_offset += *seq_offset_in_seqdb;
+        seq_info->hdr_offset += *hdr_offset_in_seqdb;
+        seq_info->ambig_offset += *ambig_offset_in_seqdb;
+    }
+    hbn_fwrite(ks_s(block->hdrs), 1, ks_size(block->hdrs), hdr_file);
+    hbn_fwrite(kv_data(block->pac), 1, kv_size(block->pac), packed_seq_file);
+    hbn_fwrite(kv_data(block->seq_infos), sizeof(CSeqInfo), kv_size(block->seq_infos), seq_info_file);
+    if (kv_size(block->ambigs)) {
+        hbn_fwrite(kv_data(block->ambigs), sizeof(CAmbigSubseq), kv_size(block->ambigs), ambig_subseq_file);
+    }
+    *seq_offset_in_seqdb += kv_size(block->pac) << 2;
+    *hdr_offset_in_seqdb += ks_size(block->hdrs);
+    *ambig_offset_in_seqdb += kv_size(block->ambigs);
 }
 
 void
@@ -300,7 +489,8 @@ build_db(const char* input,
     const int min_seq_size,
     const int max_file_seqs,
     const size_t max_file_res,
-    const int rename_seq)
+    const int rename_seq,
+    const int num_threads)
 {
     EDbFormat fmt = hbn_guess_db_format(input);
     if (fmt == eDbFormatEmptyFile) {
@@ -317,50 +507,64 @@ build_db(const char* input,
     hbn_dfopen(hdr_file, path, "wb");
     make_ambig_subseq_path(seqdb_dir, seqdb_title, path);
     hbn_dfopen(ambig_subseq_file, path, "wb");
-    int _read_id = 0;
-    int* read_id = rename_seq ? (&_read_id) : NULL;
     size_t seq_offset_in_seqdb = 0;
     size_t hdr_offset_in_seqdb = 0;
     size_t ambig_offset_in_seqdb = 0;
-    size_t seq_count = 0;
-    size_t res_count = 0;
 
-    if (fmt == eDbFormatUnknown) {
-        HbnLineReader* line_reader = HbnLineReaderNew(input);
-        while (!HbnLineReaderAtEof(line_reader)) {
-            HbnLineReaderReadOneLine(line_reader);
-            kstring_t* line = &line_reader->line;
-            if (ks_empty(*line)) continue;
-            kputc('\0', line);
-            if (truncate_both_end_spaces(ks_s(*line)) == 0) continue;
-            pack_one_file(ks_s(*line), 
-                read_id, 
-                &seq_offset_in_seqdb, 
-                &hdr_offset_in_seqdb, 
+    SeqdbBuildData data;
+    memset(&data, 0, sizeof(SeqdbBuildData));
+    data.input = input;
+    data.fmt = fmt;
+    data.min_seq_size = min_seq_size;
+    data.rename_seq = rename_seq;
+    data.num_threads = num_threads;
+    const int num_packers = hbn_max(num_threads, 1);
+    data.num_slots = num_packers + 2;
+    data.blocks = (SeqdbBlock*)calloc(data.num_slots, sizeof(SeqdbBlock));
+    pthread_mutex_init(&data.lock, NULL);
+    pthread_cond_init(&data.cond, NULL);
+    pthread_t reader_job;
+    pthread_create(&reader_job, NULL, seqdb_reader_thread, &data);
+    pthread_t packer_jobs[num_packers];
+    for (int i = 0; i < num_packers; ++i) {
+        pthread_create(packer_jobs + i, NULL, seqdb_packer_thread, &data);
+    }
+
+    int num_written_blocks = 0;
+    pthread_mutex_lock(&data.lock);
+    while (1) {
+        if (num_written_blocks < data.num_read_blocks
+            &&
+            seqdb_block_slot(&data, num_written_blocks)->state == eSeqdbBlockPacked) {
+            SeqdbBlock* block = seqdb_block_slot(&data, num_written_blocks);
+            pthread_mutex_unlock(&data.lock);
+            write_one_block(block,
+                &seq_offset_in_seqdb,
+                &hdr_offset_in_seqdb,
+                &ambig_offset_in_seqdb,
                 hdr_file,
                 seq_info_file,
                 packed_seq_file,
-                &ambig_offset_in_seqdb,
-                ambig_subseq_file,
-                min_seq_size,
-                &seq_count,
-                &res_count);
+                ambig_subseq_file);
+            pthread_mutex_lock(&data.lock);
+            block->state = eSeqdbBlockFree;
+            ++num_written_blocks;
+            pthread_cond_broadcast(&data.cond);
+            continue;
         }
-        HbnLineReaderFree(line_reader);
-    } else {
-        pack_one_file(input, 
-            read_id, 
-            &seq_offset_in_seqdb, 
-            &hdr_offset_in_seqdb, 
-            hdr_file,
-            seq_info_file,
-            packed_seq_file,
-            &ambig_offset_in_seqdb,
-            ambig_subseq_file,
-            min_seq_size,
-            &seq_count,
-            &res_count);
-    }    
+        if (data.all_blocks_read && num_written_blocks == data.num_read_blocks) break;
+        pthread_cond_wait(&data.cond, &data.lock);
+    }
+    pthread_mutex_unlock(&data.lock);
+
+    pthread_join(reader_job, NULL);
+    for (int i = 0; i < num_packers; ++i) pthread_join(packer_jobs[i], NULL);
+    for (int i = 0; i < data.num_slots; ++i) seqdb_block_destroy(data.blocks + i);
+    free(data.blocks);
+    pthread_mutex_destroy(&data.lock);
+    pthread_cond_destroy(&data.cond);
+    const size_t seq_count = data.seq_count;
+    const size_t res_count = data.res_count;
 
     hbn_fclose(seq_info_file);
     hbn_fclose(packed_seq_file);
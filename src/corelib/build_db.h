@@ -25,6 +25,7 @@ hbndb_make_built(const char* input,
     const size_t max_file_res,
     const int rename_seq);
 
+/// packs the sequences with num_threads threads, plus one reading the input
 void
 build_db(const char* input,
     const char* seqdb_dir,
@@ -32,7 +33,8 @@ build_db(const char* input,
     const int min_seq_size,
     const int max_file_seqs,
     const size_t max_file_res,
-    const int rename_seq);
+    const int rename_seq,
+    const int num_threads);
 
 #ifdef __cplusplus
 }
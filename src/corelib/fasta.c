@@ -123,10 +123,16 @@ cache_new_name(CachedSeqNames* names, const char* new_name)
 
 HbnFastaReader*
 HbnFastaReaderNew(const char* filename)
+{
+    return HbnFastaReaderNewWithThreads(filename, 0);
+}
+
+HbnFastaReader*
+HbnFastaReaderNewWithThreads(const char* filename, const int num_threads)
 {
     HbnFastaReader* reader = (HbnFastaReader*)calloc(1, sizeof(HbnFastaReader));
     reader->filename = filename;
-    reader->line_reader = HbnLineReaderNew(filename);
+    reader->line_reader = HbnLineReaderNewWithThreads(filename, num_threads);
     ks_init(reader->name);
     ks_init(reader->comment);
     ks_init(reader->sequence);
@@ -22,6 +22,9 @@ typedef struct {
 HbnFastaReader*
 HbnFastaReaderNew(const char* filename);
 
+HbnFastaReader*
+HbnFastaReaderNewWithThreads(const char* filename, const int num_threads);
+
 HbnFastaReader*
 HbnFastaReaderFree(HbnFastaReader* reader);
 
@@ -0,0 +1,343 @@
+#include "gz_reader.h"
+
+#include <errno.h>
+
+/// members per BGZF chunk, each member holds at most 64 KiB of data
+#define BGZF_CHUNK_MEMBERS      32
+#define BGZF_HEADER_SIZE        12
+#define BGZF_TRAILER_SIZE       8
+/// bytes decompressed at a time by the read-ahead thread of other inputs
+#define PLAIN_CHUNK_SIZE        (1024 * 1024)
+
+static u32
+load_u16_le(const u8* p)
+{
+    return (u32)p[0] | ((u32)p[1] << 8);
+}
+
+static u32
+load_u32_le(const u8* p)
+{
+    return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+/// returns the BSIZE subfield of a gzip member header, -1 if it has none
+static int
+bgzf_block_size(const u8* header, const u8* extra, const u32 xlen)
+{
+    if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !(header[3] & 4)) return -1;
+    u32 i = 0;
+    while (i + 4 <= xlen) {
+        const u32 slen = load_u16_le(extra + i + 2);
+        if (extra[i] == 'B' && extra[i+1] == 'C' && slen == 2 && i + 6 <= xlen) {
+            return load_u16_le(extra + i + 4);
+        }
+        i += 4 + slen;
+    }
+    return -1;
+}
+
+BOOL
+hbn_gz_file_is_bgzf(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in) return FALSE;
+    u8 buf[BGZF_HEADER_SIZE + 256];
+    size_t n = fread(buf, 1, sizeof(buf), in);
+    fclose(in);
+    if (n < BGZF_HEADER_SIZE) return FALSE;
+    const u32 xlen = load_u16_le(buf + 10);
+    if (BGZF_HEADER_SIZE + xlen > n) return FALSE;
+    return bgzf_block_size(buf, buf + BGZF_HEADER_SIZE, xlen) >= 0;
+}
+
+#define gz_chunk_slot(reader, i) ((reader)->chunks + (i) % (reader)->num_chunks)
+
+/// reads the next BGZF member into comp, returns FALSE at the end of the file
+static BOOL
+read_one_bgzf_member(HbnGzReader* reader, vec_u8* comp)
+{
+    u8 header[BGZF_HEADER_SIZE];
+    size_t n = fread(header, 1, BGZF_HEADER_SIZE, reader->raw_stream);
+    if (n == 0) return FALSE;
+    if (n < BGZF_HEADER_SIZE) HBN_ERR("%s is truncated", reader->path);
+    const u32 xlen = load_u16_le(header + 10);
+    const size_t from = kv_size(*comp);
+    kv_resize(u8, *comp, from + BGZF_HEADER_SIZE + xlen);
+    memcpy(kv_data(*comp) + from, header, BGZF_HEADER_SIZE);
+    u8* extra = kv_data(*comp) + from + BGZF_HEADER_SIZE;
+    if (fread(extra, 1, xlen, reader->raw_stream) != xlen) HBN_ERR("%s is truncated", reader->path);
+    const int bsize = bgzf_block_size(header, extra, xlen);
+    if (bsize < 0) HBN_ERR("%s is not a valid BGZF file", reader->path);
+    const size_t member_size = (size_t)bsize + 1;
+    if (member_size < BGZF_HEADER_SIZE + xlen + BGZF_TRAILER_SIZE) HBN_ERR("%s is not a valid BGZF file", reader->path);
+    const size_t rest = member_size - BGZF_HEADER_SIZE - xlen;
+    kv_resize(u8, *comp, from + member_size);
+    if (fread(kv_data(*comp) + from + BGZF_HEADER_SIZE + xlen, 1, rest, reader->raw_stream) != rest) {
+        HBN_ERR("%s is truncated", reader->path);
+    }
+    return TRUE;
+}
+
+/// waits for the slot of the next chunk, returns NULL if the reader is being freed
+static HbnGzChunk*
+wait_free_chunk(HbnGzReader* reader)
+{
+    HbnGzChunk* chunk = gz_chunk_slot(reader, reader->num_read_chunks);
+    pthread_mutex_lock(&reader->lock);
+    while (chunk->state != eGzChunkFree && !reader->stop) pthread_cond_wait(&reader->cond, &reader->lock);
+    const BOOL stop = reader->stop;
+    pthread_mutex_unlock(&reader->lock);
+    return stop ? NULL : chunk;
+}
+
+static void
+submit_chunk(HbnGzReader* reader, HbnGzChunk* chunk, EGzChunkState state)
+{
+    pthread_mutex_lock(&reader->lock);
+    chunk->state = state;
+    ++reader->num_read_chunks;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+}
+
+static void*
+bgzf_reader_thread(void* params)
+{
+    HbnGzReader* reader = (HbnGzReader*)(params);
+    BOOL at_eof = FALSE;
+    while (!at_eof) {
+        HbnGzChunk* chunk = wait_free_chunk(reader);
+        if (!chunk) break;
+        kv_clear(chunk->comp);
+        kv_clear(chunk->member_offsets);
+        kv_push(size_t, chunk->member_offsets, 0);
+        while (kv_size(chunk->member_offsets) <= BGZF_CHUNK_MEMBERS) {
+            if (!read_one_bgzf_member(reader, &chunk->comp)) {
+                at_eof = TRUE;
+                break;
+            }
+            kv_push(size_t, chunk->member_offsets, kv_size(chunk->comp));
+        }
+        if (kv_size(chunk->member_offsets) > 1) submit_chunk(reader, chunk, eGzChunkRead);
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    reader->all_chunks_read = TRUE;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+/// gzread() that dies on error, returns less than count only at the end of the input
+static int
+gz_read_chunk(HbnGzReader* reader, u8* buffer, int count)
+{
+    int n = gzread(reader->gz_stream, buffer, count);
+    if (n < 0) {
+        int errnum;
+        const char* error_string = gzerror(reader->gz_stream, &errnum);
+        HBN_ERR("fail to read %s: %s", reader->path, error_string);
+    }
+    return n;
+}
+
+static void*
+plain_reader_thread(void* params)
+{
+    HbnGzReader* reader = (HbnGzReader*)(params);
+    BOOL at_eof = FALSE;
+    while (!at_eof) {
+        HbnGzChunk* chunk = wait_free_chunk(reader);
+        if (!chunk) break;
+        kv_resize(u8, chunk->data, PLAIN_CHUNK_SIZE);
+        int n = gz_read_chunk(reader, kv_data(chunk->data), PLAIN_CHUNK_SIZE);
+        kv_size(chunk->data) = n;
+        if (n < PLAIN_CHUNK_SIZE) at_eof = TRUE;
+        if (n > 0) submit_chunk(reader, chunk, eGzChunkInflated);
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    reader->all_chunks_read = TRUE;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+static void
+inflate_one_chunk(HbnGzReader* reader, HbnGzChunk* chunk, z_stream* zs)
+{
+    const u8* comp = kv_data(chunk->comp);
+    const size_t num_members = kv_size(chunk->member_offsets) - 1;
+    size_t data_size = 0;
+    for (size_t i = 0; i < num_members; ++i) {
+        data_size += load_u32_le(comp + kv_A(chunk->member_offsets, i + 1) - 4);
+    }
+    /// at least one byte, a chunk may hold only the empty EOF member and
+    /// inflate() rejects a NULL output buffer
+    if (kv_max(chunk->data) < data_size + 1) kv_reserve(u8, chunk->data, data_size + 1);
+    kv_size(chunk->data) = data_size;
+
+    u8* out = kv_data(chunk->data);
+    for (size_t i = 0; i < num_members; ++i) {
+        const u8* member = comp + kv_A(chunk->member_offsets, i);
+        const u8* member_end = comp + kv_A(chunk->member_offsets, i + 1);
+        const u32 xlen = load_u16_le(member + 10);
+        const u32 crc = load_u32_le(member_end - 8);
+        const u32 isize = load_u32_le(member_end - 4);
+        inflateReset(zs);
+        zs->next_in = (Bytef*)(member + BGZF_HEADER_SIZE + xlen);
+        zs->avail_in = (member_end - BGZF_TRAILER_SIZE) - zs->next_in;
+        zs->next_out = out;
+        zs->avail_out = isize;
+        int r = inflate(zs, Z_FINISH);
+        if (r != Z_STREAM_END || zs->avail_out) {
+            HBN_ERR("fail to inflate a BGZF member of %s: %s", reader->path, zs->msg ? zs->msg : "size mismatch");
+        }
+        if (crc32(crc32(0L, Z_NULL, 0), out, isize) != crc) HBN_ERR("CRC mismatch in %s", reader->path);
+        out += isize;
+    }
+}
+
+static void*
+inflate_thread(void* params)
+{
+    HbnGzReader* reader = (HbnGzReader*)(params);
+    z_stream zs;
+    memset(&zs, 0, sizeof(z_stream));
+    if (inflateInit2(&zs, -15) != Z_OK) HBN_ERR("fail to initialise zlib");
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->stop) {
+        if (reader->num_inflating_chunks < reader->num_read_chunks) {
+            HbnGzChunk* chunk = gz_chunk_slot(reader, reader->num_inflating_chunks);
+            ++reader->num_inflating_chunks;
+            chunk->state = eGzChunkInflating;
+            pthread_mutex_unlock(&reader->lock);
+            inflate_one_chunk(reader, chunk, &zs);
+            pthread_mutex_lock(&reader->lock);
+            chunk->state = eGzChunkInflated;
+            pthread_cond_broadcast(&reader->cond);
+            continue;
+        }
+        if (reader->all_chunks_read) break;
+        pthread_cond_wait(&reader->cond, &reader->lock);
+    }
+    pthread_mutex_unlock(&reader->lock);
+    inflateEnd(&zs);
+    return NULL;
+}
+
+HbnGzReader*
+HbnGzReaderNew(const char* path, const int num_threads)
+{
+    HbnGzReader* reader = (HbnGzReader*)calloc(1, sizeof(HbnGzReader));
+    reader->path = path;
+    reader->is_bgzf = num_threads > 0 && hbn_gz_file_is_bgzf(path);
+    if (reader->is_bgzf) {
+        hbn_fopen(reader->raw_stream, path, "rb");
+        reader->read_ahead = TRUE;
+        reader->num_inflate_threads = num_threads;
+        reader->num_chunks = 2 * reader->num_inflate_threads + 2;
+    } else {
+        hbn_gzopen(reader->gz_stream, path, "r");
+        gzbuffer(reader->gz_stream, 256 * 1024);
+        /// uncompressed text is not worth a thread, gzdirect() peeks at the header
+        reader->read_ahead = num_threads > 0 && !gzdirect(reader->gz_stream);
+        reader->num_inflate_threads = 0;
+        reader->num_chunks = 3;
+    }
+    if (!reader->read_ahead) return reader;
+    reader->chunks = (HbnGzChunk*)calloc(reader->num_chunks, sizeof(HbnGzChunk));
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+    pthread_create(&reader->reader_job, NULL, reader->is_bgzf ? bgzf_reader_thread : plain_reader_thread, reader);
+    if (reader->num_inflate_threads) {
+        reader->inflate_jobs = (pthread_t*)calloc(reader->num_inflate_threads, sizeof(pthread_t));
+        for (int i = 0; i < reader->num_inflate_threads; ++i) {
+            pthread_create(reader->inflate_jobs + i, NULL, inflate_thread, reader);
+        }
+    }
+    return reader;
+}
+
+HbnGzReader*
+HbnGzReaderFree(HbnGzReader* reader)
+{
+    if (!reader->read_ahead) {
+        hbn_gzclose(reader->gz_stream);
+        free(reader);
+        return NULL;
+    }
+    /// the caller may stop before the end of the input
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = TRUE;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->reader_job, NULL);
+    for (int i = 0; i < reader->num_inflate_threads; ++i) pthread_join(reader->inflate_jobs[i], NULL);
+    if (reader->inflate_jobs) free(reader->inflate_jobs);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->cond);
+
+    for (int i = 0; i < reader->num_chunks; ++i) {
+        HbnGzChunk* chunk = reader->chunks + i;
+        kv_destroy(chunk->comp);
+        kv_destroy(chunk->member_offsets);
+        kv_destroy(chunk->data);
+    }
+    free(reader->chunks);
+    if (reader->raw_stream) hbn_fclose(reader->raw_stream);
+    if (reader->gz_stream) hbn_gzclose(reader->gz_stream);
+    free(reader);
+    return NULL;
+}
+
+size_t
+HbnGzReaderRead(HbnGzReader* reader, void* buffer, size_t count)
+{
+    u8* dst = (u8*)(buffer);
+    size_t n = 0;
+    if (!reader->read_ahead) {
+        while (n < count && !reader->eof) {
+            const int m = gz_read_chunk(reader, dst + n, hbn_min(count - n, (size_t)PLAIN_CHUNK_SIZE));
+            if (m == 0) reader->eof = TRUE;
+            n += m;
+        }
+        return n;
+    }
+    while (n < count && !reader->eof) {
+        HbnGzChunk* chunk = gz_chunk_slot(reader, reader->curr_chunk);
+        pthread_mutex_lock(&reader->lock);
+        while (1) {
+            if (reader->curr_chunk < reader->num_read_chunks && chunk->state == eGzChunkInflated) break;
+            if (reader->all_chunks_read && reader->curr_chunk == reader->num_read_chunks) {
+                reader->eof = TRUE;
+                break;
+            }
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+        pthread_mutex_unlock(&reader->lock);
+        if (reader->eof) break;
+
+        const size_t left = kv_size(chunk->data) - reader->curr_pos;
+        const size_t m = hbn_min(left, count - n);
+        memcpy(dst + n, kv_data(chunk->data) + reader->curr_pos, m);
+        n += m;
+        reader->curr_pos += m;
+        if (reader->curr_pos == kv_size(chunk->data)) {
+            pthread_mutex_lock(&reader->lock);
+            chunk->state = eGzChunkFree;
+            ++reader->curr_chunk;
+            reader->curr_pos = 0;
+            pthread_cond_broadcast(&reader->cond);
+            pthread_mutex_unlock(&reader->lock);
+        }
+    }
+    return n;
+}
+
+BOOL
+HbnGzReaderEof(const HbnGzReader* reader)
+{
+    return reader->eof;
+}
@@ -0,0 +1,89 @@
+#ifndef __GZ_READER_H
+#define __GZ_READER_H
+
+#include "hbn_aux.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Read-ahead decompression for HbnLineReader.
+///
+/// With num_threads > 0 a compressed input is decompressed by background
+/// threads into a ring of chunks while the caller parses the chunks already
+/// done. BGZF files (the gzip flavour written by bgzip and samtools, a series
+/// of independent gzip members of at most 64 KiB) are read as raw members by
+/// one thread and the chunks are inflated by num_threads workers; plain gzip
+/// is read through zlib by one read-ahead thread. Uncompressed text, and any
+/// input when num_threads is 0, is read through zlib by the caller.
+
+typedef enum {
+    eGzChunkFree,
+    eGzChunkRead,
+    eGzChunkInflating,
+    eGzChunkInflated
+} EGzChunkState;
+
+typedef struct {
+    EGzChunkState state;
+    /// raw BGZF members, member i is comp[member_offsets[i], member_offsets[i+1])
+    vec_u8 comp;
+    vec_size_t member_offsets;
+    /// decompressed data
+    vec_u8 data;
+} HbnGzChunk;
+
+typedef struct {
+    const char* path;
+    BOOL is_bgzf;
+    /// FALSE if the caller reads gz_stream directly, no thread is started
+    BOOL read_ahead;
+    FILE* raw_stream;
+    gzFile gz_stream;
+
+    HbnGzChunk* chunks;
+    int num_chunks;
+    /// chunk i lives in chunks[i % num_chunks]
+    int num_read_chunks;
+    int num_inflating_chunks;
+    BOOL all_chunks_read;
+    /// set when the reader is freed before the end of the input
+    BOOL stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t reader_job;
+    pthread_t* inflate_jobs;
+    int num_inflate_threads;
+
+    /// the chunk being consumed
+    int curr_chunk;
+    size_t curr_pos;
+    BOOL eof;
+} HbnGzReader;
+
+/// whether the file starts with a BGZF member
+BOOL
+hbn_gz_file_is_bgzf(const char* path);
+
+HbnGzReader*
+HbnGzReaderNew(const char* path, const int num_threads);
+
+HbnGzReader*
+HbnGzReaderFree(HbnGzReader* reader);
+
+/// copies at most count decompressed bytes to buffer, returns the number
+/// of bytes copied, which is less than count only at the end of the input
+size_t
+HbnGzReaderRead(HbnGzReader* reader, void* buffer, size_t count);
+
+/// TRUE once every byte of the input has been returned by HbnGzReaderRead
+BOOL
+HbnGzReaderEof(const HbnGzReader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __GZ_READER_H
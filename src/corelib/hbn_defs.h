@@ -57,6 +57,7 @@ typedef u64         uidx;
 #define U16_MAX     UINT16_MAX
 #define I32_MIN     INT32_MIN
 #define I32_MAX     INT32_MAX
+#define U32_MAX     UINT32_MAX
 #define I64_MIN     INT64_MIN
 #define I64_MAX     INT64_MAX
 #define U64_MAX     UINT64_MAX
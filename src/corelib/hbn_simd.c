@@ -0,0 +1,50 @@
+#include "hbn_simd.h"
+
+#include <pthread.h>
+
+const char* simd_level_names[eSimdInvalid] = {
+    "scalar",
+    "sse4.1",
+    "avx2"
+};
+
+static pthread_once_t s_simd_level_once = PTHREAD_ONCE_INIT;
+static ESimdLevel s_cpu_simd_level = eSimdScalar;
+/// written with __atomic_store_n, read with __atomic_load_n
+static int s_simd_level = eSimdScalar;
+
+static void
+init_simd_level()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        s_cpu_simd_level = eSimdAvx2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        s_cpu_simd_level = eSimdSse41;
+    } else {
+        s_cpu_simd_level = eSimdScalar;
+    }
+    __atomic_store_n(&s_simd_level, s_cpu_simd_level, __ATOMIC_RELAXED);
+}
+
+ESimdLevel
+hbn_detect_simd_level()
+{
+    pthread_once(&s_simd_level_once, init_simd_level);
+    return s_cpu_simd_level;
+}
+
+void
+hbn_set_simd_level(ESimdLevel level)
+{
+    ESimdLevel max_level = hbn_detect_simd_level();
+    if (level > max_level) level = max_level;
+    __atomic_store_n(&s_simd_level, level, __ATOMIC_RELAXED);
+}
+
+ESimdLevel
+hbn_get_simd_level()
+{
+    pthread_once(&s_simd_level_once, init_simd_level);
+    return (ESimdLevel)__atomic_load_n(&s_simd_level, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,40 @@
+#ifndef __HBN_SIMD_H
+#define __HBN_SIMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The simd level used by every kernel with runtime dispatch. A kernel
+/// runs its widest version not above the level, the ones without an
+/// sse4.1 version run the scalar one at eSimdSse41.
+///
+/// The cpu is probed once (pthread_once) and the level starts at the best
+/// one it supports. hbn_set_simd_level() is meant for option parsing and
+/// benchmarks, before the worker threads start.
+
+typedef enum {
+    eSimdScalar,
+    eSimdSse41,
+    eSimdAvx2,
+    eSimdInvalid
+} ESimdLevel;
+
+extern const char* simd_level_names[eSimdInvalid];
+
+/// the best level supported by the cpu
+ESimdLevel
+hbn_detect_simd_level();
+
+/// levels above the one supported by the cpu are lowered to it
+void
+hbn_set_simd_level(ESimdLevel level);
+
+ESimdLevel
+hbn_get_simd_level();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HBN_SIMD_H
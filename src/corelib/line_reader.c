@@ -15,10 +15,10 @@ typedef enum {
 } ERW_Result;
 
 HbnBufferedLineReader*
-HbnBufferedLineReaderNew(const char* filename)
+HbnBufferedLineReaderNew(const char* filename, const int num_threads)
 {
     HbnBufferedLineReader* reader = (HbnBufferedLineReader*)calloc(1, sizeof(HbnBufferedLineReader));
-    hbn_gzopen(reader->stream, filename, "r");
+    reader->stream = HbnGzReaderNew(filename, num_threads);
     reader->eof = FALSE;
     reader->ungetline = FALSE;
     reader->buffer_size = 32 * 1024;
@@ -35,7 +35,7 @@ HbnBufferedLineReaderNew(const char* filename)
 HbnBufferedLineReader*
 HbnBufferedLineReaderFree(HbnBufferedLineReader* reader)
 {
-    hbn_gzclose(reader->stream);
+    HbnGzReaderFree(reader->stream);
     free(reader->buffer);
     ks_destroy(reader->line);
     free(reader);
@@ -44,7 +44,7 @@ HbnBufferedLineReaderFree(HbnBufferedLineReader* reader)
 
 BOOL HbnBufferedLineReaderAtEof(const HbnBufferedLineReader* reader)
 {
-    return gzeof(reader->stream) && (reader->pos >= reader->end) && (!reader->ungetline);
+    return HbnGzReaderEof(reader->stream) && (reader->pos >= reader->end) && (!reader->ungetline);
 }
 
 char HbnBufferedLineReaderPeekChar(HbnBufferedLineReader* reader)
@@ -78,21 +78,13 @@ void HbnBufferedLineReaderUngetline(HbnBufferedLineReader* reader)
 }
 
 static ERW_Result
-HbnBufferedLineReaderLoadData(gzFile stream, char* buffer, int count, int* bytes_read)
+HbnBufferedLineReaderLoadData(HbnGzReader* stream, char* buffer, int count, int* bytes_read)
 {
     ERW_Result result = eRW_Success;
-    int n = gzread(stream, buffer, count);
+    int n = HbnGzReaderRead(stream, buffer, count);
     if (n < count) {
-        hbn_assert(gzeof(stream));
-        if (gzeof(stream)) {
-            result = eRW_Eof;
-        } else {
-            int errno;
-            const char* error_string = gzerror(stream, &errno);
-            if (errno) {
-                HBN_ERR("%s", error_string);
-            }
-        }
+        hbn_assert(HbnGzReaderEof(stream));
+        result = eRW_Eof;
     }
     *bytes_read = n;
     return result;
@@ -298,5 +290,11 @@ HbnLineReaderFree(HbnLineReader* reader)
 HbnLineReader*
 HbnLineReaderNew(const char* filename)
 {
-    return HbnBufferedLineReaderNew(filename);
+    return HbnBufferedLineReaderNew(filename, 0);
+}
+
+HbnLineReader*
+HbnLineReaderNewWithThreads(const char* filename, const int num_threads)
+{
+    return HbnBufferedLineReaderNew(filename, num_threads);
 }
\ No newline at end of file
@@ -2,13 +2,14 @@
 #define __LINE_READER_H
 
 #include "hbn_aux.h"
+#include "gz_reader.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct {
-    gzFile      stream;
+    HbnGzReader* stream;
     BOOL        eof;
     BOOL        ungetline;
     size_t      last_read_size;
@@ -43,6 +44,10 @@ HbnLineReaderFree(HbnLineReader* reader);
 HbnLineReader*
 HbnLineReaderNew(const char* filename);
 
+/// decompresses the input on num_threads background threads, see HbnGzReaderNew()
+HbnLineReader*
+HbnLineReaderNewWithThreads(const char* filename, const int num_threads);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,6 @@
 #include "partition_aux.h"
 
-#include <pthread.h>
+#include "cstr_util.h"
 
 void
 make_partition_name(const char* data_dir, const char* prefix, const int pid, char path[])
@@ -59,201 +59,136 @@ void* load_part_records(const char* path, const size_t record_size, size_t* n_re
     return a;    
 }
 
-typedef struct {
-    FILE** out_list;
+/// Records of every part are collected in memory and appended to the part
+/// files whenever the buffered records outgrow the memory budget, so the
+/// record file is read once whatever the number of parts, and at most one
+/// part file is open at any time.
+struct RecordWriter {
+    const char* wrk_dir;
+    vec_u8* buf_list;
     int n;
-} RecordWriter;
-
-RecordWriter*
-can_writer_new(const char* wrk_dir, const int pid_from, const int pid_to)
+    size_t buffered_bytes;
+    size_t mem_budget;
+    size_t bytes_written;
+    int num_spills;
+};
+
+static RecordWriter*
+record_writer_new(const char* wrk_dir, const int num_parts, const size_t mem_budget)
 {
-    RecordWriter* w = (RecordWriter*)malloc( sizeof(RecordWriter) );
-    int n = pid_to - pid_from;
-    w->out_list = (FILE**)malloc( sizeof(FILE*) * n );
-    w->n = n;
+    RecordWriter* w = (RecordWriter*)calloc(1, sizeof(RecordWriter));
+    w->wrk_dir = wrk_dir;
+    w->buf_list = (vec_u8*)calloc(num_parts, sizeof(vec_u8));
+    w->n = num_parts;
+    w->mem_budget = mem_budget;
+    /// parts without any record still get an empty file
     char path[HBN_MAX_PATH_LEN];
-    for (int i = pid_from; i < pid_to; ++i) {
+    for (int i = 0; i < num_parts; ++i) {
         make_partition_name(wrk_dir, DEFAULT_PART_PREFIX, i, path);
-        int fid = i - pid_from;
-        hbn_fopen(w->out_list[fid], path, "wb");
+        hbn_dfopen(out, path, "wb");
+        hbn_fclose(out);
     }
     return w;
 }
 
-RecordWriter*
-can_writer_free(RecordWriter* w)
+static void
+record_writer_spill(RecordWriter* w)
+{
+    char path[HBN_MAX_PATH_LEN];
+    for (int i = 0; i < w->n; ++i) {
+        vec_u8* buf = w->buf_list + i;
+        if (kv_empty(*buf)) continue;
+        make_partition_name(w->wrk_dir, DEFAULT_PART_PREFIX, i, path);
+        hbn_dfopen(out, path, "ab");
+        hbn_fwrite(kv_data(*buf), 1, kv_size(*buf), out);
+        hbn_fclose(out);
+        w->bytes_written += kv_size(*buf);
+        /// give the memory back, the next round may fill other parts
+        kv_destroy(*buf);
+        kv_init(*buf);
+    }
+    w->buffered_bytes = 0;
+    ++w->num_spills;
+}
+
+static void
+record_writer_add(RecordWriter* w, const int pid, const void* records, const size_t num_bytes)
 {
-    for (int i = 0; i < w->n; ++i) hbn_fclose(w->out_list[i]);
-    free(w->out_list);
+    hbn_assert(pid < w->n);
+    kv_push_v(u8, w->buf_list[pid], records, num_bytes);
+    w->buffered_bytes += num_bytes;
+    if (w->buffered_bytes >= w->mem_budget) record_writer_spill(w);
+}
+
+static RecordWriter*
+record_writer_free(RecordWriter* w)
+{
+    hbn_assert(w->buffered_bytes == 0);
+    free(w->buf_list);
     free(w);
     return NULL;
 }
 
-static size_t
-load_records(void* array, const size_t size, const size_t count, FILE* in, pthread_mutex_t* in_lock)
+size_t
+part_record_load(PartRecordData* data, void* a, const size_t max_records)
 {
-    size_t n = 0;
-    pthread_mutex_lock(in_lock);
-    n = fread(array, size, count, in);
-    pthread_mutex_unlock(in_lock);
+    pthread_mutex_lock(&data->in_lock);
+    size_t n = fread(a, data->record_size, max_records, data->in);
+    data->bytes_read += n * data->record_size;
+    pthread_mutex_unlock(&data->in_lock);
     return n;
 }
 
-typedef struct {
-    FILE* in;
-    pthread_mutex_t*            in_lock;
-    RecordWriter*               w;
-    pthread_mutex_t*            w_lock;
-    qid_extract_func           get_qid;
-    sid_extract_func           get_sid;
-    change_record_roles_func    change_roles;
-    normolize_sdir_func        normalise_sdir;
-    record_sort_func           sort_records;
-    int                         min_read_id;
-    int                         max_read_id;
-    int                         batch_size;
-    size_t                      record_size;
-} PartRecordData;
-
-#define id_in_range(id, L, R) ((id) >= (L) && (id) < (R))
-
-static void*
-pcan_worker(void* param)
+void
+part_record_dump(PartRecordData* data, const void* a, const size_t* run_from, const int* run_pid, const int num_runs)
 {
-    PartRecordData* data = (PartRecordData*)(param);
-    const size_t S = U64_ONE * 256 * 1024 * 1024;
-    const size_t N = S / data->record_size;
-    const size_t N2 = 2 * N;
-    void* a = malloc( N2 * data->record_size );
-    void* record = malloc( data->record_size );
-    kv_dinit(vec_size_t, idx_range);
-
-    size_t n, m;
-    while ((n = load_records(a, data->record_size, N, data->in, data->in_lock))) {
-        m = 0;
-        for (size_t i = 0; i < n; ++i) {
-            void* e = a + data->record_size * i;
-            int qid = (*data->get_qid)(e);
-            int sid = (*data->get_sid)(e);
-            int r = id_in_range(qid, data->min_read_id, data->max_read_id) || 
-                    id_in_range(sid, data->min_read_id, data->max_read_id);
-            if (r) {
-                (*data->normalise_sdir)(e);
-                if (i > m) memcpy(a + m * data->record_size, a + i * data->record_size, data->record_size);
-                ++m;
-            }
-        }
-        if (m == 0) continue;
-        n = m;
-        for (size_t i = 0; i < m; ++i) {
-            void* e = a + i * data->record_size;
-            int sid_is_in = 0;
-            int sid = (*data->get_sid)(e);
-            if (id_in_range(sid, data->min_read_id, data->max_read_id)) sid_is_in = 1;
-            int qid = (*data->get_qid)(e);
-            if (id_in_range(qid, data->min_read_id, data->max_read_id)) {
-                (*data->change_roles)(e, record);
-                (*data->normalise_sdir)(record);
-                if (sid_is_in) {
-                    memcpy(a + n * data->record_size, record, data->record_size);
-                    ++n;
-                } else {
-                    memcpy(a + i * data->record_size, record, data->record_size);
-                }
-            }
-        }
-
-        (*data->sort_records)(n, a);
-        kv_clear(idx_range);
-        kv_push(size_t, idx_range, 0);
-        size_t i = 0;
-        while (i < n) {
-            void* e = a + i * data->record_size;
-            const int sid = (*data->get_sid)(e);
-            const int pid = sid / data->batch_size;
-            const int sid_from = pid * data->batch_size;
-            const int sid_to = sid_from + data->batch_size;
-            size_t j = i + 1;
-            while (j < n) {
-                e = a + j * data->record_size;
-                int id = (*data->get_sid)(e);
-                if (id >= sid_to) break;
-                ++j;
-            }
-            kv_push(size_t, idx_range, j);
-            i = j;
-        }
-        hbn_assert(kv_back(idx_range) == n);
-
-        pthread_mutex_lock(data->w_lock);
-        for (i = 0; i < kv_size(idx_range) - 1; ++i) {
-            size_t from = kv_A(idx_range, i);
-            size_t to = kv_A(idx_range, i + 1);
-            m = to - from;
-            void* e = a + from * data->record_size;
-            int sid = (*data->get_sid)(e);
-            int fid = (sid - data->min_read_id) / data->batch_size;
-            hbn_assert(fid < data->w->n);
-            hbn_fwrite(a + from * data->record_size, data->record_size, m, data->w->out_list[fid]);
-        }
-        pthread_mutex_unlock(data->w_lock);
+    const u8* p = (const u8*)(a);
+    pthread_mutex_lock(&data->w_lock);
+    for (int i = 0; i < num_runs; ++i) {
+        const size_t from = run_from[i] * data->record_size;
+        const size_t to = run_from[i + 1] * data->record_size;
+        record_writer_add(data->w, run_pid[i], p + from, to - from);
     }
-
-    free(record);
-    free(a);
-    kv_destroy(idx_range);
-    return NULL;
+    pthread_mutex_unlock(&data->w_lock);
 }
 
 void
-part_record_main(const char* part_wrk_dir,
+part_record_run(const char* part_wrk_dir,
     const char* record_path,
     const int num_batches,
     const int batch_size,
     const int num_threads,
-    const int num_dumpped_files,
+    const size_t mem_budget,
     const size_t record_size,
-    qid_extract_func           get_qid,
-    sid_extract_func           get_sid,
-    change_record_roles_func    change_roles,
-    normolize_sdir_func        normalise_sdir,
-    record_sort_func           sort_records)
+    void* (*worker)(void*))
 {
-    pthread_mutex_t in_lock;
-    pthread_mutex_init(&in_lock, NULL);
-    pthread_mutex_t out_lock;
-    pthread_mutex_init(&out_lock, NULL);
     pthread_t job_ids[num_threads];
-
-    for (int fid = 0; fid < num_batches; fid += num_dumpped_files) {
-        int sfid = fid;
-        int efid = hbn_min(sfid + num_dumpped_files, num_batches);
-        int min_read_id = sfid * batch_size;
-        int max_read_id = efid * batch_size;
-        RecordWriter* w = can_writer_new(part_wrk_dir, sfid, efid);
-        hbn_dfopen(record_in, record_path, "rb");
-        PartRecordData can_data = {
-            record_in,
-            &in_lock,
-            w,
-            &out_lock,
-            get_qid,
-            get_sid,
-            change_roles,
-            normalise_sdir,
-            sort_records,
-            min_read_id,
-            max_read_id,
-            batch_size,
-            record_size
-        };
-        for (int i = 0; i < num_threads; ++i) {
-            pthread_create(job_ids + i, NULL, pcan_worker, &can_data);
-        }
-        for (int i = 0; i < num_threads; ++i) {
-            pthread_join(job_ids[i], NULL);
-        }
-        hbn_fclose(record_in);
-        can_writer_free(w);
+    PartRecordData data;
+    memset(&data, 0, sizeof(PartRecordData));
+    hbn_fopen(data.in, record_path, "rb");
+    pthread_mutex_init(&data.in_lock, NULL);
+    data.w = record_writer_new(part_wrk_dir, num_batches, mem_budget);
+    pthread_mutex_init(&data.w_lock, NULL);
+    data.max_read_id = num_batches * batch_size;
+    data.batch_size = batch_size;
+    data.record_size = record_size;
+
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(job_ids + i, NULL, worker, &data);
     }
-}
\ No newline at end of file
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(job_ids[i], NULL);
+    }
+    hbn_fclose(data.in);
+    RecordWriter* w = data.w;
+    if (w->buffered_bytes) record_writer_spill(w);
+    char buf1[64], buf2[64];
+    HBN_LOG("%d parts written in 1 pass: %s read, %s written in %d spills",
+        num_batches,
+        u64_to_string_datasize(data.bytes_read, buf1),
+        u64_to_string_datasize(w->bytes_written, buf2),
+        w->num_spills);
+    record_writer_free(w);
+    pthread_mutex_destroy(&data.in_lock);
+    pthread_mutex_destroy(&data.w_lock);
+}
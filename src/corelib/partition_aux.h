@@ -3,6 +3,8 @@
 
 #include "hbn_aux.h"
 
+#include <pthread.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,27 +20,149 @@ dump_partition_count(const char* data_dir, const char* prefix, const int np);
 int
 load_partition_count(const char* data_dir, const char* prefix);
 
-typedef int (*qid_extract_func)(void* r);
-typedef int (*sid_extract_func)(void* r);
-typedef void (*change_record_roles_func)(void* src, void* dst);
-typedef void (*normolize_sdir_func)(void* r);
-typedef void (*record_sort_func)(size_t n, void* a);
-
 void* load_part_records(const char* path, const size_t record_size, size_t* n_record);
 
+/// Splitting a record file into parts.
+///
+/// PART_RECORD_INIT(name, type, change_roles, normalise_sdir) generates
+/// part_record_main_##name(), which splits the records of record_path
+/// into num_batches part files under part_wrk_dir in one pass. A record
+/// goes to the part of its subject and, with the roles changed, to the part
+/// of its query. At most mem_budget bytes of records are buffered before
+/// they are appended to the part files.
+///
+/// type must have int qid and sid fields. change_roles(const type* src,
+/// type* dst) swaps the query and the subject, normalise_sdir(type* r) puts
+/// the subject on the forward strand. Both are expanded inline in the
+/// kernel, and the records of a chunk are ordered by subject with a stable
+/// radix sort.
+
+typedef struct RecordWriter RecordWriter;
+
+/// shared by the workers of one run
+typedef struct {
+    FILE*               in;
+    pthread_mutex_t     in_lock;
+    RecordWriter*       w;
+    pthread_mutex_t     w_lock;
+    int                 max_read_id;
+    int                 batch_size;
+    size_t              record_size;
+    size_t              bytes_read;
+} PartRecordData;
+
+/// reads the next chunk of at most max_records records into a
+size_t
+part_record_load(PartRecordData* data, void* a, const size_t max_records);
+
+/// run i is a[run_from[i], run_from[i + 1]), all of its records go to part run_pid[i]
 void
-part_record_main(const char* part_wrk_dir,
+part_record_dump(PartRecordData* data, const void* a, const size_t* run_from, const int* run_pid, const int num_runs);
+
+void
+part_record_run(const char* part_wrk_dir,
     const char* record_path,
     const int num_batches,
     const int batch_size,
     const int num_threads,
-    const int num_dumpped_files,
+    const size_t mem_budget,
     const size_t record_size,
-    qid_extract_func get_qid,
-    sid_extract_func get_sid,
-    change_record_roles_func change_roles,
-    normolize_sdir_func normalise_sdir,
-    record_sort_func sort_records);
+    void* (*worker)(void*));
+
+/// records read by a worker at a time, the worker holds twice as many for
+/// the records with changed roles and as many again for sorting
+#define PART_RECORD_CHUNK_BYTES     (U64_ONE * 128 * 1024 * 1024)
+#define PART_RECORD_RADIX_BITS      11
+
+#define part_record_id_in_range(id, R) ((id) >= 0 && (id) < (R))
+
+#define PART_RECORD_INIT(name, type, change_roles, normalise_sdir) \
+    /* returns a or b, whichever holds the sorted records */ \
+    static type* part_record_radix_sort_##name(type* a, type* b, const size_t n, const int max_sid) \
+    { \
+        const int num_buckets = 1 << PART_RECORD_RADIX_BITS; \
+        const u32 mask = num_buckets - 1; \
+        size_t cnts[1 << PART_RECORD_RADIX_BITS]; \
+        for (int shift = 0; shift < 32 && (((u32)max_sid) >> shift); shift += PART_RECORD_RADIX_BITS) { \
+            memset(cnts, 0, sizeof(size_t) * num_buckets); \
+            for (size_t i = 0; i < n; ++i) ++cnts[((u32)a[i].sid >> shift) & mask]; \
+            if (n == 0 || cnts[((u32)a[0].sid >> shift) & mask] == n) continue; \
+            size_t sum = 0; \
+            for (int k = 0; k < num_buckets; ++k) { \
+                const size_t c = cnts[k]; \
+                cnts[k] = sum; \
+                sum += c; \
+            } \
+            for (size_t i = 0; i < n; ++i) b[cnts[((u32)a[i].sid >> shift) & mask]++] = a[i]; \
+            type* t = a; a = b; b = t; \
+        } \
+        return a; \
+    } \
+    \
+    static void* part_record_worker_##name(void* param) \
+    { \
+        PartRecordData* data = (PartRecordData*)(param); \
+        const int R = data->max_read_id; \
+        const size_t N = PART_RECORD_CHUNK_BYTES / sizeof(type); \
+        type* a = (type*)malloc(sizeof(type) * 2 * N); \
+        type* b = (type*)malloc(sizeof(type) * 2 * N); \
+        kv_dinit(vec_size_t, run_from); \
+        kv_dinit(vec_int, run_pid); \
+        size_t n; \
+        while ((n = part_record_load(data, a, N))) { \
+            size_t m = 0; \
+            for (size_t i = 0; i < n; ++i) { \
+                if (!part_record_id_in_range(a[i].qid, R) && !part_record_id_in_range(a[i].sid, R)) continue; \
+                if (i > m) a[m] = a[i]; \
+                normalise_sdir(a + m); \
+                ++m; \
+            } \
+            n = m; \
+            for (size_t i = 0; i < m; ++i) { \
+                if (!part_record_id_in_range(a[i].qid, R)) continue; \
+                type r; \
+                change_roles(a + i, &r); \
+                normalise_sdir(&r); \
+                if (part_record_id_in_range(a[i].sid, R)) { \
+                    a[n++] = r; \
+                } else { \
+                    a[i] = r; \
+                } \
+            } \
+            if (n == 0) continue; \
+            const type* s = part_record_radix_sort_##name(a, b, n, R - 1); \
+            kv_clear(run_from); \
+            kv_clear(run_pid); \
+            size_t i = 0; \
+            while (i < n) { \
+                const int pid = s[i].sid / data->batch_size; \
+                const int sid_to = (pid + 1) * data->batch_size; \
+                size_t j = i + 1; \
+                while (j < n && s[j].sid < sid_to) ++j; \
+                kv_push(size_t, run_from, i); \
+                kv_push(int, run_pid, pid); \
+                i = j; \
+            } \
+            kv_push(size_t, run_from, n); \
+            part_record_dump(data, s, kv_data(run_from), kv_data(run_pid), kv_size(run_pid)); \
+        } \
+        free(a); \
+        free(b); \
+        kv_destroy(run_from); \
+        kv_destroy(run_pid); \
+        return NULL; \
+    } \
+    \
+    static void part_record_main_##name(const char* part_wrk_dir, \
+        const char* record_path, \
+        const int num_batches, \
+        const int batch_size, \
+        const int num_threads, \
+        const size_t mem_budget) \
+    { \
+        part_record_run(part_wrk_dir, record_path, num_batches, batch_size, num_threads, \
+            mem_budget, sizeof(type), part_record_worker_##name); \
+    }
 
 #ifdef __cplusplus
 }
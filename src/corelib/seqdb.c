@@ -1,5 +1,7 @@
 #include "seqdb.h"
 
+#include "unpack_pac.h"
+
 void
 make_ambig_subseq_path(const char* data_dir, const char* db_name, char path[])
 {
@@ -130,7 +132,7 @@ seqdb_load_unpac(const char* seqdb_dir, const char* seqdb_title, const size_t re
     u8* pac = seqdb_load_pac(seqdb_dir, seqdb_title, res_from, res_to);
     size_t res_cnt = res_to - res_from;
     u8* unpac = (u8*)calloc(res_cnt, sizeof(u8));
-    for (size_t i = 0; i < res_cnt; ++i) unpac[i] = _get_pac(pac, i);
+    unpack_pac_fwd(pac, 0, res_cnt, unpac);
     free(pac);
     return unpac;
 }
@@ -270,24 +272,11 @@ seqdb_extract_subsequence(const CSeqDB* seqdb,
     size_t start = seqdb_seq_offset(seqdb, seq_id);
     size_t size = seqdb_seq_size(seqdb, seq_id);
     hbn_assert(from <= to && to <= size);
-    kv_clear(*seq);
+    kv_resize(u8, *seq, to - from);
     if (strand == FWD) {
-        size_t sfrom = start + from;
-        size_t sto = start + to;
-        for (size_t i = sfrom; i < sto; ++i) {
-            u8 c = _get_pac(seqdb->packed_seq, i);
-            kv_push(u8, *seq, c);
-        }        
+        unpack_pac_fwd(seqdb->packed_seq, start + from, to - from, kv_data(*seq));
     } else {
-        size_t sfrom = start + (size - to);
-        size_t sto = start + (size - from);
-        size_t i = sto;
-        while (i > sfrom) {
-            --i;
-            u8 c = _get_pac(seqdb->packed_seq, i);
-            c = 3 - c;
-            kv_push(u8, *seq, c);
-        }
+        unpack_pac_rev(seqdb->packed_seq, start + (size - to), to - from, kv_data(*seq));
     }
 }
 
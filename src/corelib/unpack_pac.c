@@ -0,0 +1,165 @@
+#include "unpack_pac.h"
+
+#include <immintrin.h>
+
+void
+unpack_pac_fwd_scalar(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    const size_t to = from + cnt;
+    size_t i = from;
+    for (; i < to && (i & 3); ++i) *dst++ = _get_pac(pac, i);
+    for (; i + 4 <= to; i += 4) {
+        const u8 b = pac[i >> 2];
+        dst[0] = b >> 6;
+        dst[1] = (b >> 4) & 3;
+        dst[2] = (b >> 2) & 3;
+        dst[3] = b & 3;
+        dst += 4;
+    }
+    for (; i < to; ++i) *dst++ = _get_pac(pac, i);
+}
+
+void
+unpack_pac_rev_scalar(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    size_t i = from + cnt;
+    while (i > from && (i & 3)) {
+        --i;
+        *dst++ = 3 - _get_pac(pac, i);
+    }
+    for (; i >= from + 4; i -= 4) {
+        const u8 b = ~pac[(i >> 2) - 1];
+        dst[0] = b & 3;
+        dst[1] = (b >> 2) & 3;
+        dst[2] = (b >> 4) & 3;
+        dst[3] = b >> 6;
+        dst += 4;
+    }
+    while (i > from) {
+        --i;
+        *dst++ = 3 - _get_pac(pac, i);
+    }
+}
+
+/// Decodes the 32 bases of the 8 packed bytes in x. Output byte q takes
+/// packed byte rep[q], the high nibble of it where hi_nibble[q] is set and
+/// the low one elsewhere, and looks the nibble up in first_lut where
+/// first_base[q] is set (the base in the upper two bits of the nibble) and
+/// in second_lut elsewhere.
+__attribute__((target("avx2")))
+static inline __m256i
+unpack_32_bases(const u64 x,
+    const __m256i rep,
+    const __m256i hi_nibble,
+    const __m256i first_base,
+    const __m256i first_lut,
+    const __m256i second_lut)
+{
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    __m256i r = _mm256_shuffle_epi8(_mm256_set1_epi64x((long long)x), rep);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(r, 4), low4);
+    __m256i lo = _mm256_and_si256(r, low4);
+    __m256i nib = _mm256_blendv_epi8(lo, hi, hi_nibble);
+    return _mm256_blendv_epi8(_mm256_shuffle_epi8(second_lut, nib),
+                              _mm256_shuffle_epi8(first_lut, nib),
+                              first_base);
+}
+
+#define N0 0
+#define NF -1
+
+__attribute__((target("avx2")))
+void
+unpack_pac_fwd_avx2(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    const size_t to = from + cnt;
+    size_t i = from;
+    for (; i < to && (i & 3); ++i) *dst++ = _get_pac(pac, i);
+    if (i + 32 <= to) {
+        /// output byte q holds base q & 3 of packed byte q >> 2
+        const __m256i rep = _mm256_setr_epi8(
+            0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+            4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+        const __m256i hi_nibble = _mm256_setr_epi8(
+            NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0,
+            NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0);
+        const __m256i first_base = _mm256_setr_epi8(
+            NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0,
+            NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0);
+        const __m256i first_lut = _mm256_setr_epi8(
+            0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+            0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+        const __m256i second_lut = _mm256_setr_epi8(
+            0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3,
+            0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+        for (; i + 32 <= to; i += 32) {
+            u64 x;
+            memcpy(&x, pac + (i >> 2), sizeof(u64));
+            __m256i v = unpack_32_bases(x, rep, hi_nibble, first_base, first_lut, second_lut);
+            _mm256_storeu_si256((__m256i*)dst, v);
+            dst += 32;
+        }
+    }
+    unpack_pac_fwd_scalar(pac, i, to - i, dst);
+}
+
+__attribute__((target("avx2")))
+void
+unpack_pac_rev_avx2(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    size_t i = from + cnt;
+    while (i > from && (i & 3)) {
+        --i;
+        *dst++ = 3 - _get_pac(pac, i);
+    }
+    if (i >= from + 32) {
+        /// output byte q holds the complement of base 3 - (q & 3) of
+        /// packed byte 7 - (q >> 2)
+        const __m256i rep = _mm256_setr_epi8(
+            7, 7, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4,
+            3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+        const __m256i hi_nibble = _mm256_setr_epi8(
+            N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF,
+            N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF, N0, N0, NF, NF);
+        const __m256i first_base = _mm256_setr_epi8(
+            N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF,
+            N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF, N0, NF);
+        const __m256i first_lut = _mm256_setr_epi8(
+            3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0,
+            3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+        const __m256i second_lut = _mm256_setr_epi8(
+            3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0,
+            3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0);
+        for (; i >= from + 32; i -= 32) {
+            u64 x;
+            memcpy(&x, pac + (i >> 2) - 8, sizeof(u64));
+            __m256i v = unpack_32_bases(x, rep, hi_nibble, first_base, first_lut, second_lut);
+            _mm256_storeu_si256((__m256i*)dst, v);
+            dst += 32;
+        }
+    }
+    unpack_pac_rev_scalar(pac, from, i - from, dst);
+}
+
+#undef N0
+#undef NF
+
+void
+unpack_pac_fwd(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    if (cnt >= 32 && hbn_get_simd_level() >= eSimdAvx2) {
+        unpack_pac_fwd_avx2(pac, from, cnt, dst);
+    } else {
+        unpack_pac_fwd_scalar(pac, from, cnt, dst);
+    }
+}
+
+void
+unpack_pac_rev(const u8* pac, const size_t from, const size_t cnt, u8* dst)
+{
+    if (cnt >= 32 && hbn_get_simd_level() >= eSimdAvx2) {
+        unpack_pac_rev_avx2(pac, from, cnt, dst);
+    } else {
+        unpack_pac_rev_scalar(pac, from, cnt, dst);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef __UNPACK_PAC_H
+#define __UNPACK_PAC_H
+
+#include "hbn_aux.h"
+#include "hbn_simd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Bulk decoding of 2-bit packed sequences (see _get_pac).
+///
+/// The scalar kernels decode one packed byte (four bases) per step. The
+/// avx2 kernels decode eight packed bytes (32 bases) per step: a byte
+/// shuffle copies every packed byte to the four output positions of its
+/// bases, the nibble holding each base is selected, and two 16-entry
+/// shuffle tables turn the nibble into the base. The reverse complement
+/// uses the same steps with mirrored shuffle indices and complemented
+/// tables, so it costs no more than the forward strand. The avx2 kernels
+/// are used at simd level eSimdAvx2.
+
+/// dst[i] = _get_pac(pac, from + i) for 0 <= i < cnt
+void
+unpack_pac_fwd(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+/// dst[i] = 3 - _get_pac(pac, from + cnt - 1 - i) for 0 <= i < cnt
+void
+unpack_pac_rev(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+void
+unpack_pac_fwd_scalar(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+void
+unpack_pac_rev_scalar(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+void
+unpack_pac_fwd_avx2(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+void
+unpack_pac_rev_avx2(const u8* pac, const size_t from, const size_t cnt, u8* dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __UNPACK_PAC_H
@@ -14,9 +14,11 @@ SOURCES      := \
 	./corelib/db_format.c \
 	./corelib/fasta.c \
 	./corelib/gapped_candidate.c \
+	./corelib/gz_reader.c \
 	./corelib/hbn_aux.c \
 	./corelib/hbn_format.c \
 	./corelib/hbn_hit.c \
+	./corelib/hbn_simd.c \
 	./corelib/hbn_package_version.c \
 	./corelib/kstring.c \
 	./corelib/line_reader.c \
@@ -30,14 +32,20 @@ SOURCES      := \
 	./corelib/seq_tag_report.cpp \
 	./corelib/small_object_alloc.c \
 	./corelib/string2hsp.c \
+	./corelib/unpack_pac.c \
+	./algo/bit_parallel_ed.c \
 	./algo/chain_dp.c \
 	./algo/diff_gapalign.cpp \
 	./algo/hash_list_bucket_sort.c \
 	./algo/kalloc.c \
 	./algo/ksw2_extd2_sse.c \
+	./algo/ksw2_extd2_avx2.c \
 	./algo/ksw2_extz2_sse.c \
+	./algo/ksw2_extz2_avx2.c \
 	./algo/ksw2_wrapper.c \
 	./algo/hbn_lookup_table.c \
+	./algo/kmer_hash.c \
+	./algo/kmer_mphf.c \
 	./algo/hbn_traceback_aux.c \
 	./algo/word_finder.c \
 	./ncbi_blast/c_ncbi_blast_aux.c \
@@ -86,4 +94,6 @@ SUBMAKEFILES := \
 	./app/fsa/assemble.mk \
 	./app/fsa/bridge.mk	\
 	./app/fsa/rd_stat.mk \
-	./pipeline/main.mk \
\ No newline at end of file
+	./app/fsa/convert.mk \
+	./pipeline/main.mk \
+	./app/test/main.mk \
\ No newline at end of file
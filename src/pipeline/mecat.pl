@@ -244,7 +244,7 @@ sub runAlignTReads($$) {
     my $binPath = %$env{"BinPath"};
     my $trimReads = "$prjDir/2-trim_bases/trimReads.fasta";
 
-    my $asmPm = "$workDir/asm_pm.m4";
+    my $asmPm = "$workDir/asm_pm.m4x";
     my $options = %$cfg{"ASM_OVLP_OPTIONS"};
     my $thread = %$cfg{"THREADS"};
 
@@ -254,7 +254,7 @@ sub runAlignTReads($$) {
         ofiles => [],
         gfiles => [],
         mfiles => [],
-        cmds => ["$binPath/mecat2map $options -task pm -num_threads $thread -db_dir $volDir -out $asmPm $trimReads $trimReads"],
+        cmds => ["$binPath/mecat2map $options -task pm -num_threads $thread -db_dir $volDir -keep_db -outfmt m4x -out $asmPm $trimReads $trimReads"],
         msg => "pairwise mapping of trimmed reads",
     );
     
@@ -262,7 +262,7 @@ sub runAlignTReads($$) {
         name => "altr_job",
         ifiles => [$trimReads],
         ofiles => [$asmPm],
-        mfiles => [$volDir],
+        mfiles => [],
         jobs => [$jobPm],
         msg => "aligning trimmed reads for assembling",
     );
@@ -278,10 +278,12 @@ sub runAssemble($$) {
     mkdir $workDir;
 
     my $script = "$prjDir/scripts/assemble.sh";
-    my $overlaps = "$prjDir/3-assembly/asm_pm.m4";
+    my $overlaps = "$prjDir/3-assembly/asm_pm.m4x";
+    # the read ids of the m4x records are ordinals in this database
+    my $overlapsDb = "$prjDir/3-assembly/asm_pm_dir";
     my $reads = "$prjDir/2-trim_bases/trimReads.fasta";
     my $contigs = "$workDir/contigs.fasta";
-    my $filtered_overlaps = "$workDir/filter.m4";
+    my $filtered_overlaps = "$workDir/filter.ovb";
 
     my $binPath = %$env{"BinPath"}; 
     my $thread = %$cfg{"THREADS"};
@@ -296,8 +298,8 @@ sub runAssemble($$) {
         ifiles => [$overlaps, $reads],
         ofiles => [$filtered_overlaps, $contigs],
         gfiles => [$filtered_overlaps, $contigs],
-        mfiles => [],
-        cmds => ["$binPath/fsa_ol_filter $overlaps $filtered_overlaps --thread_size=$thread --output_directory=$workDir $filterOptions", 
+        mfiles => [$overlapsDb],
+        cmds => ["$binPath/fsa_ol_filter $overlaps $filtered_overlaps --m4x_seqdb=$overlapsDb --thread_size=$thread --output_directory=$workDir $filterOptions", 
                  "$binPath/fsa_assemble $filtered_overlaps --read_file=$reads --thread_size=$thread --output_directory=$workDir $assembleOptions"],
         msg => "assembling",
     );